@@ -104,6 +104,9 @@
 #include "llc.h"
 #include "extract.h"
 #include "oui.h"
+#include "namecache.h"
+#include "namedb.h"
+#include "resolver.h"
 
 /*
  * hash tables for whatever-to-name translations
@@ -119,12 +122,42 @@ struct hnamemem {
 	struct hnamemem *nxt;
 };
 
-static struct hnamemem hnametable[HASHNAMESIZE];
-static struct hnamemem tporttable[HASHNAMESIZE];
-static struct hnamemem uporttable[HASHNAMESIZE];
-static struct hnamemem eprototable[HASHNAMESIZE];
-static struct hnamemem dnaddrtable[HASHNAMESIZE];
-static struct hnamemem ipxsaptable[HASHNAMESIZE];
+/*
+ * The names of IPv4 and IPv6 hosts, of MAC-48 and other link-layer
+ * addresses, of NSAPs and of SNAP protocol IDs, of which there can be
+ * any number, are kept in bounded caches (see namecache.h) rather than
+ * in hash tables like the above.
+ */
+static ND_THREAD_LOCAL struct name_cache hname_cache =
+    NAME_CACHE_INIT(sizeof(nd_ipv4));
+static ND_THREAD_LOCAL struct name_cache h6name_cache =
+    NAME_CACHE_INIT(sizeof(nd_ipv6));
+static ND_THREAD_LOCAL struct name_cache ename_cache =
+    NAME_CACHE_INIT(MAC48_LEN);
+static ND_THREAD_LOCAL struct name_cache bsname_cache =
+    NAME_CACHE_INIT_VAR;
+static ND_THREAD_LOCAL struct name_cache nsapname_cache =
+    NAME_CACHE_INIT_VAR;
+static ND_THREAD_LOCAL struct name_cache protoidname_cache =
+    NAME_CACHE_INIT(5);
+
+/*
+ * With --async-dns, the name of a host is its numeric address until
+ * the answer to the lookup arrives; if the lookup fails, the host is
+ * looked up again once the negative cache TTL has passed.
+ */
+#define RESOLVE_DONE		0	/* the name is final */
+#define RESOLVE_PENDING		1	/* waiting for the answer */
+#define RESOLVE_FAILED		2	/* look it up again after retry */
+
+/* Seconds before retrying a lookup dropped because the queue was full */
+#define RESOLVE_DROPPED_RETRY	1
+
+static ND_THREAD_LOCAL struct hnamemem tporttable[HASHNAMESIZE];
+static ND_THREAD_LOCAL struct hnamemem uporttable[HASHNAMESIZE];
+static ND_THREAD_LOCAL struct hnamemem eprototable[HASHNAMESIZE];
+static ND_THREAD_LOCAL struct hnamemem dnaddrtable[HASHNAMESIZE];
+static ND_THREAD_LOCAL struct hnamemem ipxsaptable[HASHNAMESIZE];
 
 #ifdef _WIN32
 /*
@@ -137,8 +170,8 @@ static struct hnamemem ipxsaptable[HASHNAMESIZE];
 static struct hostent *
 win32_gethostbyaddr(const char *addr, int len, int type)
 {
-	static struct hostent host;
-	static char hostbuf[NI_MAXHOST];
+	static ND_THREAD_LOCAL struct hostent host;
+	static ND_THREAD_LOCAL char hostbuf[NI_MAXHOST];
 	char hname[NI_MAXHOST];
 
 	host.h_name = hostbuf;
@@ -169,47 +202,6 @@ win32_gethostbyaddr(const char *addr, int len, int type)
 #define gethostbyaddr win32_gethostbyaddr
 #endif /* _WIN32 */
 
-struct h6namemem {
-	nd_ipv6 addr;
-	char *name;
-	struct h6namemem *nxt;
-};
-
-static struct h6namemem h6nametable[HASHNAMESIZE];
-
-struct enamemem {
-	u_short e_addr0;
-	u_short e_addr1;
-	u_short e_addr2;
-	const char *e_name;
-	u_char *e_nsap;			/* used only for nsaptable[] */
-	struct enamemem *e_nxt;
-};
-
-static struct enamemem enametable[HASHNAMESIZE];
-static struct enamemem nsaptable[HASHNAMESIZE];
-
-struct bsnamemem {
-	u_short bs_addr0;
-	u_short bs_addr1;
-	u_short bs_addr2;
-	const char *bs_name;
-	u_char *bs_bytes;
-	unsigned int bs_nbytes;
-	struct bsnamemem *bs_nxt;
-};
-
-static struct bsnamemem bytestringtable[HASHNAMESIZE];
-
-struct protoidmem {
-	uint32_t p_oui;
-	u_short p_proto;
-	const char *p_name;
-	struct protoidmem *p_nxt;
-};
-
-static struct protoidmem protoidtable[HASHNAMESIZE];
-
 /*
  * A faster replacement for inet_ntoa().
  */
@@ -219,7 +211,7 @@ intoa(uint32_t addr)
 	char *cp;
 	u_int byte;
 	int n;
-	static char buf[sizeof(".xxx.xxx.xxx.xxx")];
+	static ND_THREAD_LOCAL char buf[sizeof(".xxx.xxx.xxx.xxx")];
 
 	addr = ntohl(addr);
 	cp = buf + sizeof(buf);
@@ -243,12 +235,58 @@ intoa(uint32_t addr)
 	return cp + 1;
 }
 
-static uint32_t f_netmask;
-static uint32_t f_localnet;
+static ND_THREAD_LOCAL uint32_t f_netmask;
+static ND_THREAD_LOCAL uint32_t f_localnet;
 #ifdef HAVE_CASPER
 cap_channel_t *capdns;
 #endif
 
+/*
+ * Set the name of a host entry to the name a lookup found, and return it.
+ */
+static const char *
+host_name(netdissect_options *ndo, struct name_entry *e, const char *name)
+{
+	char buf[NI_MAXHOST];
+	char *dotp;
+
+	e->state = RESOLVE_DONE;
+	if (ndo->ndo_Nflag) {
+		/* Remove domain qualifications */
+		strlcpy(buf, name, sizeof(buf));
+		dotp = strchr(buf, '.');
+		if (dotp)
+			*dotp = '\0';
+		name = buf;
+	}
+	return (name_cache_set_name(ndo, e, name));
+}
+
+#ifdef RESOLVER_THREAD
+static ND_THREAD_LOCAL struct resolver_client *dns_client;
+
+/*
+ * Queue a lookup of the name of an address, for --async-dns; returns
+ * the new RESOLVE_ state of its table entry.
+ */
+static u_char
+request_name(netdissect_options *ndo, int af, const void *addr,
+	     time_t *retry)
+{
+	if (dns_client == NULL) {
+		dns_client = resolver_client_new();
+		if (dns_client == NULL)
+			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+					  "%s: resolver_client_new", __func__);
+	}
+	if (resolver_request(dns_client, af, addr))
+		return RESOLVE_PENDING;
+	*retry = time(NULL) + RESOLVE_DROPPED_RETRY;
+	return RESOLVE_FAILED;
+}
+
+#endif /* RESOLVER_THREAD */
+
 /*
  * Return a name for the IP address pointed to by ap.  This address
  * is assumed to be in network byte order.
@@ -272,16 +310,20 @@ ipaddr_string(netdissect_options *ndo, const u_char *ap)
 {
 	struct hostent *hp;
 	uint32_t addr;
-	struct hnamemem *p;
+	struct name_entry *e;
+	const char *cp;
 
 	memcpy(&addr, ap, sizeof(addr));
-	p = &hnametable[addr & (HASHNAMESIZE-1)];
-	for (; p->nxt; p = p->nxt) {
-		if (p->addr == addr)
-			return (p->name);
+	e = name_cache_lookup(&hname_cache, &addr);
+	if (e != NULL) {
+#ifdef RESOLVER_THREAD
+		if (e->state == RESOLVE_FAILED && time(NULL) >= e->retry)
+			e->state = request_name(ndo, AF_INET, &addr,
+			    &e->retry);
+#endif
+		return (e->name);
 	}
-	p->addr = addr;
-	p->nxt = newhnamemem(ndo);
+	e = name_cache_add(ndo, &hname_cache, &addr);
 
 	/*
 	 * Print names unless:
@@ -293,6 +335,18 @@ ipaddr_string(netdissect_options *ndo, const u_char *ap)
 	 */
 	if (!ndo->ndo_nflag &&
 	    (addr & f_netmask) == f_localnet) {
+		if (ndo->ndo_name_db != NULL &&
+		    (cp = namedb_lookup(ndo->ndo_name_db, NAMEDB_IPV4,
+		    (const u_char *)&addr)) != NULL)
+			return (host_name(ndo, e, cp));
+#ifdef RESOLVER_THREAD
+		if (ndo->ndo_async_dns) {
+			/* Use the numeric address until the answer arrives. */
+			e->state = request_name(ndo, AF_INET, &addr,
+			    &e->retry);
+			hp = NULL;
+		} else
+#endif
 #ifdef HAVE_CASPER
 		if (capdns != NULL) {
 			hp = cap_gethostbyaddr(capdns, (char *)&addr, 4,
@@ -300,27 +354,10 @@ ipaddr_string(netdissect_options *ndo, const u_char *ap)
 		} else
 #endif
 			hp = gethostbyaddr((char *)&addr, 4, AF_INET);
-		if (hp) {
-			char *dotp;
-
-			p->name = strdup(hp->h_name);
-			if (p->name == NULL)
-				(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-					"%s: strdup(hp->h_name)", __func__);
-			if (ndo->ndo_Nflag) {
-				/* Remove domain qualifications */
-				dotp = strchr(p->name, '.');
-				if (dotp)
-					*dotp = '\0';
-			}
-			return (p->name);
-		}
+		if (hp)
+			return (host_name(ndo, e, hp->h_name));
 	}
-	p->name = strdup(intoa(addr));
-	if (p->name == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: strdup(intoa(addr))", __func__);
-	return (p->name);
+	return (name_cache_set_name(ndo, e, intoa(addr)));
 }
 
 /*
@@ -331,31 +368,40 @@ const char *
 ip6addr_string(netdissect_options *ndo, const u_char *ap)
 {
 	struct hostent *hp;
-	union {
-		nd_ipv6 addr;
-		struct for_hash_addr {
-			char fill[14];
-			uint16_t d;
-		} addra;
-	} addr;
-	struct h6namemem *p;
+	nd_ipv6 addr;
+	struct name_entry *e;
 	const char *cp;
 	char ntop_buf[INET6_ADDRSTRLEN];
 
 	memcpy(&addr, ap, sizeof(addr));
-	p = &h6nametable[addr.addra.d & (HASHNAMESIZE-1)];
-	for (; p->nxt; p = p->nxt) {
-		if (memcmp(&p->addr, &addr, sizeof(addr)) == 0)
-			return (p->name);
+	e = name_cache_lookup(&h6name_cache, &addr);
+	if (e != NULL) {
+#ifdef RESOLVER_THREAD
+		if (e->state == RESOLVE_FAILED && time(NULL) >= e->retry)
+			e->state = request_name(ndo, AF_INET6, &addr,
+			    &e->retry);
+#endif
+		return (e->name);
 	}
-	memcpy(p->addr, addr.addr, sizeof(nd_ipv6));
-	p->nxt = newh6namemem(ndo);
+	e = name_cache_add(ndo, &h6name_cache, &addr);
 
 	/*
 	 * Do not print names if -n was given.
 	 */
 #ifdef AF_INET6
 	if (!ndo->ndo_nflag) {
+		if (ndo->ndo_name_db != NULL &&
+		    (cp = namedb_lookup(ndo->ndo_name_db, NAMEDB_IPV6,
+		    (const u_char *)&addr)) != NULL)
+			return (host_name(ndo, e, cp));
+#ifdef RESOLVER_THREAD
+		if (ndo->ndo_async_dns) {
+			/* Use the numeric address until the answer arrives. */
+			e->state = request_name(ndo, AF_INET6, &addr,
+			    &e->retry);
+			hp = NULL;
+		} else
+#endif
 #ifdef HAVE_CASPER
 		if (capdns != NULL) {
 			hp = cap_gethostbyaddr(capdns, (char *)&addr,
@@ -364,29 +410,58 @@ ip6addr_string(netdissect_options *ndo, const u_char *ap)
 #endif
 			hp = gethostbyaddr((char *)&addr, sizeof(addr),
 			    AF_INET6);
-		if (hp) {
-			char *dotp;
-
-			p->name = strdup(hp->h_name);
-			if (p->name == NULL)
-				(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-					"%s: strdup(hp->h_name)", __func__);
-			if (ndo->ndo_Nflag) {
-				/* Remove domain qualifications */
-				dotp = strchr(p->name, '.');
-				if (dotp)
-					*dotp = '\0';
-			}
-			return (p->name);
-		}
+		if (hp)
+			return (host_name(ndo, e, hp->h_name));
 	}
 #endif /* AF_INET6 */
 	cp = addrtostr6(ap, ntop_buf, sizeof(ntop_buf));
-	p->name = strdup(cp);
-	if (p->name == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: strdup(cp)", __func__);
-	return (p->name);
+	return (name_cache_set_name(ndo, e, cp));
+}
+
+#ifdef RESOLVER_THREAD
+/*
+ * With --async-dns, put the names found by the lookups that have been
+ * answered since the last call into the caches.
+ */
+static void
+update_host_names(netdissect_options *ndo)
+{
+	struct resolver_answer *ans, *next;
+	struct name_entry *e;
+
+	if (dns_client == NULL)
+		return;
+	for (ans = resolver_answers(dns_client); ans != NULL; ans = next) {
+		next = ans->next;
+		e = name_cache_lookup(ans->af == AF_INET ? &hname_cache :
+		    &h6name_cache, ans->addr);
+		/* The entry may have been evicted in the meantime. */
+		if (e != NULL && e->state == RESOLVE_PENDING) {
+			if (ans->name != NULL)
+				(void)host_name(ndo, e, ans->name);
+			else {
+				e->state = RESOLVE_FAILED;
+				e->retry = time(NULL) +
+				    ndo->ndo_dns_negative_ttl;
+			}
+		}
+		resolver_answer_free(ans);
+	}
+}
+#endif /* RESOLVER_THREAD */
+
+/*
+ * Called before printing each packet; the names returned for the
+ * previous packet may be freed from now on.
+ */
+void
+addrtoname_new_packet(netdissect_options *ndo _U_)
+{
+	name_cache_new_packet();
+#ifdef RESOLVER_THREAD
+	if (ndo->ndo_async_dns)
+		update_host_names(ndo);
+#endif
 }
 
 static const char hex[16] = {
@@ -426,159 +501,62 @@ octet_to_hex(char *cp, uint8_t octet)
 	return (cp);
 }
 
-/* Find the hash node that corresponds the ether address 'ep' */
+/* Find the cache entry for the ether address 'ep', adding it if needed */
 
-static struct enamemem *
+static struct name_entry *
 lookup_emem(netdissect_options *ndo, const u_char *ep)
 {
-	u_int i, j, k;
-	struct enamemem *tp;
-
-	k = (ep[0] << 8) | ep[1];
-	j = (ep[2] << 8) | ep[3];
-	i = (ep[4] << 8) | ep[5];
-
-	tp = &enametable[(i ^ j) & (HASHNAMESIZE-1)];
-	while (tp->e_nxt)
-		if (tp->e_addr0 == i &&
-		    tp->e_addr1 == j &&
-		    tp->e_addr2 == k)
-			return tp;
-		else
-			tp = tp->e_nxt;
-	tp->e_addr0 = (u_short)i;
-	tp->e_addr1 = (u_short)j;
-	tp->e_addr2 = (u_short)k;
-	tp->e_nxt = (struct enamemem *)calloc(1, sizeof(*tp));
-	if (tp->e_nxt == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: calloc", __func__);
-
-	return tp;
+	struct name_entry *e;
+
+	e = name_cache_lookup(&ename_cache, ep);
+	if (e == NULL)
+		e = name_cache_add(ndo, &ename_cache, ep);
+	return e;
 }
 
 /*
- * Find the hash node that corresponds to the bytestring 'bs'
- * with length 'nlen'
+ * Find the cache entry for the bytestring 'bs' with length 'nlen',
+ * adding it if needed
  */
 
-static struct bsnamemem *
+static struct name_entry *
 lookup_bytestring(netdissect_options *ndo, const u_char *bs,
 		  const unsigned int nlen)
 {
-	struct bsnamemem *tp;
-	u_int i, j, k;
-
-	if (nlen >= 6) {
-		k = (bs[0] << 8) | bs[1];
-		j = (bs[2] << 8) | bs[3];
-		i = (bs[4] << 8) | bs[5];
-	} else if (nlen >= 4) {
-		k = (bs[0] << 8) | bs[1];
-		j = (bs[2] << 8) | bs[3];
-		i = 0;
-	} else
-		i = j = k = 0;
-
-	tp = &bytestringtable[(i ^ j) & (HASHNAMESIZE-1)];
-	while (tp->bs_nxt)
-		if (nlen == tp->bs_nbytes &&
-		    tp->bs_addr0 == i &&
-		    tp->bs_addr1 == j &&
-		    tp->bs_addr2 == k &&
-		    memcmp((const char *)bs, (const char *)(tp->bs_bytes), nlen) == 0)
-			return tp;
-		else
-			tp = tp->bs_nxt;
-
-	tp->bs_addr0 = (u_short)i;
-	tp->bs_addr1 = (u_short)j;
-	tp->bs_addr2 = (u_short)k;
+	struct name_entry *e;
 
-	tp->bs_bytes = (u_char *) calloc(1, nlen);
-	if (tp->bs_bytes == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: calloc", __func__);
-
-	memcpy(tp->bs_bytes, bs, nlen);
-	tp->bs_nbytes = nlen;
-	tp->bs_nxt = (struct bsnamemem *)calloc(1, sizeof(*tp));
-	if (tp->bs_nxt == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: calloc", __func__);
-
-	return tp;
+	e = name_cache_lookup_var(&bsname_cache, bs, nlen);
+	if (e == NULL)
+		e = name_cache_add_var(ndo, &bsname_cache, bs, nlen);
+	return e;
 }
 
-/* Find the hash node that corresponds the NSAP 'nsap' */
+/* Find the cache entry for the NSAP 'nsap', adding it if needed */
 
-static struct enamemem *
+static struct name_entry *
 lookup_nsap(netdissect_options *ndo, const u_char *nsap,
 	    u_int nsap_length)
 {
-	u_int i, j, k;
-	struct enamemem *tp;
-	const u_char *ensap;
-
-	if (nsap_length > 6) {
-		ensap = nsap + nsap_length - 6;
-		k = (ensap[0] << 8) | ensap[1];
-		j = (ensap[2] << 8) | ensap[3];
-		i = (ensap[4] << 8) | ensap[5];
-	} else
-		i = j = k = 0;
-
-	tp = &nsaptable[(i ^ j) & (HASHNAMESIZE-1)];
-	while (tp->e_nxt)
-		if (nsap_length == tp->e_nsap[0] &&
-		    tp->e_addr0 == i &&
-		    tp->e_addr1 == j &&
-		    tp->e_addr2 == k &&
-		    memcmp((const char *)nsap,
-			(char *)&(tp->e_nsap[1]), nsap_length) == 0)
-			return tp;
-		else
-			tp = tp->e_nxt;
-	tp->e_addr0 = (u_short)i;
-	tp->e_addr1 = (u_short)j;
-	tp->e_addr2 = (u_short)k;
-	tp->e_nsap = (u_char *)malloc(nsap_length + 1);
-	if (tp->e_nsap == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: malloc", __func__);
-	tp->e_nsap[0] = (u_char)nsap_length;	/* guaranteed < ISONSAP_MAX_LENGTH */
-	memcpy((char *)&tp->e_nsap[1], (const char *)nsap, nsap_length);
-	tp->e_nxt = (struct enamemem *)calloc(1, sizeof(*tp));
-	if (tp->e_nxt == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: calloc", __func__);
-
-	return tp;
+	struct name_entry *e;
+
+	e = name_cache_lookup_var(&nsapname_cache, nsap, nsap_length);
+	if (e == NULL)
+		e = name_cache_add_var(ndo, &nsapname_cache, nsap,
+		    nsap_length);
+	return e;
 }
 
-/* Find the hash node that corresponds the protoid 'pi'. */
+/* Find the cache entry for the protoid 'pi', adding it if needed */
 
-static struct protoidmem *
+static struct name_entry *
 lookup_protoid(netdissect_options *ndo, const u_char *pi)
 {
-	u_int i, j;
-	struct protoidmem *tp;
-
-	/* 5 octets won't be aligned */
-	i = (((pi[0] << 8) + pi[1]) << 8) + pi[2];
-	j =   (pi[3] << 8) + pi[4];
-	/* XXX should be endian-insensitive, but do big-endian testing  XXX */
-
-	tp = &protoidtable[(i ^ j) & (HASHNAMESIZE-1)];
-	while (tp->p_nxt)
-		if (tp->p_oui == i && tp->p_proto == j)
-			return tp;
-		else
-			tp = tp->p_nxt;
-	tp->p_oui = i;
-	tp->p_proto = (u_short)j;
-	tp->p_nxt = (struct protoidmem *)calloc(1, sizeof(*tp));
-	if (tp->p_nxt == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: calloc", __func__);
-
-	return tp;
+	struct name_entry *e;
+
+	e = name_cache_lookup(&protoidname_cache, pi);
+	if (e == NULL)
+		e = name_cache_add(ndo, &protoidname_cache, pi);
+	return e;
 }
 
 const char *
@@ -586,13 +564,18 @@ mac48_string(netdissect_options *ndo, const uint8_t *ep)
 {
 	int i;
 	char *cp;
-	struct enamemem *tp;
+	struct name_entry *e;
 	int oui;
+	const uint8_t *oui_key;
+	const char *name;
 	char buf[BUFSIZE];
 
-	tp = lookup_emem(ndo, ep);
-	if (tp->e_name)
-		return (tp->e_name);
+	e = lookup_emem(ndo, ep);
+	if (e->name)
+		return (e->name);
+	if (!ndo->ndo_nflag && ndo->ndo_name_db != NULL &&
+	    (name = namedb_lookup(ndo->ndo_name_db, NAMEDB_MAC48, ep)) != NULL)
+		return (name_cache_set_name(ndo, e, name));
 #ifdef USE_ETHER_NTOHOST
 	if (!ndo->ndo_nflag) {
 		char buf2[BUFSIZE];
@@ -604,17 +587,13 @@ mac48_string(netdissect_options *ndo, const uint8_t *ep)
 		struct ether_addr ea;
 
 		memcpy (&ea, ep, MAC48_LEN);
-		if (ether_ntohost(buf2, &ea) == 0) {
-			tp->e_name = strdup(buf2);
-			if (tp->e_name == NULL)
-				(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-					"%s: strdup(buf2)", __func__);
-			return (tp->e_name);
-		}
+		if (ether_ntohost(buf2, &ea) == 0)
+			return (name_cache_set_name(ndo, e, buf2));
 	}
 #endif
 	cp = buf;
 	oui = EXTRACT_BE_U_3(ep);
+	oui_key = ep;
 	cp = octet_to_hex(cp, *ep++);
 	for (i = 5; --i >= 0;) {
 		*cp++ = ':';
@@ -622,15 +601,17 @@ mac48_string(netdissect_options *ndo, const uint8_t *ep)
 	}
 
 	if (!ndo->ndo_nflag) {
-		snprintf(cp, BUFSIZE - (2 + 5*3), " (oui %s)",
-		    tok2str(oui_values, "Unknown", oui));
+		if (ndo->ndo_name_db != NULL) {
+			name = namedb_lookup(ndo->ndo_name_db, NAMEDB_OUI,
+			    oui_key);
+			if (name == NULL)
+				name = "Unknown";
+		} else
+			name = tok2str(oui_values, "Unknown", oui);
+		snprintf(cp, BUFSIZE - (2 + 5*3), " (oui %s)", name);
 	} else
 		*cp = '\0';
-	tp->e_name = strdup(buf);
-	if (tp->e_name == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: strdup(buf)", __func__);
-	return (tp->e_name);
+	return (name_cache_set_name(ndo, e, buf));
 }
 
 const char *
@@ -648,12 +629,12 @@ eui64le_string(netdissect_options *ndo, const uint8_t *ep)
 	const unsigned int len = 8;
 	u_int i;
 	char *cp;
-	struct bsnamemem *tp;
+	struct name_entry *e;
 	char buf[BUFSIZE];
 
-	tp = lookup_bytestring(ndo, ep, len);
-	if (tp->bs_name)
-		return (tp->bs_name);
+	e = lookup_bytestring(ndo, ep, len);
+	if (e->name)
+		return (e->name);
 
 	cp = buf;
 	for (i = len; i > 0 ; --i) {
@@ -664,12 +645,7 @@ eui64le_string(netdissect_options *ndo, const uint8_t *ep)
 
 	*cp = '\0';
 
-	tp->bs_name = strdup(buf);
-	if (tp->bs_name == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: strdup(buf)", __func__);
-
-	return (tp->bs_name);
+	return (name_cache_set_name(ndo, e, buf));
 }
 
 const char *
@@ -677,8 +653,9 @@ linkaddr_string(netdissect_options *ndo, const uint8_t *ep,
 		const unsigned int type, const unsigned int len)
 {
 	u_int i;
-	char *cp;
-	struct bsnamemem *tp;
+	char *buf, *cp;
+	struct name_entry *e;
+	const char *name;
 
 	if (len == 0)
 		return ("<empty>");
@@ -689,12 +666,12 @@ linkaddr_string(netdissect_options *ndo, const uint8_t *ep,
 	if (type == LINKADDR_FRELAY)
 		return (q922_string(ndo, ep, len));
 
-	tp = lookup_bytestring(ndo, ep, len);
-	if (tp->bs_name)
-		return (tp->bs_name);
+	e = lookup_bytestring(ndo, ep, len);
+	if (e->name)
+		return (e->name);
 
-	tp->bs_name = cp = (char *)malloc(len*3);
-	if (tp->bs_name == NULL)
+	buf = cp = (char *)malloc(len*3);
+	if (buf == NULL)
 		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
 				  "%s: malloc", __func__);
 	cp = octet_to_hex(cp, *ep++);
@@ -703,7 +680,9 @@ linkaddr_string(netdissect_options *ndo, const uint8_t *ep,
 		cp = octet_to_hex(cp, *ep++);
 	}
 	*cp = '\0';
-	return (tp->bs_name);
+	name = name_cache_set_name(ndo, e, buf);
+	free(buf);
+	return (name);
 }
 
 #define ISONSAP_MAX_LENGTH 20
@@ -713,19 +692,17 @@ isonsap_string(netdissect_options *ndo, const uint8_t *nsap,
 {
 	u_int nsap_idx;
 	char *cp;
-	struct enamemem *tp;
+	struct name_entry *e;
+	char buf[sizeof("xx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xx")];
 
 	if (nsap_length < 1 || nsap_length > ISONSAP_MAX_LENGTH)
 		return ("isonsap_string: illegal length");
 
-	tp = lookup_nsap(ndo, nsap, nsap_length);
-	if (tp->e_name)
-		return tp->e_name;
+	e = lookup_nsap(ndo, nsap, nsap_length);
+	if (e->name)
+		return e->name;
 
-	tp->e_name = cp = (char *)malloc(sizeof("xx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xx"));
-	if (cp == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: malloc", __func__);
+	cp = buf;
 
 	for (nsap_idx = 0; nsap_idx < nsap_length; nsap_idx++) {
 		cp = octet_to_hex(cp, *nsap++);
@@ -735,7 +712,7 @@ isonsap_string(netdissect_options *ndo, const uint8_t *nsap,
 		}
 	}
 	*cp = '\0';
-	return (tp->e_name);
+	return (name_cache_set_name(ndo, e, buf));
 }
 
 const char *
@@ -743,6 +720,7 @@ tcpport_string(netdissect_options *ndo, u_short port)
 {
 	struct hnamemem *tp;
 	uint32_t i = port;
+	u_char key[2];
 	char buf[sizeof("00000")];
 
 	for (tp = &tporttable[i & (HASHNAMESIZE-1)]; tp->nxt; tp = tp->nxt)
@@ -752,6 +730,14 @@ tcpport_string(netdissect_options *ndo, u_short port)
 	tp->addr = i;
 	tp->nxt = newhnamemem(ndo);
 
+	if (!ndo->ndo_nflag && ndo->ndo_name_db != NULL) {
+		key[0] = (u_char)(port >> 8);
+		key[1] = (u_char)port;
+		tp->name = namedb_lookup(ndo->ndo_name_db, NAMEDB_TCP_PORT, key);
+		if (tp->name != NULL)
+			return (tp->name);
+	}
+
 	(void)snprintf(buf, sizeof(buf), "%u", i);
 	tp->name = strdup(buf);
 	if (tp->name == NULL)
@@ -765,6 +751,7 @@ udpport_string(netdissect_options *ndo, u_short port)
 {
 	struct hnamemem *tp;
 	uint32_t i = port;
+	u_char key[2];
 	char buf[sizeof("00000")];
 
 	for (tp = &uporttable[i & (HASHNAMESIZE-1)]; tp->nxt; tp = tp->nxt)
@@ -774,6 +761,14 @@ udpport_string(netdissect_options *ndo, u_short port)
 	tp->addr = i;
 	tp->nxt = newhnamemem(ndo);
 
+	if (!ndo->ndo_nflag && ndo->ndo_name_db != NULL) {
+		key[0] = (u_char)(port >> 8);
+		key[1] = (u_char)port;
+		tp->name = namedb_lookup(ndo->ndo_name_db, NAMEDB_UDP_PORT, key);
+		if (tp->name != NULL)
+			return (tp->name);
+	}
+
 	(void)snprintf(buf, sizeof(buf), "%u", i);
 	tp->name = strdup(buf);
 	if (tp->name == NULL)
@@ -902,7 +897,7 @@ static void
 init_protoidarray(netdissect_options *ndo)
 {
 	int i;
-	struct protoidmem *tp;
+	struct name_entry *e;
 	const struct protoidlist *pl;
 	u_char protoid[5];
 
@@ -913,20 +908,19 @@ init_protoidarray(netdissect_options *ndo)
 		u_short etype = htons(eproto_db[i].p);
 
 		memcpy((char *)&protoid[3], (char *)&etype, 2);
-		tp = lookup_protoid(ndo, protoid);
-		tp->p_name = strdup(eproto_db[i].s);
-		if (tp->p_name == NULL)
-			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				"%s: strdup(eproto_db[i].s)", __func__);
+		e = lookup_protoid(ndo, protoid);
+		(void)name_cache_set_name(ndo, e, eproto_db[i].s);
+		e->flags |= NAME_ENTRY_PINNED;
 	}
 	/* Hardwire some SNAP proto ID names */
 	for (pl = protoidlist; pl->name != NULL; ++pl) {
-		tp = lookup_protoid(ndo, pl->protoid);
+		e = lookup_protoid(ndo, pl->protoid);
 		/* Don't override existing name */
-		if (tp->p_name != NULL)
+		if (e->name != NULL)
 			continue;
 
-		tp->p_name = pl->name;
+		(void)name_cache_set_name(ndo, e, pl->name);
+		e->flags |= NAME_ENTRY_PINNED;
 	}
 }
 
@@ -956,22 +950,24 @@ static void
 init_etherarray(netdissect_options *ndo)
 {
 	const struct etherlist *el;
-	struct enamemem *tp;
+	struct name_entry *e;
 #ifdef USE_ETHER_NTOHOST
 	char name[256];
 #else
 	struct pcap_etherent *ep;
 	FILE *fp;
 
-	/* Suck in entire ethers file */
-	fp = fopen(PCAP_ETHERS_FILE, "r");
+	/*
+	 * Suck in entire ethers file, unless its names are in the
+	 * --name-db database; the names can't be found again, so the
+	 * entries are never evicted.
+	 */
+	fp = ndo->ndo_name_db == NULL ? fopen(PCAP_ETHERS_FILE, "r") : NULL;
 	if (fp != NULL) {
 		while ((ep = pcap_next_etherent(fp)) != NULL) {
-			tp = lookup_emem(ndo, ep->addr);
-			tp->e_name = strdup(ep->name);
-			if (tp->e_name == NULL)
-				(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-					"%s: strdup(ep->addr)", __func__);
+			e = lookup_emem(ndo, ep->addr);
+			(void)name_cache_set_name(ndo, e, ep->name);
+			e->flags |= NAME_ENTRY_PINNED;
 		}
 		(void)fclose(fp);
 	}
@@ -979,10 +975,11 @@ init_etherarray(netdissect_options *ndo)
 
 	/* Hardwire some ethernet names */
 	for (el = etherlist; el->name != NULL; ++el) {
-		tp = lookup_emem(ndo, el->addr);
+		e = lookup_emem(ndo, el->addr);
 		/* Don't override existing name */
-		if (tp->e_name != NULL)
+		if (e->name != NULL)
 			continue;
+		e->flags |= NAME_ENTRY_PINNED;
 
 #ifdef USE_ETHER_NTOHOST
 		/*
@@ -992,14 +989,11 @@ init_etherarray(netdissect_options *ndo)
 		struct ether_addr ea;
 		memcpy (&ea, el->addr, MAC48_LEN);
 		if (ether_ntohost(name, &ea) == 0) {
-			tp->e_name = strdup(name);
-			if (tp->e_name == NULL)
-				(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-					"%s: strdup(name)", __func__);
+			(void)name_cache_set_name(ndo, e, name);
 			continue;
 		}
 #endif
-		tp->e_name = el->name;
+		(void)name_cache_set_name(ndo, e, el->name);
 	}
 }
 
@@ -1260,7 +1254,9 @@ init_addrtoname(netdissect_options *ndo, uint32_t localnet, uint32_t mask)
 		return;
 
 	init_etherarray(ndo);
-	init_servarray(ndo);
+	/* With --name-db, the names are looked up in it when needed. */
+	if (ndo->ndo_name_db == NULL)
+		init_servarray(ndo);
 	init_eprotoarray(ndo);
 	init_protoidarray(ndo);
 	init_ipxsaparray(ndo);
@@ -1288,8 +1284,8 @@ struct hnamemem *
 newhnamemem(netdissect_options *ndo)
 {
 	struct hnamemem *p;
-	static struct hnamemem *ptr = NULL;
-	static u_int num = 0;
+	static ND_THREAD_LOCAL struct hnamemem *ptr = NULL;
+	static ND_THREAD_LOCAL u_int num = 0;
 
 	if (num  == 0) {
 		num = 64;
@@ -1303,31 +1299,11 @@ newhnamemem(netdissect_options *ndo)
 	return (p);
 }
 
-/* Return a zero'ed h6namemem struct and cuts down on calloc() overhead */
-struct h6namemem *
-newh6namemem(netdissect_options *ndo)
-{
-	struct h6namemem *p;
-	static struct h6namemem *ptr = NULL;
-	static u_int num = 0;
-
-	if (num  == 0) {
-		num = 64;
-		ptr = (struct h6namemem *)calloc(num, sizeof (*ptr));
-		if (ptr == NULL)
-			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-					  "%s: calloc", __func__);
-	}
-	--num;
-	p = ptr++;
-	return (p);
-}
-
 /* Represent TCI part of the 802.1Q 4-octet tag as text. */
 const char *
 ieee8021q_tci_string(const uint16_t tci)
 {
-	static char buf[128];
+	static ND_THREAD_LOCAL char buf[128];
 	snprintf(buf, sizeof(buf), "vlan %u, p %u%s",
 	         tci & 0xfff,
 	         tci >> 13,
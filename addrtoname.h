@@ -58,10 +58,10 @@ extern const char *ipxsap_string(netdissect_options *, u_short);
 extern const char *ipaddr_string(netdissect_options *, const u_char *);
 extern const char *ip6addr_string(netdissect_options *, const u_char *);
 extern const char *intoa(uint32_t);
+extern void addrtoname_new_packet(netdissect_options *);
 
 extern void init_addrtoname(netdissect_options *, uint32_t, uint32_t);
 extern struct hnamemem *newhnamemem(netdissect_options *);
-extern struct h6namemem *newh6namemem(netdissect_options *);
 extern const char * ieee8021q_tci_string(const uint16_t);
 
 /* macro(s) and inline function(s) with setjmp/longjmp logic to call
@@ -134,3 +134,8 @@ get_ip6addr_string(netdissect_options *ndo, const u_char *p)
 #define GET_ISONSAP_STRING(nsap, nsap_length) get_isonsap_string(ndo, (const u_char *)(nsap), nsap_length)
 #define GET_IPADDR_STRING(p) get_ipaddr_string(ndo, (const u_char *)(p))
 #define GET_IP6ADDR_STRING(p) get_ip6addr_string(ndo, (const u_char *)(p))
+
+/* The same, for a field of a header view; see ND_VIEW_CHECK() */
+#define V_MAC48_STRING(f) mac48_string(ndo, ND_VIEW_FIELD((f), MAC48_LEN))
+#define V_IPADDR_STRING(f) ipaddr_string(ndo, ND_VIEW_FIELD((f), 4))
+#define V_IP6ADDR_STRING(f) ip6addr_string(ndo, ND_VIEW_FIELD((f), 16))
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pcap.h>
+
+#include "dumpwriter.h"
+
+#ifdef DUMPWRITER_THREAD
+
+#include <pthread.h>
+#include <sys/time.h>
+
+/*
+ * Each packet is stored in the ring as a record header followed by the
+ * packet data, padded to a multiple of RECORD_ALIGN bytes.  A record
+ * never wraps around the end of the ring: if it doesn't fit before the
+ * end, the rest of the ring is skipped, and a record header with a
+ * length of 0 is written there if there's room for one.
+ */
+struct record {
+	uint32_t len;		/* length of the record, including padding */
+	uint32_t pad;
+	struct pcap_pkthdr hdr;
+};
+
+#define RECORD_ALIGN		8
+#define RECORD_LEN(caplen) \
+	((sizeof(struct record) + (caplen) + RECORD_ALIGN - 1) & \
+	    ~(size_t)(RECORD_ALIGN - 1))
+
+/*
+ * How long the writer thread sleeps, at most, when the ring is empty,
+ * so that it notices flush requests from signal handlers.
+ */
+#define IDLE_WAIT_MS		100
+
+#define LOAD(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define LOAD_SC(p)	__atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define STORE_SC(p, v)	__atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+
+static u_char *ring;
+static size_t ring_size;		/* a power of 2 */
+static int blocking;
+
+static pcap_handler write_func;
+static void (*flush_func)(u_char *);
+static u_char *write_user;
+
+/*
+ * head is written only by the capture thread and tail only by the
+ * writer thread; both only ever increase, and are reduced modulo
+ * ring_size to get an offset in the ring.
+ */
+static size_t head;
+static size_t tail;
+static size_t cached_tail;	/* capture thread's copy of tail */
+static u_int drops;
+
+static int writer_waiting;	/* the writer thread is waiting for packets */
+static int capture_waiting;	/* the capture thread is waiting for room */
+static int flush_requested;
+static int stopping;
+
+static pthread_t writer;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t capture_cond = PTHREAD_COND_INITIALIZER;
+
+static void
+wait_ms(pthread_cond_t *cond, u_int ms)
+{
+	struct timeval now;
+	struct timespec deadline;
+
+	gettimeofday(&now, NULL);
+	deadline.tv_sec = now.tv_sec + ms / 1000;
+	deadline.tv_nsec = (now.tv_usec + (ms % 1000) * 1000) * 1000;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+	pthread_cond_timedwait(cond, &lock, &deadline);
+}
+
+static void *
+writer_main(void *arg _U_)
+{
+	const struct record *rec;
+	size_t t, h, off, len;
+
+	t = tail;
+	for (;;) {
+		h = LOAD(&head);
+		while (t != h) {
+			off = t & (ring_size - 1);
+			rec = (const struct record *)(ring + off);
+			if (ring_size - off < sizeof(struct record) ||
+			    rec->len == 0) {
+				/* Skipped end of the ring. */
+				t += ring_size - off;
+			} else {
+				len = rec->len;
+				(*write_func)(write_user, &rec->hdr,
+				    (const u_char *)(rec + 1));
+				t += len;
+			}
+			STORE_SC(&tail, t);
+			if (LOAD_SC(&capture_waiting)) {
+				pthread_mutex_lock(&lock);
+				STORE(&capture_waiting, 0);
+				pthread_cond_signal(&capture_cond);
+				pthread_mutex_unlock(&lock);
+			}
+		}
+
+		/*
+		 * The ring is empty; write out what has been buffered,
+		 * if asked to, before going to sleep.
+		 */
+		if (__atomic_exchange_n(&flush_requested, 0, __ATOMIC_ACQ_REL))
+			(*flush_func)(write_user);
+		if (LOAD(&stopping) && LOAD(&head) == t)
+			break;
+
+		pthread_mutex_lock(&lock);
+		STORE_SC(&writer_waiting, 1);
+		if (LOAD_SC(&head) == t && !LOAD(&stopping))
+			wait_ms(&writer_cond, IDLE_WAIT_MS);
+		STORE(&writer_waiting, 0);
+		pthread_mutex_unlock(&lock);
+	}
+	(*flush_func)(write_user);
+	return NULL;
+}
+
+/*
+ * Start the writer thread, with a ring of ring_kb KiB.  Each packet is
+ * written by calling write_packet, with user as its first argument, on
+ * the writer thread; flush is called on the writer thread when a flush
+ * has been requested and the ring is empty, and when the writer is
+ * stopped.  If block is set, dumpwriter_packet() waits for room in the
+ * ring instead of dropping the packet.
+ *
+ * Returns 0 on success and an errno value on failure.
+ */
+int
+dumpwriter_start(size_t ring_kb, int block, pcap_handler write_packet,
+    void (*flush)(u_char *), u_char *user)
+{
+	int err;
+
+	ring_size = DUMPWRITER_MIN_RING_KB * 1024;
+	while (ring_size < ring_kb * 1024)
+		ring_size <<= 1;
+	ring = malloc(ring_size);
+	if (ring == NULL)
+		return ENOMEM;
+	blocking = block;
+	write_func = write_packet;
+	flush_func = flush;
+	write_user = user;
+	head = tail = cached_tail = 0;
+	drops = 0;
+	stopping = 0;
+
+	err = pthread_create(&writer, NULL, writer_main, NULL);
+	if (err != 0) {
+		free(ring);
+		ring = NULL;
+	}
+	return err;
+}
+
+/*
+ * Queue a packet to be written; this is called on the capture thread.
+ */
+void
+dumpwriter_packet(const struct pcap_pkthdr *h, const u_char *sp)
+{
+	struct record *rec;
+	size_t len, off, skip;
+
+	len = RECORD_LEN(h->caplen);
+	if (len > ring_size / 4) {
+		/* Larger than any packet libpcap supplies. */
+		drops++;
+		return;
+	}
+	off = head & (ring_size - 1);
+	skip = ring_size - off < len ? ring_size - off : 0;
+
+	if (ring_size - (head - cached_tail) < skip + len) {
+		cached_tail = LOAD(&tail);
+		while (ring_size - (head - cached_tail) < skip + len) {
+			if (!blocking) {
+				drops++;
+				return;
+			}
+			pthread_mutex_lock(&lock);
+			STORE_SC(&capture_waiting, 1);
+			if (ring_size - (head - LOAD_SC(&tail)) < skip + len)
+				pthread_cond_wait(&capture_cond, &lock);
+			STORE(&capture_waiting, 0);
+			pthread_mutex_unlock(&lock);
+			cached_tail = LOAD(&tail);
+		}
+	}
+
+	if (skip != 0) {
+		if (skip >= sizeof(struct record))
+			((struct record *)(ring + off))->len = 0;
+		off = 0;
+	}
+	rec = (struct record *)(ring + off);
+	rec->len = (uint32_t)len;
+	rec->hdr = *h;
+	memcpy(rec + 1, sp, h->caplen);
+	STORE_SC(&head, head + skip + len);
+
+	if (LOAD_SC(&writer_waiting)) {
+		pthread_mutex_lock(&lock);
+		pthread_cond_signal(&writer_cond);
+		pthread_mutex_unlock(&lock);
+	}
+}
+
+/*
+ * Ask the writer thread to flush the savefile once it has written the
+ * packets in the ring; this can be called from a signal handler.
+ */
+void
+dumpwriter_request_flush(void)
+{
+	STORE(&flush_requested, 1);
+}
+
+/*
+ * Return the number of packets dropped because the ring was full.
+ */
+u_int
+dumpwriter_drops(void)
+{
+	return drops;
+}
+
+/*
+ * Wait for the packets in the ring to be written, and stop the writer
+ * thread.
+ */
+void
+dumpwriter_stop(void)
+{
+	if (ring == NULL)
+		return;
+	pthread_mutex_lock(&lock);
+	STORE(&stopping, 1);
+	pthread_cond_signal(&writer_cond);
+	pthread_mutex_unlock(&lock);
+	pthread_join(writer, NULL);
+	free(ring);
+	ring = NULL;
+}
+#endif /* DUMPWRITER_THREAD */
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef dumpwriter_h
+#define dumpwriter_h
+
+/*
+ * Asynchronous writing of savefiles ("--async-write").
+ *
+ * The capture thread copies each packet into a single-producer,
+ * single-consumer ring, and a writer thread takes the packets out of
+ * the ring and hands them to a write routine, which writes them to the
+ * savefile and does the -C and -G rotation, the -z compression and the
+ * fsync()s, so that none of that stalls the capture.  If the ring is
+ * full, the packet is dropped and counted, unless the writer was
+ * started in blocking mode, which is used when reading savefiles.
+ *
+ * The ring is lock-free; this requires POSIX threads and the __atomic
+ * built-ins of GCC and Clang.
+ */
+#if defined(HAVE_PTHREAD) && defined(__ATOMIC_ACQUIRE)
+#define DUMPWRITER_THREAD
+
+/* Limits of the size of the ring, in KiB. */
+#define DUMPWRITER_MIN_RING_KB	1024
+#define DUMPWRITER_MAX_RING_KB	(1024 * 1024)
+/* Size used when another option needs the writer thread. */
+#define DUMPWRITER_DEFAULT_RING_KB	(16 * 1024)
+
+extern int dumpwriter_start(size_t, int, pcap_handler, void (*)(u_char *),
+    u_char *);
+extern void dumpwriter_packet(const struct pcap_pkthdr *, const u_char *);
+extern void dumpwriter_request_flush(void);
+extern u_int dumpwriter_drops(void);
+extern void dumpwriter_stop(void);
+#endif /* defined(HAVE_PTHREAD) && defined(__ATOMIC_ACQUIRE) */
+
+#endif /* dumpwriter_h */
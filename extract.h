@@ -939,4 +939,38 @@ get_cpy_bytes(netdissect_options *ndo, u_char *dst, const u_char *p, size_t len)
 
 #define GET_CPY_BYTES(dst, p, len) get_cpy_bytes(ndo, (u_char *)(dst), (const u_char *)(p), len)
 
+/*
+ * Header views.
+ *
+ * Each GET_ macro checks that its own field was captured.  When all
+ * of a fixed-size header is needed, ND_VIEW_CHECK(p, size) checks once
+ * that the "size" bytes of "*(p)" were captured, longjmp()ing as the
+ * GET_ macros do if they weren't, and the V_ macros then extract the
+ * fields of "*(p)" without checking them again; ND_VIEW_TTEST(p, size)
+ * only tests.  A V_ macro must only be used on a field of a header that
+ * has passed one of those checks.
+ *
+ * Both fail to compile if "size", the size of the header on the wire,
+ * isn't "sizeof(*(p))", as it would be if the compiler padded the
+ * structure, and each V_ macro fails to compile if the field isn't of
+ * the size that it extracts.
+ */
+#define ND_SIZE_ASSERT(size, expected) \
+	((size) + 0 * sizeof(char [(size) == (expected) ? 1 : -1]))
+
+#define ND_VIEW_TTEST(p, size) \
+	ND_TTEST_LEN((p), ND_SIZE_ASSERT(sizeof(*(p)), (size)))
+#define ND_VIEW_CHECK(p, size) \
+do { \
+if (!ND_VIEW_TTEST(p, size)) nd_trunc_longjmp(ndo); \
+} while (0)
+
+/* "f", as a pointer, if it's a field of "l" bytes */
+#define ND_VIEW_FIELD(f, l) \
+	((const u_char *)(f) + 0 * ND_SIZE_ASSERT(sizeof(f), (l)))
+
+#define V_U_1(f) EXTRACT_U_1(ND_VIEW_FIELD((f), 1))
+#define V_BE_U_2(f) EXTRACT_BE_U_2(ND_VIEW_FIELD((f), 2))
+#define V_BE_U_4(f) EXTRACT_BE_U_4(ND_VIEW_FIELD((f), 4))
+
 #endif /* EXTRACT_H */
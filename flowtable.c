@@ -0,0 +1,456 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "netdissect.h"
+#include "extract.h"
+#include "ip.h"
+#include "ip6.h"
+#include "flowtable.h"
+
+/* Number of buckets of a table when first used */
+#define INITIAL_BUCKETS	1024
+
+struct nd_flow_type *const nd_flow_types[] = {
+	&tcp_seq_flow_type,
+	&sunrpc_call_flow_type,
+	&rx_call_flow_type,
+	&quic_cid_flow_type,
+	&tcp_stream_flow_type,
+	&ip_datagram_flow_type,
+	NULL
+};
+
+/* The flows of a type */
+struct flow_lists {
+	struct nd_flow lru;		/* list head, least recent last */
+	struct nd_flow closed;		/* list head, oldest last */
+	u_int count;
+};
+
+struct flow_table {
+	struct nd_flow **buckets;
+	u_int nbuckets;			/* a power of 2 */
+	u_int count;
+	uint32_t seed;
+	struct flow_lists types[ND_FLOW_NTYPES];
+};
+
+static ND_THREAD_LOCAL struct flow_table flows;
+
+/* The same for all threads; set before any of them are started */
+static u_int flow_max = ND_FLOW_DEFAULT_MAX;
+static u_int flow_timeout = ND_FLOW_DEFAULT_TIMEOUT;
+
+/*
+ * The counters are shared by the tables of all threads, and are read
+ * from the signal handler of info().
+ */
+#ifdef __ATOMIC_RELAXED
+#define STATS_INC(x)	((void)__atomic_add_fetch(&(x), 1, __ATOMIC_RELAXED))
+#define STATS_GET(x)	__atomic_load_n(&(x), __ATOMIC_RELAXED)
+#else
+#define STATS_INC(x)	((void)(x)++)
+#define STATS_GET(x)	(x)
+#endif
+
+/*
+ * Set a flow key from the IPv4 or IPv6 header at ip, which has been
+ * checked by the caller, and the ports of the packet, in host byte
+ * order, with no identifier.  The lower port, or address if the ports
+ * are the same, comes first; returns 1 if that's the destination of the
+ * packet and 0 otherwise.
+ */
+int
+nd_flow_key_set(struct nd_flow_key *key, const u_char *ip, uint8_t proto,
+		uint16_t sport, uint16_t dport)
+{
+	const u_char *src, *dst;
+	u_int len;
+	int rev;
+
+	memset(key, 0, sizeof(*key));
+	if ((EXTRACT_U_1(ip) >> 4) == 6) {
+		src = ((const struct ip6_hdr *)ip)->ip6_src;
+		dst = ((const struct ip6_hdr *)ip)->ip6_dst;
+		len = sizeof(nd_ipv6);
+		key->af = 6;
+	} else {
+		src = ((const struct ip *)ip)->ip_src;
+		dst = ((const struct ip *)ip)->ip_dst;
+		len = sizeof(nd_ipv4);
+		key->af = 4;
+	}
+	key->proto = proto;
+	if (sport != dport)
+		rev = sport > dport;
+	else
+		rev = UNALIGNED_MEMCMP(src, dst, len) > 0;
+	if (rev) {
+		key->port[0] = dport;
+		key->port[1] = sport;
+		UNALIGNED_MEMCPY(key->addr[0], dst, len);
+		UNALIGNED_MEMCPY(key->addr[1], src, len);
+	} else {
+		key->port[0] = sport;
+		key->port[1] = dport;
+		UNALIGNED_MEMCPY(key->addr[0], src, len);
+		UNALIGNED_MEMCPY(key->addr[1], dst, len);
+	}
+	return rev;
+}
+
+/*
+ * Set the identifier of a key, set by nd_flow_key_set() or zeroed;
+ * len is at most ND_FLOW_MAX_ID_LEN.
+ */
+void
+nd_flow_key_set_id(struct nd_flow_key *key, const void *id, u_int len)
+{
+	key->id_len = (uint8_t)len;
+	UNALIGNED_MEMCPY(key->id, id, len);
+}
+
+static uint32_t
+hash_key(const struct nd_flow_type *type, const struct nd_flow_key *key,
+	 uint32_t seed)
+{
+	const u_char *p = (const u_char *)key;
+	uint32_t h, w;
+	size_t len;
+
+	h = seed ^ ((uint32_t)(uintptr_t)type * 0x9e3779b9U);
+	/* MurmurHash3-style mixing of 4 bytes at a time. */
+	for (len = sizeof(*key); len >= 4; p += 4, len -= 4) {
+		memcpy(&w, p, 4);
+		w *= 0xcc9e2d51U;
+		w = (w << 15) | (w >> 17);
+		h ^= w * 0x1b873593U;
+		h = (h << 13) | (h >> 19);
+		h = h * 5 + 0xe6546b64U;
+	}
+	for (; len > 0; p++, len--)
+		h = (h ^ *p) * 0x01000193U;
+	h ^= (uint32_t)sizeof(*key);
+	h ^= h >> 16;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35U;
+	h ^= h >> 16;
+	return h;
+}
+
+static void
+list_remove(struct nd_flow *f)
+{
+	f->prev->next = f->next;
+	f->next->prev = f->prev;
+}
+
+static void
+list_insert(struct nd_flow *head, struct nd_flow *f)
+{
+	f->prev = head;
+	f->next = head->next;
+	head->next->prev = f;
+	head->next = f;
+}
+
+static void
+init_table(netdissect_options *ndo, struct flow_table *t)
+{
+	struct flow_lists *l;
+	u_int i;
+
+	t->buckets = calloc(INITIAL_BUCKETS, sizeof(*t->buckets));
+	if (t->buckets == NULL)
+		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: calloc",
+		    __func__);
+	t->nbuckets = INITIAL_BUCKETS;
+	for (i = 0; i < ND_FLOW_NTYPES; i++) {
+		l = &t->types[i];
+		l->lru.next = l->lru.prev = &l->lru;
+		l->closed.next = l->closed.prev = &l->closed;
+	}
+	/*
+	 * Seed the hash, so that the chains can't be made long on
+	 * purpose by crafting the addresses, ports and identifiers.
+	 */
+	t->seed = (uint32_t)time(NULL) ^ (uint32_t)(uintptr_t)t;
+	t->seed = hash_key(NULL, &t->types[0].lru.key, t->seed);
+}
+
+static void
+grow_table(struct flow_table *t)
+{
+	struct nd_flow **buckets, *f, *next;
+	u_int nbuckets, i;
+
+	nbuckets = t->nbuckets * 2;
+	buckets = calloc(nbuckets, sizeof(*buckets));
+	if (buckets == NULL)
+		return;		/* live with longer chains */
+	for (i = 0; i < t->nbuckets; i++) {
+		for (f = t->buckets[i]; f != NULL; f = next) {
+			next = f->hash_next;
+			f->hash_next = buckets[f->hash & (nbuckets - 1)];
+			buckets[f->hash & (nbuckets - 1)] = f;
+		}
+	}
+	free(t->buckets);
+	t->buckets = buckets;
+	t->nbuckets = nbuckets;
+}
+
+static void
+remove_flow(struct flow_table *t, struct nd_flow *f)
+{
+	struct nd_flow **fp;
+
+	for (fp = &t->buckets[f->hash & (t->nbuckets - 1)]; *fp != f;
+	    fp = &(*fp)->hash_next)
+		;
+	*fp = f->hash_next;
+	list_remove(f);
+	t->types[f->type->index].count--;
+	t->count--;
+	if (f->type->free_data != NULL)
+		(*f->type->free_data)(ND_FLOW_DATA(f));
+	free(f);
+}
+
+/*
+ * Remove the closed flows, and the idle ones or those at the end of
+ * their lifetime that have expired.  The lists are in the order in
+ * which their flows expire, the first ones to expire last.
+ */
+static void
+expire_flows(struct flow_table *t, time_t now)
+{
+	struct flow_lists *l;
+	struct nd_flow *f;
+	u_int i;
+
+	for (i = 0; i < ND_FLOW_NTYPES; i++) {
+		l = &t->types[i];
+		while ((f = l->closed.prev) != &l->closed &&
+		    f->expires <= now) {
+			STATS_INC(f->type->stats.closed);
+			remove_flow(t, f);
+		}
+		if (flow_timeout == 0 && nd_flow_types[i]->lifetime == 0)
+			continue;
+		while ((f = l->lru.prev) != &l->lru && f->expires <= now) {
+			STATS_INC(f->type->stats.expired);
+			remove_flow(t, f);
+		}
+	}
+}
+
+/*
+ * Return the last flow of a list, if it's older than oldest or oldest
+ * is NULL, and oldest otherwise.
+ */
+static struct nd_flow *
+older_flow(struct nd_flow *head, struct nd_flow *oldest)
+{
+	struct nd_flow *f = head->prev;
+
+	if (f != head && (oldest == NULL || f->expires < oldest->expires))
+		return f;
+	return oldest;
+}
+
+/*
+ * Return the flow to evict to make room among the flows of a type, or
+ * of all types if l is NULL: the one closed first, if any, or else the
+ * least recently seen one.
+ */
+static struct nd_flow *
+oldest_flow(struct flow_table *t, struct flow_lists *l)
+{
+	struct nd_flow *oldest = NULL;
+	u_int i;
+
+	if (l != NULL) {
+		oldest = older_flow(&l->closed, NULL);
+		return oldest != NULL ? oldest : older_flow(&l->lru, NULL);
+	}
+	for (i = 0; i < ND_FLOW_NTYPES; i++)
+		oldest = older_flow(&t->types[i].closed, oldest);
+	if (oldest != NULL)
+		return oldest;
+	for (i = 0; i < ND_FLOW_NTYPES; i++)
+		oldest = older_flow(&t->types[i].lru, oldest);
+	return oldest;
+}
+
+/*
+ * Find the flow of the given type with the given key; if there's none,
+ * add one, with its data zeroed, if create is set, and return NULL
+ * otherwise.  The flow becomes the most recently seen one, unless it's
+ * closed or its type gives it a lifetime.
+ */
+struct nd_flow *
+nd_flow_lookup(netdissect_options *ndo, struct nd_flow_type *type,
+	       const struct nd_flow_key *key, int create)
+{
+	struct flow_table *t = &flows;
+	struct flow_lists *l = &t->types[type->index];
+	struct nd_flow *f;
+	time_t now = ndo->ndo_latest_time;
+	uint32_t hash;
+
+	if (t->buckets == NULL) {
+		if (!create) {
+			STATS_INC(type->stats.misses);
+			return NULL;
+		}
+		init_table(ndo, t);
+	}
+	expire_flows(t, now);
+
+	hash = hash_key(type, key, t->seed);
+	for (f = t->buckets[hash & (t->nbuckets - 1)]; f != NULL;
+	    f = f->hash_next) {
+		if (f->hash == hash && f->type == type &&
+		    memcmp(&f->key, key, sizeof(*key)) == 0) {
+			if (!(f->flags & ND_FLOW_CLOSED) &&
+			    type->lifetime == 0) {
+				list_remove(f);
+				list_insert(&l->lru, f);
+				f->expires = now + flow_timeout;
+			}
+			STATS_INC(type->stats.hits);
+			return f;
+		}
+	}
+	if (!create) {
+		STATS_INC(type->stats.misses);
+		return NULL;
+	}
+
+	/* Make room, evicting a closed flow first. */
+	if (type->max != 0 && l->count >= type->max) {
+		f = oldest_flow(t, l);
+		STATS_INC(f->type->stats.evicted);
+		remove_flow(t, f);
+	}
+	if (t->count >= flow_max) {
+		f = oldest_flow(t, NULL);
+		STATS_INC(f->type->stats.evicted);
+		remove_flow(t, f);
+	}
+	if (t->count >= t->nbuckets)
+		grow_table(t);
+
+	f = malloc(sizeof(*f) + type->data_size);
+	if (f == NULL)
+		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: malloc",
+		    __func__);
+	memset(ND_FLOW_DATA(f), 0, type->data_size);
+	f->type = type;
+	f->hash = hash;
+	f->flags = 0;
+	f->expires = now + (type->lifetime != 0 ? type->lifetime :
+	    flow_timeout);
+	f->key = *key;
+	f->hash_next = t->buckets[hash & (t->nbuckets - 1)];
+	t->buckets[hash & (t->nbuckets - 1)] = f;
+	list_insert(&l->lru, f);
+	l->count++;
+	t->count++;
+	STATS_INC(type->stats.created);
+	return f;
+}
+
+/*
+ * Mark a flow as closed; it's removed ND_FLOW_CLOSED_TIMEOUT seconds
+ * later, unless it's reopened.
+ */
+void
+nd_flow_close(netdissect_options *ndo, struct nd_flow *f)
+{
+	if (f->flags & ND_FLOW_CLOSED)
+		return;
+	list_remove(f);
+	list_insert(&flows.types[f->type->index].closed, f);
+	f->flags |= ND_FLOW_CLOSED;
+	f->expires = ndo->ndo_latest_time + ND_FLOW_CLOSED_TIMEOUT;
+}
+
+/*
+ * Make a closed flow active again, for instance when a new connection
+ * uses the same addresses and ports.
+ */
+void
+nd_flow_reopen(netdissect_options *ndo, struct nd_flow *f)
+{
+	if (!(f->flags & ND_FLOW_CLOSED))
+		return;
+	list_remove(f);
+	list_insert(&flows.types[f->type->index].lru, f);
+	f->flags &= ~ND_FLOW_CLOSED;
+	f->expires = ndo->ndo_latest_time + flow_timeout;
+}
+
+/*
+ * Remove a flow now, for instance when the printer is done with it.
+ */
+void
+nd_flow_remove(struct nd_flow *f)
+{
+	STATS_INC(f->type->stats.closed);
+	remove_flow(&flows, f);
+}
+
+/*
+ * Set the maximum number of flows per thread, of all types, and the
+ * idle timeout, in seconds, 0 meaning none.
+ */
+void
+nd_flow_set_limits(u_int max, u_int timeout)
+{
+	flow_max = max;
+	flow_timeout = timeout;
+}
+
+/*
+ * Set the maximum number of flows of a type per thread, 0 meaning no
+ * limit other than the one for all types.
+ */
+void
+nd_flow_set_type_limit(struct nd_flow_type *type, u_int max)
+{
+	type->max = max;
+}
+
+void
+nd_flow_get_stats(const struct nd_flow_type *type, struct nd_flow_stats *sp)
+{
+	sp->hits = STATS_GET(type->stats.hits);
+	sp->misses = STATS_GET(type->stats.misses);
+	sp->created = STATS_GET(type->stats.created);
+	sp->closed = STATS_GET(type->stats.closed);
+	sp->expired = STATS_GET(type->stats.expired);
+	sp->evicted = STATS_GET(type->stats.evicted);
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef flowtable_h
+#define flowtable_h
+
+/*
+ * Per-conversation state kept by the printers.
+ *
+ * Each thread has one table of flows, shared by all the printers that
+ * keep state across packets.  A flow is identified by its type, which
+ * says which printer it belongs to and what data it has, and by a key:
+ * the address family, protocol, addresses and ports, in a canonical
+ * order, so that both directions of a conversation have the same key,
+ * and an identifier defined by the printer, such as an RPC transaction
+ * ID.  The flows are kept in a hash table with a seeded hash of the
+ * whole key, and in a list per type from the least recently seen one;
+ * the table has at most a set number of flows, of all types, and a type
+ * may have a lower limit of its own; when a limit is reached, the least
+ * recently seen flow, of any type or of that type, is evicted to make
+ * room for a new one.  Flows that
+ * haven't been seen for the idle timeout, measured against the latest
+ * time stamp so far, are evicted, and so are the flows that have been closed, for
+ * instance by a TCP FIN exchange or RST, after a short while, so that
+ * the stray packets that follow the close still find them.  A type may
+ * instead give its flows a lifetime, such as the time allowed for the
+ * fragments of an IP datagram to arrive, after which they're evicted
+ * however recently they were seen.
+ *
+ * The tables are per thread; the counters are shared by all threads.
+ */
+
+/* Defaults for the maximum number of flows and the idle timeout */
+#define ND_FLOW_DEFAULT_MAX	262144
+#define ND_FLOW_DEFAULT_TIMEOUT	0
+
+/* Seconds a closed flow is kept, for the packets that follow the close */
+#define ND_FLOW_CLOSED_TIMEOUT	30
+
+/* Longest identifier in a key, the length of a QUIC connection ID */
+#define ND_FLOW_MAX_ID_LEN	20
+
+struct nd_flow_key {
+	uint8_t af;			/* 4, 6, or 0 if no addresses */
+	uint8_t proto;			/* IPPROTO_ value */
+	uint16_t port[2];		/* in host byte order */
+	u_char addr[2][16];		/* IPv4 addresses use 4 bytes */
+	uint8_t id_len;
+	u_char id[ND_FLOW_MAX_ID_LEN];	/* defined by the printer */
+};
+
+struct nd_flow_stats {
+	u_int hits;			/* lookups that found a flow */
+	u_int misses;			/* lookups that didn't, and didn't add one */
+	u_int created;			/* flows added */
+	u_int closed;			/* removed after being closed */
+	u_int expired;			/* removed after the idle timeout */
+	u_int evicted;			/* removed to make room */
+};
+
+/*
+ * A type of flow, with the data that a printer attaches to each flow
+ * of that type.
+ */
+struct nd_flow_type {
+	u_int index;			/* ND_FLOW_TYPE_ value */
+	const char *name;		/* what a flow is, for the counters */
+	size_t data_size;
+	void (*free_data)(void *);	/* called when a flow is removed */
+	u_int lifetime;			/* seconds, 0 for the idle timeout */
+	u_int max;			/* most flows per thread, 0 if no limit */
+	struct nd_flow_stats stats;
+};
+
+#define ND_FLOW_TYPE_INIT(index, name, data_size) \
+	ND_FLOW_TYPE_INIT_FREE(index, name, data_size, NULL)
+#define ND_FLOW_TYPE_INIT_FREE(index, name, data_size, free_data) \
+	ND_FLOW_TYPE_INIT_LIFETIME(index, name, data_size, free_data, 0)
+#define ND_FLOW_TYPE_INIT_LIFETIME(index, name, data_size, free_data, lifetime) \
+	{ (index), (name), (data_size), (free_data), (lifetime), 0, \
+	  { 0, 0, 0, 0, 0, 0 } }
+
+#define ND_FLOW_TYPE_TCP_SEQ		0
+#define ND_FLOW_TYPE_SUNRPC_CALL	1
+#define ND_FLOW_TYPE_RX_CALL		2
+#define ND_FLOW_TYPE_QUIC_CID		3
+#define ND_FLOW_TYPE_TCP_STREAM		4
+#define ND_FLOW_TYPE_IP_DATAGRAM	5
+#define ND_FLOW_NTYPES			6
+
+struct nd_flow {
+	struct nd_flow *hash_next;
+	struct nd_flow *prev;		/* in the LRU or closed list */
+	struct nd_flow *next;
+	struct nd_flow_type *type;
+	uint32_t hash;
+	u_int flags;			/* ND_FLOW_ values */
+	time_t expires;
+	struct nd_flow_key key;
+	/* followed by the data of the printer, zeroed when created */
+};
+
+#define ND_FLOW_CLOSED	0x01		/* in the closed list */
+
+/* The data of the printer that follows a flow */
+#define ND_FLOW_DATA(f)	((void *)((f) + 1))
+
+/* The types of flow of the printers, for the counters */
+extern struct nd_flow_type tcp_seq_flow_type;
+extern struct nd_flow_type sunrpc_call_flow_type;
+extern struct nd_flow_type rx_call_flow_type;
+extern struct nd_flow_type quic_cid_flow_type;
+extern struct nd_flow_type tcp_stream_flow_type;
+extern struct nd_flow_type ip_datagram_flow_type;
+
+/* All of the above, by ND_FLOW_TYPE_ value, ending with NULL */
+extern struct nd_flow_type *const nd_flow_types[];
+
+extern int nd_flow_key_set(struct nd_flow_key *, const u_char *,
+    uint8_t, uint16_t, uint16_t);
+extern void nd_flow_key_set_id(struct nd_flow_key *, const void *, u_int);
+extern struct nd_flow *nd_flow_lookup(netdissect_options *,
+    struct nd_flow_type *, const struct nd_flow_key *, int);
+extern void nd_flow_close(netdissect_options *, struct nd_flow *);
+extern void nd_flow_reopen(netdissect_options *, struct nd_flow *);
+extern void nd_flow_remove(struct nd_flow *);
+extern void nd_flow_set_limits(u_int, u_int);
+extern void nd_flow_set_type_limit(struct nd_flow_type *, u_int);
+extern void nd_flow_get_stats(const struct nd_flow_type *,
+    struct nd_flow_stats *);
+
+#endif /* flowtable_h */
@@ -66,6 +66,8 @@ struct ip {
 	nd_ipv4		ip_src,ip_dst;	/* source and dest address */
 };
 
+#define IP_HDRLEN	20		/* "struct ip" on the wire */
+
 #define	IP_MAXPACKET	65535		/* maximum packet size */
 
 /*
@@ -87,6 +87,8 @@ struct ip6_hdr {
 	nd_ipv6 ip6_dst;	/* destination address */
 };
 
+#define IP6_HDRLEN	40		/* "struct ip6_hdr" on the wire */
+
 #define ip6_vfc		ip6_ctlun.ip6_un2_vfc
 #define IP6_VERSION(ip6_hdr)	((GET_U_1((ip6_hdr)->ip6_vfc) & 0xf0) >> 4)
 #define ip6_flow	ip6_ctlun.ip6_un1.ip6_un1_flow
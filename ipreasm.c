@@ -0,0 +1,516 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "netdissect.h"
+#include "ip.h"
+#include "ip6.h"
+#include "flowtable.h"
+#include "ipreasm.h"
+
+/* Largest IPv4 datagram, and largest IPv6 payload without a jumbogram */
+#define IP_MAXLEN	65535
+#define IP6_MAXPLEN	65535
+
+/* Last byte of the hole at the end, until the last fragment is seen */
+#define HOLE_END	UINT_MAX
+
+/* Results of add_fragment() */
+#define REASM_INCOMPLETE	0	/* more fragments are needed */
+#define REASM_COMPLETE		1	/* the datagram is complete */
+#define REASM_OVERLAP		2	/* overlaps different data */
+#define REASM_INVALID		3	/* inconsistent with the others */
+#define REASM_DISCARDED		4	/* the datagram was discarded */
+#define REASM_NO_MEMORY		5	/* the datagram is over the limit */
+
+struct hole {
+	struct hole *next;
+	u_int first;			/* first and last bytes */
+	u_int last;
+};
+
+/*
+ * A datagram being reassembled; the flow of a datagram has the
+ * addresses, protocol and identification in its key.
+ */
+struct datagram {
+	struct datagram *prev;		/* in the buffer list, oldest last */
+	struct datagram *next;
+	uint8_t af;
+	int discarded;
+	u_int nfrags;
+	u_char *hdr;			/* from the first fragment */
+	u_int hdr_len;
+	u_int nh_off;
+	uint8_t nh;
+	u_char *data;
+	u_int size;			/* allocated for data */
+	u_int len;			/* 0 until the last fragment is seen */
+	u_int max_end;			/* end of the data received */
+	struct hole *holes;		/* in order */
+	size_t mem;			/* used by all of the above */
+};
+
+/* The datagrams of a thread that have buffers, that is not discarded */
+struct datagram_buffers {
+	struct datagram list;		/* list head, oldest last */
+	size_t mem_used;
+};
+
+static ND_THREAD_LOCAL struct datagram_buffers buffers;
+
+/* The same for all threads; set before any of them are started */
+static size_t mem_limit = IP_REASM_DEFAULT_LIMIT_KB * (size_t)1024;
+
+static void datagram_free(void *);
+
+struct nd_flow_type ip_datagram_flow_type =
+    ND_FLOW_TYPE_INIT_LIFETIME(ND_FLOW_TYPE_IP_DATAGRAM, "IP datagram",
+			       sizeof(struct datagram), datagram_free,
+			       IP_REASM_TIMEOUT);
+
+static void
+list_insert(struct datagram *d)
+{
+	struct datagram *head = &buffers.list;
+
+	if (head->next == NULL)
+		head->next = head->prev = head;
+	d->prev = head;
+	d->next = head->next;
+	head->next->prev = d;
+	head->next = d;
+}
+
+/*
+ * Free the header, data and holes of a datagram, keeping the datagram
+ * itself, so that the fragments that follow are known to be part of a
+ * discarded one.
+ */
+static void
+discard_datagram(struct datagram *d)
+{
+	struct hole *h;
+
+	if (d->discarded)
+		return;
+	while ((h = d->holes) != NULL) {
+		d->holes = h->next;
+		free(h);
+	}
+	free(d->hdr);
+	free(d->data);
+	d->hdr = d->data = NULL;
+	d->size = 0;
+	d->prev->next = d->next;
+	d->next->prev = d->prev;
+	buffers.mem_used -= d->mem;
+	d->mem = 0;
+	d->discarded = 1;
+}
+
+/* Called when the flow of a datagram is removed */
+static void
+datagram_free(void *data)
+{
+	discard_datagram(data);
+}
+
+/*
+ * Discard the oldest datagrams other than d until mem more bytes can
+ * be used; return 0 if they can't.
+ */
+static int
+make_room(const struct datagram *d, size_t mem)
+{
+	struct datagram *old;
+
+	while (buffers.mem_used + mem > mem_limit) {
+		old = buffers.list.prev;
+		if (old == d)
+			old = old->prev;
+		if (old == &buffers.list)
+			return 0;
+		discard_datagram(old);
+	}
+	return 1;
+}
+
+static struct hole *
+new_hole(struct datagram *d, u_int first, u_int last)
+{
+	struct hole *h;
+
+	if (!make_room(d, sizeof(*h)) ||
+	    (h = malloc(sizeof(*h))) == NULL)
+		return NULL;
+	h->first = first;
+	h->last = last;
+	d->mem += sizeof(*h);
+	buffers.mem_used += sizeof(*h);
+	return h;
+}
+
+static void
+free_hole(struct datagram *d, struct hole *h)
+{
+	free(h);
+	d->mem -= sizeof(*h);
+	buffers.mem_used -= sizeof(*h);
+}
+
+/*
+ * Return 1 if the data of a fragment, from first to end, is the same
+ * as the data already received where they overlap, 0 otherwise.
+ */
+static int
+same_data(const struct datagram *d, const u_char *data, u_int first,
+	  u_int end)
+{
+	const struct hole *h;
+	u_int pos, stop;
+
+	/* What isn't in a hole has been received. */
+	pos = first;
+	for (h = d->holes; h != NULL && pos < end; h = h->next) {
+		if (h->last < pos)
+			continue;
+		stop = ND_MIN(h->first, end);
+		if (pos < stop &&
+		    memcmp(d->data + pos, data + (pos - first), stop - pos) != 0)
+			return 0;
+		if (h->last >= end)
+			return 1;
+		pos = ND_MAX(pos, h->last + 1);
+	}
+	if (pos < end &&
+	    memcmp(d->data + pos, data + (pos - first), end - pos) != 0)
+		return 0;
+	return 1;
+}
+
+/*
+ * Remove from the holes of a datagram the bytes from first to end,
+ * which have just been received; return 0 if out of memory.
+ */
+static int
+fill_holes(struct datagram *d, u_int first, u_int end)
+{
+	struct hole **hp, *h, *n;
+
+	for (hp = &d->holes; (h = *hp) != NULL; ) {
+		if (h->first >= end || h->last < first) {
+			hp = &h->next;
+			continue;
+		}
+		if (h->first < first && h->last >= end) {
+			/* Split it in two. */
+			n = new_hole(d, end, h->last);
+			if (n == NULL)
+				return 0;
+			n->next = h->next;
+			h->last = first - 1;
+			h->next = n;
+			hp = &n->next;
+		} else if (h->first < first) {
+			h->last = first - 1;
+			hp = &h->next;
+		} else if (h->last >= end) {
+			h->first = end;
+			hp = &h->next;
+		} else {
+			*hp = h->next;
+			free_hole(d, h);
+		}
+	}
+	return 1;
+}
+
+/*
+ * The last fragment has been seen: the datagram is len bytes long, and
+ * so has no hole past that.
+ */
+static void
+set_length(struct datagram *d, u_int len)
+{
+	struct hole **hp, *h;
+
+	d->len = len;
+	for (hp = &d->holes; (h = *hp) != NULL; ) {
+		if (h->first >= len) {
+			*hp = h->next;
+			free_hole(d, h);
+			continue;
+		}
+		if (h->last >= len)
+			h->last = len - 1;
+		hp = &h->next;
+	}
+}
+
+/*
+ * Find the flow of the datagram of a fragment, adding it if needed; the
+ * datagram of a new flow has no buffer yet.
+ */
+static struct nd_flow *
+find_datagram(netdissect_options *ndo, const struct ip_reasm_frag *frag)
+{
+	struct nd_flow_key key;
+	u_int len = frag->af == 4 ? 4 : 16;
+
+	/* The addresses in the order of the fragment, not canonical. */
+	memset(&key, 0, sizeof(key));
+	key.af = (uint8_t)frag->af;
+	key.proto = frag->proto;
+	memcpy(key.addr[0], frag->src, len);
+	memcpy(key.addr[1], frag->dst, len);
+	nd_flow_key_set_id(&key, &frag->id, sizeof(frag->id));
+	return nd_flow_lookup(ndo, &ip_datagram_flow_type, &key, 1);
+}
+
+/*
+ * Start a new datagram, with one hole for all of it; returns 0 if out
+ * of memory.
+ */
+static int
+init_datagram(struct datagram *d, u_int af)
+{
+	d->af = (uint8_t)af;
+	if (!make_room(NULL, sizeof(*d->holes)) ||
+	    (d->holes = malloc(sizeof(*d->holes))) == NULL) {
+		d->discarded = 1;
+		return 0;
+	}
+	d->holes->next = NULL;
+	d->holes->first = 0;
+	d->holes->last = HOLE_END;
+	d->mem = sizeof(*d->holes);
+	buffers.mem_used += d->mem;
+	list_insert(d);
+	return 1;
+}
+
+/*
+ * Make room in the buffer of a datagram for the data up to end.
+ */
+static int
+grow_data(struct datagram *d, u_int end)
+{
+	u_char *data;
+	u_int size;
+
+	if (end <= d->size)
+		return 1;
+	/* The length is known, or else leave room for more fragments. */
+	if (d->len != 0)
+		size = d->len;
+	else
+		size = ND_MIN(ND_MAX(end, d->size * 2), IP_MAXLEN);
+	if (!make_room(d, size - d->size) ||
+	    (data = realloc(d->data, size)) == NULL)
+		return 0;
+	d->data = data;
+	d->mem += size - d->size;
+	buffers.mem_used += size - d->size;
+	d->size = size;
+	return 1;
+}
+
+/*
+ * Build the reassembled datagram, with the header of its first
+ * fragment changed to describe the whole datagram.
+ */
+static u_char *
+build_datagram(const struct datagram *d, u_int *lenp)
+{
+	struct cksum_vec vec[1];
+	u_char *buf;
+	u_int len;
+	uint16_t sum;
+
+	len = d->hdr_len + d->len;
+	buf = malloc(len);
+	if (buf == NULL)
+		return NULL;
+	memcpy(buf, d->hdr, d->hdr_len);
+	memcpy(buf + d->hdr_len, d->data, d->len);
+	if (d->af == 4) {
+		/* Total length, no offset or MF flag, and checksum */
+		buf[2] = (u_char)(len >> 8);
+		buf[3] = (u_char)len;
+		buf[6] &= (0x8000|IP_DF) >> 8;	/* the reserved and DF flags */
+		buf[7] = 0;
+		buf[10] = buf[11] = 0;
+		vec[0].ptr = buf;
+		vec[0].len = d->hdr_len;
+		sum = in_cksum(vec, 1);
+		memcpy(buf + 10, &sum, 2);
+	} else {
+		/* Payload length, and no Fragment header */
+		buf[4] = (u_char)((len - sizeof(struct ip6_hdr)) >> 8);
+		buf[5] = (u_char)(len - sizeof(struct ip6_hdr));
+		buf[d->nh_off] = d->nh;
+	}
+	*lenp = len;
+	return buf;
+}
+
+/*
+ * Add a fragment to its datagram.  If that completes it, set *bufp to
+ * the reassembled datagram, allocated with malloc(), and *lenp to its
+ * length.
+ */
+static int
+add_fragment(netdissect_options *ndo, const struct ip_reasm_frag *frag,
+	     u_char **bufp, u_int *lenp, u_int *nfragsp)
+{
+	struct nd_flow *flow;
+	struct datagram *d;
+	u_int first = frag->offset, end = frag->offset + frag->len;
+	u_int max_len;
+
+	/* All fragments but the last are multiples of 8 bytes long. */
+	if (frag->more && (frag->len == 0 || frag->len % 8 != 0))
+		return REASM_INVALID;
+	if (frag->af == 4)
+		max_len = IP_MAXLEN - sizeof(struct ip);
+	else
+		max_len = IP6_MAXPLEN;
+	if (end > max_len)
+		return REASM_INVALID;
+
+	flow = find_datagram(ndo, frag);
+	d = ND_FLOW_DATA(flow);
+	if (d->discarded)
+		return REASM_DISCARDED;
+	/* Zeroed by nd_flow_lookup() if new */
+	if (d->holes == NULL && !init_datagram(d, frag->af))
+		return REASM_NO_MEMORY;
+
+	/*
+	 * The last fragment ends the datagram, and no other fragment
+	 * may go past that end.
+	 */
+	if (d->len != 0 ? end > d->len || (!frag->more && end != d->len) :
+	    !frag->more && d->max_end > end) {
+		discard_datagram(d);
+		return REASM_INVALID;
+	}
+	if (!same_data(d, frag->data, first, end)) {
+		discard_datagram(d);
+		return REASM_OVERLAP;
+	}
+
+	if (first == 0 && d->hdr == NULL) {
+		if (!make_room(d, frag->hdr_len) ||
+		    (d->hdr = malloc(frag->hdr_len)) == NULL) {
+			discard_datagram(d);
+			return REASM_NO_MEMORY;
+		}
+		memcpy(d->hdr, frag->hdr, frag->hdr_len);
+		d->hdr_len = frag->hdr_len;
+		d->nh_off = frag->nh_off;
+		d->nh = frag->nh;
+		d->mem += frag->hdr_len;
+		buffers.mem_used += frag->hdr_len;
+	}
+	if (!frag->more)
+		set_length(d, end);
+	if (!grow_data(d, end) || !fill_holes(d, first, end)) {
+		discard_datagram(d);
+		return REASM_NO_MEMORY;
+	}
+	if (frag->len != 0)
+		memcpy(d->data + first, frag->data, frag->len);
+	d->max_end = ND_MAX(d->max_end, end);
+	d->nfrags++;
+	if (d->holes != NULL)
+		return REASM_INCOMPLETE;
+
+	/* Complete; the first fragment, with the header, has been seen. */
+	*nfragsp = d->nfrags;
+	if (d->af == 4 ? d->hdr_len + d->len > IP_MAXLEN :
+	    d->hdr_len - sizeof(struct ip6_hdr) + d->len > IP6_MAXPLEN) {
+		nd_flow_remove(flow);
+		return REASM_INVALID;
+	}
+	*bufp = build_datagram(d, lenp);
+	nd_flow_remove(flow);
+	if (*bufp == NULL)
+		return REASM_NO_MEMORY;
+	return REASM_COMPLETE;
+}
+
+/*
+ * Add a fragment to its datagram and, if that completes the datagram,
+ * print it.
+ */
+void
+ip_reasm_fragment(netdissect_options *ndo, const struct ip_reasm_frag *frag)
+{
+	u_char *buf = NULL;
+	u_int len = 0, nfrags = 0;
+
+	switch (add_fragment(ndo, frag, &buf, &len, &nfrags)) {
+
+	case REASM_INCOMPLETE:
+		return;
+
+	case REASM_OVERLAP:
+		ND_PRINT(" [overlapping fragment]");
+		return;
+
+	case REASM_INVALID:
+		ND_PRINT(" [invalid fragment]");
+		return;
+
+	case REASM_DISCARDED:
+		ND_PRINT(" [datagram discarded]");
+		return;
+
+	case REASM_NO_MEMORY:
+		ND_PRINT(" [reassembly memory exhausted]");
+		return;
+	}
+
+	ND_PRINT(", reassembled from %u fragments: ", nfrags);
+	if (!nd_push_buffer(ndo, buf, buf, len)) {
+		free(buf);
+		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+			"%s: can't push buffer on buffer stack", __func__);
+	}
+	if (frag->af == 4)
+		ip_print(ndo, buf, len);
+	else
+		ip6_print(ndo, buf, len);
+	nd_pop_packet_info(ndo);
+}
+
+/*
+ * Set the limit on the memory used by the datagrams of each thread.
+ */
+void
+ip_reasm_set_limit(size_t limit)
+{
+	mem_limit = limit;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef ipreasm_h
+#define ipreasm_h
+
+/*
+ * Reassembly of fragmented IPv4 and IPv6 datagrams ("--reassemble-ip").
+ *
+ * The datagrams being reassembled are flows (see flowtable.h), found by
+ * their addresses, identification and, for IPv4, protocol.  A datagram
+ * has a buffer with the data of the fragments received so far, and a
+ * list of the holes left in it, as in RFC 815; it's complete once the
+ * last fragment has been received and no hole is left.  It's then
+ * printed, with the header of its first fragment, as an unfragmented
+ * datagram.
+ *
+ * A fragment may overlap data already received only if it has the
+ * same data, as a duplicate does; otherwise, as the receiver could
+ * have kept either copy, the datagram is discarded, and so are its
+ * fragments that follow, as RFC 5722 requires for IPv6.  A datagram
+ * that isn't complete IP_REASM_TIMEOUT seconds after its first
+ * fragment, measured against the latest time stamp so far, is
+ * dropped.  The oldest datagrams are discarded when the buffers of
+ * those of a thread would use more memory than the limit, and, as
+ * other flows, when there are too many flows.
+ */
+
+/* Default and smallest limits on the memory used by each thread */
+#define IP_REASM_DEFAULT_LIMIT_KB	4096
+#define IP_REASM_MIN_LIMIT_KB		256
+
+/* Seconds to wait for the fragments of a datagram */
+#define IP_REASM_TIMEOUT		60
+
+struct ip_reasm_frag {
+	u_int af;			/* 4 or 6 */
+	uint8_t proto;			/* IPv4 protocol, 0 for IPv6 */
+	const u_char *src;		/* addresses, 4 or 16 bytes */
+	const u_char *dst;
+	uint32_t id;			/* identification */
+	u_int offset;			/* in bytes */
+	int more;			/* More Fragments flag */
+	const u_char *data;
+	u_int len;
+	/*
+	 * The part of the datagram that precedes the fragment data:
+	 * the IPv4 header, or the IPv6 header and the extension headers
+	 * before the Fragment header.  For IPv6, nh_off is the offset,
+	 * in it, of the Next Header field that names the Fragment
+	 * header, and nh the Next Header field of the Fragment header.
+	 * Only those of the first fragment are used.
+	 */
+	const u_char *hdr;
+	u_int hdr_len;
+	u_int nh_off;
+	uint8_t nh;
+};
+
+extern void ip_reasm_fragment(netdissect_options *,
+    const struct ip_reasm_frag *);
+extern void ip_reasm_set_limit(size_t);
+
+#endif /* ipreasm_h */
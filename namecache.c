@@ -0,0 +1,428 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "netdissect.h"
+#include "namecache.h"
+
+/* Number of slots of a cache or of the string table when first used */
+#define INITIAL_SIZE	256
+
+/* Whether a table of size slots is too full for one more entry */
+#define TOO_FULL(count, size)	(((count) + 1) * 4 > (size) * 3)
+
+/*
+ * Whether slot k, where an entry that hashes to slot h is, may be
+ * moved to the empty slot i when deleting from a table with linear
+ * probing: it may unless h is cyclically in (i, k].
+ */
+#define MAY_MOVE(h, i, k) \
+	((i) <= (k) ? ((h) <= (i) || (h) > (k)) : ((h) <= (i) && (h) > (k)))
+
+/* The same for all threads; set before any of them are started */
+static size_t mem_limit = NAME_CACHE_DEFAULT_LIMIT_KB * (size_t)1024;
+
+static ND_THREAD_LOCAL size_t mem_used;
+static ND_THREAD_LOCAL u_int generation = 1;
+
+/*
+ * Interned names.
+ */
+struct name_string {
+	u_int refs;
+	uint32_t hash;
+	char str[];
+};
+
+#define STRING_ALLOC_SIZE(len)	(offsetof(struct name_string, str) + (len) + 1)
+
+static ND_THREAD_LOCAL struct name_string **strings;
+static ND_THREAD_LOCAL u_int strings_size;
+static ND_THREAD_LOCAL u_int strings_count;
+
+static uint32_t
+hash_string(const char *str, size_t *lenp)
+{
+	const u_char *p;
+	uint32_t h = 2166136261U;
+
+	/* FNV-1a */
+	for (p = (const u_char *)str; *p != '\0'; p++) {
+		h ^= *p;
+		h *= 16777619U;
+	}
+	*lenp = (size_t)(p - (const u_char *)str);
+	return h;
+}
+
+static uint32_t
+hash_key(const u_char *key, u_int len)
+{
+	uint32_t h, w;
+
+	h = 0x9e3779b9U * len;
+	for (; len >= 4; key += 4, len -= 4) {
+		memcpy(&w, key, 4);
+		h = (h ^ w) * 0x85ebca6bU;
+		h ^= h >> 15;
+	}
+	for (; len > 0; key++, len--)
+		h = (h ^ *key) * 0xcc9e2d51U;
+	h ^= h >> 16;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+	return h;
+}
+
+static void
+grow_strings(netdissect_options *ndo)
+{
+	struct name_string **table;
+	u_int size, i, j;
+
+	size = strings_size != 0 ? strings_size * 2 : INITIAL_SIZE;
+	table = (struct name_string **)calloc(size, sizeof(*table));
+	if (table == NULL)
+		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: calloc",
+		    __func__);
+	for (i = 0; i < strings_size; i++) {
+		if (strings[i] == NULL)
+			continue;
+		j = strings[i]->hash & (size - 1);
+		while (table[j] != NULL)
+			j = (j + 1) & (size - 1);
+		table[j] = strings[i];
+	}
+	free(strings);
+	mem_used += (size - strings_size) * sizeof(*table);
+	strings = table;
+	strings_size = size;
+}
+
+/*
+ * Return the interned copy of str, with one more reference to it.
+ */
+static char *
+intern(netdissect_options *ndo, const char *str)
+{
+	struct name_string *s;
+	uint32_t hash;
+	size_t len;
+	u_int i;
+
+	if (TOO_FULL(strings_count, strings_size))
+		grow_strings(ndo);
+	hash = hash_string(str, &len);
+	for (i = hash & (strings_size - 1); strings[i] != NULL;
+	    i = (i + 1) & (strings_size - 1)) {
+		s = strings[i];
+		if (s->hash == hash && strcmp(s->str, str) == 0) {
+			s->refs++;
+			return s->str;
+		}
+	}
+	s = (struct name_string *)malloc(STRING_ALLOC_SIZE(len));
+	if (s == NULL)
+		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: malloc",
+		    __func__);
+	s->refs = 1;
+	s->hash = hash;
+	memcpy(s->str, str, len + 1);
+	strings[i] = s;
+	strings_count++;
+	mem_used += STRING_ALLOC_SIZE(len);
+	return s->str;
+}
+
+/*
+ * Drop a reference to an interned name, and free it if it was the last.
+ */
+static void
+release(char *str)
+{
+	struct name_string *s;
+	u_int i, j, h, mask = strings_size - 1;
+
+	s = (struct name_string *)(void *)(str - offsetof(struct name_string, str));
+	if (--s->refs != 0)
+		return;
+	for (i = s->hash & mask; strings[i] != s; i = (i + 1) & mask)
+		;
+	for (j = (i + 1) & mask; strings[j] != NULL; j = (j + 1) & mask) {
+		h = strings[j]->hash & mask;
+		if (MAY_MOVE(h, i, j)) {
+			strings[i] = strings[j];
+			i = j;
+		}
+	}
+	strings[i] = NULL;
+	strings_count--;
+	mem_used -= STRING_ALLOC_SIZE(strlen(s->str));
+	free(s);
+}
+
+/*
+ * The key of an entry, and its length.
+ */
+static const u_char *
+entry_key(const struct name_cache *nc, const struct name_entry *e,
+	  u_int *lenp)
+{
+	if (nc->key_len != 0) {
+		*lenp = nc->key_len;
+		return e->key.fixed;
+	}
+	*lenp = e->key.var.len;
+	return e->key.var.bytes;
+}
+
+static uint32_t
+hash_entry(const struct name_cache *nc, const struct name_entry *e)
+{
+	const u_char *key;
+	u_int len;
+
+	key = entry_key(nc, e, &len);
+	return hash_key(key, len);
+}
+
+static void
+grow_cache(netdissect_options *ndo, struct name_cache *nc)
+{
+	struct name_entry *entries, *e;
+	u_int size, i, j;
+
+	size = nc->size != 0 ? nc->size * 2 : INITIAL_SIZE;
+	entries = (struct name_entry *)calloc(size, sizeof(*entries));
+	if (entries == NULL)
+		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: calloc",
+		    __func__);
+	for (i = 0; i < nc->size; i++) {
+		e = &nc->entries[i];
+		if (!(e->flags & NAME_ENTRY_IN_USE))
+			continue;
+		j = hash_entry(nc, e) & (size - 1);
+		while (entries[j].flags & NAME_ENTRY_IN_USE)
+			j = (j + 1) & (size - 1);
+		entries[j] = *e;
+	}
+	free(nc->entries);
+	mem_used += (size - nc->size) * sizeof(*entries);
+	nc->entries = entries;
+	nc->size = size;
+	nc->hand = 0;
+}
+
+static void
+remove_entry(struct name_cache *nc, u_int i)
+{
+	struct name_entry *entries = nc->entries;
+	u_int j, h, mask = nc->size - 1;
+
+	if (entries[i].name != NULL)
+		release(entries[i].name);
+	if (nc->key_len == 0) {
+		mem_used -= entries[i].key.var.len;
+		free(entries[i].key.var.bytes);
+	}
+	for (j = (i + 1) & mask; entries[j].flags & NAME_ENTRY_IN_USE;
+	    j = (j + 1) & mask) {
+		h = hash_entry(nc, &entries[j]) & mask;
+		if (MAY_MOVE(h, i, j)) {
+			entries[i] = entries[j];
+			i = j;
+		}
+	}
+	memset(&entries[i], 0, sizeof(entries[i]));
+	nc->count--;
+}
+
+/*
+ * Evict an entry with the CLOCK algorithm; returns 0 if no entry could
+ * be evicted.
+ */
+static int
+evict(struct name_cache *nc)
+{
+	struct name_entry *e;
+	u_int n;
+
+	/* At most two turns; the first one might only clear flags. */
+	for (n = 0; n < 2 * nc->size; n++) {
+		e = &nc->entries[nc->hand];
+		if ((e->flags & (NAME_ENTRY_IN_USE|NAME_ENTRY_PINNED)) ==
+		    NAME_ENTRY_IN_USE && e->used != generation) {
+			if (!(e->flags & NAME_ENTRY_REFERENCED)) {
+				/* The entry moved here will be next. */
+				remove_entry(nc, nc->hand);
+				return 1;
+			}
+			e->flags &= ~NAME_ENTRY_REFERENCED;
+		}
+		nc->hand = (nc->hand + 1) & (nc->size - 1);
+	}
+	return 0;
+}
+
+static struct name_entry *
+lookup(struct name_cache *nc, const void *key, u_int len)
+{
+	struct name_entry *e;
+	const u_char *ekey;
+	u_int i, mask, elen;
+
+	if (nc->count == 0)
+		return NULL;
+	mask = nc->size - 1;
+	for (i = hash_key(key, len) & mask; ; i = (i + 1) & mask) {
+		e = &nc->entries[i];
+		if (!(e->flags & NAME_ENTRY_IN_USE))
+			return NULL;
+		ekey = entry_key(nc, e, &elen);
+		if (elen == len && memcmp(ekey, key, len) == 0) {
+			e->flags |= NAME_ENTRY_REFERENCED;
+			e->used = generation;
+			return e;
+		}
+	}
+}
+
+static struct name_entry *
+add(netdissect_options *ndo, struct name_cache *nc, const void *key,
+    u_int len)
+{
+	struct name_entry *e;
+	u_int i, mask;
+
+	while (mem_used > mem_limit && evict(nc))
+		;
+	if (nc->entries == NULL || TOO_FULL(nc->count, nc->size)) {
+		/*
+		 * Make room by evicting an entry if growing the cache
+		 * would go over the limit.
+		 */
+		if (nc->entries == NULL ||
+		    mem_used + nc->size * sizeof(*e) <= mem_limit ||
+		    !evict(nc))
+			grow_cache(ndo, nc);
+	}
+
+	mask = nc->size - 1;
+	i = hash_key(key, len) & mask;
+	while (nc->entries[i].flags & NAME_ENTRY_IN_USE)
+		i = (i + 1) & mask;
+	e = &nc->entries[i];
+	if (nc->key_len != 0)
+		memcpy(e->key.fixed, key, len);
+	else {
+		e->key.var.bytes = (u_char *)malloc(len != 0 ? len : 1);
+		if (e->key.var.bytes == NULL)
+			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+			    "%s: malloc", __func__);
+		memcpy(e->key.var.bytes, key, len);
+		e->key.var.len = len;
+		mem_used += len;
+	}
+	e->name = NULL;
+	e->retry = 0;
+	e->used = generation;
+	e->state = 0;
+	e->flags = NAME_ENTRY_IN_USE|NAME_ENTRY_REFERENCED;
+	nc->count++;
+	return e;
+}
+
+/*
+ * Find the entry for a key; returns NULL if there's none.
+ */
+struct name_entry *
+name_cache_lookup(struct name_cache *nc, const void *key)
+{
+	return lookup(nc, key, nc->key_len);
+}
+
+/*
+ * The same, in a cache with keys of any length.
+ */
+struct name_entry *
+name_cache_lookup_var(struct name_cache *nc, const void *key, u_int len)
+{
+	return lookup(nc, key, len);
+}
+
+/*
+ * Add an entry, with no name, for a key that isn't in the cache.
+ * Entries returned earlier by name_cache_lookup() and name_cache_add()
+ * may have moved, but their names stay valid until the next packet.
+ */
+struct name_entry *
+name_cache_add(netdissect_options *ndo, struct name_cache *nc,
+	       const void *key)
+{
+	return add(ndo, nc, key, nc->key_len);
+}
+
+/*
+ * The same, in a cache with keys of any length.
+ */
+struct name_entry *
+name_cache_add_var(netdissect_options *ndo, struct name_cache *nc,
+		   const void *key, u_int len)
+{
+	return add(ndo, nc, key, len);
+}
+
+/*
+ * Set the name of an entry, and return it.
+ */
+const char *
+name_cache_set_name(netdissect_options *ndo, struct name_entry *e,
+		    const char *name)
+{
+	char *interned;
+
+	interned = intern(ndo, name);
+	if (e->name != NULL)
+		release(e->name);
+	e->name = interned;
+	return interned;
+}
+
+/*
+ * Called before printing each packet: the names used for the previous
+ * packet may now be evicted.
+ */
+void
+name_cache_new_packet(void)
+{
+	generation++;
+}
+
+/*
+ * Set the limit on the memory used by the caches of each thread.
+ */
+void
+name_cache_set_limit(size_t limit)
+{
+	mem_limit = limit;
+}
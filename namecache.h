@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef namecache_h
+#define namecache_h
+
+/*
+ * Bounded caches of the names of addresses, used by addrtoname.c.
+ *
+ * Each cache is an open-addressed hash table, with linear probing, of
+ * keys of a fixed length, or of any length, such as link-layer addresses
+ * and NSAPs; the keys of the latter are allocated, and count towards the
+ * memory limit below.  The names are interned, so that addresses with
+ * the same name share one copy of it.  The caches of a thread, and
+ * their names, are kept below a memory limit by evicting entries with
+ * the CLOCK algorithm; entries that have been used in the packet being
+ * printed are never evicted, so that the names returned for a packet
+ * stay valid until the next one, and neither are pinned entries, which
+ * hold names that can't be found again, such as those read from the
+ * ethers file at startup.
+ */
+
+#define NAME_CACHE_MAX_KEY_LEN	16
+
+/* Default memory limit, in KiB, and the smallest one allowed */
+#define NAME_CACHE_DEFAULT_LIMIT_KB	(64 * 1024)
+#define NAME_CACHE_MIN_LIMIT_KB		64
+
+struct name_entry {
+	union {
+		u_char fixed[NAME_CACHE_MAX_KEY_LEN];
+		struct {
+			u_char *bytes;	/* allocated */
+			u_int len;
+		} var;
+	} key;
+	char *name;			/* interned, NULL if not set yet */
+	time_t retry;			/* for the user of the cache */
+	u_int used;			/* packet in which it was last used */
+	u_char state;			/* for the user of the cache */
+	u_char flags;			/* NAME_ENTRY_ values */
+};
+
+#define NAME_ENTRY_IN_USE	0x01	/* the slot holds an entry */
+#define NAME_ENTRY_REFERENCED	0x02	/* used since the hand passed */
+#define NAME_ENTRY_PINNED	0x04	/* never evicted */
+
+struct name_cache {
+	struct name_entry *entries;
+	u_int size;			/* number of slots, a power of 2 */
+	u_int count;			/* number of entries */
+	u_int hand;			/* CLOCK hand */
+	u_int key_len;			/* 0 if keys are of any length */
+};
+
+/* Initializer for a cache with keys of the given length */
+#define NAME_CACHE_INIT(key_len)	{ NULL, 0, 0, 0, (key_len) }
+
+/* Initializer for a cache with keys of any length */
+#define NAME_CACHE_INIT_VAR		NAME_CACHE_INIT(0)
+
+extern struct name_entry *name_cache_lookup(struct name_cache *,
+    const void *);
+extern struct name_entry *name_cache_add(netdissect_options *,
+    struct name_cache *, const void *);
+extern struct name_entry *name_cache_lookup_var(struct name_cache *,
+    const void *, u_int);
+extern struct name_entry *name_cache_add_var(netdissect_options *,
+    struct name_cache *, const void *, u_int);
+extern const char *name_cache_set_name(netdissect_options *,
+    struct name_entry *, const char *);
+extern void name_cache_new_packet(void);
+extern void name_cache_set_limit(size_t);
+
+#endif /* namecache_h */
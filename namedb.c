@@ -0,0 +1,781 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <pcap.h>
+#include <pcap-namedb.h>
+#ifndef HAVE_GETSERVENT
+#include <getservent.h>
+#endif
+
+#include "netdissect.h"
+#include "extract.h"
+#include "oui.h"
+#include "namedb.h"
+
+/*
+ * The layout of the file:
+ *
+ *	header:
+ *	    magic, version, size of the file,
+ *	    offset and length of the names,
+ *	    for each table: number of keys, number of buckets,
+ *	        number of slots, key length, offset of the seeds,
+ *	        offset of the slots;
+ *	for each table:
+ *	    the seeds, a 4-byte number per bucket,
+ *	    the slots, each one the offset of its name in the names,
+ *	        or NO_NAME if the slot is empty, and its key;
+ *	the names, NUL-terminated.
+ */
+#define MAGIC		0x74636e64	/* "tcnd" */
+#define VERSION		1
+#define NO_NAME		0xffffffffU
+
+#define HEADER_FIXED_LEN	20
+#define TABLE_HEADER_LEN	24
+#define HEADER_LEN	(HEADER_FIXED_LEN + NAMEDB_NTABLES * TABLE_HEADER_LEN)
+
+/* Longest path of a file in the directory of --name-db-source */
+#define SOURCE_PATH_MAX	1024
+
+#ifndef _WIN32
+#define NAMEDB_HOSTS_FILE	"/etc/hosts"
+#else
+#define NAMEDB_HOSTS_FILE	NULL	/* not read */
+#endif
+
+static const u_int key_lens[NAMEDB_NTABLES] = {
+	2,	/* NAMEDB_TCP_PORT */
+	2,	/* NAMEDB_UDP_PORT */
+	6,	/* NAMEDB_MAC48 */
+	3,	/* NAMEDB_OUI */
+	4,	/* NAMEDB_IPV4 */
+	16,	/* NAMEDB_IPV6 */
+};
+
+struct namedb_table {
+	u_int nkeys;
+	u_int nbuckets;
+	u_int nslots;
+	u_int key_len;
+	const u_char *seeds;
+	const u_char *slots;
+};
+
+struct namedb {
+	u_char *data;
+	size_t size;
+	const char *names;
+	u_int names_len;
+	struct namedb_table tables[NAMEDB_NTABLES];
+};
+
+static uint32_t
+fmix32(uint32_t h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35U;
+	h ^= h >> 16;
+	return h;
+}
+
+/*
+ * Hash a key with a seed; seed 0 gives the bucket of the key, and the
+ * seed of the bucket gives its slot.
+ */
+static uint32_t
+hash_key(const u_char *key, u_int len, uint32_t seed)
+{
+	uint32_t h;
+
+	h = fmix32(seed + 0x9e3779b9U);
+	for (; len > 0; key++, len--)
+		h = (h ^ *key) * 16777619U;
+	return fmix32(h);
+}
+
+/*
+ * Map a database into memory and check it.  Returns NULL, with a
+ * message in errbuf, on failure.
+ */
+struct namedb *
+namedb_open(const char *path, char *errbuf, size_t errbuf_size)
+{
+	struct namedb *db;
+	FILE *f;
+	const u_char *p;
+	struct namedb_table *t;
+	uint64_t names_off, end;
+	u_int i;
+#ifndef _WIN32
+	struct stat st;
+	void *map;
+#else
+	long len;
+#endif
+
+	db = calloc(1, sizeof(*db));
+	if (db == NULL) {
+		snprintf(errbuf, errbuf_size, "%s: out of memory", path);
+		return NULL;
+	}
+	f = fopen(path, "rb");
+	if (f == NULL) {
+		snprintf(errbuf, errbuf_size, "%s: %s", path, strerror(errno));
+		free(db);
+		return NULL;
+	}
+#ifndef _WIN32
+	if (fstat(fileno(f), &st) == -1) {
+		snprintf(errbuf, errbuf_size, "%s: %s", path, strerror(errno));
+		goto fail;
+	}
+	db->size = (size_t)st.st_size;
+	if (db->size < HEADER_LEN)
+		goto bad;
+	map = mmap(NULL, db->size, PROT_READ, MAP_SHARED, fileno(f), 0);
+	if (map == MAP_FAILED) {
+		snprintf(errbuf, errbuf_size, "%s: %s", path, strerror(errno));
+		goto fail;
+	}
+	db->data = map;
+#else
+	if (fseek(f, 0, SEEK_END) == -1 || (len = ftell(f)) == -1 ||
+	    fseek(f, 0, SEEK_SET) == -1) {
+		snprintf(errbuf, errbuf_size, "%s: %s", path, strerror(errno));
+		goto fail;
+	}
+	db->size = (size_t)len;
+	if (db->size < HEADER_LEN)
+		goto bad;
+	db->data = malloc(db->size);
+	if (db->data == NULL) {
+		snprintf(errbuf, errbuf_size, "%s: out of memory", path);
+		goto fail;
+	}
+	if (fread(db->data, 1, db->size, f) != db->size) {
+		snprintf(errbuf, errbuf_size, "%s: read error", path);
+		goto fail;
+	}
+#endif
+	(void)fclose(f);
+	f = NULL;
+
+	p = db->data;
+	if (EXTRACT_BE_U_4(p) != MAGIC || EXTRACT_BE_U_4(p + 8) != db->size)
+		goto bad;
+	if (EXTRACT_BE_U_4(p + 4) != VERSION) {
+		snprintf(errbuf, errbuf_size,
+		    "%s: unsupported name database version %u", path,
+		    EXTRACT_BE_U_4(p + 4));
+		goto fail;
+	}
+	names_off = EXTRACT_BE_U_4(p + 12);
+	db->names_len = EXTRACT_BE_U_4(p + 16);
+	if (names_off + db->names_len > db->size)
+		goto bad;
+	db->names = (const char *)db->data + names_off;
+	/* So that every name is terminated. */
+	if (db->names_len != 0 && db->names[db->names_len - 1] != '\0')
+		goto bad;
+
+	for (i = 0; i < NAMEDB_NTABLES; i++) {
+		p = db->data + HEADER_FIXED_LEN + i * TABLE_HEADER_LEN;
+		t = &db->tables[i];
+		t->nkeys = EXTRACT_BE_U_4(p);
+		t->nbuckets = EXTRACT_BE_U_4(p + 4);
+		t->nslots = EXTRACT_BE_U_4(p + 8);
+		t->key_len = EXTRACT_BE_U_4(p + 12);
+		if (t->key_len != key_lens[i] || t->nslots < t->nkeys ||
+		    (t->nkeys != 0 && t->nbuckets == 0))
+			goto bad;
+		end = (uint64_t)EXTRACT_BE_U_4(p + 16) + t->nbuckets * 4ULL;
+		if (end > db->size)
+			goto bad;
+		t->seeds = db->data + EXTRACT_BE_U_4(p + 16);
+		end = (uint64_t)EXTRACT_BE_U_4(p + 20) +
+		    t->nslots * (uint64_t)(4 + t->key_len);
+		if (end > db->size)
+			goto bad;
+		t->slots = db->data + EXTRACT_BE_U_4(p + 20);
+	}
+	return db;
+
+bad:
+	snprintf(errbuf, errbuf_size, "%s: not a valid name database", path);
+fail:
+	if (f != NULL)
+		(void)fclose(f);
+#ifndef _WIN32
+	if (db->data != NULL)
+		(void)munmap(db->data, db->size);
+#else
+	free(db->data);
+#endif
+	free(db);
+	return NULL;
+}
+
+/*
+ * Look up the name for a key in one of the tables; returns NULL if
+ * there's none.  The names stay valid as long as the process runs.
+ */
+const char *
+namedb_lookup(const struct namedb *db, u_int table, const u_char *key)
+{
+	const struct namedb_table *t = &db->tables[table];
+	const u_char *slot;
+	uint32_t bucket, seed, off;
+
+	if (t->nkeys == 0)
+		return NULL;
+	bucket = hash_key(key, t->key_len, 0) % t->nbuckets;
+	seed = EXTRACT_BE_U_4(t->seeds + bucket * 4);
+	slot = t->slots +
+	    (size_t)(hash_key(key, t->key_len, seed) % t->nslots) *
+	    (4 + t->key_len);
+	off = EXTRACT_BE_U_4(slot);
+	if (off >= db->names_len || memcmp(slot + 4, key, t->key_len) != 0)
+		return NULL;
+	return db->names + off;
+}
+
+/*
+ * Building a database.
+ */
+struct build_entry {
+	u_char key[16];
+	uint32_t name;			/* offset in the names */
+	u_int order;			/* the first one of a key is kept */
+	uint32_t bucket;
+};
+
+struct build_table {
+	struct build_entry *entries;
+	u_int count;
+	u_int alloc;
+	u_int nbuckets;
+	u_int nslots;
+	uint32_t *seeds;
+	uint32_t *slot_names;		/* NO_NAME if empty */
+	u_int *slot_entries;
+};
+
+struct build {
+	struct build_table tables[NAMEDB_NTABLES];
+	char *names;
+	size_t names_len;
+	size_t names_alloc;
+};
+
+static int
+add_name(struct build *b, u_int table, const u_char *key, const char *name)
+{
+	struct build_table *t = &b->tables[table];
+	struct build_entry *e;
+	size_t len;
+
+	if (t->count == t->alloc) {
+		u_int alloc = t->alloc != 0 ? t->alloc * 2 : 256;
+
+		e = realloc(t->entries, alloc * sizeof(*e));
+		if (e == NULL)
+			return -1;
+		t->entries = e;
+		t->alloc = alloc;
+	}
+	len = strlen(name) + 1;
+	if (b->names_len + len > b->names_alloc) {
+		size_t alloc = b->names_alloc != 0 ? b->names_alloc * 2 : 65536;
+		char *names;
+
+		while (b->names_len + len > alloc)
+			alloc *= 2;
+		names = realloc(b->names, alloc);
+		if (names == NULL)
+			return -1;
+		b->names = names;
+		b->names_alloc = alloc;
+	}
+	if (b->names_len + len > NO_NAME)
+		return -1;
+
+	e = &t->entries[t->count];
+	memset(e->key, 0, sizeof(e->key));
+	memcpy(e->key, key, key_lens[table]);
+	e->name = (uint32_t)b->names_len;
+	e->order = t->count;
+	t->count++;
+	memcpy(b->names + b->names_len, name, len);
+	b->names_len += len;
+	return 0;
+}
+
+static int
+compare_keys(const void *a, const void *b)
+{
+	const struct build_entry *ea = a, *eb = b;
+	int r;
+
+	r = memcmp(ea->key, eb->key, sizeof(ea->key));
+	if (r != 0)
+		return r;
+	return ea->order < eb->order ? -1 : ea->order > eb->order;
+}
+
+static int
+compare_buckets(const void *a, const void *b)
+{
+	const struct build_entry *ea = a, *eb = b;
+
+	return ea->bucket < eb->bucket ? -1 : ea->bucket > eb->bucket;
+}
+
+struct bucket_range {
+	u_int first;
+	u_int count;
+};
+
+static int
+compare_bucket_sizes(const void *a, const void *b)
+{
+	const struct bucket_range *ra = a, *rb = b;
+
+	/* Largest first. */
+	return ra->count > rb->count ? -1 : ra->count < rb->count;
+}
+
+/* Most seeds tried for a bucket before giving up */
+#define MAX_SEED	(1U << 24)
+
+/*
+ * Find the seeds of the buckets of a table, placing the largest
+ * buckets first, while most of the slots are free.
+ */
+static int
+hash_table(struct build_table *t, u_int key_len)
+{
+	struct bucket_range *ranges;
+	u_char *used;
+	u_int *slots;
+	u_int i, j, k, n, nranges, max_count;
+	uint32_t seed;
+
+	if (t->count == 0)
+		return 0;
+	/* Drop the duplicate keys, keeping the first one of each. */
+	qsort(t->entries, t->count, sizeof(*t->entries), compare_keys);
+	for (i = 0, n = 0; i < t->count; i++) {
+		if (n != 0 && memcmp(t->entries[n - 1].key, t->entries[i].key,
+		    sizeof(t->entries[i].key)) == 0)
+			continue;
+		t->entries[n++] = t->entries[i];
+	}
+	t->count = n;
+
+	t->nbuckets = n / 4 + 1;
+	t->nslots = n + n / 8 + 1;
+	for (i = 0; i < n; i++)
+		t->entries[i].bucket =
+		    hash_key(t->entries[i].key, key_len, 0) % t->nbuckets;
+	qsort(t->entries, n, sizeof(*t->entries), compare_buckets);
+
+	ranges = calloc(t->nbuckets, sizeof(*ranges));
+	t->seeds = calloc(t->nbuckets, sizeof(*t->seeds));
+	t->slot_names = malloc(t->nslots * sizeof(*t->slot_names));
+	t->slot_entries = calloc(t->nslots, sizeof(*t->slot_entries));
+	used = calloc(t->nslots, 1);
+	if (ranges == NULL || t->seeds == NULL || t->slot_names == NULL ||
+	    t->slot_entries == NULL || used == NULL) {
+		free(ranges);
+		free(used);
+		return -1;
+	}
+	for (i = 0; i < t->nslots; i++)
+		t->slot_names[i] = NO_NAME;
+
+	nranges = 0;
+	max_count = 0;
+	for (i = 0; i < n; i = j) {
+		for (j = i + 1; j < n &&
+		    t->entries[j].bucket == t->entries[i].bucket; j++)
+			;
+		ranges[nranges].first = i;
+		ranges[nranges].count = j - i;
+		if (j - i > max_count)
+			max_count = j - i;
+		nranges++;
+	}
+	qsort(ranges, nranges, sizeof(*ranges), compare_bucket_sizes);
+
+	slots = malloc(max_count * sizeof(*slots));
+	if (slots == NULL) {
+		free(ranges);
+		free(used);
+		return -1;
+	}
+	for (i = 0; i < nranges; i++) {
+		struct build_entry *first = &t->entries[ranges[i].first];
+
+		for (seed = 1; seed < MAX_SEED; seed++) {
+			for (k = 0; k < ranges[i].count; k++) {
+				slots[k] = hash_key(first[k].key, key_len,
+				    seed) % t->nslots;
+				if (used[slots[k]])
+					break;
+				used[slots[k]] = 1;
+			}
+			if (k == ranges[i].count)
+				break;
+			/* Undo, and try the next seed. */
+			while (k-- > 0)
+				used[slots[k]] = 0;
+		}
+		if (seed == MAX_SEED) {
+			free(slots);
+			free(ranges);
+			free(used);
+			errno = 0;
+			return -1;
+		}
+		t->seeds[first->bucket] = seed;
+		for (k = 0; k < ranges[i].count; k++) {
+			t->slot_names[slots[k]] = first[k].name;
+			t->slot_entries[slots[k]] = ranges[i].first + k;
+		}
+	}
+	free(slots);
+	free(ranges);
+	free(used);
+	return 0;
+}
+
+static void
+put_be_u_4(u_char *p, uint32_t v)
+{
+	p[0] = (u_char)(v >> 24);
+	p[1] = (u_char)(v >> 16);
+	p[2] = (u_char)(v >> 8);
+	p[3] = (u_char)v;
+}
+
+/* Add the name of a port for a protocol, if it's TCP or UDP */
+static int
+add_port(struct build *b, u_int port, const char *proto, const char *name)
+{
+	u_char key[2];
+
+	key[0] = (u_char)(port >> 8);
+	key[1] = (u_char)port;
+	if (strcmp(proto, "tcp") == 0)
+		return add_name(b, NAMEDB_TCP_PORT, key, name);
+	if (strcmp(proto, "udp") == 0)
+		return add_name(b, NAMEDB_UDP_PORT, key, name);
+	return 0;
+}
+
+static int
+add_services(struct build *b)
+{
+	struct servent *sv;
+	int ret = 0;
+
+	while ((sv = getservent()) != NULL) {
+		ret = add_port(b, ntohs((u_short)sv->s_port), sv->s_proto,
+		    sv->s_name);
+		if (ret != 0)
+			break;
+	}
+	endservent();
+	return ret;
+}
+
+/*
+ * Add the names of the ports in a file in the format of the services
+ * file: a name, a port and protocol as "port/protocol", and aliases,
+ * with comments from a '#' to the end of the line.
+ */
+static int
+add_services_file(struct build *b, const char *path)
+{
+	FILE *fp;
+	char line[1024], *cp, *name, *port, *proto, *end;
+	u_long n;
+	int ret = 0;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return 0;
+	while (ret == 0 && fgets(line, sizeof(line), fp) != NULL) {
+		if ((cp = strchr(line, '#')) != NULL)
+			*cp = '\0';
+		name = strtok(line, " \t\r\n");
+		port = strtok(NULL, " \t\r\n");
+		if (name == NULL || port == NULL ||
+		    (proto = strchr(port, '/')) == NULL)
+			continue;
+		*proto++ = '\0';
+		n = strtoul(port, &end, 10);
+		if (end == port || *end != '\0' || n > 65535)
+			continue;
+		ret = add_port(b, (u_int)n, proto, name);
+	}
+	(void)fclose(fp);
+	return ret;
+}
+
+static int
+add_ethers(struct build *b, const char *path)
+{
+	struct pcap_etherent *ep;
+	FILE *fp;
+	int ret = 0;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return 0;
+	while ((ep = pcap_next_etherent(fp)) != NULL) {
+		ret = add_name(b, NAMEDB_MAC48, ep->addr, ep->name);
+		if (ret != 0)
+			break;
+	}
+	(void)fclose(fp);
+	return ret;
+}
+
+static int
+add_ouis(struct build *b)
+{
+	const struct tok *tp;
+	u_char key[3];
+
+	for (tp = oui_values; tp->s != NULL; tp++) {
+		key[0] = (u_char)(tp->v >> 16);
+		key[1] = (u_char)(tp->v >> 8);
+		key[2] = (u_char)tp->v;
+		if (add_name(b, NAMEDB_OUI, key, tp->s) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+/*
+ * Add the canonical name, the first one on the line, of each address in
+ * a hosts file.
+ */
+static int
+add_hosts(struct build *b, const char *path)
+{
+	FILE *fp;
+	char line[1024], *cp, *addr, *name;
+	struct addrinfo hints, *res;
+	int ret = 0;
+
+	if (path == NULL)
+		return 0;
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return 0;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_flags = AI_NUMERICHOST;
+	while (ret == 0 && fgets(line, sizeof(line), fp) != NULL) {
+		if ((cp = strchr(line, '#')) != NULL)
+			*cp = '\0';
+		addr = strtok(line, " \t\r\n");
+		name = strtok(NULL, " \t\r\n");
+		if (addr == NULL || name == NULL ||
+		    getaddrinfo(addr, NULL, &hints, &res) != 0)
+			continue;
+		if (res->ai_family == AF_INET)
+			ret = add_name(b, NAMEDB_IPV4, (const u_char *)
+			    &((struct sockaddr_in *)res->ai_addr)->sin_addr,
+			    name);
+		else if (res->ai_family == AF_INET6)
+			ret = add_name(b, NAMEDB_IPV6, (const u_char *)
+			    &((struct sockaddr_in6 *)res->ai_addr)->sin6_addr,
+			    name);
+		freeaddrinfo(res);
+	}
+	(void)fclose(fp);
+	return ret;
+}
+
+static int
+write_db(struct build *b, FILE *f)
+{
+	u_char header[HEADER_LEN], *buf;
+	struct build_table *t;
+	uint32_t off;
+	size_t len;
+	u_int i, j, key_len;
+
+	off = HEADER_LEN;
+	memset(header, 0, sizeof(header));
+	put_be_u_4(header, MAGIC);
+	put_be_u_4(header + 4, VERSION);
+	for (i = 0; i < NAMEDB_NTABLES; i++) {
+		u_char *p = header + HEADER_FIXED_LEN + i * TABLE_HEADER_LEN;
+
+		t = &b->tables[i];
+		put_be_u_4(p, t->count);
+		put_be_u_4(p + 4, t->nbuckets);
+		put_be_u_4(p + 8, t->nslots);
+		put_be_u_4(p + 12, key_lens[i]);
+		put_be_u_4(p + 16, off);
+		off += t->nbuckets * 4;
+		put_be_u_4(p + 20, off);
+		off += t->nslots * (4 + key_lens[i]);
+	}
+	put_be_u_4(header + 12, off);
+	put_be_u_4(header + 16, (uint32_t)b->names_len);
+	put_be_u_4(header + 8, off + (uint32_t)b->names_len);
+	if (fwrite(header, 1, sizeof(header), f) != sizeof(header))
+		return -1;
+
+	for (i = 0; i < NAMEDB_NTABLES; i++) {
+		t = &b->tables[i];
+		key_len = key_lens[i];
+		len = t->nbuckets * 4 + t->nslots * (4 + key_len);
+		if (len == 0)
+			continue;
+		buf = malloc(len);
+		if (buf == NULL)
+			return -1;
+		for (j = 0; j < t->nbuckets; j++)
+			put_be_u_4(buf + j * 4, t->seeds[j]);
+		for (j = 0; j < t->nslots; j++) {
+			u_char *slot = buf + t->nbuckets * 4 + j * (4 + key_len);
+
+			put_be_u_4(slot, t->slot_names[j]);
+			if (t->slot_names[j] != NO_NAME)
+				memcpy(slot + 4,
+				    t->entries[t->slot_entries[j]].key, key_len);
+			else
+				memset(slot + 4, 0, key_len);
+		}
+		if (fwrite(buf, 1, len, f) != len) {
+			free(buf);
+			return -1;
+		}
+		free(buf);
+	}
+	if (b->names_len != 0 &&
+	    fwrite(b->names, 1, b->names_len, f) != b->names_len)
+		return -1;
+	return 0;
+}
+
+/*
+ * Add the names from the files named services, ethers and hosts in a
+ * directory, those of them that exist.
+ */
+static int
+add_source_dir(struct build *b, const char *dir)
+{
+	char path[SOURCE_PATH_MAX];
+
+	(void)snprintf(path, sizeof(path), "%s/services", dir);
+	if (add_services_file(b, path) != 0)
+		return -1;
+	(void)snprintf(path, sizeof(path), "%s/ethers", dir);
+	if (add_ethers(b, path) != 0)
+		return -1;
+	(void)snprintf(path, sizeof(path), "%s/hosts", dir);
+	return add_hosts(b, path);
+}
+
+/*
+ * Build a database from the services database, the ethers file and the
+ * hosts file, or from the files of the same names in the directory
+ * srcdir if it's not NULL, and the OUI table, and write it to path.
+ * Returns 0 on success and -1, with a message in errbuf, on failure.
+ */
+int
+namedb_build(const char *path, const char *srcdir, char *errbuf,
+	     size_t errbuf_size)
+{
+	struct build b;
+	FILE *f;
+	u_int i;
+	int r, ret = -1;
+
+	memset(&b, 0, sizeof(b));
+	if (srcdir != NULL && strlen(srcdir) + sizeof("/services") >
+	    SOURCE_PATH_MAX) {
+		snprintf(errbuf, errbuf_size, "%s: name too long", srcdir);
+		goto done;
+	}
+	if (srcdir != NULL)
+		r = add_source_dir(&b, srcdir);
+	else if ((r = add_services(&b)) == 0 &&
+	    (r = add_ethers(&b, PCAP_ETHERS_FILE)) == 0)
+		r = add_hosts(&b, NAMEDB_HOSTS_FILE);
+	if (r != 0 || add_ouis(&b) != 0) {
+		snprintf(errbuf, errbuf_size, "out of memory");
+		goto done;
+	}
+	for (i = 0; i < NAMEDB_NTABLES; i++) {
+		errno = ENOMEM;
+		if (hash_table(&b.tables[i], key_lens[i]) != 0) {
+			snprintf(errbuf, errbuf_size, "%s",
+			    errno == ENOMEM ? "out of memory" :
+			    "can't build the hash tables");
+			goto done;
+		}
+	}
+
+	f = fopen(path, "wb");
+	if (f == NULL) {
+		snprintf(errbuf, errbuf_size, "%s: %s", path, strerror(errno));
+		goto done;
+	}
+	if (write_db(&b, f) != 0) {
+		snprintf(errbuf, errbuf_size, "%s: write error", path);
+		(void)fclose(f);
+		goto done;
+	}
+	if (fclose(f) != 0) {
+		snprintf(errbuf, errbuf_size, "%s: %s", path, strerror(errno));
+		goto done;
+	}
+	ret = 0;
+
+done:
+	for (i = 0; i < NAMEDB_NTABLES; i++) {
+		free(b.tables[i].entries);
+		free(b.tables[i].seeds);
+		free(b.tables[i].slot_names);
+		free(b.tables[i].slot_entries);
+	}
+	free(b.names);
+	return ret;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef namedb_h
+#define namedb_h
+
+/*
+ * Prebuilt databases of names ("--name-db" and "--build-name-db").
+ *
+ * A database holds the names of TCP and UDP ports, from the services
+ * database, of MAC-48 addresses, from the ethers file, of OUIs, from
+ * the table built into tcpdump, and of IPv4 and IPv6 hosts, from the
+ * hosts file, or from files of the same names and formats in the
+ * directory given with "--name-db-source".  It's built once, and then
+ * mapped read-only into memory by each tcpdump that uses it, so that
+ * nothing needs to be read or parsed at startup.
+ *
+ * Each kind of name is in a table with a perfect hash of its keys: a
+ * key is hashed into a bucket, the bucket gives the seed with which the
+ * key is hashed into its slot, and the key stored in that slot tells
+ * whether it's the right one, so that a lookup is a single probe.  All
+ * the numbers in the file are big-endian, so that a database can be
+ * used on another machine.
+ */
+
+/* The tables, in the order they are in the file */
+#define NAMEDB_TCP_PORT	0	/* key: port, 2 bytes */
+#define NAMEDB_UDP_PORT	1	/* key: port, 2 bytes */
+#define NAMEDB_MAC48	2	/* key: MAC-48 address, 6 bytes */
+#define NAMEDB_OUI	3	/* key: OUI, 3 bytes */
+#define NAMEDB_IPV4	4	/* key: IPv4 address, 4 bytes */
+#define NAMEDB_IPV6	5	/* key: IPv6 address, 16 bytes */
+#define NAMEDB_NTABLES	6
+
+struct namedb;
+
+extern struct namedb *namedb_open(const char *, char *, size_t);
+extern const char *namedb_lookup(const struct namedb *, u_int,
+    const u_char *);
+extern int namedb_build(const char *, const char *, char *, size_t);
+
+#endif /* namedb_h */
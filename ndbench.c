@@ -0,0 +1,910 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Measure how fast the printers are, in-process: the packets of the
+ * given capture files, and of a synthetic file, are read into memory,
+ * and printed, with the output discarded, a number of times with each
+ * set of printing flags.
+ *
+ * Usage: ndbench [ -j ] [ -t ] [ -i iterations ] [ -m modes ] [ -s count ]
+ *                [ file ... ]
+ *
+ * For each mode, a line gives the number of packets printed per second,
+ * the time per packet, the number of calls to malloc() per packet and,
+ * on Linux, the number of branch instructions run per packet for all
+ * the packets, followed by a line for each printer giving the
+ * time spent in it, as counted by --profile, per packet it printed
+ * part of.  The modes are comma-separated sets of the flags v, x, X, e,
+ * q and A, which are used as with tcpdump, always with -n, and F, which
+ * makes -q use the printers of each layer rather than the summary
+ * printer (see netdissect-summary.c); the default is ",v,vv,x,X,q".
+ * With -s, <count> packets of Ethernet, 802.1Q and MPLS, IPv4 and IPv6,
+ * TCP, UDP and ICMP, with random addresses and ports, are printed too,
+ * as if read from a file named "synthetic".
+ * With -t, the time to look up values in a few of the tables of
+ * tok2str() is given first, compared with scanning the tables.  With
+ * -j, each line is a JSON object.
+ *
+ * tests/BENCHrun measures tcpdump binaries as a whole instead, which
+ * includes the time to read the files.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "netdissect.h"
+#include "netdissect-alloc.h"
+#include "print.h"
+#include "ethertype.h"
+#include "ipproto.h"
+#include "oui.h"
+
+static const char *program_name = "ndbench";
+
+#define DEFAULT_ITERATIONS	3
+#define DEFAULT_MODES		",v,vv,x,X,q"
+#define MAX_ROWS		1024
+#define MODE_FLAGS		"vxXeqAF"
+
+/*
+ * Count the calls to malloc(), calloc() and realloc() where the C
+ * library allows replacing them; not under the sanitizers, which
+ * replace them too.
+ */
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer) || \
+    __has_feature(memory_sanitizer)
+#define NO_ALLOC_COUNT
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define NO_ALLOC_COUNT
+#endif
+
+#if defined(__GLIBC__) && !defined(NO_ALLOC_COUNT)
+#define COUNT_ALLOCS
+static uint64_t allocs;
+
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+
+void *
+malloc(size_t size)
+{
+	allocs++;
+	return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+	allocs++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+	allocs++;
+	return __libc_realloc(ptr, size);
+}
+#endif
+
+/*
+ * Count the branch instructions run in user mode, where the kernel
+ * lets us; the file descriptor of the counter, or -1.
+ */
+static int branch_fd = -1;
+
+static void
+branches_open(void)
+{
+#if defined(HAVE_LINUX_PERF_EVENT_H) && defined(SYS_perf_event_open)
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_BRANCH_INSTRUCTIONS;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	branch_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+/* 1 and the count so far, or 0 if branches aren't counted */
+static int
+branches_read(uint64_t *count)
+{
+#ifdef HAVE_LINUX_PERF_EVENT_H
+	if (branch_fd != -1 &&
+	    read(branch_fd, count, sizeof(*count)) == sizeof(*count))
+		return 1;
+#endif
+	*count = 0;
+	return 0;
+}
+
+struct bench_packet {
+	struct pcap_pkthdr hdr;
+	u_char *data;
+};
+
+struct bench_file {
+	const char *name;
+	int dlt;
+	int snaplen;
+	if_printer printer;
+	struct bench_packet *packets;
+	u_int count;
+};
+
+static struct bench_file *files;
+static u_int nfiles;
+static uint64_t total_packets;
+
+static struct nd_profile *profile;
+static int json;
+static jmp_buf bench_env;
+static u_int errors;
+
+/* VARARGS */
+static void NORETURN PRINTFLIKE(1, 2)
+error(FORMAT_STRING(const char *fmt), ...)
+{
+	va_list ap;
+
+	(void)fflush(stdout);
+	(void)fprintf(stderr, "%s: ", program_name);
+	va_start(ap, fmt);
+	(void)vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	(void)fputc('\n', stderr);
+	exit(S_ERR_HOST_PROGRAM);
+}
+
+/*
+ * A printer that fails, as when it runs out of memory, only loses its
+ * packet.
+ */
+/* VARARGS */
+static void NORETURN PRINTFLIKE(3, 4)
+bench_error(netdissect_options *ndo _U_, status_exit_codes_t status _U_,
+	    FORMAT_STRING(const char *fmt _U_), ...)
+{
+	longjmp(bench_env, 1);
+}
+
+/* VARARGS */
+static void PRINTFLIKE(2, 3)
+bench_warning(netdissect_options *ndo _U_, FORMAT_STRING(const char *fmt _U_),
+	      ...)
+{
+}
+
+/* The output is formatted, then dropped. */
+static void
+bench_output_sink(netdissect_options *ndo)
+{
+	ndo->ndo_outbuf_len = 0;
+}
+
+/* Time in nanoseconds */
+static uint64_t
+now_ns(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER t, f;
+
+	QueryPerformanceCounter(&t);
+	QueryPerformanceFrequency(&f);
+	return (uint64_t)((double)t.QuadPart * 1e9 / (double)f.QuadPart);
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static struct bench_file *
+new_file(const char *name, int dlt, int snaplen)
+{
+	struct bench_file *f;
+
+	files = realloc(files, (nfiles + 1) * sizeof(*files));
+	if (files == NULL)
+		error("%s: realloc", __func__);
+	f = &files[nfiles++];
+	memset(f, 0, sizeof(*f));
+	f->name = name;
+	f->dlt = dlt;
+	f->snaplen = snaplen;
+	f->printer = get_if_printer(dlt);
+	return f;
+}
+
+static void
+add_packet(struct bench_file *f, const struct pcap_pkthdr *hdr,
+	   const u_char *data)
+{
+	struct bench_packet *p;
+
+	if ((f->count & (f->count - 1)) == 0) {
+		f->packets = realloc(f->packets,
+		    (f->count == 0 ? 1 : f->count * 2) * sizeof(*f->packets));
+		if (f->packets == NULL)
+			error("%s: realloc", __func__);
+	}
+	p = &f->packets[f->count++];
+	p->hdr = *hdr;
+	p->data = malloc(hdr->caplen != 0 ? hdr->caplen : 1);
+	if (p->data == NULL)
+		error("%s: malloc", __func__);
+	memcpy(p->data, data, hdr->caplen);
+	total_packets++;
+}
+
+/*
+ * Read all the packets of a file; files that can't be read are
+ * skipped, with a warning.
+ */
+static void
+load_file(const char *name)
+{
+	char ebuf[PCAP_ERRBUF_SIZE];
+	struct pcap_pkthdr *hdr;
+	const u_char *data;
+	struct bench_file *f;
+	pcap_t *pd;
+
+	pd = pcap_open_offline(name, ebuf);
+	if (pd == NULL) {
+		(void)fprintf(stderr, "%s: %s\n", program_name, ebuf);
+		return;
+	}
+	f = new_file(name, pcap_datalink(pd), pcap_snapshot(pd));
+	while (pcap_next_ex(pd, &hdr, &data) == 1)
+		add_packet(f, hdr, data);
+	pcap_close(pd);
+	if (f->count == 0)
+		nfiles--;
+}
+
+/* A small random number generator, so the runs are the same */
+static uint32_t rng_state = 1;
+
+static uint32_t
+rng(void)
+{
+	rng_state = rng_state * 1103515245 + 12345;
+	return rng_state >> 8;
+}
+
+static void
+put_be16(u_char *p, u_int v)
+{
+	p[0] = (u_char)(v >> 8);
+	p[1] = (u_char)v;
+}
+
+static void
+put_be32(u_char *p, uint32_t v)
+{
+	put_be16(p, v >> 16);
+	put_be16(p + 2, v & 0xffff);
+}
+
+/* Checksums are stored as in_cksum() computes them */
+static void
+put_cksum(u_char *p, uint16_t sum)
+{
+	memcpy(p, &sum, 2);
+}
+
+/*
+ * The checksum of an IPv4 or IPv6 transport header and its data, with
+ * the pseudo-header.
+ */
+static uint16_t
+l4_cksum(const u_char *src, const u_char *dst, u_int addr_len,
+	 uint8_t proto, const u_char *l4, u_int len)
+{
+	struct cksum_vec vec[2];
+	u_char ph[40];
+
+	memset(ph, 0, sizeof(ph));
+	memcpy(ph, src, addr_len);
+	memcpy(ph + addr_len, dst, addr_len);
+	if (addr_len == 4) {
+		ph[8] = 0;
+		ph[9] = proto;
+		put_be16(ph + 10, len);
+		vec[0].len = 12;
+	} else {
+		put_be32(ph + 32, len);
+		ph[39] = proto;
+		vec[0].len = 40;
+	}
+	vec[0].ptr = ph;
+	vec[1].ptr = l4;
+	vec[1].len = len;
+	return in_cksum(vec, 2);
+}
+
+/*
+ * Build a synthetic packet of kind k, for host pair h and port p;
+ * returns its length.
+ */
+static u_int
+synthetic_packet(u_char *buf, u_int k, u_int h, u_int p)
+{
+	static const u_char dns_query[] = {
+		0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x03, 'w', 'w', 'w',
+		0x07, 'e', 'x', 'a', 'm', 'p', 'l', 'e',
+		0x03, 'c', 'o', 'm', 0x00, 0x00, 0x01, 0x00, 0x01
+	};
+	struct cksum_vec vec;
+	u_char *ip, *l4, *src, *dst;
+	u_int off, addr_len, l4_len, proto, ip6;
+	uint16_t sum;
+
+	/* Ethernet, with locally administered addresses */
+	buf[0] = 0x02;
+	put_be32(buf + 1, h);
+	buf[5] = 0x01;
+	buf[6] = 0x02;
+	put_be32(buf + 7, h ^ 0xff);
+	buf[11] = 0x02;
+	off = 12;
+	ip6 = (k == 1 || k == 3);
+	if (k == 5) {
+		/* 802.1Q */
+		put_be16(buf + off, 0x8100);
+		put_be16(buf + off + 2, 100 + h % 8);
+		off += 4;
+	}
+	if (k == 6) {
+		/* MPLS */
+		put_be16(buf + off, 0x8847);
+		put_be32(buf + off + 2, ((16 + h % 1000) << 12) | 0x100 | 64);
+		off += 6;
+	} else {
+		put_be16(buf + off, ip6 ? 0x86dd : 0x0800);
+		off += 2;
+	}
+
+	ip = buf + off;
+	if (ip6) {
+		memset(ip, 0, 40);
+		put_be32(ip, 0x60000000);
+		ip[7] = 64;
+		ip[8] = 0x20; ip[9] = 0x01; ip[10] = 0x0d; ip[11] = 0xb8;
+		put_be32(ip + 20, h);
+		ip[24] = 0x20; ip[25] = 0x01; ip[26] = 0x0d; ip[27] = 0xb8;
+		put_be32(ip + 36, h ^ 0xffff);
+		src = ip + 8;
+		dst = ip + 24;
+		addr_len = 16;
+		l4 = ip + 40;
+	} else {
+		memset(ip, 0, 20);
+		ip[0] = 0x45;
+		put_be16(ip + 4, p);
+		put_be16(ip + 6, 0x4000);	/* DF */
+		ip[8] = 64;
+		put_be32(ip + 12, 0x0a000000 | h);
+		put_be32(ip + 16, 0xc0a80000 | (h & 0xffff));
+		src = ip + 12;
+		dst = ip + 16;
+		addr_len = 4;
+		l4 = ip + 20;
+	}
+
+	switch (k) {
+
+	case 2:
+	case 3:
+		/* DNS query */
+		proto = 17;
+		l4_len = 8 + sizeof(dns_query);
+		put_be16(l4, 1024 + p);
+		put_be16(l4 + 2, 53);
+		put_be16(l4 + 4, l4_len);
+		put_be16(l4 + 6, 0);
+		memcpy(l4 + 8, dns_query, sizeof(dns_query));
+		put_be16(l4 + 8, p);
+		break;
+
+	case 4:
+		/* ICMP echo request */
+		proto = 1;
+		l4_len = 8 + 56;
+		memset(l4, 0, l4_len);
+		l4[0] = 8;
+		put_be16(l4 + 4, h);
+		put_be16(l4 + 6, p);
+		vec.ptr = l4;
+		vec.len = l4_len;
+		put_cksum(l4 + 2, in_cksum(&vec, 1));
+		break;
+
+	case 6:
+	case 7:
+		/* UDP to some port */
+		proto = 17;
+		l4_len = 8 + 120;
+		memset(l4, 0, l4_len);
+		put_be16(l4, 1024 + p);
+		put_be16(l4 + 2, 30000 + p % 20000);
+		put_be16(l4 + 4, l4_len);
+		break;
+
+	default:
+		/* TCP segment with timestamps and data */
+		proto = 6;
+		l4_len = 32 + 200;
+		memset(l4, 0, l4_len);
+		put_be16(l4, 1024 + p);
+		put_be16(l4 + 2, p % 3 == 0 ? 80 : 443);
+		put_be32(l4 + 4, rng());
+		put_be32(l4 + 8, rng());
+		l4[12] = 8 << 4;
+		l4[13] = 0x18;		/* PSH, ACK */
+		put_be16(l4 + 14, 65535);
+		l4[20] = 1; l4[21] = 1;
+		l4[22] = 8; l4[23] = 10;
+		put_be32(l4 + 24, rng());
+		put_be32(l4 + 28, rng());
+		memset(l4 + 32, 'a' + p % 26, 200);
+		break;
+	}
+
+	if (ip6) {
+		put_be16(ip + 4, l4_len);
+		ip[6] = (u_char)proto;
+	} else {
+		put_be16(ip + 2, 20 + l4_len);
+		ip[9] = (u_char)proto;
+		vec.ptr = ip;
+		vec.len = 20;
+		put_cksum(ip + 10, in_cksum(&vec, 1));
+	}
+	if (proto != 1) {
+		sum = l4_cksum(src, dst, addr_len, (uint8_t)proto, l4, l4_len);
+		put_cksum(l4 + (proto == 6 ? 16 : 6), sum == 0 ? 0xffff : sum);
+	}
+	return (u_int)(l4 - buf) + l4_len;
+}
+
+static void
+make_synthetic(u_int count)
+{
+	struct pcap_pkthdr hdr;
+	u_char buf[512];
+	struct bench_file *f;
+	u_int i;
+
+	f = new_file("synthetic", DLT_EN10MB, 65535);
+	memset(&hdr, 0, sizeof(hdr));
+	for (i = 0; i < count; i++) {
+		hdr.ts.tv_sec = 1700000000 + i / 1000;
+		hdr.ts.tv_usec = (i % 1000) * 1000;
+		hdr.len = hdr.caplen = synthetic_packet(buf, i % 8,
+		    rng() % 4096, rng() % 60000);
+		add_packet(f, &hdr, buf);
+	}
+}
+
+/* Print all the packets once. */
+static void
+replay(netdissect_options *ndo)
+{
+	const struct bench_file *f;
+	volatile u_int i;
+	u_int fi, n = 0;
+
+	for (fi = 0; fi < nfiles; fi++) {
+		f = &files[fi];
+		ndo->ndo_if_printer = f->printer;
+		ndo->ndo_dlt = f->dlt;
+		ndo->ndo_snaplen = f->snaplen;
+		i = 0;
+		while (i < f->count) {
+			if (setjmp(bench_env) == 0) {
+				for (; i < f->count; i++)
+					pretty_print_packet(ndo,
+					    &f->packets[i].hdr,
+					    f->packets[i].data, ++n);
+			} else {
+				nd_pop_all_packet_info(ndo);
+				ndo->ndo_outbuf_len = 0;
+				nd_free_all(ndo);
+				errors++;
+				i++;
+			}
+		}
+	}
+}
+
+/* "count" per packet, or "-" (null with -j) if it wasn't counted */
+static void
+format_per_packet(char *buf, size_t size, const char *fmt, int counted,
+		  uint64_t count, uint64_t packets)
+{
+	if (counted)
+		(void)snprintf(buf, size, fmt,
+		    packets != 0 ? (double)count / (double)packets : 0);
+	else
+		(void)strcpy(buf, json ? "null" : "-");
+}
+
+static void
+print_result(const char *mode, const char *printer, uint64_t packets,
+	     double ns, int with_allocs, uint64_t nallocs,
+	     int with_branches, uint64_t nbranches)
+{
+	double ns_per_packet = packets != 0 ? ns / (double)packets : 0;
+	double rate = ns != 0 ? (double)packets * 1e9 / ns : 0;
+	char allocs_str[32], branches_str[32];
+
+	format_per_packet(allocs_str, sizeof(allocs_str), "%.3f",
+	    with_allocs, nallocs, packets);
+	format_per_packet(branches_str, sizeof(branches_str), "%.1f",
+	    with_branches, nbranches, packets);
+	if (json)
+		(void)printf("{\"mode\":\"%s\",\"printer\":\"%s\","
+		    "\"packets\":%" PRIu64 ",\"ns_per_packet\":%.1f,"
+		    "\"packets_per_second\":%.0f,\"allocs_per_packet\":%s,"
+		    "\"branches_per_packet\":%s}\n",
+		    mode, printer, packets, ns_per_packet, rate, allocs_str,
+		    branches_str);
+	else
+		(void)printf("%-8s %-16s %12" PRIu64 " %10.1f %12.0f %10s %12s\n",
+		    mode, printer, packets, ns_per_packet, rate, allocs_str,
+		    branches_str);
+}
+
+static int
+row_cmp(const void *a, const void *b)
+{
+	const struct nd_profile_row *ra = a, *rb = b;
+
+	if (ra->ticks != rb->ticks)
+		return ra->ticks < rb->ticks ? 1 : -1;
+	return strcmp(ra->protocol, rb->protocol);
+}
+
+/*
+ * Print all the packets with the flags of a mode, first to time them,
+ * then with the profile counters to break the time down by printer.
+ */
+static void
+bench_mode(netdissect_options *ndo, const char *mode, u_int iterations)
+{
+	static struct nd_profile_row rows[MAX_ROWS];
+	char mode_name[32];
+	const char *c;
+	uint64_t start, ns, ticks, nallocs = 0, nbranches, branches_end;
+	u_int i, n;
+	double ns_per_tick;
+	int with_allocs = 0, with_branches;
+
+	ndo->ndo_vflag = ndo->ndo_xflag = ndo->ndo_Xflag = 0;
+	ndo->ndo_eflag = ndo->ndo_qflag = ndo->ndo_Aflag = 0;
+	ndo->ndo_no_summary = 0;
+	for (c = mode; *c != '\0'; c++) {
+		switch (*c) {
+		case 'v':
+			ndo->ndo_vflag++;
+			break;
+		case 'x':
+			ndo->ndo_xflag++;
+			break;
+		case 'X':
+			ndo->ndo_Xflag++;
+			break;
+		case 'e':
+			ndo->ndo_eflag++;
+			break;
+		case 'q':
+			ndo->ndo_qflag++;
+			break;
+		case 'A':
+			ndo->ndo_Aflag++;
+			break;
+		case 'F':
+			ndo->ndo_no_summary = 1;
+			break;
+		default:
+			error("invalid flag '%c' in mode \"%s\"", *c, mode);
+		}
+	}
+	(void)snprintf(mode_name, sizeof(mode_name), "-n%s", mode);
+
+	/* Once to fill the caches and the tables */
+	replay(ndo);
+
+#ifdef COUNT_ALLOCS
+	nallocs = allocs;
+	with_allocs = 1;
+#endif
+	with_branches = branches_read(&nbranches);
+	start = now_ns();
+	for (i = 0; i < iterations; i++)
+		replay(ndo);
+	ns = now_ns() - start;
+	with_branches &= branches_read(&branches_end);
+	nbranches = branches_end - nbranches;
+#ifdef COUNT_ALLOCS
+	nallocs = allocs - nallocs;
+#endif
+	print_result(mode_name, "all", total_packets * iterations, (double)ns,
+	    with_allocs, nallocs, with_branches, nbranches);
+
+	nd_profile_reset(profile);
+	ndo->ndo_profile = profile;
+	start = now_ns();
+	for (i = 0; i < iterations; i++)
+		replay(ndo);
+	ns = now_ns() - start;
+	ndo->ndo_profile = NULL;
+
+	n = nd_profile_collect(rows, MAX_ROWS);
+	ticks = 0;
+	for (i = 0; i < n; i++)
+		ticks += rows[i].ticks;
+	/* The profile's time, which may be cycles, converted to ns */
+	ns_per_tick = ticks != 0 ? (double)ns / (double)ticks : 0;
+	qsort(rows, n, sizeof(rows[0]), row_cmp);
+	for (i = 0; i < n; i++) {
+		if (rows[i].packets == 0)
+			continue;
+		print_result(mode_name, rows[i].protocol[0] != '\0' ?
+		    rows[i].protocol : "-", rows[i].packets,
+		    (double)rows[i].ticks * ns_per_tick, 0, 0, 0, 0);
+	}
+}
+
+/* tok2str() as it was, scanning the table */
+static const char *
+scan_tok2str(const struct tok *lp, const char *fmt, u_int v)
+{
+	static char buf[128];
+
+	while (lp->s != NULL) {
+		if (lp->v == v)
+			return lp->s;
+		lp++;
+	}
+	(void)snprintf(buf, sizeof(buf), fmt != NULL ? fmt : "#%d", v);
+	return buf;
+}
+
+/*
+ * Where the strings looked up are stored, so that the lookups aren't
+ * optimized away; the pointer, not what it points to, is volatile.
+ */
+static const char *volatile tok_sink;
+
+/*
+ * Time looking up values with tok2str() and by scanning the table,
+ * in ns per lookup.
+ */
+static void
+time_tok(const struct tok *table, const u_int *values, u_int nvalues,
+	 u_int rounds, double *scan_ns, double *tok_ns)
+{
+	uint64_t start;
+	u_int i, r;
+
+	start = now_ns();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < nvalues; i++)
+			tok_sink = scan_tok2str(table, NULL, values[i]);
+	*scan_ns = (double)(now_ns() - start) / ((double)rounds * nvalues);
+
+	start = now_ns();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < nvalues; i++)
+			tok_sink = tok2str(table, NULL, values[i]);
+	*tok_ns = (double)(now_ns() - start) / ((double)rounds * nvalues);
+}
+
+/*
+ * Look up each value of a table, then as many values not in it, with
+ * tok2str() and by scanning the table.
+ */
+static void
+bench_tok(const char *name, const struct tok *table, u_int iterations)
+{
+	u_int *hits, *misses, n, max = 0, i, rounds;
+	double scan_hit, tok_hit, scan_miss, tok_miss;
+
+	for (n = 0; table[n].s != NULL; n++)
+		if (table[n].v > max)
+			max = table[n].v;
+	hits = malloc(n * sizeof(*hits));
+	misses = malloc(n * sizeof(*misses));
+	if (hits == NULL || misses == NULL)
+		error("%s: malloc", __func__);
+	for (i = 0; i < n; i++) {
+		hits[i] = table[(i * 7) % n].v;
+		misses[i] = max + 1 + i;
+	}
+	rounds = (1 + 1000000 / n) * iterations;
+	time_tok(table, hits, n, rounds, &scan_hit, &tok_hit);
+	time_tok(table, misses, n, rounds, &scan_miss, &tok_miss);
+	free(hits);
+	free(misses);
+
+	if (json)
+		(void)printf("{\"table\":\"%s\",\"entries\":%u,"
+		    "\"scan_hit_ns\":%.2f,\"tok2str_hit_ns\":%.2f,"
+		    "\"scan_miss_ns\":%.2f,\"tok2str_miss_ns\":%.2f}\n",
+		    name, n, scan_hit, tok_hit, scan_miss, tok_miss);
+	else
+		(void)printf("%-16s %8u %10.2f %10.2f %10.2f %10.2f\n", name, n,
+		    scan_hit, tok_hit, scan_miss, tok_miss);
+}
+
+static void NORETURN
+usage(void)
+{
+	(void)fprintf(stderr,
+	    "Usage: %s [ -j ] [ -t ] [ -i iterations ] [ -m modes ]\n"
+	    "\t\t[ -s count ] [ file ... ]\n", program_name);
+	exit(S_ERR_HOST_PROGRAM);
+}
+
+static u_int
+parse_count(const char *what, const char *arg)
+{
+	char *end;
+	unsigned long v;
+
+	v = strtoul(arg, &end, 10);
+	if (*arg == '\0' || *end != '\0' || v == 0 || v > UINT_MAX)
+		error("invalid %s \"%s\"", what, arg);
+	return (u_int)v;
+}
+
+int
+main(int argc, char **argv)
+{
+	netdissect_options Ndo;
+	netdissect_options *ndo = &Ndo;
+	char ebuf[PCAP_ERRBUF_SIZE];
+	const char *modes = DEFAULT_MODES;
+	char *modes_copy, *mode, *next;
+	u_int iterations = DEFAULT_ITERATIONS, synthetic = 0;
+	int tok = 0;
+	int i;
+
+	for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+		if (strcmp(argv[i], "--") == 0) {
+			i++;
+			break;
+		}
+		if (strcmp(argv[i], "-j") == 0)
+			json = 1;
+		else if (strcmp(argv[i], "-t") == 0)
+			tok = 1;
+		else if (i + 1 < argc && strcmp(argv[i], "-i") == 0)
+			iterations = parse_count("number of iterations",
+			    argv[++i]);
+		else if (i + 1 < argc && strcmp(argv[i], "-m") == 0)
+			modes = argv[++i];
+		else if (i + 1 < argc && strcmp(argv[i], "-s") == 0)
+			synthetic = parse_count("number of packets",
+			    argv[++i]);
+		else
+			usage();
+	}
+	if (i == argc && synthetic == 0 && !tok)
+		usage();
+	if (modes[strspn(modes, MODE_FLAGS ",")] != '\0')
+		error("invalid modes \"%s\"", modes);
+
+	if (nd_init(ebuf, sizeof(ebuf)) == -1)
+		error("%s", ebuf);
+	memset(ndo, 0, sizeof(*ndo));
+	ndo_set_function_pointers(ndo);
+	ndo->program_name = program_name;
+	ndo->ndo_error = bench_error;
+	ndo->ndo_warning = bench_warning;
+	ndo->ndo_output_sink = bench_output_sink;
+	ndo->ndo_nflag = 1;
+	init_print(ndo, 0, 0);
+	profile = nd_profile_new(ndo);
+	branches_open();
+
+	if (tok) {
+		if (!json)
+			(void)printf("%-16s %8s %10s %10s %10s %10s\n",
+			    "table", "entries", "scan hit", "tok2str", "scan miss",
+			    "tok2str");
+		bench_tok("ipproto_values", ipproto_values, iterations);
+		bench_tok("oui_values", oui_values, iterations);
+		bench_tok("ethertype_values", ethertype_values, iterations);
+		bench_tok("smi_values", smi_values, iterations);
+		(void)fflush(stdout);
+		if (i == argc && synthetic == 0) {
+			nd_cleanup();
+			return S_SUCCESS;
+		}
+	}
+
+	for (; i < argc; i++)
+		load_file(argv[i]);
+	if (synthetic != 0)
+		make_synthetic(synthetic);
+	if (nfiles == 0)
+		error("no packets to print");
+
+	if (json)
+		(void)printf("{\"files\":%u,\"packets\":%" PRIu64
+		    ",\"iterations\":%u}\n", nfiles, total_packets, iterations);
+	else {
+		(void)printf("%u files, %" PRIu64 " packets, %u iterations\n",
+		    nfiles, total_packets, iterations);
+		(void)printf("%-8s %-16s %12s %10s %12s %10s %12s\n", "mode",
+		    "printer", "packets", "ns/packet", "packets/s",
+		    "allocs/pkt", "branches/pkt");
+	}
+
+	modes_copy = strdup(modes);
+	if (modes_copy == NULL)
+		error("%s: strdup", __func__);
+	for (mode = modes_copy; mode != NULL; mode = next) {
+		next = strchr(mode, ',');
+		if (next != NULL)
+			*next++ = '\0';
+		bench_mode(ndo, mode, iterations);
+		(void)fflush(stdout);
+	}
+	free(modes_copy);
+
+	if (errors != 0)
+		(void)fprintf(stderr, "%s: %u packets failed to print\n",
+		    program_name, errors);
+	nd_cleanup();
+	if (fflush(stdout) == EOF)
+		error("standard output: %s", strerror(errno));
+	return S_SUCCESS;
+}
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Read a binary record stream written by tcpdump --output-format=binary
+ * (see netdissect-record.h) and print it as tcpdump
+ * --output-format=json would have.
+ *
+ * Usage: ndrecord [ file ]
+ *
+ * With no file, or with "-", read the standard input.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "netdissect.h"
+#include "netdissect-record.h"
+#include "extract.h"
+#include "print.h"
+
+static const char *program_name = "ndrecord";
+
+/* VARARGS */
+static void NORETURN PRINTFLIKE(1, 2)
+error(FORMAT_STRING(const char *fmt), ...)
+{
+	va_list ap;
+
+	(void)fflush(stdout);
+	(void)fprintf(stderr, "%s: ", program_name);
+	va_start(ap, fmt);
+	(void)vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	(void)fputc('\n', stderr);
+	exit(S_ERR_HOST_PROGRAM);
+}
+
+/*
+ * Read len bytes; return 0 at the end of the file, and fail if it's in
+ * the middle of what's being read.
+ */
+static int
+read_bytes(FILE *f, const char *name, u_char *buf, size_t len)
+{
+	size_t n;
+
+	n = fread(buf, 1, len, f);
+	if (n == len)
+		return 1;
+	if (ferror(f))
+		error("%s: %s", name, strerror(errno));
+	if (n != 0)
+		error("%s: truncated record", name);
+	return 0;
+}
+
+/*
+ * Fill in a record from its fixed part.
+ */
+static void
+parse_record(const u_char *p, struct nd_record *rec)
+{
+	u_int addr_len;
+
+	memset(rec, 0, sizeof(*rec));
+	rec->nr_present = EXTRACT_LE_U_2(p + ND_REC_OFF_PRESENT);
+	rec->nr_ts.tv_sec = (time_t)EXTRACT_LE_U_8(p + ND_REC_OFF_TS_SEC);
+	rec->nr_ts.tv_usec = EXTRACT_LE_U_4(p + ND_REC_OFF_TS_FRAC);
+	rec->nr_packet_number = EXTRACT_LE_U_4(p + ND_REC_OFF_NUM);
+	rec->nr_caplen = EXTRACT_LE_U_4(p + ND_REC_OFF_CAPLEN);
+	rec->nr_len = EXTRACT_LE_U_4(p + ND_REC_OFF_LEN);
+	rec->nr_dlt = (int)EXTRACT_LE_U_4(p + ND_REC_OFF_DLT);
+
+	memcpy(rec->nr_ether_src, p + ND_REC_OFF_ETHER_SRC, 6);
+	memcpy(rec->nr_ether_dst, p + ND_REC_OFF_ETHER_DST, 6);
+	rec->nr_ether_type = EXTRACT_LE_U_2(p + ND_REC_OFF_ETHER_TYPE);
+
+	rec->nr_ip_version = EXTRACT_U_1(p + ND_REC_OFF_IP_VERSION);
+	rec->nr_ip_proto = EXTRACT_U_1(p + ND_REC_OFF_IP_PROTO);
+	rec->nr_ip_ttl = EXTRACT_U_1(p + ND_REC_OFF_IP_TTL);
+	rec->nr_ip_tos = EXTRACT_U_1(p + ND_REC_OFF_IP_TOS);
+	addr_len = rec->nr_ip_version == 4 ? 4 : 16;
+	memcpy(rec->nr_ip_src, p + ND_REC_OFF_IP_SRC, addr_len);
+	memcpy(rec->nr_ip_dst, p + ND_REC_OFF_IP_DST, addr_len);
+	rec->nr_ip_len = EXTRACT_LE_U_4(p + ND_REC_OFF_IP_LEN);
+	rec->nr_ip_id = EXTRACT_LE_U_4(p + ND_REC_OFF_IP_ID);
+	rec->nr_ip_off = EXTRACT_LE_U_2(p + ND_REC_OFF_IP_OFF);
+	rec->nr_ip_hlen = EXTRACT_U_1(p + ND_REC_OFF_IP_HLEN);
+
+	rec->nr_sport = EXTRACT_LE_U_2(p + ND_REC_OFF_SPORT);
+	rec->nr_dport = EXTRACT_LE_U_2(p + ND_REC_OFF_DPORT);
+	rec->nr_l4_len = EXTRACT_LE_U_4(p + ND_REC_OFF_L4_LEN);
+	rec->nr_tcp_flags = EXTRACT_LE_U_2(p + ND_REC_OFF_TCP_FLAGS);
+	rec->nr_tcp_win = EXTRACT_LE_U_2(p + ND_REC_OFF_TCP_WIN);
+	rec->nr_tcp_urp = EXTRACT_LE_U_2(p + ND_REC_OFF_TCP_URP);
+	rec->nr_tcp_seq = EXTRACT_LE_U_4(p + ND_REC_OFF_TCP_SEQ);
+	rec->nr_tcp_ack = EXTRACT_LE_U_4(p + ND_REC_OFF_TCP_ACK);
+}
+
+int
+main(int argc, char **argv)
+{
+	netdissect_options Ndo;
+	netdissect_options *ndo = &Ndo;
+	const char *name;
+	FILE *f;
+	u_char hdr[ND_RECFILE_HDRLEN];
+	u_char *buf = NULL;
+	size_t buf_size = 0;
+	u_int hdr_len, rec_len, rec_hdr_len, off, type, len;
+	struct nd_record rec;
+	const char *opts, *text;
+	size_t opts_len, text_len;
+
+	if (argc > 2) {
+		(void)fprintf(stderr, "Usage: %s [ file ]\n", program_name);
+		exit(S_ERR_HOST_PROGRAM);
+	}
+	if (argc < 2 || strcmp(argv[1], "-") == 0) {
+		name = "standard input";
+		f = stdin;
+	} else {
+		name = argv[1];
+		f = fopen(name, "rb");
+		if (f == NULL)
+			error("%s: %s", name, strerror(errno));
+	}
+
+	memset(ndo, 0, sizeof(*ndo));
+	ndo_set_function_pointers(ndo);
+	ndo->program_name = program_name;
+
+	if (!read_bytes(f, name, hdr, 8))
+		error("%s: empty file", name);
+	if (memcmp(hdr + ND_RECFILE_OFF_MAGIC, ND_RECFILE_MAGIC, 4) != 0)
+		error("%s: not a tcpdump record stream", name);
+	if (EXTRACT_LE_U_2(hdr + ND_RECFILE_OFF_VERSION) != ND_RECFILE_VERSION)
+		error("%s: unsupported version %u", name,
+		    EXTRACT_LE_U_2(hdr + ND_RECFILE_OFF_VERSION));
+	hdr_len = EXTRACT_LE_U_2(hdr + ND_RECFILE_OFF_HDRLEN);
+	if (hdr_len < ND_RECFILE_HDRLEN)
+		error("%s: file header length %u < %u", name, hdr_len,
+		    ND_RECFILE_HDRLEN);
+	if (!read_bytes(f, name, hdr + 8, ND_RECFILE_HDRLEN - 8))
+		error("%s: truncated file header", name);
+	/* Skip the part of the file header added in later versions. */
+	for (off = ND_RECFILE_HDRLEN; off < hdr_len; off++)
+		if (getc(f) == EOF)
+			error("%s: truncated file header", name);
+#ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
+	if (EXTRACT_LE_U_4(hdr + ND_RECFILE_OFF_FLAGS) & ND_RECFILE_NANO)
+		ndo->ndo_tstamp_precision = PCAP_TSTAMP_PRECISION_NANO;
+#endif
+
+	for (;;) {
+		u_char len_buf[4];
+
+		if (!read_bytes(f, name, len_buf, 4))
+			break;
+		rec_len = EXTRACT_LE_U_4(len_buf);
+		if (rec_len < ND_REC_HDRLEN)
+			error("%s: record length %u < %u", name, rec_len,
+			    ND_REC_HDRLEN);
+		if (rec_len > buf_size) {
+			buf_size = rec_len;
+			buf = realloc(buf, buf_size);
+			if (buf == NULL)
+				error("%s: realloc", __func__);
+		}
+		memcpy(buf, len_buf, 4);
+		if (!read_bytes(f, name, buf + 4, rec_len - 4))
+			error("%s: truncated record", name);
+
+		rec_hdr_len = EXTRACT_LE_U_2(buf + ND_REC_OFF_HDRLEN);
+		if (rec_hdr_len < ND_REC_HDRLEN || rec_hdr_len > rec_len)
+			error("%s: invalid record header length %u", name,
+			    rec_hdr_len);
+		parse_record(buf, &rec);
+
+		opts = text = "";
+		opts_len = text_len = 0;
+		off = rec_hdr_len;
+		while (off + ND_REC_TLV_HDRLEN <= rec_len) {
+			type = EXTRACT_LE_U_2(buf + off);
+			len = EXTRACT_LE_U_4(buf + off + 4);
+			if (type == 0)
+				break;	/* padding */
+			off += ND_REC_TLV_HDRLEN;
+			if (len > rec_len - off)
+				error("%s: TLV length %u past the end of the record",
+				    name, len);
+			switch (type) {
+
+			case ND_REC_TLV_TEXT:
+				text = (const char *)buf + off;
+				text_len = len;
+				break;
+
+			case ND_REC_TLV_TCP_OPTS:
+				opts = (const char *)buf + off;
+				opts_len = len;
+				break;
+			}
+			off += (len + 3) & ~3U;
+		}
+
+		nd_record_json(ndo, &rec, opts, opts_len, text, text_len);
+		nd_output_flush(ndo);
+	}
+	free(buf);
+	free(ndo->ndo_outbuf);
+	if (f != stdin)
+		(void)fclose(f);
+	if (fflush(stdout) == EOF)
+		error("standard output: %s", strerror(errno));
+	return S_SUCCESS;
+}
@@ -19,44 +19,117 @@
 #include <stdlib.h>
 #include "netdissect-alloc.h"
 
-static void nd_add_alloc_list(netdissect_options *, nd_mem_chunk_t *);
-
 /*
- * nd_free_all() is intended to be used after a packet printing
+ * Per-packet scratch memory.
+ *
+ * nd_malloc() hands out memory from an arena attached to the
+ * netdissect_options structure, by bumping a pointer in the current
+ * slab; nd_free_all(), called after a packet is printed, makes all of
+ * it available again without freeing anything, so, once the arena has
+ * grown to what a packet needs, printing doesn't call malloc() or
+ * free().  The slabs are kept in a linked list and are only freed by
+ * nd_arena_free().
  */
 
-/* Add a memory chunk in allocation linked list */
-static void
-nd_add_alloc_list(netdissect_options *ndo, nd_mem_chunk_t *chunkp)
+/* Size of a slab, unless a bigger one is needed for an allocation. */
+#define ND_ARENA_SLAB_SIZE	65536
+
+/* Alignment of the memory handed out. */
+#define ND_ARENA_ALIGN		16
+
+struct nd_arena_slab {
+	struct nd_arena_slab *next;
+	size_t size;		/* number of bytes of data */
+	/* data follows, at the first ND_ARENA_ALIGN boundary */
+};
+
+#define ND_ARENA_HDR_SIZE \
+	((sizeof(struct nd_arena_slab) + ND_ARENA_ALIGN - 1) & \
+	    ~(size_t)(ND_ARENA_ALIGN - 1))
+
+/* Allocate a slab with at least size bytes of data. */
+static struct nd_arena_slab *
+nd_arena_new_slab(size_t size)
 {
-	if (ndo->ndo_last_mem_p == NULL)	/* first memory allocation */
-		chunkp->prev_mem_p = NULL;
-	else					/* previous memory allocation */
-		chunkp->prev_mem_p = ndo->ndo_last_mem_p;
-	ndo->ndo_last_mem_p = chunkp;
+	struct nd_arena_slab *slab;
+
+	if (size < ND_ARENA_SLAB_SIZE)
+		size = ND_ARENA_SLAB_SIZE;
+	if (size > SIZE_MAX - ND_ARENA_HDR_SIZE)
+		return NULL;
+	slab = malloc(ND_ARENA_HDR_SIZE + size);
+	if (slab == NULL)
+		return NULL;
+	slab->next = NULL;
+	slab->size = size;
+	return slab;
 }
 
-/* malloc replacement, with tracking in a linked list */
+/* malloc replacement, allocating from the per-packet arena */
 void *
 nd_malloc(netdissect_options *ndo, size_t size)
 {
-	nd_mem_chunk_t *chunkp = malloc(sizeof(nd_mem_chunk_t) + size);
-	if (chunkp == NULL)
+	struct nd_arena_slab *slab = ndo->ndo_arena_cur;
+	void *p;
+
+	/* Round up, so that the next allocation is aligned. */
+	if (size > SIZE_MAX - (ND_ARENA_ALIGN - 1))
 		return NULL;
-	nd_add_alloc_list(ndo, chunkp);
-	return chunkp + 1;
+	size = (size + ND_ARENA_ALIGN - 1) & ~(size_t)(ND_ARENA_ALIGN - 1);
+
+	if (slab == NULL || slab->size - ndo->ndo_arena_off < size) {
+		/*
+		 * Not enough room in this slab; move on to the next one,
+		 * if it's big enough, or put a new one after this one.
+		 */
+		if (slab != NULL && slab->next != NULL &&
+		    slab->next->size >= size)
+			slab = slab->next;
+		else {
+			struct nd_arena_slab *new_slab;
+
+			new_slab = nd_arena_new_slab(size);
+			if (new_slab == NULL)
+				return NULL;
+			if (slab == NULL) {
+				new_slab->next = ndo->ndo_arena_head;
+				ndo->ndo_arena_head = new_slab;
+			} else {
+				new_slab->next = slab->next;
+				slab->next = new_slab;
+			}
+			slab = new_slab;
+		}
+		ndo->ndo_arena_cur = slab;
+		ndo->ndo_arena_off = 0;
+	}
+	p = (u_char *)slab + ND_ARENA_HDR_SIZE + ndo->ndo_arena_off;
+	ndo->ndo_arena_off += size;
+	return p;
 }
 
-/* Free chunks in allocation linked list from last to first */
+/*
+ * Release everything nd_malloc() handed out; it's intended to be used
+ * after a packet is printed.  The slabs are kept for the next packet.
+ */
 void
 nd_free_all(netdissect_options *ndo)
 {
-	nd_mem_chunk_t *current, *previous;
-	current = ndo->ndo_last_mem_p;
-	while (current != NULL) {
-		previous = current->prev_mem_p;
-		free(current);
-		current = previous;
+	ndo->ndo_arena_cur = ndo->ndo_arena_head;
+	ndo->ndo_arena_off = 0;
+}
+
+/* Free the slabs of the arena */
+void
+nd_arena_free(netdissect_options *ndo)
+{
+	struct nd_arena_slab *slab, *next;
+
+	for (slab = ndo->ndo_arena_head; slab != NULL; slab = next) {
+		next = slab->next;
+		free(slab);
 	}
-	ndo->ndo_last_mem_p = NULL;
+	ndo->ndo_arena_head = NULL;
+	ndo->ndo_arena_cur = NULL;
+	ndo->ndo_arena_off = 0;
 }
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Buffered output.
+ *
+ * The output for a packet is accumulated in a growable buffer in the
+ * netdissect_options structure and handed, in one piece, to the
+ * ndo_output_sink routine when the packet has been printed, rather
+ * than going through stdio one field at a time.
+ *
+ * ND_PRINT() formats into the buffer with vsnprintf(); the nd_out_*()
+ * routines append strings and numbers to it without parsing a format
+ * string, for the fields that are printed for most packets.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "netdissect.h"
+
+/* Initial size of the output buffer. */
+#define ND_OUTBUF_INITIAL_SIZE	1024
+
+/*
+ * Room to ask for before formatting with vsnprintf(), so that most
+ * calls don't have to format twice.
+ */
+#define ND_OUTBUF_PRINTF_ROOM	128
+
+/*
+ * Make sure there's room for at least len more bytes, plus a
+ * terminating null, in the output buffer.
+ */
+void
+nd_output_grow(netdissect_options *ndo, size_t len)
+{
+	size_t new_size;
+	char *new_buf;
+
+	if (ndo->ndo_outbuf_size - ndo->ndo_outbuf_len > len)
+		return;
+	new_size = ndo->ndo_outbuf_size != 0 ?
+	    ndo->ndo_outbuf_size : ND_OUTBUF_INITIAL_SIZE;
+	while (new_size - ndo->ndo_outbuf_len <= len)
+		new_size *= 2;
+	new_buf = realloc(ndo->ndo_outbuf, new_size);
+	if (new_buf == NULL)
+		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: realloc",
+		    __func__);
+	ndo->ndo_outbuf = new_buf;
+	ndo->ndo_outbuf_size = new_size;
+}
+
+/*
+ * Format into the output buffer.
+ */
+int
+nd_output_vprintf(netdissect_options *ndo, const char *fmt, va_list args)
+{
+	va_list args_copy;
+	size_t room;
+	int ret;
+
+	nd_output_grow(ndo, ND_OUTBUF_PRINTF_ROOM);
+	room = ndo->ndo_outbuf_size - ndo->ndo_outbuf_len;
+	va_copy(args_copy, args);
+	ret = vsnprintf(ndo->ndo_outbuf + ndo->ndo_outbuf_len, room, fmt,
+	    args_copy);
+	va_end(args_copy);
+	if (ret < 0)
+		(*ndo->ndo_error)(ndo, S_ERR_ND_WRITE_FILE,
+		    "Unable to format output: %s", strerror(errno));
+	if ((size_t)ret >= room) {
+		/* It didn't fit; make room and do it again. */
+		nd_output_grow(ndo, (size_t)ret);
+		room = ndo->ndo_outbuf_size - ndo->ndo_outbuf_len;
+		ret = vsnprintf(ndo->ndo_outbuf + ndo->ndo_outbuf_len, room,
+		    fmt, args);
+		if (ret < 0)
+			(*ndo->ndo_error)(ndo, S_ERR_ND_WRITE_FILE,
+			    "Unable to format output: %s", strerror(errno));
+	}
+	ndo->ndo_outbuf_len += ret;
+	return (ret);
+}
+
+/*
+ * Hand whatever is in the output buffer to the output sink.
+ */
+void
+nd_output_flush(netdissect_options *ndo)
+{
+	if (ndo->ndo_outbuf_len != 0)
+		(*ndo->ndo_output_sink)(ndo);
+}
+
+void
+nd_out_bytes(netdissect_options *ndo, const char *s, size_t len)
+{
+	nd_output_grow(ndo, len);
+	memcpy(ndo->ndo_outbuf + ndo->ndo_outbuf_len, s, len);
+	ndo->ndo_outbuf_len += len;
+}
+
+void
+nd_out_str(netdissect_options *ndo, const char *s)
+{
+	nd_out_bytes(ndo, s, strlen(s));
+}
+
+void
+nd_out_char(netdissect_options *ndo, int c)
+{
+	nd_output_grow(ndo, 1);
+	ndo->ndo_outbuf[ndo->ndo_outbuf_len++] = (char)c;
+}
+
+/*
+ * Append an unsigned decimal number, zero-padded to at least width
+ * digits, as "%0*" PRIu64 would.
+ */
+void
+nd_out_uint(netdissect_options *ndo, uint64_t v, u_int width)
+{
+	char buf[20];		/* enough for 2^64-1 */
+	u_int n = 0;
+
+	do {
+		buf[sizeof(buf) - ++n] = '0' + (char)(v % 10);
+		v /= 10;
+	} while (v != 0);
+	nd_output_grow(ndo, (width > n ? width : n));
+	while (width > n) {
+		ndo->ndo_outbuf[ndo->ndo_outbuf_len++] = '0';
+		width--;
+	}
+	memcpy(ndo->ndo_outbuf + ndo->ndo_outbuf_len, buf + sizeof(buf) - n,
+	    n);
+	ndo->ndo_outbuf_len += n;
+}
+
+/*
+ * Append an unsigned hexadecimal number, in lower case and zero-padded
+ * to at least width digits, as "%0*" PRIx64 would.
+ */
+void
+nd_out_hex(netdissect_options *ndo, uint64_t v, u_int width)
+{
+	static const char hex[] = "0123456789abcdef";
+	char buf[16];		/* enough for 2^64-1 */
+	u_int n = 0;
+
+	do {
+		buf[sizeof(buf) - ++n] = hex[v & 0xf];
+		v >>= 4;
+	} while (v != 0);
+	nd_output_grow(ndo, (width > n ? width : n));
+	while (width > n) {
+		ndo->ndo_outbuf[ndo->ndo_outbuf_len++] = '0';
+		width--;
+	}
+	memcpy(ndo->ndo_outbuf + ndo->ndo_outbuf_len, buf + sizeof(buf) - n,
+	    n);
+	ndo->ndo_outbuf_len += n;
+}
@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Counters of the work done by each printer ("--profile").
+ *
+ * The printers are told apart by ndo_protocol, which each of them sets
+ * when called.  The time is taken when a packet starts and ends, and
+ * around the calls made by the main demultiplexers, and the time since
+ * the previous one is charged to the printer that set ndo_protocol
+ * last; when a demultiplexer's call returns, the time is charged to the
+ * caller again.  So each printer is charged the time spent in it and in
+ * the printers it calls without going through a demultiplexer.  A
+ * printer is counted once per packet in which it runs, with the length
+ * given to it by the demultiplexer that called it.
+ *
+ * Each netdissect_options has its own table, written by the thread
+ * that uses it; the tables are all read, and added up, by
+ * nd_profile_collect(), which may be called from a signal handler.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "netdissect.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+/* Number of printers a table can hold, a power of 2 */
+#define PROFILE_SLOTS	1024
+
+struct profile_entry {
+	const char *protocol;		/* ndo_protocol; NULL if unused */
+	uint64_t packets;
+	uint64_t bytes;
+	uint64_t ticks;
+	uint64_t truncated;
+	uint64_t invalid;
+	u_int last_packet;		/* last packet counted */
+};
+
+struct nd_profile {
+	struct nd_profile *next;	/* in the list of all tables */
+	u_int packet;			/* number of the packet being printed */
+	uint64_t last;			/* time of the last check point */
+	struct profile_entry *current;	/* printer charged */
+	const char *last_set;		/* ndo_protocol at the last one */
+	u_int pending_len;		/* length given to the printer called */
+	struct profile_entry entries[PROFILE_SLOTS];
+};
+
+/* All the tables, created before any thread is started */
+static struct nd_profile *profiles;
+
+/*
+ * The counters are written by one thread and read by whichever reports
+ * them.
+ */
+#if defined(__ATOMIC_RELAXED) && defined(__SIZEOF_POINTER__) && \
+    __SIZEOF_POINTER__ >= 8
+#define COUNTER_ADD(x, n) \
+	__atomic_store_n(&(x), (x) + (n), __ATOMIC_RELAXED)
+#define COUNTER_GET(x)	__atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define PUBLISH(x, v)	__atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#define PUBLISHED(x)	__atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#else
+#define COUNTER_ADD(x, n)	((x) += (n))
+#define COUNTER_GET(x)	(x)
+#define PUBLISH(x, v)	((x) = (v))
+#define PUBLISHED(x)	(x)
+#endif
+
+/*
+ * The clock: the time stamp counter where there's one, as it's the
+ * cheapest to read, and a monotonic clock otherwise.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define PROFILE_UNIT	"cycles"
+static uint64_t
+profile_clock(void)
+{
+	return __builtin_ia32_rdtsc();
+}
+#elif defined(_WIN32)
+#define PROFILE_UNIT	"ticks"
+static uint64_t
+profile_clock(void)
+{
+	LARGE_INTEGER t;
+
+	QueryPerformanceCounter(&t);
+	return (uint64_t)t.QuadPart;
+}
+#elif defined(CLOCK_MONOTONIC)
+#define PROFILE_UNIT	"ns"
+static uint64_t
+profile_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+#else
+#define PROFILE_UNIT	"(no clock)"
+static uint64_t
+profile_clock(void)
+{
+	return 0;
+}
+#endif
+
+/*
+ * Create the table of a netdissect_options; this must be done before
+ * any other thread is started.
+ */
+struct nd_profile *
+nd_profile_new(netdissect_options *ndo)
+{
+	struct nd_profile *p;
+
+	p = calloc(1, sizeof(*p));
+	if (p == NULL)
+		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: calloc",
+		    __func__);
+	p->next = profiles;
+	profiles = p;
+	return p;
+}
+
+/* Zero the counters of a table, which mustn't be in use */
+void
+nd_profile_reset(struct nd_profile *p)
+{
+	u_int i;
+
+	for (i = 0; i < PROFILE_SLOTS; i++) {
+		p->entries[i].packets = 0;
+		p->entries[i].bytes = 0;
+		p->entries[i].ticks = 0;
+		p->entries[i].truncated = 0;
+		p->entries[i].invalid = 0;
+	}
+}
+
+/* The unit of the times */
+const char *
+nd_profile_unit(void)
+{
+	return PROFILE_UNIT;
+}
+
+/*
+ * Return the entry of a printer; as there are only a few hundred, the
+ * table can't fill up unless ndo_protocol is set to something other
+ * than a string constant, and the last entry is then used for all the
+ * others.
+ */
+static struct profile_entry *
+find_entry(struct nd_profile *p, const char *protocol)
+{
+	struct profile_entry *e;
+	u_int i, n;
+
+	i = (u_int)(((uintptr_t)protocol >> 3) * 0x9e3779b1U) &
+	    (PROFILE_SLOTS - 1);
+	for (n = 0; n < PROFILE_SLOTS - 1; n++) {
+		e = &p->entries[i];
+		if (e->protocol == protocol)
+			return e;
+		if (e->protocol == NULL) {
+			PUBLISH(e->protocol, protocol);
+			return e;
+		}
+		i = (i + 1) & (PROFILE_SLOTS - 1);
+	}
+	e = &p->entries[PROFILE_SLOTS - 1];
+	if (e->protocol == NULL)
+		PUBLISH(e->protocol, "(other)");
+	return e;
+}
+
+/*
+ * A check point: charge the time since the last one to the printer
+ * that set ndo_protocol last, and count that printer for the packet
+ * if it's the first time it's seen in it.
+ */
+static void
+check_point(netdissect_options *ndo, struct nd_profile *p)
+{
+	struct profile_entry *e;
+	uint64_t now;
+
+	if (ndo->ndo_protocol != p->last_set) {
+		p->last_set = ndo->ndo_protocol;
+		p->current = find_entry(p, ndo->ndo_protocol);
+		e = p->current;
+		if (e->last_packet != p->packet) {
+			e->last_packet = p->packet;
+			COUNTER_ADD(e->packets, 1);
+			COUNTER_ADD(e->bytes, p->pending_len);
+		}
+	}
+	now = profile_clock();
+	if (p->current != NULL)
+		COUNTER_ADD(p->current->ticks, now - p->last);
+	p->last = now;
+}
+
+/*
+ * Called when a packet, with the given on-the-network length, starts
+ * being printed, and when it's done.
+ */
+void
+nd_profile_packet_begin(netdissect_options *ndo, u_int len)
+{
+	struct nd_profile *p = ndo->ndo_profile;
+
+	/* 0 is the number of no packet, for the unused entries */
+	if (++p->packet == 0)
+		p->packet = 1;
+	p->current = NULL;
+	p->last_set = NULL;
+	p->pending_len = len;
+	p->last = profile_clock();
+}
+
+void
+nd_profile_packet_end(netdissect_options *ndo)
+{
+	check_point(ndo, ndo->ndo_profile);
+}
+
+/*
+ * Called by a demultiplexer before it calls the printer of the data,
+ * of the given length, that it has found, and after it returns.
+ */
+void
+nd_profile_enter(netdissect_options *ndo, struct nd_profile_frame *f,
+		 u_int len)
+{
+	struct nd_profile *p = ndo->ndo_profile;
+
+	check_point(ndo, p);
+	f->parent = p->current;
+	p->pending_len = len;
+}
+
+void
+nd_profile_leave(netdissect_options *ndo, const struct nd_profile_frame *f)
+{
+	struct nd_profile *p = ndo->ndo_profile;
+
+	check_point(ndo, p);
+	p->current = f->parent;
+}
+
+/*
+ * Count a truncated or invalid packet for the printer that found it to
+ * be so.
+ */
+void
+nd_profile_count(netdissect_options *ndo, int what)
+{
+	struct profile_entry *e;
+
+	e = find_entry(ndo->ndo_profile, ndo->ndo_protocol);
+	if (what == ND_PROFILE_TRUNCATED)
+		COUNTER_ADD(e->truncated, 1);
+	else
+		COUNTER_ADD(e->invalid, 1);
+}
+
+/*
+ * Add up the counters of each printer in all the tables, and put them
+ * in rows, at most max of them, in no particular order; returns the
+ * number of rows.  Printers with the same name are added together.
+ */
+u_int
+nd_profile_collect(struct nd_profile_row *rows, u_int max)
+{
+	const struct nd_profile *p;
+	const struct profile_entry *e;
+	struct nd_profile_row *r;
+	const char *protocol;
+	u_int i, j, n = 0;
+
+	for (p = profiles; p != NULL; p = p->next) {
+		for (i = 0; i < PROFILE_SLOTS; i++) {
+			e = &p->entries[i];
+			protocol = PUBLISHED(e->protocol);
+			if (protocol == NULL)
+				continue;
+			for (j = 0; j < n; j++) {
+				if (strcmp(rows[j].protocol, protocol) == 0)
+					break;
+			}
+			if (j == n) {
+				if (n == max)
+					continue;
+				r = &rows[n++];
+				memset(r, 0, sizeof(*r));
+				r->protocol = protocol;
+			} else
+				r = &rows[j];
+			r->packets += COUNTER_GET(e->packets);
+			r->bytes += COUNTER_GET(e->bytes);
+			r->ticks += COUNTER_GET(e->ticks);
+			r->truncated += COUNTER_GET(e->truncated);
+			r->invalid += COUNTER_GET(e->invalid);
+		}
+	}
+	return n;
+}
@@ -0,0 +1,565 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Structured output.
+ *
+ * When the output format isn't text, the printers of the most common
+ * protocols (Ethernet, IPv4, IPv6, TCP and UDP) record the fields of
+ * the outermost headers of the packet in ndo->ndo_record, and mark the
+ * text they've printed for them as covered by those fields with
+ * nd_record_text_start().  Once the packet has been printed,
+ * nd_record_end() replaces the output for the packet with a record
+ * made of those fields and, as the "text" field, whatever the other
+ * printers printed, either as a line of JSON or as a binary record
+ * (see netdissect-record.h).
+ *
+ * Only the headers of the packet itself are recorded, not the ones of
+ * packets quoted in ICMP errors or carried in tunnels; the TCP and UDP
+ * fields are recorded only if the header they follow is the recorded
+ * IP header.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <string.h>
+
+#include "netdissect.h"
+#include "netdissect-alloc.h"
+#include "netdissect-record.h"
+#include "addrtostr.h"
+#include "extract.h"
+#include "ip.h"
+#include "ip6.h"
+
+/*
+ * Start recording a packet.
+ */
+void
+nd_record_begin(netdissect_options *ndo, const struct pcap_pkthdr *h,
+		u_int packet_number)
+{
+	struct nd_record *rec = &ndo->ndo_record;
+
+	rec->nr_present = 0;
+	rec->nr_ts.tv_sec = h->ts.tv_sec;
+	rec->nr_ts.tv_usec = h->ts.tv_usec;
+	rec->nr_caplen = h->caplen;
+	rec->nr_len = h->len;
+	rec->nr_packet_number = packet_number;
+	rec->nr_dlt = ndo->ndo_dlt;
+	rec->nr_text_off = ndo->ndo_outbuf_len;
+	rec->nr_ip_hdr = NULL;
+}
+
+/*
+ * Note that everything printed so far is covered by the recorded
+ * fields; the "text" field starts here.
+ */
+void
+nd_record_text_start(netdissect_options *ndo)
+{
+	ndo->ndo_record.nr_text_off = ndo->ndo_outbuf_len;
+}
+
+/*
+ * Record the Ethernet addresses and type of the packet, if neither
+ * they nor an IP header have been recorded yet; the header must have
+ * been captured.
+ * Return 1 if they've been recorded, 0 otherwise.
+ */
+int
+nd_record_ether(netdissect_options *ndo, const u_char *src,
+		const u_char *dst, uint16_t type)
+{
+	struct nd_record *rec = &ndo->ndo_record;
+
+	if (!ND_RECORDING(ndo) ||
+	    (rec->nr_present & (ND_REC_ETHER | ND_REC_IP)))
+		return 0;
+	memcpy(rec->nr_ether_src, src, sizeof(rec->nr_ether_src));
+	memcpy(rec->nr_ether_dst, dst, sizeof(rec->nr_ether_dst));
+	rec->nr_ether_type = type;
+	rec->nr_present |= ND_REC_ETHER;
+	return 1;
+}
+
+/*
+ * Record the fields of the IPv4 or IPv6 header at bp, if no IP header
+ * has been recorded yet; the fixed part of the header must have been
+ * captured.  Return 1 if they've been recorded, 0 otherwise.
+ */
+int
+nd_record_ip(netdissect_options *ndo, const u_char *bp)
+{
+	struct nd_record *rec = &ndo->ndo_record;
+	const struct ip *ip = (const struct ip *)bp;
+	const struct ip6_hdr *ip6 = (const struct ip6_hdr *)bp;
+	uint32_t flow;
+
+	if (!ND_RECORDING(ndo) || (rec->nr_present & ND_REC_IP))
+		return 0;
+	rec->nr_ip_version = IP_V(ip);
+	switch (rec->nr_ip_version) {
+
+	case 4:
+		rec->nr_ip_proto = GET_U_1(ip->ip_p);
+		rec->nr_ip_ttl = GET_U_1(ip->ip_ttl);
+		rec->nr_ip_tos = GET_U_1(ip->ip_tos);
+		rec->nr_ip_hlen = IP_HL(ip) * 4;
+		memcpy(rec->nr_ip_src, ip->ip_src, 4);
+		memcpy(rec->nr_ip_dst, ip->ip_dst, 4);
+		rec->nr_ip_len = GET_BE_U_2(ip->ip_len);
+		rec->nr_ip_id = GET_BE_U_2(ip->ip_id);
+		rec->nr_ip_off = GET_BE_U_2(ip->ip_off);
+		break;
+
+	case 6:
+		flow = GET_BE_U_4(ip6->ip6_flow);
+		rec->nr_ip_proto = GET_U_1(ip6->ip6_nxt);
+		rec->nr_ip_ttl = GET_U_1(ip6->ip6_hlim);
+		rec->nr_ip_tos = (uint8_t)((flow & 0x0ff00000) >> 20);
+		memcpy(rec->nr_ip_src, ip6->ip6_src, 16);
+		memcpy(rec->nr_ip_dst, ip6->ip6_dst, 16);
+		rec->nr_ip_len = GET_BE_U_2(ip6->ip6_plen) +
+		    (uint32_t)sizeof(struct ip6_hdr);
+		rec->nr_ip_id = flow & 0x000fffff;
+		rec->nr_ip_off = 0;
+		break;
+
+	default:
+		return 0;
+	}
+	rec->nr_ip_hdr = bp;
+	rec->nr_present |= ND_REC_IP;
+	return 1;
+}
+
+/*
+ * Record the ports of a TCP or UDP header (type is ND_REC_TCP or
+ * ND_REC_UDP) following the IP header at ip_hdr, if that's the IP
+ * header that was recorded.  Return 1 if they've been recorded, in
+ * which case the caller should record the rest of the fields, 0
+ * otherwise.
+ */
+int
+nd_record_l4(netdissect_options *ndo, uint32_t type, const u_char *ip_hdr,
+	     uint16_t sport, uint16_t dport)
+{
+	struct nd_record *rec = &ndo->ndo_record;
+
+	if (!ND_RECORDING(ndo) || ip_hdr != rec->nr_ip_hdr ||
+	    (rec->nr_present & (ND_REC_TCP | ND_REC_UDP)))
+		return 0;
+	rec->nr_sport = sport;
+	rec->nr_dport = dport;
+	rec->nr_l4_len = 0;
+	rec->nr_present |= type;
+	return 1;
+}
+
+/*
+ * Append a JSON string, escaping what has to be escaped; bytes that
+ * aren't printable ASCII are escaped too, so that the output is valid
+ * UTF-8 whatever the printers printed.
+ */
+static void
+json_string(netdissect_options *ndo, const char *s, size_t len)
+{
+	const char *run = s;
+	u_char c;
+
+	nd_out_char(ndo, '"');
+	for (; len != 0; s++, len--) {
+		c = (u_char)*s;
+		if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\')
+			continue;
+		nd_out_bytes(ndo, run, s - run);
+		run = s + 1;
+		switch (c) {
+
+		case '"':
+			nd_out_bytes(ndo, "\\\"", 2);
+			break;
+
+		case '\\':
+			nd_out_bytes(ndo, "\\\\", 2);
+			break;
+
+		case '\n':
+			nd_out_bytes(ndo, "\\n", 2);
+			break;
+
+		case '\r':
+			nd_out_bytes(ndo, "\\r", 2);
+			break;
+
+		case '\t':
+			nd_out_bytes(ndo, "\\t", 2);
+			break;
+
+		default:
+			nd_out_bytes(ndo, "\\u00", 4);
+			nd_out_hex(ndo, c, 2);
+			break;
+		}
+	}
+	nd_out_bytes(ndo, run, s - run);
+	nd_out_char(ndo, '"');
+}
+
+/* Append ,"name": */
+static void
+json_key(netdissect_options *ndo, const char *name)
+{
+	nd_out_bytes(ndo, ",\"", 2);
+	nd_out_str(ndo, name);
+	nd_out_bytes(ndo, "\":", 2);
+}
+
+static void
+json_uint(netdissect_options *ndo, const char *name, uint64_t v)
+{
+	json_key(ndo, name);
+	nd_out_uint(ndo, v, 0);
+}
+
+static void
+json_mac48(netdissect_options *ndo, const uint8_t *addr)
+{
+	u_int i;
+
+	nd_out_char(ndo, '"');
+	for (i = 0; i < 6; i++) {
+		if (i != 0)
+			nd_out_char(ndo, ':');
+		nd_out_hex(ndo, addr[i], 2);
+	}
+	nd_out_char(ndo, '"');
+}
+
+static void
+json_ipaddr(netdissect_options *ndo, const char *name, u_int version,
+	    const uint8_t *addr)
+{
+	char buf[INET6_ADDRSTRLEN];
+
+	json_key(ndo, name);
+	nd_out_char(ndo, '"');
+	if (version == 4)
+		nd_out_str(ndo, addrtostr(addr, buf, sizeof(buf)));
+	else
+		nd_out_str(ndo, addrtostr6(addr, buf, sizeof(buf)));
+	nd_out_char(ndo, '"');
+}
+
+static const struct tok tcp_flag_chars[] = {
+	{ 0x01, "F" },
+	{ 0x02, "S" },
+	{ 0x04, "R" },
+	{ 0x08, "P" },
+	{ 0x10, "." },
+	{ 0x20, "U" },
+	{ 0x40, "E" },
+	{ 0x80, "W" },
+	{ 0x100, "e" },
+	{ 0, NULL }
+};
+
+/*
+ * Write the record as a JSON object on one line.
+ */
+void
+nd_record_json(netdissect_options *ndo, const struct nd_record *rec,
+	       const char *opts, size_t opts_len, const char *text,
+	       size_t text_len)
+{
+	nd_out_bytes(ndo, "{\"ts\":", 6);
+	nd_out_uint(ndo, (uint64_t)rec->nr_ts.tv_sec, 0);
+	nd_out_char(ndo, '.');
+#ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
+	if (ndo->ndo_tstamp_precision == PCAP_TSTAMP_PRECISION_NANO)
+		nd_out_uint(ndo, (u_int)rec->nr_ts.tv_usec, 9);
+	else
+#endif
+		nd_out_uint(ndo, (u_int)rec->nr_ts.tv_usec, 6);
+	json_uint(ndo, "num", rec->nr_packet_number);
+	json_uint(ndo, "caplen", rec->nr_caplen);
+	json_uint(ndo, "len", rec->nr_len);
+	json_uint(ndo, "dlt", (u_int)rec->nr_dlt);
+
+	if (rec->nr_present & ND_REC_ETHER) {
+		nd_out_bytes(ndo, ",\"eth\":{\"src\":", 14);
+		json_mac48(ndo, rec->nr_ether_src);
+		json_key(ndo, "dst");
+		json_mac48(ndo, rec->nr_ether_dst);
+		json_uint(ndo, "type", rec->nr_ether_type);
+		nd_out_char(ndo, '}');
+	}
+
+	if (rec->nr_present & ND_REC_IP) {
+		nd_out_bytes(ndo, ",\"ip\":{\"v\":", 11);
+		nd_out_uint(ndo, rec->nr_ip_version, 0);
+		json_ipaddr(ndo, "src", rec->nr_ip_version, rec->nr_ip_src);
+		json_ipaddr(ndo, "dst", rec->nr_ip_version, rec->nr_ip_dst);
+		json_uint(ndo, "proto", rec->nr_ip_proto);
+		json_uint(ndo, "ttl", rec->nr_ip_ttl);
+		json_uint(ndo, "tos", rec->nr_ip_tos);
+		json_uint(ndo, "len", rec->nr_ip_len);
+		if (rec->nr_ip_version == 4) {
+			json_uint(ndo, "hlen", rec->nr_ip_hlen);
+			json_uint(ndo, "id", rec->nr_ip_id);
+			json_uint(ndo, "off", (rec->nr_ip_off & 0x1fff) * 8);
+			if (rec->nr_ip_off & 0x4000)
+				nd_out_bytes(ndo, ",\"df\":true", 10);
+			if (rec->nr_ip_off & 0x2000)
+				nd_out_bytes(ndo, ",\"mf\":true", 10);
+		} else
+			json_uint(ndo, "flow", rec->nr_ip_id);
+		nd_out_char(ndo, '}');
+	}
+
+	if (rec->nr_present & (ND_REC_TCP | ND_REC_UDP)) {
+		if (rec->nr_present & ND_REC_TCP)
+			nd_out_bytes(ndo, ",\"tcp\":{\"sport\":", 16);
+		else
+			nd_out_bytes(ndo, ",\"udp\":{\"sport\":", 16);
+		nd_out_uint(ndo, rec->nr_sport, 0);
+		json_uint(ndo, "dport", rec->nr_dport);
+		if (rec->nr_present & ND_REC_TCP_HDR) {
+			json_key(ndo, "flags");
+			nd_out_char(ndo, '"');
+			nd_out_str(ndo, bittok2str_nosep(tcp_flag_chars, "",
+			    rec->nr_tcp_flags));
+			nd_out_char(ndo, '"');
+		}
+		if (rec->nr_present & ND_REC_TCP_SEQ)
+			json_uint(ndo, "seq", rec->nr_tcp_seq);
+		if (rec->nr_present & ND_REC_TCP_ACK)
+			json_uint(ndo, "ack", rec->nr_tcp_ack);
+		if (rec->nr_present & ND_REC_TCP_HDR) {
+			json_uint(ndo, "win", rec->nr_tcp_win);
+			if (rec->nr_tcp_flags & 0x20)
+				json_uint(ndo, "urg", rec->nr_tcp_urp);
+		}
+		if (rec->nr_present & ND_REC_TCP_OPTS) {
+			json_key(ndo, "options");
+			json_string(ndo, opts, opts_len);
+		}
+		json_uint(ndo, "len", rec->nr_l4_len);
+		nd_out_char(ndo, '}');
+	}
+
+	if (text_len != 0) {
+		json_key(ndo, "text");
+		json_string(ndo, text, text_len);
+	}
+	nd_out_bytes(ndo, "}\n", 2);
+}
+
+static void
+put_le_u16(u_char *p, uint16_t v)
+{
+	p[0] = (u_char)v;
+	p[1] = (u_char)(v >> 8);
+}
+
+static void
+put_le_u32(u_char *p, uint32_t v)
+{
+	put_le_u16(p, (uint16_t)v);
+	put_le_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+static void
+put_le_u64(u_char *p, uint64_t v)
+{
+	put_le_u32(p, (uint32_t)v);
+	put_le_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+/* Length of a TLV with a value of len bytes, including the padding. */
+#define TLV_SIZE(len)	(ND_REC_TLV_HDRLEN + (((len) + 3) & ~(size_t)3))
+
+static u_char *
+put_tlv(u_char *p, uint16_t type, const char *value, size_t len)
+{
+	put_le_u16(p, type);
+	put_le_u32(p + 4, (uint32_t)len);
+	memcpy(p + ND_REC_TLV_HDRLEN, value, len);
+	return p + TLV_SIZE(len);
+}
+
+/*
+ * Write the file header of the binary record stream.
+ */
+void
+nd_record_file_header(netdissect_options *ndo)
+{
+	u_char *p;
+
+	if (ndo->ndo_output_format != ND_OUTPUT_BINARY)
+		return;
+	nd_output_grow(ndo, ND_RECFILE_HDRLEN);
+	p = (u_char *)ndo->ndo_outbuf + ndo->ndo_outbuf_len;
+	memset(p, 0, ND_RECFILE_HDRLEN);
+	memcpy(p + ND_RECFILE_OFF_MAGIC, ND_RECFILE_MAGIC, 4);
+	put_le_u16(p + ND_RECFILE_OFF_VERSION, ND_RECFILE_VERSION);
+	put_le_u16(p + ND_RECFILE_OFF_HDRLEN, ND_RECFILE_HDRLEN);
+#ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
+	if (ndo->ndo_tstamp_precision == PCAP_TSTAMP_PRECISION_NANO)
+		put_le_u32(p + ND_RECFILE_OFF_FLAGS, ND_RECFILE_NANO);
+#endif
+	ndo->ndo_outbuf_len += ND_RECFILE_HDRLEN;
+}
+
+/*
+ * Write the record in binary; see netdissect-record.h.  The fields
+ * are stored directly in the output buffer.
+ */
+static void
+binary_record(netdissect_options *ndo, const struct nd_record *rec,
+	      const char *opts, size_t opts_len, const char *text,
+	      size_t text_len)
+{
+	size_t rec_len;
+	u_char *p, *tlv;
+
+	rec_len = ND_REC_HDRLEN;
+	if (text_len != 0)
+		rec_len += TLV_SIZE(text_len);
+	if (rec->nr_present & ND_REC_TCP_OPTS)
+		rec_len += TLV_SIZE(opts_len);
+	rec_len = (rec_len + ND_REC_ALIGN - 1) & ~(size_t)(ND_REC_ALIGN - 1);
+
+	nd_output_grow(ndo, rec_len);
+	p = (u_char *)ndo->ndo_outbuf + ndo->ndo_outbuf_len;
+	memset(p, 0, rec_len);
+
+	put_le_u32(p + ND_REC_OFF_RECLEN, (uint32_t)rec_len);
+	put_le_u16(p + ND_REC_OFF_HDRLEN, ND_REC_HDRLEN);
+	put_le_u16(p + ND_REC_OFF_PRESENT, (uint16_t)rec->nr_present);
+	put_le_u64(p + ND_REC_OFF_TS_SEC, (uint64_t)rec->nr_ts.tv_sec);
+	put_le_u32(p + ND_REC_OFF_TS_FRAC, (uint32_t)rec->nr_ts.tv_usec);
+	put_le_u32(p + ND_REC_OFF_NUM, rec->nr_packet_number);
+	put_le_u32(p + ND_REC_OFF_CAPLEN, rec->nr_caplen);
+	put_le_u32(p + ND_REC_OFF_LEN, rec->nr_len);
+	put_le_u32(p + ND_REC_OFF_DLT, (uint32_t)rec->nr_dlt);
+
+	if (rec->nr_present & ND_REC_ETHER) {
+		memcpy(p + ND_REC_OFF_ETHER_SRC, rec->nr_ether_src, 6);
+		memcpy(p + ND_REC_OFF_ETHER_DST, rec->nr_ether_dst, 6);
+		put_le_u16(p + ND_REC_OFF_ETHER_TYPE, rec->nr_ether_type);
+	}
+
+	if (rec->nr_present & ND_REC_IP) {
+		p[ND_REC_OFF_IP_VERSION] = rec->nr_ip_version;
+		p[ND_REC_OFF_IP_PROTO] = rec->nr_ip_proto;
+		p[ND_REC_OFF_IP_TTL] = rec->nr_ip_ttl;
+		p[ND_REC_OFF_IP_TOS] = rec->nr_ip_tos;
+		memcpy(p + ND_REC_OFF_IP_SRC, rec->nr_ip_src,
+		    rec->nr_ip_version == 4 ? 4 : 16);
+		memcpy(p + ND_REC_OFF_IP_DST, rec->nr_ip_dst,
+		    rec->nr_ip_version == 4 ? 4 : 16);
+		put_le_u32(p + ND_REC_OFF_IP_LEN, rec->nr_ip_len);
+		put_le_u32(p + ND_REC_OFF_IP_ID, rec->nr_ip_id);
+		put_le_u16(p + ND_REC_OFF_IP_OFF, rec->nr_ip_off);
+		p[ND_REC_OFF_IP_HLEN] = rec->nr_ip_hlen;
+	}
+
+	if (rec->nr_present & (ND_REC_TCP | ND_REC_UDP)) {
+		put_le_u16(p + ND_REC_OFF_SPORT, rec->nr_sport);
+		put_le_u16(p + ND_REC_OFF_DPORT, rec->nr_dport);
+		put_le_u32(p + ND_REC_OFF_L4_LEN, rec->nr_l4_len);
+	}
+	if (rec->nr_present & ND_REC_TCP_HDR) {
+		put_le_u16(p + ND_REC_OFF_TCP_FLAGS, rec->nr_tcp_flags);
+		put_le_u16(p + ND_REC_OFF_TCP_WIN, rec->nr_tcp_win);
+		put_le_u16(p + ND_REC_OFF_TCP_URP, rec->nr_tcp_urp);
+	}
+	if (rec->nr_present & ND_REC_TCP_SEQ)
+		put_le_u32(p + ND_REC_OFF_TCP_SEQ, rec->nr_tcp_seq);
+	if (rec->nr_present & ND_REC_TCP_ACK)
+		put_le_u32(p + ND_REC_OFF_TCP_ACK, rec->nr_tcp_ack);
+
+	tlv = p + ND_REC_HDRLEN;
+	if (rec->nr_present & ND_REC_TCP_OPTS)
+		tlv = put_tlv(tlv, ND_REC_TLV_TCP_OPTS, opts, opts_len);
+	if (text_len != 0)
+		put_tlv(tlv, ND_REC_TLV_TEXT, text, text_len);
+
+	ndo->ndo_outbuf_len += rec_len;
+}
+
+/*
+ * Replace the output for the packet with its record.
+ */
+void
+nd_record_end(netdissect_options *ndo)
+{
+	const struct nd_record *rec = &ndo->ndo_record;
+	size_t out_len = ndo->ndo_outbuf_len;
+	size_t text_off = rec->nr_text_off;
+	const char *opts = NULL;
+	size_t opts_len = 0;
+	char *out;
+
+	/*
+	 * Copy the output, as the record is written over it; the copy
+	 * is per-packet memory.
+	 */
+	out = nd_malloc(ndo, out_len + 1);
+	if (out == NULL)
+		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: nd_malloc",
+		    __func__);
+	memcpy(out, ndo->ndo_outbuf, out_len);
+	if (rec->nr_present & ND_REC_TCP_OPTS) {
+		opts = out + rec->nr_tcp_opt_off;
+		opts_len = rec->nr_tcp_opt_len;
+	}
+
+	/*
+	 * Trim the separators left between the text covered by the
+	 * fields and the rest, and trailing white space.
+	 */
+	if (text_off > out_len)
+		text_off = out_len;
+	while (text_off < out_len &&
+	    (out[text_off] == ' ' || out[text_off] == ',' ||
+	     out[text_off] == ':' || out[text_off] == '\n' ||
+	     out[text_off] == '\t'))
+		text_off++;
+	while (out_len > text_off &&
+	    (out[out_len - 1] == ' ' || out[out_len - 1] == '\n' ||
+	     out[out_len - 1] == '\t'))
+		out_len--;
+
+	ndo->ndo_outbuf_len = 0;
+	switch (ndo->ndo_output_format) {
+
+	case ND_OUTPUT_JSON:
+		nd_record_json(ndo, rec, opts, opts_len, out + text_off,
+		    out_len - text_off);
+		break;
+
+	case ND_OUTPUT_BINARY:
+		binary_record(ndo, rec, opts, opts_len, out + text_off,
+		    out_len - text_off);
+		break;
+	}
+}
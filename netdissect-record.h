@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef netdissect_record_h
+#define netdissect_record_h
+
+/*
+ * Layout of the binary record stream written with
+ * --output-format=binary.
+ *
+ * All the multi-byte fields are little-endian, and all the fields are
+ * naturally aligned if the stream is, so that the stream can be mapped
+ * into memory and the fields read in place on little-endian machines.
+ *
+ * The stream starts with a file header:
+ */
+#define ND_RECFILE_MAGIC	"NDRC"	/* 4 bytes */
+#define ND_RECFILE_VERSION	1
+
+#define ND_RECFILE_OFF_MAGIC	0	/* ND_RECFILE_MAGIC */
+#define ND_RECFILE_OFF_VERSION	4	/* 2 bytes, ND_RECFILE_VERSION */
+#define ND_RECFILE_OFF_HDRLEN	6	/* 2 bytes, length of the file header */
+#define ND_RECFILE_OFF_FLAGS	8	/* 4 bytes, ND_RECFILE_NANO */
+#define ND_RECFILE_HDRLEN	16	/* 12 to 15 are reserved */
+
+#define ND_RECFILE_NANO		0x00000001	/* ts_frac is in ns, not us */
+
+/*
+ * followed by one record per packet.  A record has a fixed part:
+ */
+#define ND_REC_OFF_RECLEN	0	/* 4 bytes, length of the record */
+#define ND_REC_OFF_HDRLEN	4	/* 2 bytes, length of the fixed part */
+#define ND_REC_OFF_PRESENT	6	/* 2 bytes, ND_REC_ bits */
+#define ND_REC_OFF_TS_SEC	8	/* 8 bytes */
+#define ND_REC_OFF_TS_FRAC	16	/* 4 bytes, us or ns */
+#define ND_REC_OFF_NUM		20	/* 4 bytes, packet number */
+#define ND_REC_OFF_CAPLEN	24	/* 4 bytes */
+#define ND_REC_OFF_LEN		28	/* 4 bytes */
+#define ND_REC_OFF_DLT		32	/* 4 bytes, link-layer header type */
+#define ND_REC_OFF_IP_VERSION	36	/* 1 byte */
+#define ND_REC_OFF_IP_PROTO	37	/* 1 byte */
+#define ND_REC_OFF_IP_TTL	38	/* 1 byte */
+#define ND_REC_OFF_IP_TOS	39	/* 1 byte */
+#define ND_REC_OFF_IP_SRC	40	/* 16 bytes; IPv4 in the first 4 */
+#define ND_REC_OFF_IP_DST	56	/* 16 bytes; IPv4 in the first 4 */
+#define ND_REC_OFF_SPORT	72	/* 2 bytes */
+#define ND_REC_OFF_DPORT	74	/* 2 bytes */
+#define ND_REC_OFF_TCP_FLAGS	76	/* 2 bytes */
+#define ND_REC_OFF_TCP_WIN	78	/* 2 bytes */
+#define ND_REC_OFF_TCP_SEQ	80	/* 4 bytes */
+#define ND_REC_OFF_TCP_ACK	84	/* 4 bytes */
+#define ND_REC_OFF_IP_LEN	88	/* 4 bytes */
+#define ND_REC_OFF_IP_ID	92	/* 4 bytes, IPv4 ID or IPv6 flow label */
+#define ND_REC_OFF_IP_OFF	96	/* 2 bytes */
+#define ND_REC_OFF_IP_HLEN	98	/* 1 byte; 99 is reserved */
+#define ND_REC_OFF_L4_LEN	100	/* 4 bytes */
+#define ND_REC_OFF_ETHER_SRC	104	/* 6 bytes */
+#define ND_REC_OFF_ETHER_DST	110	/* 6 bytes */
+#define ND_REC_OFF_ETHER_TYPE	116	/* 2 bytes */
+#define ND_REC_OFF_TCP_URP	118	/* 2 bytes */
+#define ND_REC_HDRLEN		120
+
+/*
+ * The fields for which the corresponding ND_REC_ bit isn't set are
+ * zero.  The fixed part is followed by TLVs, each with a 2-byte type,
+ * 2 reserved bytes, a 4-byte length of the value and the value, padded
+ * to a multiple of 4 bytes; the record is padded with zeroes to a
+ * multiple of 8 bytes.
+ * Readers must skip the TLVs with types they don't know, and the end
+ * of the fixed part past the fields they know, so that fields can be
+ * added.
+ */
+#define ND_REC_TLV_TEXT		1	/* the "text" of the JSON output */
+#define ND_REC_TLV_TCP_OPTS	2	/* the TCP options, as printed */
+
+#define ND_REC_TLV_HDRLEN	8
+
+#define ND_REC_ALIGN		8
+
+/*
+ * Write a record as JSON; the text and TCP options are given
+ * separately, as they aren't in the record itself.
+ */
+extern void nd_record_json(netdissect_options *, const struct nd_record *,
+    const char *, size_t, const char *, size_t);
+
+#endif /* netdissect_record_h */
@@ -338,4 +338,44 @@ typedef char *caddr_t;
 #  define ND_FALL_THROUGH
 #endif /*  __has_attribute(fallthrough) */
 
+/*
+ * Thread-local storage class, for the per-packet scratch buffers and
+ * caches that printers keep in static variables, so that several
+ * threads can each dissect packets with their own netdissect_options
+ * (see "--threads").
+ *
+ * C11 has _Thread_local; GCC, Clang, Sun C and IBM XL C
+ * have had __thread for much longer, and MSVC has __declspec(thread).
+ * If none of them is available, ND_HAVE_THREAD_LOCAL isn't defined,
+ * the variables are simply global, and only one thread may dissect
+ * packets.
+ */
+#if defined(_MSC_VER)
+#  define ND_THREAD_LOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#  define ND_THREAD_LOCAL _Thread_local
+#elif defined(__GNUC__) || defined(__clang__) || defined(__SUNPRO_C) || \
+    defined(__xlC__)
+#  define ND_THREAD_LOCAL __thread
+#endif
+
+#ifdef ND_THREAD_LOCAL
+#  define ND_HAVE_THREAD_LOCAL 1
+#else
+#  define ND_THREAD_LOCAL
+#endif
+
+/*
+ * localtime() and gmtime() return a pointer to a static structure, which
+ * another thread may overwrite; printers use these instead, with a
+ * structure of their own.
+ */
+#ifdef _WIN32
+#  define nd_localtime(t, tm)	(localtime_s((tm), (t)) == 0 ? (tm) : NULL)
+#  define nd_gmtime(t, tm)	(gmtime_s((tm), (t)) == 0 ? (tm) : NULL)
+#else
+#  define nd_localtime(t, tm)	localtime_r((t), (tm))
+#  define nd_gmtime(t, tm)	gmtime_r((t), (tm))
+#endif
+
 #endif /* netdissect_stdinc_h */
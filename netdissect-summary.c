@@ -0,0 +1,466 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Summary printer, for -q with -n.
+ *
+ * With -q and -n, most packets are printed as a short line such as
+ *
+ *	IP 10.0.0.1.1234 > 10.0.0.2.80: tcp 0
+ *
+ * For Ethernet frames, with or without 802.1Q tags and MPLS labels,
+ * carrying IPv4 or IPv6 TCP or UDP, or IPv4 ICMP echo, nd_summary_print()
+ * decodes the headers into a struct summary, then writes the line into
+ * the output buffer in one go, rather than going through the printer
+ * of each layer.  The line is the one those printers would print.
+ * For anything else - other protocols, IP options that weren't
+ * captured, fragments, truncated or invalid headers - it prints
+ * nothing and returns 0, and the printers are called as usual.
+ *
+ * The checks made here are those of the printers: a packet that they
+ * wouldn't print in full, or would print a complaint about, is left
+ * to them.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <string.h>
+
+#include "netdissect.h"
+#include "extract.h"
+#include "addrtoname.h"
+#include "ethertype.h"
+#include "ipproto.h"
+#include "ip.h"
+#include "ip6.h"
+#include "mpls.h"
+#include "tcp.h"
+#include "udp.h"
+
+/* As in print-ether.c and print-icmp.c */
+#define ETHER_HDRLEN		14
+#define ICMP_ECHOREPLY		0
+#define ICMP_ECHO		8
+
+/* More labels than this are left to mpls_print() */
+#define SUMMARY_MAX_LABELS	8
+
+/*
+ * Room for the longest line, not counting the IPv6 addresses: the
+ * labels, then the longest IPv4 ICMP line and the longest ports and
+ * UDP line.
+ */
+#define SUMMARY_LABEL_LEN	sizeof(" (label 1048575, tc 7, [S], ttl 255)")
+#define SUMMARY_MAX_LINE \
+	(sizeof("MPLS ") + SUMMARY_MAX_LABELS * SUMMARY_LABEL_LEN + \
+	 sizeof("IP6 255.255.255.255 > 255.255.255.255: ICMP echo request, " \
+		"id 65535, seq 65535, length 4294967295") + \
+	 sizeof(".65535 > .65535: UDP, bad length 4294967295 > 4294967295"))
+
+struct summary {
+	u_int ll_hdr_len;		/* link-layer header length */
+	u_int nlabels;
+	uint32_t labels[SUMMARY_MAX_LABELS];
+	u_int ip_version;		/* 4 or 6 */
+	const u_char *src;		/* addresses */
+	const u_char *dst;
+	uint8_t proto;			/* IPPROTO_TCP, _UDP or _ICMP */
+	uint16_t sport;			/* TCP and UDP */
+	uint16_t dport;
+	u_int len;			/* TCP, UDP or ICMP length, as printed */
+	u_int ulen;			/* UDP length field, minus the header */
+	uint8_t icmp_type;		/* ICMP_ECHO or ICMP_ECHOREPLY */
+	uint16_t icmp_id;
+	uint16_t icmp_seq;
+};
+
+/*
+ * Each decoder is given the length of its header and what follows, as
+ * its printer would be, and the number of those bytes that were
+ * captured and are within the lengths of the enclosing headers, as
+ * the snapshot end would allow its printer; it returns 0 if the
+ * printers must be used.
+ */
+
+/* As tcp_print() with -q */
+static int
+summary_tcp(struct summary *s, const u_char *bp, u_int length, u_int caplen)
+{
+	const struct tcphdr *tp = (const struct tcphdr *)bp;
+	u_int hlen;
+
+	if (caplen < TCP_HDRLEN)
+		return 0;
+	hlen = ((EXTRACT_U_1(tp->th_offx2) & 0xf0) >> 4) * 4;
+	if (hlen < TCP_HDRLEN || hlen > length)
+		return 0;
+	s->sport = EXTRACT_BE_U_2(tp->th_sport);
+	s->dport = EXTRACT_BE_U_2(tp->th_dport);
+	s->len = length - hlen;
+	return 1;
+}
+
+/* As udp_print() with -q, not fragmented and without -T */
+static int
+summary_udp(struct summary *s, const u_char *bp, u_int length, u_int caplen)
+{
+	const struct udphdr *up = (const struct udphdr *)bp;
+	u_int ulen;
+
+	if (caplen < UDP_HDRLEN || length < UDP_HDRLEN)
+		return 0;
+	ulen = EXTRACT_BE_U_2(up->uh_ulen);
+	if (ulen == 0 && length > 65535)
+		ulen = length;
+	if (ulen < UDP_HDRLEN)
+		return 0;
+	ulen -= UDP_HDRLEN;
+	length -= UDP_HDRLEN;
+	s->sport = EXTRACT_BE_U_2(up->uh_sport);
+	s->dport = EXTRACT_BE_U_2(up->uh_dport);
+	s->ulen = ulen;
+	s->len = ND_MIN(ulen, length);
+	return 1;
+}
+
+/* As icmp_print() without -v, for echo requests and replies only */
+static int
+summary_icmp(struct summary *s, const u_char *bp, u_int length, u_int caplen)
+{
+	uint8_t type;
+
+	if (caplen < 8)
+		return 0;
+	type = EXTRACT_U_1(bp);
+	if (type != ICMP_ECHO && type != ICMP_ECHOREPLY)
+		return 0;
+	s->icmp_type = type;
+	s->icmp_id = EXTRACT_BE_U_2(bp + 4);
+	s->icmp_seq = EXTRACT_BE_U_2(bp + 6);
+	s->len = length;
+	return 1;
+}
+
+static int
+summary_l4(struct summary *s, const u_char *bp, u_int length, u_int caplen)
+{
+	switch (s->proto) {
+
+	case IPPROTO_TCP:
+		return summary_tcp(s, bp, length, caplen);
+
+	case IPPROTO_UDP:
+		return summary_udp(s, bp, length, caplen);
+
+	case IPPROTO_ICMP:
+		if (s->ip_version == 4)
+			return summary_icmp(s, bp, length, caplen);
+		break;
+	}
+	return 0;
+}
+
+/* As ip_print() without -v, for the first fragment of unfragmented datagrams */
+static int
+summary_ip(struct summary *s, const u_char *bp, u_int length, u_int caplen)
+{
+	const struct ip *ip = (const struct ip *)bp;
+	u_int hlen, len;
+
+	if (length < IP_HDRLEN || caplen < IP_HDRLEN)
+		return 0;
+	if (((EXTRACT_U_1(ip->ip_vhl) & 0xf0) >> 4) != 4)
+		return 0;
+	hlen = (EXTRACT_U_1(ip->ip_vhl) & 0x0f) * 4;
+	len = EXTRACT_BE_U_2(ip->ip_len);
+	if (hlen < IP_HDRLEN || len > length || len < hlen)
+		return 0;
+	if ((EXTRACT_BE_U_2(ip->ip_off) & (IP_MF|IP_OFFMASK)) != 0)
+		return 0;
+	/* The snapshot end is cut to the end of the datagram. */
+	caplen = ND_MIN(caplen, len);
+	if (caplen < hlen)
+		return 0;
+	s->ip_version = 4;
+	s->proto = EXTRACT_U_1(ip->ip_p);
+	s->src = ip->ip_src;
+	s->dst = ip->ip_dst;
+	return summary_l4(s, bp + hlen, len - hlen, caplen - hlen);
+}
+
+/* As ip6_print() without -v, for TCP or UDP right after the header */
+static int
+summary_ip6(struct summary *s, const u_char *bp, u_int length, u_int caplen)
+{
+	const struct ip6_hdr *ip6 = (const struct ip6_hdr *)bp;
+	u_int payload_len;
+
+	if (length < IP6_HDRLEN || caplen < IP6_HDRLEN)
+		return 0;
+	if (((EXTRACT_U_1(ip6->ip6_vfc) & 0xf0) >> 4) != 6)
+		return 0;
+	payload_len = EXTRACT_BE_U_2(ip6->ip6_plen);
+	if (payload_len == 0 || payload_len + IP6_HDRLEN > length)
+		return 0;
+	s->proto = EXTRACT_U_1(ip6->ip6_nxt);
+	if (s->proto != IPPROTO_TCP && s->proto != IPPROTO_UDP)
+		return 0;
+	caplen = ND_MIN(caplen, payload_len + IP6_HDRLEN);
+	s->ip_version = 6;
+	s->src = ip6->ip6_src;
+	s->dst = ip6->ip6_dst;
+	return summary_l4(s, bp + IP6_HDRLEN, payload_len,
+	    caplen - IP6_HDRLEN);
+}
+
+/* As mpls_print() without -v, for IPv4 and IPv6 */
+static int
+summary_mpls(struct summary *s, const u_char *bp, u_int length, u_int caplen)
+{
+	uint32_t label_entry;
+	uint8_t first;
+
+	do {
+		if (length < 4 || caplen < 4 ||
+		    s->nlabels == SUMMARY_MAX_LABELS)
+			return 0;
+		label_entry = EXTRACT_BE_U_4(bp);
+		s->labels[s->nlabels++] = label_entry;
+		bp += 4;
+		length -= 4;
+		caplen -= 4;
+	} while (!MPLS_STACK(label_entry));
+
+	switch (MPLS_LABEL(label_entry)) {
+
+	case 0:	/* IPv4 explicit NULL label */
+	case 3:	/* IPv4 implicit NULL label */
+		return summary_ip(s, bp, length, caplen);
+
+	case 2:	/* IPv6 explicit NULL label */
+		return summary_ip6(s, bp, length, caplen);
+	}
+	if (length < 1 || caplen < 1)
+		return 0;
+	first = EXTRACT_U_1(bp);
+	if (first >= 0x45 && first <= 0x4f)
+		return summary_ip(s, bp, length, caplen);
+	if (first >= 0x60 && first <= 0x6f)
+		return summary_ip6(s, bp, length, caplen);
+	return 0;
+}
+
+/* As ether_common_print() without -e, for IPv4, IPv6 and MPLS */
+static int
+summary_ether(struct summary *s, const u_char *bp, u_int length,
+	      u_int caplen)
+{
+	uint16_t length_type;
+	u_int hdrlen;
+
+	if (caplen < ETHER_HDRLEN)
+		return 0;
+	length_type = EXTRACT_BE_U_2(bp + 2*MAC48_LEN);
+	hdrlen = ETHER_HDRLEN;
+	while (length_type == ETHERTYPE_8021Q  ||
+	       length_type == ETHERTYPE_8021Q9100 ||
+	       length_type == ETHERTYPE_8021Q9200 ||
+	       length_type == ETHERTYPE_8021QinQ) {
+		if (caplen - hdrlen < 4)
+			return 0;
+		length_type = EXTRACT_BE_U_2(bp + hdrlen + 2);
+		hdrlen += 4;
+	}
+	s->ll_hdr_len = hdrlen;
+	bp += hdrlen;
+	length -= hdrlen;
+	caplen -= hdrlen;
+
+	switch (length_type) {
+
+	case ETHERTYPE_IP:
+		return summary_ip(s, bp, length, caplen);
+
+	case ETHERTYPE_IPV6:
+		return summary_ip6(s, bp, length, caplen);
+
+	case ETHERTYPE_MPLS:
+	case ETHERTYPE_MPLS_MULTI:
+		return summary_mpls(s, bp, length, caplen);
+	}
+	return 0;
+}
+
+/*
+ * The line is written with these, at a pointer into the output
+ * buffer, which has room for all of it.
+ */
+static char *
+put_bytes(char *d, const char *s, size_t len)
+{
+	memcpy(d, s, len);
+	return d + len;
+}
+
+#define PUT_LITERAL(d, s) put_bytes((d), (s), sizeof(s) - 1)
+
+static char *
+put_uint(char *d, u_int v)
+{
+	char buf[10];		/* enough for 2^32-1 */
+	u_int n = 0;
+
+	do {
+		buf[n++] = '0' + (char)(v % 10);
+		v /= 10;
+	} while (v != 0);
+	while (n != 0)
+		*d++ = buf[--n];
+	return d;
+}
+
+/* As intoa(), which ipaddr_string() uses with -n */
+static char *
+put_ipv4(char *d, const u_char *a)
+{
+	d = put_uint(d, a[0]);
+	*d++ = '.';
+	d = put_uint(d, a[1]);
+	*d++ = '.';
+	d = put_uint(d, a[2]);
+	*d++ = '.';
+	return put_uint(d, a[3]);
+}
+
+static void
+summary_format(netdissect_options *ndo, const struct summary *s)
+{
+	const char *src6 = NULL, *dst6 = NULL;
+	size_t src6_len = 0, dst6_len = 0;
+	char *d;
+	u_int i;
+
+	if (s->ip_version == 6) {
+		src6 = ip6addr_string(ndo, s->src);
+		src6_len = strlen(src6);
+		dst6 = ip6addr_string(ndo, s->dst);
+		dst6_len = strlen(dst6);
+	}
+	nd_output_grow(ndo, SUMMARY_MAX_LINE + src6_len + dst6_len);
+	d = ndo->ndo_outbuf + ndo->ndo_outbuf_len;
+
+	if (s->nlabels != 0) {
+		d = PUT_LITERAL(d, "MPLS");
+		for (i = 0; i < s->nlabels; i++) {
+			d = PUT_LITERAL(d, " (label ");
+			d = put_uint(d, MPLS_LABEL(s->labels[i]));
+			d = PUT_LITERAL(d, ", tc ");
+			d = put_uint(d, MPLS_TC(s->labels[i]));
+			if (MPLS_STACK(s->labels[i]))
+				d = PUT_LITERAL(d, ", [S]");
+			d = PUT_LITERAL(d, ", ttl ");
+			d = put_uint(d, MPLS_TTL(s->labels[i]));
+			*d++ = ')';
+		}
+		*d++ = ' ';
+	}
+
+	if (s->ip_version == 4) {
+		d = PUT_LITERAL(d, "IP ");
+		d = put_ipv4(d, s->src);
+	} else {
+		d = PUT_LITERAL(d, "IP6 ");
+		d = put_bytes(d, src6, src6_len);
+	}
+	if (s->proto != IPPROTO_ICMP) {
+		*d++ = '.';
+		d = put_uint(d, s->sport);
+	}
+	d = PUT_LITERAL(d, " > ");
+	if (s->ip_version == 4)
+		d = put_ipv4(d, s->dst);
+	else
+		d = put_bytes(d, dst6, dst6_len);
+
+	switch (s->proto) {
+
+	case IPPROTO_TCP:
+		*d++ = '.';
+		d = put_uint(d, s->dport);
+		d = PUT_LITERAL(d, ": tcp ");
+		d = put_uint(d, s->len);
+		break;
+
+	case IPPROTO_UDP:
+		*d++ = '.';
+		d = put_uint(d, s->dport);
+		if (s->ulen > s->len) {
+			d = PUT_LITERAL(d, ": UDP, bad length ");
+			d = put_uint(d, s->ulen);
+			d = PUT_LITERAL(d, " > ");
+			d = put_uint(d, s->len);
+		} else {
+			d = PUT_LITERAL(d, ": UDP, length ");
+			d = put_uint(d, s->ulen);
+		}
+		break;
+
+	case IPPROTO_ICMP:
+		if (s->icmp_type == ICMP_ECHO)
+			d = PUT_LITERAL(d, ": ICMP echo request, id ");
+		else
+			d = PUT_LITERAL(d, ": ICMP echo reply, id ");
+		d = put_uint(d, s->icmp_id);
+		d = PUT_LITERAL(d, ", seq ");
+		d = put_uint(d, s->icmp_seq);
+		d = PUT_LITERAL(d, ", length ");
+		d = put_uint(d, s->len);
+		break;
+	}
+	ndo->ndo_outbuf_len = (size_t)(d - ndo->ndo_outbuf);
+}
+
+/*
+ * Print the packet as the printers would, if it's one that the summary
+ * printer handles, and return 1; otherwise, print nothing and return 0.
+ */
+int
+nd_summary_print(netdissect_options *ndo, const struct pcap_pkthdr *h,
+		 const u_char *sp)
+{
+	struct summary s;
+
+	/*
+	 * The line is the same with -qq.  -x, -X and -A only need the
+	 * link-layer header length.  Those fields of struct summary that
+	 * are needed are set by the decoders.
+	 */
+	if (!ndo->ndo_qflag || !ndo->ndo_nflag || ndo->ndo_eflag ||
+	    ndo->ndo_vflag || ndo->ndo_packettype != 0 ||
+	    ndo->ndo_reassemble_ip || ND_RECORDING(ndo) ||
+	    ndo->ndo_profile != NULL || ndo->ndo_no_summary ||
+	    ndo->ndo_if_printer != ether_if_print)
+		return 0;
+
+	s.nlabels = 0;
+	if (!summary_ether(&s, sp, h->len, h->caplen))
+		return 0;
+	summary_format(ndo, &s);
+	ndo->ndo_ll_hdr_len += s.ll_hdr_len;
+	return 1;
+}
@@ -26,6 +26,7 @@
 
 #include "netdissect-stdinc.h"
 #include "netdissect.h"
+#include "netdissect-alloc.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -110,13 +111,30 @@ nd_cleanup(void)
  */
 int nd_smi_module_loaded;
 
+/*
+ * In a given netdissect_options structure:
+ *
+ *    push the current packet information onto the packet information
+ *    stack;
+ *
+ *    make the new buffer, starting at new_packetp and newlen bytes
+ *    long, the current packet.
+ *
+ * new_buffer is freed with free() when the information is popped; it
+ * should be NULL if the buffer was allocated with nd_malloc(), which
+ * is preferred, as the buffer is then released with the rest of the
+ * per-packet memory.
+ *
+ * The stack entries themselves are allocated with nd_malloc(), so
+ * this must only be called while printing a packet.
+ */
 int
 nd_push_buffer(netdissect_options *ndo, u_char *new_buffer,
 	       const u_char *new_packetp, const u_int newlen)
 {
 	struct netdissect_saved_packet_info *ndspi;
 
-	ndspi = (struct netdissect_saved_packet_info *)malloc(sizeof(struct netdissect_saved_packet_info));
+	ndspi = (struct netdissect_saved_packet_info *)nd_malloc(ndo, sizeof(struct netdissect_saved_packet_info));
 	if (ndspi == NULL)
 		return (0);	/* fail */
 	ndspi->ndspi_buffer = new_buffer;
@@ -150,7 +168,7 @@ nd_push_snaplen(netdissect_options *ndo, const u_char *bp, const u_int newlen)
 	struct netdissect_saved_packet_info *ndspi;
 	u_int snaplen_remaining;
 
-	ndspi = (struct netdissect_saved_packet_info *)malloc(sizeof(struct netdissect_saved_packet_info));
+	ndspi = (struct netdissect_saved_packet_info *)nd_malloc(ndo, sizeof(struct netdissect_saved_packet_info));
 	if (ndspi == NULL)
 		return (0);	/* fail */
 	ndspi->ndspi_buffer = NULL;	/* no new buffer */
@@ -253,7 +271,7 @@ nd_pop_packet_info(netdissect_options *ndo)
 	ndo->ndo_packet_info_stack = ndspi->ndspi_prev;
 
 	free(ndspi->ndspi_buffer);
-	free(ndspi);
+	/* ndspi itself is released by nd_free_all() */
 }
 
 void
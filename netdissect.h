@@ -198,7 +198,7 @@ typedef void (*if_printer) IF_PRINTER_ARGS;
  * free.
  */
 struct netdissect_saved_packet_info {
-  u_char *ndspi_buffer;					/* pointer to allocated buffer data */
+  u_char *ndspi_buffer;					/* pointer to malloc()ed buffer data, or NULL */
   const u_char *ndspi_packetp;				/* saved beginning of data */
   const u_char *ndspi_snapend;				/* saved end of data */
   struct netdissect_saved_packet_info *ndspi_prev;	/* previous buffer on the stack */
@@ -207,6 +207,81 @@ struct netdissect_saved_packet_info {
 /* 'val' value(s) for longjmp */
 #define ND_TRUNCATED 1
 
+/*
+ * Output formats.
+ */
+#define ND_OUTPUT_TEXT	0	/* lines of text */
+#define ND_OUTPUT_JSON	1	/* one JSON object per line */
+#define ND_OUTPUT_BINARY 2	/* binary records; see netdissect-record.h */
+
+/*
+ * Fields of a packet, filled in by the printers of the most common
+ * protocols when the output format isn't text; see netdissect-record.c.
+ */
+struct nd_record {
+  uint32_t nr_present;		/* ND_REC_ bits for the fields set */
+  struct timeval nr_ts;		/* time stamp */
+  u_int nr_caplen;		/* captured length */
+  u_int nr_len;			/* on-the-network length */
+  u_int nr_packet_number;
+  int nr_dlt;			/* link-layer header type */
+  size_t nr_text_off;		/* start of the output not covered by fields */
+
+  /* ND_REC_ETHER */
+  uint8_t nr_ether_src[6];
+  uint8_t nr_ether_dst[6];
+  uint16_t nr_ether_type;
+
+  /* ND_REC_IP */
+  const u_char *nr_ip_hdr;	/* the IPv4 or IPv6 header recorded */
+  uint8_t nr_ip_version;
+  uint8_t nr_ip_proto;		/* protocol or last next header */
+  uint8_t nr_ip_ttl;		/* TTL or hop limit */
+  uint8_t nr_ip_tos;		/* TOS or traffic class */
+  uint8_t nr_ip_hlen;		/* IPv4 header length, including options */
+  uint8_t nr_ip_src[16];
+  uint8_t nr_ip_dst[16];
+  uint32_t nr_ip_len;		/* total length, including the header */
+  uint32_t nr_ip_id;		/* IPv4 ID or IPv6 flow label */
+  uint16_t nr_ip_off;		/* IPv4 flags and fragment offset */
+
+  /* ND_REC_TCP or ND_REC_UDP */
+  uint16_t nr_sport;
+  uint16_t nr_dport;
+  uint32_t nr_l4_len;		/* payload length */
+
+  /* ND_REC_TCP_HDR */
+  uint16_t nr_tcp_flags;
+  uint16_t nr_tcp_win;
+  uint16_t nr_tcp_urp;
+  /* ND_REC_TCP_SEQ, ND_REC_TCP_ACK; as printed, so maybe relative */
+  uint32_t nr_tcp_seq;
+  uint32_t nr_tcp_ack;
+  /* ND_REC_TCP_OPTS; TCP options, as printed in the output buffer */
+  size_t nr_tcp_opt_off;
+  size_t nr_tcp_opt_len;
+};
+
+#define ND_REC_ETHER	0x00000001
+#define ND_REC_IP	0x00000002
+#define ND_REC_TCP	0x00000004
+#define ND_REC_UDP	0x00000008
+#define ND_REC_TCP_HDR	0x00000010
+#define ND_REC_TCP_SEQ	0x00000020
+#define ND_REC_TCP_ACK	0x00000040
+#define ND_REC_TCP_OPTS	0x00000080
+
+/*
+ * The last time stamp seconds rendered by ts_print(), as most packets
+ * have the same seconds as the previous one.
+ */
+struct nd_ts_cache {
+  time_t tc_sec;		/* seconds rendered */
+  int tc_format;		/* how they were rendered; 0 if not yet */
+  size_t tc_len;
+  char tc_str[64];		/* the rendered seconds, not null-terminated */
+};
+
 struct netdissect_options {
   int ndo_bflag;		/* print 4 byte ASes in ASDOT notation */
   int ndo_eflag;		/* print ethernet header */
@@ -228,17 +303,37 @@ struct netdissect_options {
   int ndo_Hflag;		/* dissect 802.11s draft mesh standard */
   const char *ndo_protocol;	/* protocol */
   jmp_buf ndo_early_end;	/* jmp_buf for setjmp()/longjmp() */
-  void *ndo_last_mem_p;		/* pointer to the last allocated memory chunk */
+  /* arena for nd_malloc(), emptied after each packet */
+  struct nd_arena_slab *ndo_arena_head;	/* first slab */
+  struct nd_arena_slab *ndo_arena_cur;	/* slab being allocated from */
+  size_t ndo_arena_off;		/* offset of the free space in it */
   int ndo_packet_number;	/* print a packet number in the beginning of line */
   int ndo_lengths;		/* print packet header caplen and len */
   int ndo_print_sampling;	/* print every Nth packet */
   int ndo_suppress_default_print; /* don't use default_print() for unknown packet types */
   int ndo_tstamp_precision;	/* requested time stamp precision */
+  struct timeval ndo_tv_ref;	/* reference time stamp for -ttt and -ttttt */
+  time_t ndo_packet_time;	/* time stamp of the packet, in seconds */
+  time_t ndo_latest_time;	/* latest time stamp so far, in seconds */
+  struct nd_ts_cache ndo_ts_cache; /* for ts_print() */
+  int ndo_output_format;	/* ND_OUTPUT_ value */
+  int ndo_async_dns;		/* look up host names in the background */
+  u_int ndo_dns_negative_ttl;	/* seconds before retrying a failed lookup */
+  const struct namedb *ndo_name_db; /* --name-db database, or NULL */
+  int ndo_reassemble_ip;	/* reassemble fragmented IP datagrams */
+  int ndo_reassemble_tcp;	/* reassemble TCP streams into PDUs */
+  struct nd_profile *ndo_profile; /* --profile counters, or NULL */
+  int ndo_no_summary;		/* don't use the summary printer for -q -n */
+  int ndo_dlt;			/* link-layer header type */
+  struct nd_record ndo_record;	/* fields of the packet being printed */
   const char *program_name;	/* Name of the program using the library */
 
   char *ndo_espsecret;
   struct sa_list *ndo_sa_list_head;  /* used by print-esp.c */
   struct sa_list *ndo_sa_default;
+  struct sa_list **ndo_sa_hash;	/* SAs by SPI and destination address */
+  u_int ndo_sa_hash_size;	/* number of buckets, a power of 2 */
+  u_int ndo_sa_hash_count;	/* number of SAs in ndo_sa_hash */
 
   char *ndo_sigsecret;		/* Signature verification secret key */
 
@@ -274,6 +369,13 @@ struct netdissect_options {
   void (*ndo_warning)(netdissect_options *,
 		      const char *fmt, ...)
 		      PRINTFLIKE_FUNCPTR(2, 3);
+
+  /* buffered output of the packet being printed */
+  char *ndo_outbuf;
+  size_t ndo_outbuf_len;	/* bytes of output in the buffer */
+  size_t ndo_outbuf_size;	/* size of the buffer */
+  /* pointer to function to consume, and empty, the output buffer */
+  void (*ndo_output_sink)(netdissect_options *);
 };
 
 extern WARN_UNUSED_RESULT int nd_push_buffer(netdissect_options *, u_char *, const u_char *, const u_int);
@@ -287,6 +389,50 @@ extern void nd_pop_all_packet_info(netdissect_options *);
  */
 NORETURN void nd_trunc_longjmp(netdissect_options *ndo);
 
+/*
+ * Counters of the work done by each printer ("--profile"), in
+ * netdissect-profile.c.  A demultiplexer brackets the call of the
+ * printer it has found with ND_PROFILE_ENTER() and ND_PROFILE_LEAVE(),
+ * so the time spent in it is charged to that printer, and that spent
+ * in the demultiplexer to its caller.
+ */
+struct nd_profile_frame {
+  void *parent;			/* printer charged before the call */
+};
+
+struct nd_profile_row {
+  const char *protocol;
+  uint64_t packets;
+  uint64_t bytes;		/* lengths given to the printer */
+  uint64_t ticks;		/* time, in nd_profile_unit() */
+  uint64_t truncated;
+  uint64_t invalid;
+};
+
+#define ND_PROFILE_TRUNCATED	0
+#define ND_PROFILE_INVALID	1
+
+extern struct nd_profile *nd_profile_new(netdissect_options *);
+extern void nd_profile_reset(struct nd_profile *);
+extern const char *nd_profile_unit(void);
+extern void nd_profile_packet_begin(netdissect_options *, u_int);
+extern void nd_profile_packet_end(netdissect_options *);
+extern void nd_profile_enter(netdissect_options *, struct nd_profile_frame *, u_int);
+extern void nd_profile_leave(netdissect_options *, const struct nd_profile_frame *);
+extern void nd_profile_count(netdissect_options *, int);
+extern u_int nd_profile_collect(struct nd_profile_row *, u_int);
+
+#define ND_PROFILE_ENTER(ndo, f, len) \
+	do { \
+		if ((ndo)->ndo_profile != NULL) \
+			nd_profile_enter((ndo), (f), (len)); \
+	} while (0)
+#define ND_PROFILE_LEAVE(ndo, f) \
+	do { \
+		if ((ndo)->ndo_profile != NULL) \
+			nd_profile_leave((ndo), (f)); \
+	} while (0)
+
 #define PT_VAT		1	/* Visual Audio Tool */
 #define PT_WB		2	/* distributed White Board */
 #define PT_RPC		3	/* Remote Procedure Call */
@@ -455,6 +601,46 @@ ND_ICHECKMSG_ZU((#expression_1), (expression_1), operator, (expression_2))
 #define ND_PRINT(...) (ndo->ndo_printf)(ndo, __VA_ARGS__)
 #define ND_DEFAULTPRINT(ap, length) (*ndo->ndo_default_print)(ndo, ap, length)
 
+/*
+ * Output buffer routines; the nd_out_*() routines append to the
+ * output buffer without going through a format string.
+ */
+extern void nd_output_grow(netdissect_options *, size_t);
+extern int nd_output_vprintf(netdissect_options *, const char *, va_list)
+    PRINTFLIKE(2, 0);
+extern void nd_output_flush(netdissect_options *);
+extern void nd_out_bytes(netdissect_options *, const char *, size_t);
+extern void nd_out_str(netdissect_options *, const char *);
+extern void nd_out_char(netdissect_options *, int);
+extern void nd_out_uint(netdissect_options *, uint64_t, u_int);
+extern void nd_out_hex(netdissect_options *, uint64_t, u_int);
+
+/*
+ * Printing of the most common packets with -q and -n in one go; see
+ * netdissect-summary.c.
+ */
+extern int nd_summary_print(netdissect_options *,
+    const struct pcap_pkthdr *, const u_char *);
+
+/*
+ * Non-zero if the printers should record the fields of the packet.
+ */
+#define ND_RECORDING(ndo) ((ndo)->ndo_output_format != ND_OUTPUT_TEXT)
+
+/*
+ * Routines to record the fields of a packet; see netdissect-record.c.
+ */
+extern void nd_record_begin(netdissect_options *, const struct pcap_pkthdr *,
+    u_int);
+extern void nd_record_text_start(netdissect_options *);
+extern void nd_record_end(netdissect_options *);
+extern void nd_record_file_header(netdissect_options *);
+extern int nd_record_ether(netdissect_options *, const u_char *,
+    const u_char *, uint16_t);
+extern int nd_record_ip(netdissect_options *, const u_char *);
+extern int nd_record_l4(netdissect_options *, uint32_t, const u_char *,
+    uint16_t, uint16_t);
+
 extern void ts_print(netdissect_options *, const struct timeval *);
 extern void signed_relts_print(netdissect_options *, int32_t);
 extern void unsigned_relts_print(netdissect_options *, uint32_t);
@@ -669,6 +855,7 @@ extern void forces_print(netdissect_options *, const u_char *, u_int);
 extern const u_char *fqdn_print(netdissect_options *, const u_char *, const u_char *);
 extern u_int fr_print(netdissect_options *, const u_char *, u_int);
 extern int frag6_print(netdissect_options *, const u_char *, const u_char *);
+extern void frag6_reassemble(netdissect_options *, const u_char *, const u_char *, const u_char *);
 extern void ftp_print(netdissect_options *, const u_char *, u_int);
 extern void geneve_print(netdissect_options *, const u_char *, u_int);
 extern void geonet_print(netdissect_options *, const u_char *, u_int, const struct lladdr_info *);
@@ -768,6 +955,9 @@ extern void someip_print(netdissect_options *, const u_char *, const u_int);
 extern void ssh_print(netdissect_options *, const u_char *, u_int);
 extern void stp_print(netdissect_options *, const u_char *, u_int);
 extern void sunrpc_print(netdissect_options *, const u_char *, u_int, const u_char *);
+extern void sunrpc_reply_print(netdissect_options *, const u_char *, u_int, uint32_t, uint32_t, uint32_t);
+extern int sunrpc_call_enter(netdissect_options *, const u_char *, const u_char *);
+extern int sunrpc_call_find(netdissect_options *, const u_char *, const u_char *, uint32_t *, uint32_t *, uint32_t *);
 extern void syslog_print(netdissect_options *, const u_char *, u_int);
 extern void tcp_print(netdissect_options *, const u_char *, u_int, const u_char *, int);
 extern void telnet_print(netdissect_options *, const u_char *, u_int);
@@ -56,6 +56,7 @@ p_ntp_time_fmt(netdissect_options *ndo, const char *fmt,
 	if (i) {
 	    int64_t seconds_64bit;
 	    time_t seconds;
+	    struct tm tm;
 	    char time_buf[128];
 	    const char *time_string;
 
@@ -72,7 +73,7 @@ p_ntp_time_fmt(netdissect_options *ndo, const char *fmt,
 		time_string = "[timestamp overflow]";
 	    } else {
 		time_string = nd_format_time(time_buf, sizeof (time_buf),
-					     fmt, gmtime(&seconds));
+					     fmt, nd_gmtime(&seconds, &tm));
 	    }
 	    ND_PRINT(" (%s)", time_string);
 	}
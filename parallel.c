@@ -0,0 +1,959 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "netdissect.h"
+#include "netdissect-alloc.h"
+#include "extract.h"
+#include "ethertype.h"
+#include "ipproto.h"
+#include "ppp.h"
+#include "print.h"
+#include "timeval-operations.h"
+#include "parallel.h"
+
+#ifdef PARALLEL_THREADS
+
+#include <pthread.h>
+#ifdef HAVE_WRITEV
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Number of packets that can be in flight per worker thread; the
+ * reader blocks once that many packets are waiting to be dissected
+ * or written.
+ */
+#define SLOTS_PER_THREAD	256
+
+/* Maximum number of packets' output written with one writev(). */
+#define WRITE_BATCH		64
+
+enum slot_state {
+	SLOT_FREE,	/* available to the reader */
+	SLOT_QUEUED,	/* waiting for, or being dissected by, a worker */
+	SLOT_DONE	/* dissected, waiting to be written */
+};
+
+/*
+ * A packet in flight, and the output generated for it.
+ */
+struct slot {
+	enum slot_state state;
+	struct pcap_pkthdr hdr;
+	u_char *data;
+	u_int data_size;
+	u_int packet_number;
+	struct timeval tv_ref;		/* reference for -ttt and -ttttt */
+	time_t latest_time;		/* latest time stamp read so far */
+	char *out;
+	size_t out_len;
+	size_t out_size;
+};
+
+/*
+ * A worker thread.
+ */
+struct worker {
+	netdissect_options ndo;
+	char *espsecret;		/* this worker's copy of -E */
+	u_int *queue;			/* indices of queued slots */
+	u_int queue_head;
+	u_int queue_len;
+	pthread_t thread;
+	pthread_cond_t cond;
+};
+
+static netdissect_options *main_ndo;
+static int linktype;
+static uint32_t init_localnet, init_netmask;
+
+static struct slot *slots;
+static u_int nslots;
+static struct worker *workers;
+static u_int nworkers;
+
+static uint64_t next_seq;	/* sequence number of the next packet read */
+static uint64_t write_seq;	/* sequence number of the next packet written */
+static int stopping;
+
+/* Time stamp references for -ttt and -ttttt, in reading order. */
+static struct timeval tv_prev, tv_first;
+
+/* Latest time stamp read, against which the workers expire state. */
+static time_t latest_time;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t init_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * ndo_output_sink routine for the workers: leave the output in the
+ * buffer, which worker_main() hands over to the packet's slot.
+ */
+static void
+parallel_output_sink(netdissect_options *ndo _U_)
+{
+}
+
+static void *
+worker_main(void *arg)
+{
+	struct worker *w = arg;
+	struct slot *s;
+	u_int idx;
+
+	/*
+	 * The address-to-name tables are per-thread, so initialize
+	 * them in this thread; the routines that fill them in from
+	 * system databases aren't reentrant, so one at a time.
+	 */
+	pthread_mutex_lock(&init_lock);
+	init_print(&w->ndo, init_localnet, init_netmask);
+	pthread_mutex_unlock(&init_lock);
+
+	pthread_mutex_lock(&lock);
+	for (;;) {
+		while (w->queue_len == 0 && !stopping)
+			pthread_cond_wait(&w->cond, &lock);
+		if (w->queue_len == 0)
+			break;
+		idx = w->queue[w->queue_head];
+		w->queue_head = (w->queue_head + 1) % nslots;
+		w->queue_len--;
+		pthread_mutex_unlock(&lock);
+
+		/*
+		 * Print into the slot's output buffer, so that it
+		 * doesn't have to be copied.
+		 */
+		s = &slots[idx];
+		w->ndo.ndo_outbuf = s->out;
+		w->ndo.ndo_outbuf_len = 0;
+		w->ndo.ndo_outbuf_size = s->out_size;
+		w->ndo.ndo_tv_ref = s->tv_ref;
+		w->ndo.ndo_latest_time = s->latest_time;
+		pretty_print_packet(&w->ndo, &s->hdr, s->data,
+		    s->packet_number);
+		s->out = w->ndo.ndo_outbuf;
+		s->out_len = w->ndo.ndo_outbuf_len;
+		s->out_size = w->ndo.ndo_outbuf_size;
+
+		pthread_mutex_lock(&lock);
+		s->state = SLOT_DONE;
+		if (idx == write_seq % nslots)
+			pthread_cond_signal(&done_cond);
+	}
+	pthread_mutex_unlock(&lock);
+	return (NULL);
+}
+
+static void
+write_error(void)
+{
+	(*main_ndo->ndo_error)(main_ndo, S_ERR_ND_WRITE_FILE,
+	    "Unable to write output: %s", strerror(errno));
+}
+
+/*
+ * Write the output of the packets with sequence numbers from start up
+ * to, but not including, end, in batches of up to WRITE_BATCH packets
+ * per system call.
+ */
+static void
+write_slots(uint64_t start, uint64_t end)
+{
+#ifdef HAVE_WRITEV
+	struct iovec iov[WRITE_BATCH];
+	struct iovec *iovp;
+	int iovcnt;
+	ssize_t n;
+	struct slot *s;
+
+	/* Anything written with stdio has to go out first. */
+	if (fflush(stdout) == EOF)
+		write_error();
+	while (start < end) {
+		iovcnt = 0;
+		for (; start < end && iovcnt < WRITE_BATCH; start++) {
+			s = &slots[start % nslots];
+			if (s->out_len == 0)
+				continue;
+			iov[iovcnt].iov_base = s->out;
+			iov[iovcnt].iov_len = s->out_len;
+			iovcnt++;
+		}
+		iovp = iov;
+		while (iovcnt != 0) {
+			n = writev(STDOUT_FILENO, iovp, iovcnt);
+			if (n == -1) {
+				if (errno == EINTR)
+					continue;
+				write_error();
+			}
+			/* Skip what was written. */
+			while (iovcnt != 0 && (size_t)n >= iovp->iov_len) {
+				n -= iovp->iov_len;
+				iovp++;
+				iovcnt--;
+			}
+			if (iovcnt != 0) {
+				iovp->iov_base = (char *)iovp->iov_base + n;
+				iovp->iov_len -= n;
+			}
+		}
+	}
+#else
+	struct slot *s;
+
+	for (; start < end; start++) {
+		s = &slots[start % nslots];
+		if (s->out_len != 0 &&
+		    fwrite(s->out, 1, s->out_len, stdout) != s->out_len)
+			write_error();
+	}
+#endif
+}
+
+/*
+ * Write, in order, the output of the packets that have been dissected.
+ * If wait_seq is past write_seq, wait until everything before it has
+ * been written.
+ *
+ * Called with the lock held.
+ */
+static void
+write_done(uint64_t wait_seq)
+{
+	uint64_t seq, end;
+
+	for (;;) {
+		end = write_seq;
+		while (end < next_seq && slots[end % nslots].state == SLOT_DONE)
+			end++;
+		if (end == write_seq) {
+			if (write_seq >= wait_seq)
+				return;
+			pthread_cond_wait(&done_cond, &lock);
+			continue;
+		}
+
+		/*
+		 * Only this thread touches slots in the SLOT_DONE state,
+		 * so they can be written without holding the lock.
+		 */
+		pthread_mutex_unlock(&lock);
+		write_slots(write_seq, end);
+		pthread_mutex_lock(&lock);
+		for (seq = write_seq; seq < end; seq++)
+			slots[seq % nslots].state = SLOT_FREE;
+		write_seq = end;
+	}
+}
+
+/*
+ * Flow-affine dispatch.
+ *
+ * Printers such as the TCP, NFS and Rx ones keep state about a
+ * conversation from earlier packets, so all the packets of a
+ * conversation, in both directions, have to be dissected by the same
+ * thread, in order.  We compute a symmetric hash of the protocol,
+ * addresses and ports from the IPv4 or IPv6 header, found without
+ * full dissection, and pick the thread from that.
+ *
+ * ICMP and ICMPv6 errors are hashed by the packet they quote, and
+ * tunneled packets (IP-in-IP, GRE, VXLAN, VXLAN-GPE and Geneve) by the
+ * packet they carry, as that's the conversation whose state their
+ * printers use.  Fragments other than the first one have no ports,
+ * and nothing past their IP header is dissected, so they're hashed
+ * without ports; with --reassemble-ip, so is the first one, so that
+ * all the fragments of a datagram are reassembled by the same thread.
+ *
+ * Packets for which we can't find an IP header go to the first
+ * thread, so they're all dissected in order with respect to each
+ * other.
+ */
+#define FNV_OFFSET_BASIS	2166136261U
+#define FNV_PRIME		16777619U
+
+/* Maximum number of encapsulations and quotations to look through. */
+#define FLOW_MAX_DEPTH		4
+
+#define HTTPS_PORT		443
+#define ISAKMP_PORT		500
+#define NFS_PORT		2049
+#define ISAKMP_PORT_NATT	4500
+#define VXLAN_PORT		4789
+#define VXLAN_GPE_PORT		4790
+#define GENEVE_PORT		6081
+#define RX_PORT_LOW		7000
+#define RX_PORT_HIGH		7009
+#define ISAKMP_PORT_USER1	7500
+#define ISAKMP_PORT_USER2	8500
+
+#define ETHERTYPE_TEB		0x6558	/* transparent Ethernet bridging */
+
+#define IS_PORT(p)	(sport == (p) || dport == (p))
+
+static uint32_t flow_hash_ip(const u_char *, u_int, u_int);
+static uint32_t flow_hash_ether(const u_char *, u_int, u_int);
+
+static uint32_t
+fnv1a(uint32_t h, const u_char *p, u_int len)
+{
+	while (len != 0) {
+		h ^= *p++;
+		h *= FNV_PRIME;
+		len--;
+	}
+	return h;
+}
+
+/*
+ * Some printers keep state that isn't per-conversation: the NFS XID
+ * map, the Rx call cache, the ISAKMP cookie cache and the QUIC
+ * connection ID list are shared by all the conversations of their
+ * protocol, and what a lookup finds can depend on the packets of the
+ * other conversations.  Return a non-zero class for packets of those
+ * protocols, which are all dissected by the same thread.
+ */
+static uint8_t
+shared_state_class(uint8_t proto, u_int sport, u_int dport)
+{
+	if (IS_PORT(NFS_PORT))
+		return 1;
+	if (proto != IPPROTO_UDP)
+		return 0;
+	/* -T can make any UDP port QUIC, or anything else. */
+	if (main_ndo->ndo_packettype != 0)
+		return 2;
+	if ((sport >= RX_PORT_LOW && sport <= RX_PORT_HIGH) ||
+	    (dport >= RX_PORT_LOW && dport <= RX_PORT_HIGH))
+		return 3;
+	if (IS_PORT(ISAKMP_PORT) || IS_PORT(ISAKMP_PORT_NATT) ||
+	    IS_PORT(ISAKMP_PORT_USER1) || IS_PORT(ISAKMP_PORT_USER2))
+		return 4;
+	if (IS_PORT(HTTPS_PORT))
+		return 5;
+	return 0;
+}
+
+static uint32_t
+flow_hash(uint8_t proto, const u_char *src, const u_char *dst,
+    u_int addr_len, const u_char *sport, const u_char *dport)
+{
+	static const u_char noport[2];
+	const u_char *tmp;
+	uint32_t h;
+	uint8_t class;
+	int cmp;
+
+	if (sport == NULL)
+		sport = dport = noport;
+	else {
+		class = shared_state_class(proto, EXTRACT_BE_U_2(sport),
+		    EXTRACT_BE_U_2(dport));
+		if (class != 0)
+			return fnv1a(FNV_OFFSET_BASIS, &class, 1);
+	}
+
+	/* Put the endpoints in a canonical order. */
+	cmp = memcmp(src, dst, addr_len);
+	if (cmp > 0 || (cmp == 0 && memcmp(sport, dport, 2) > 0)) {
+		tmp = src;
+		src = dst;
+		dst = tmp;
+		tmp = sport;
+		sport = dport;
+		dport = tmp;
+	}
+	h = fnv1a(FNV_OFFSET_BASIS, &proto, 1);
+	h = fnv1a(h, src, addr_len);
+	h = fnv1a(h, sport, 2);
+	h = fnv1a(h, dst, addr_len);
+	h = fnv1a(h, dport, 2);
+	/* Don't return 0, which means "no flow". */
+	return h != 0 ? h : 1;
+}
+
+static uint32_t
+flow_hash_ethertype(u_int type, const u_char *p, u_int len, u_int depth)
+{
+	switch (type) {
+
+	case ETHERTYPE_IP:
+	case ETHERTYPE_IPV6:
+		return flow_hash_ip(p, len, depth);
+
+	case ETHERTYPE_TEB:
+		return flow_hash_ether(p, len, depth);
+
+	case ETHERTYPE_MPLS:
+	case ETHERTYPE_MPLS_MULTI:
+		/* Skip to the bottom of the label stack. */
+		while (len >= 4) {
+			p += 4;
+			len -= 4;
+			if (EXTRACT_U_1(p - 2) & 0x01)
+				return flow_hash_ip(p, len, depth);
+		}
+		break;
+
+	case ETHERTYPE_PPPOES:
+		if (len < 8)
+			break;
+		switch (EXTRACT_BE_U_2(p + 6)) {
+
+		case PPP_IP:
+		case PPP_IPV6:
+			return flow_hash_ip(p + 8, len - 8, depth);
+		}
+		break;
+	}
+	return 0;
+}
+
+static uint32_t
+flow_hash_ether(const u_char *p, u_int len, u_int depth)
+{
+	u_int type, i;
+
+	if (len < 14)
+		return 0;
+	type = EXTRACT_BE_U_2(p + 12);
+	p += 14;
+	len -= 14;
+	/* Skip VLAN tags. */
+	for (i = 0; i < 4; i++) {
+		if (type != ETHERTYPE_8021Q && type != ETHERTYPE_8021QinQ &&
+		    type != ETHERTYPE_8021Q9100 && type != ETHERTYPE_8021Q9200)
+			break;
+		if (len < 4)
+			return 0;
+		type = EXTRACT_BE_U_2(p + 2);
+		p += 4;
+		len -= 4;
+	}
+	return flow_hash_ethertype(type, p, len, depth);
+}
+
+/*
+ * Hash of the packet carried by a GRE packet, or 0.
+ */
+static uint32_t
+flow_hash_gre(const u_char *p, u_int len, u_int depth)
+{
+	u_int flags, hlen;
+
+	if (len < 4)
+		return 0;
+	flags = EXTRACT_BE_U_2(p);
+	if ((flags & 0x0007) != 0)	/* only version 0 */
+		return 0;
+	hlen = 4;
+	if (flags & 0x8000)		/* checksum present */
+		hlen += 4;
+	if (flags & 0x2000)		/* key present */
+		hlen += 4;
+	if (flags & 0x1000)		/* sequence number present */
+		hlen += 4;
+	if (hlen > len)
+		return 0;
+	return flow_hash_ethertype(EXTRACT_BE_U_2(p + 2), p + hlen,
+	    len - hlen, depth);
+}
+
+/*
+ * Hash of the packet carried by a UDP tunnel packet, or 0.
+ */
+static uint32_t
+flow_hash_udp_tunnel(const u_char *p, u_int len, u_int depth)
+{
+	u_int sport, dport, hlen;
+
+	if (len < 16)
+		return 0;
+	sport = EXTRACT_BE_U_2(p);
+	dport = EXTRACT_BE_U_2(p + 2);
+	p += 8;
+	len -= 8;
+	if (IS_PORT(VXLAN_PORT))
+		return flow_hash_ether(p + 8, len - 8, depth);
+	if (IS_PORT(VXLAN_GPE_PORT)) {
+		switch (EXTRACT_U_1(p + 3)) {
+
+		case 1:
+		case 2:
+			return flow_hash_ip(p + 8, len - 8, depth);
+
+		case 3:
+			return flow_hash_ether(p + 8, len - 8, depth);
+		}
+		return 0;
+	}
+	if (IS_PORT(GENEVE_PORT)) {
+		hlen = 8 + (EXTRACT_U_1(p) & 0x3f) * 4;
+		if (hlen > len)
+			return 0;
+		return flow_hash_ethertype(EXTRACT_BE_U_2(p + 2), p + hlen,
+		    len - hlen, depth);
+	}
+	return 0;
+}
+
+static uint32_t
+flow_hash_ipv4(const u_char *p, u_int len, u_int depth)
+{
+	const u_char *src = p + 12, *dst = p + 16;
+	u_int hlen;
+	uint8_t proto, type;
+	uint32_t h = 0;
+
+	if (len < 20)
+		return 0;
+	hlen = (EXTRACT_U_1(p) & 0x0f) * 4;
+	if (hlen < 20 || hlen > len)
+		return 0;
+	proto = EXTRACT_U_1(p + 9);
+	/* Not the first fragment, or a fragment to reassemble? */
+	if ((EXTRACT_BE_U_2(p + 6) &
+	    (main_ndo->ndo_reassemble_ip ? 0x3fff : 0x1fff)) != 0)
+		return flow_hash(proto, src, dst, 4, NULL, NULL);
+	p += hlen;
+	len -= hlen;
+
+	switch (proto) {
+
+	case IPPROTO_TCP:
+	case IPPROTO_SCTP:
+	case IPPROTO_DCCP:
+		if (len >= 4)
+			return flow_hash(proto, src, dst, 4, p, p + 2);
+		break;
+
+	case IPPROTO_UDP:
+		if (depth < FLOW_MAX_DEPTH)
+			h = flow_hash_udp_tunnel(p, len, depth + 1);
+		if (h == 0 && len >= 4)
+			h = flow_hash(proto, src, dst, 4, p, p + 2);
+		break;
+
+	case IPPROTO_ICMP:
+		if (len < 8 || depth >= FLOW_MAX_DEPTH)
+			break;
+		type = EXTRACT_U_1(p);
+		/* Unreachable, source quench, redirect, time exceeded,
+		   parameter problem */
+		if (type == 3 || type == 4 || type == 5 || type == 11 ||
+		    type == 12)
+			h = flow_hash_ip(p + 8, len - 8, depth + 1);
+		break;
+
+	case IPPROTO_IPV4:
+	case IPPROTO_IPV6:
+		if (depth < FLOW_MAX_DEPTH)
+			h = flow_hash_ip(p, len, depth + 1);
+		break;
+
+	case IPPROTO_GRE:
+		if (depth < FLOW_MAX_DEPTH)
+			h = flow_hash_gre(p, len, depth + 1);
+		break;
+	}
+	if (h != 0)
+		return h;
+	return flow_hash(proto, src, dst, 4, NULL, NULL);
+}
+
+static uint32_t
+flow_hash_ipv6(const u_char *p, u_int len, u_int depth)
+{
+	const u_char *src = p + 8, *dst = p + 24;
+	uint8_t nh, type;
+	u_int off, hlen, i;
+	uint32_t h = 0;
+
+	if (len < 40)
+		return 0;
+	nh = EXTRACT_U_1(p + 6);
+	off = 40;
+
+	/* Skip extension headers, up to a sane limit. */
+	for (i = 0; i < 8; i++) {
+		if (nh != IPPROTO_HOPOPTS && nh != IPPROTO_ROUTING &&
+		    nh != IPPROTO_DSTOPTS && nh != IPPROTO_AH &&
+		    nh != IPPROTO_FRAGMENT)
+			break;
+		if (off + 8 > len)
+			return flow_hash(nh, src, dst, 16, NULL, NULL);
+		if (nh == IPPROTO_FRAGMENT) {
+			/* Not the first fragment, or one to reassemble? */
+			if ((EXTRACT_BE_U_2(p + off + 2) & 0xfff8) != 0 ||
+			    main_ndo->ndo_reassemble_ip)
+				return flow_hash(EXTRACT_U_1(p + off), src,
+				    dst, 16, NULL, NULL);
+			hlen = 8;
+		} else if (nh == IPPROTO_AH)
+			hlen = (EXTRACT_U_1(p + off + 1) + 2) * 4;
+		else
+			hlen = (EXTRACT_U_1(p + off + 1) + 1) * 8;
+		nh = EXTRACT_U_1(p + off);
+		off += hlen;
+	}
+	if (off > len)
+		return flow_hash(nh, src, dst, 16, NULL, NULL);
+	p += off;
+	len -= off;
+
+	switch (nh) {
+
+	case IPPROTO_TCP:
+	case IPPROTO_SCTP:
+	case IPPROTO_DCCP:
+		if (len >= 4)
+			return flow_hash(nh, src, dst, 16, p, p + 2);
+		break;
+
+	case IPPROTO_UDP:
+		if (depth < FLOW_MAX_DEPTH)
+			h = flow_hash_udp_tunnel(p, len, depth + 1);
+		if (h == 0 && len >= 4)
+			h = flow_hash(nh, src, dst, 16, p, p + 2);
+		break;
+
+	case IPPROTO_ICMPV6:
+		if (len < 8 || depth >= FLOW_MAX_DEPTH)
+			break;
+		type = EXTRACT_U_1(p);
+		/* Destination unreachable, packet too big, time exceeded,
+		   parameter problem */
+		if (type >= 1 && type <= 4)
+			h = flow_hash_ip(p + 8, len - 8, depth + 1);
+		break;
+
+	case IPPROTO_IPV4:
+	case IPPROTO_IPV6:
+		if (depth < FLOW_MAX_DEPTH)
+			h = flow_hash_ip(p, len, depth + 1);
+		break;
+
+	case IPPROTO_GRE:
+		if (depth < FLOW_MAX_DEPTH)
+			h = flow_hash_gre(p, len, depth + 1);
+		break;
+	}
+	if (h != 0)
+		return h;
+	return flow_hash(nh, src, dst, 16, NULL, NULL);
+}
+
+static uint32_t
+flow_hash_ip(const u_char *p, u_int len, u_int depth)
+{
+	if (len < 1)
+		return 0;
+	switch (EXTRACT_U_1(p) >> 4) {
+
+	case 4:
+		return flow_hash_ipv4(p, len, depth);
+
+	case 6:
+		return flow_hash_ipv6(p, len, depth);
+	}
+	return 0;
+}
+
+/*
+ * Return the flow hash of a packet, or 0 if it has none.
+ */
+static uint32_t
+flow_hash_packet(const struct pcap_pkthdr *h, const u_char *p)
+{
+	u_int len = h->caplen;
+
+	switch (linktype) {
+
+	case DLT_EN10MB:
+		return flow_hash_ether(p, len, 0);
+
+	case DLT_RAW:
+#ifdef DLT_IPV4
+	case DLT_IPV4:
+#endif
+#ifdef DLT_IPV6
+	case DLT_IPV6:
+#endif
+		return flow_hash_ip(p, len, 0);
+
+	case DLT_NULL:
+#ifdef DLT_LOOP
+	case DLT_LOOP:
+#endif
+		/*
+		 * The address family values for IPv6 differ between
+		 * OSes, so look at the IP version instead.
+		 */
+		if (len < 4)
+			return 0;
+		return flow_hash_ip(p + 4, len - 4, 0);
+
+#ifdef DLT_LINUX_SLL
+	case DLT_LINUX_SLL:
+		if (len < 16)
+			return 0;
+		return flow_hash_ethertype(EXTRACT_BE_U_2(p + 14), p + 16,
+		    len - 16, 0);
+#endif
+
+#ifdef DLT_LINUX_SLL2
+	case DLT_LINUX_SLL2:
+		if (len < 20)
+			return 0;
+		return flow_hash_ethertype(EXTRACT_BE_U_2(p), p + 20,
+		    len - 20, 0);
+#endif
+	}
+	return 0;
+}
+
+/*
+ * Return 1 if pretty_print_packet() will print a time stamp for this
+ * packet, i.e. if it will update the -ttt/-ttttt reference.
+ */
+static int
+prints_time_stamp(const struct pcap_pkthdr *h)
+{
+	if (h->caplen == 0 || h->len == 0 || h->len < h->caplen)
+		return 0;
+	if (h->caplen > MAXIMUM_SNAPLEN || h->len > MAXIMUM_SNAPLEN)
+		return 0;
+	return 1;
+}
+
+/*
+ * Start nthreads worker threads, dissecting packets of the given
+ * link-layer header type with copies of the given netdissect_options.
+ */
+void
+parallel_start(netdissect_options *ndo, u_int nthreads, int dlt,
+    uint32_t localnet, uint32_t netmask)
+{
+	struct worker *w;
+	u_int i;
+	int err;
+
+	main_ndo = ndo;
+	linktype = dlt;
+	init_localnet = localnet;
+	init_netmask = netmask;
+
+	nslots = nthreads * SLOTS_PER_THREAD;
+	slots = calloc(nslots, sizeof(*slots));
+	if (slots == NULL)
+		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: calloc", __func__);
+
+	nworkers = nthreads;
+	workers = calloc(nworkers, sizeof(*workers));
+	if (workers == NULL)
+		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: calloc", __func__);
+	for (i = 0; i < nworkers; i++) {
+		w = &workers[i];
+		w->ndo = *ndo;
+		w->ndo.ndo_outbuf = NULL;
+		w->ndo.ndo_outbuf_len = 0;
+		w->ndo.ndo_outbuf_size = 0;
+		w->ndo.ndo_output_sink = parallel_output_sink;
+		w->ndo.ndo_arena_head = NULL;
+		w->ndo.ndo_arena_cur = NULL;
+		w->ndo.ndo_arena_off = 0;
+		if (ndo->ndo_profile != NULL)
+			w->ndo.ndo_profile = nd_profile_new(ndo);
+		/*
+		 * The ESP secrets are parsed in place, on first use, by
+		 * each worker.
+		 */
+		if (ndo->ndo_espsecret != NULL) {
+			w->espsecret = strdup(ndo->ndo_espsecret);
+			if (w->espsecret == NULL)
+				(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+				    "%s: strdup", __func__);
+			w->ndo.ndo_espsecret = w->espsecret;
+		}
+		w->queue = calloc(nslots, sizeof(*w->queue));
+		if (w->queue == NULL)
+			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+			    "%s: calloc", __func__);
+		pthread_cond_init(&w->cond, NULL);
+		err = pthread_create(&w->thread, NULL, worker_main, w);
+		if (err != 0)
+			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+			    "%s: pthread_create: %s", __func__, strerror(err));
+	}
+}
+
+/*
+ * Queue a packet for dissection.
+ */
+void
+parallel_packet(const struct pcap_pkthdr *h, const u_char *sp,
+    u_int packets_captured)
+{
+	struct slot *s;
+	struct worker *w;
+	u_char *data;
+	u_int idx;
+
+	if (main_ndo->ndo_print_sampling &&
+	    packets_captured % main_ndo->ndo_print_sampling != 0)
+		return;
+
+	idx = (u_int)(next_seq % nslots);
+	s = &slots[idx];
+	pthread_mutex_lock(&lock);
+	if (s->state != SLOT_FREE)
+		write_done(next_seq - nslots + 1);
+	pthread_mutex_unlock(&lock);
+
+	if (h->caplen > s->data_size) {
+		data = realloc(s->data, h->caplen);
+		if (data == NULL)
+			(*main_ndo->ndo_error)(main_ndo, S_ERR_ND_MEM_ALLOC,
+			    "%s: realloc", __func__);
+		s->data = data;
+		s->data_size = h->caplen;
+	}
+	s->hdr = *h;
+	if (h->caplen != 0)
+		memcpy(s->data, sp, h->caplen);
+	s->packet_number = packets_captured;
+
+	/*
+	 * ts_print() computes -ttt and -ttttt time stamps relative to
+	 * the previous or first packet it printed; the workers see
+	 * only some of the packets, so keep track of that here.
+	 */
+	switch (main_ndo->ndo_tflag) {
+
+	case 3:
+		s->tv_ref = tv_prev;
+		if (prints_time_stamp(h)) {
+			tv_prev.tv_sec = h->ts.tv_sec;
+			tv_prev.tv_usec = h->ts.tv_usec;
+		}
+		break;
+
+	case 5:
+		if (!netdissect_timevalisset(&tv_first) &&
+		    prints_time_stamp(h)) {
+			tv_first.tv_sec = h->ts.tv_sec;
+			tv_first.tv_usec = h->ts.tv_usec;
+		}
+		s->tv_ref = tv_first;
+		break;
+	}
+
+	/*
+	 * The state that a worker keeps across packets expires against
+	 * the latest time stamp of all the packets read, as when they
+	 * are printed by one thread, not just of those that it gets.
+	 */
+	if (h->ts.tv_sec > latest_time)
+		latest_time = h->ts.tv_sec;
+	s->latest_time = latest_time;
+
+	w = &workers[flow_hash_packet(h, sp) % nworkers];
+
+	pthread_mutex_lock(&lock);
+	s->state = SLOT_QUEUED;
+	w->queue[(w->queue_head + w->queue_len) % nslots] = idx;
+	w->queue_len++;
+	next_seq++;
+	pthread_cond_signal(&w->cond);
+	pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Change the link-layer header type; the caller must have drained the
+ * pipeline.
+ */
+void
+parallel_set_linktype(int dlt)
+{
+	u_int i;
+
+	linktype = dlt;
+	for (i = 0; i < nworkers; i++) {
+		workers[i].ndo.ndo_if_printer = get_if_printer(dlt);
+		workers[i].ndo.ndo_dlt = dlt;
+	}
+}
+
+/*
+ * Wait for all queued packets to be dissected and written.
+ */
+void
+parallel_drain(void)
+{
+	pthread_mutex_lock(&lock);
+	write_done(next_seq);
+	pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Drain the pipeline, and stop and free the worker threads.
+ */
+void
+parallel_stop(void)
+{
+	u_int i;
+
+	parallel_drain();
+
+	pthread_mutex_lock(&lock);
+	stopping = 1;
+	for (i = 0; i < nworkers; i++)
+		pthread_cond_signal(&workers[i].cond);
+	pthread_mutex_unlock(&lock);
+
+	for (i = 0; i < nworkers; i++) {
+		pthread_join(workers[i].thread, NULL);
+		pthread_cond_destroy(&workers[i].cond);
+		free(workers[i].queue);
+		free(workers[i].espsecret);
+		nd_arena_free(&workers[i].ndo);
+	}
+	free(workers);
+	workers = NULL;
+	nworkers = 0;
+
+	for (i = 0; i < nslots; i++) {
+		free(slots[i].data);
+		free(slots[i].out);
+	}
+	free(slots);
+	slots = NULL;
+	nslots = 0;
+}
+#endif /* PARALLEL_THREADS */
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef parallel_h
+#define parallel_h
+
+/*
+ * Multi-threaded dissection of savefiles ("--threads").
+ *
+ * Packets are read by the main thread, dissected by a pool of worker
+ * threads, each with its own copy of the netdissect_options, and the
+ * output of each packet is written by the main thread in the order in
+ * which the packets were read.  All the packets of a conversation are
+ * dissected by the same thread, so that the output is identical to the
+ * output of a single-threaded run.
+ *
+ * This requires POSIX threads and thread-local storage for the state
+ * that printers keep in static variables.
+ */
+#if defined(HAVE_PTHREAD) && defined(ND_HAVE_THREAD_LOCAL)
+#define PARALLEL_THREADS
+
+#define PARALLEL_MAX_THREADS	64
+
+extern void parallel_start(netdissect_options *, u_int, int, uint32_t, uint32_t);
+extern void parallel_packet(const struct pcap_pkthdr *, const u_char *, u_int);
+extern void parallel_set_linktype(int);
+extern void parallel_drain(void);
+extern void parallel_stop(void);
+#endif /* defined(HAVE_PTHREAD) && defined(ND_HAVE_THREAD_LOCAL) */
+
+#endif /* parallel_h */
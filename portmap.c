@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Choice of the printer of the data of UDP and TCP by port; see
+ * portmap.h.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <string.h>
+
+#include "netdissect.h"
+#include "ascii_strcasecmp.h"
+#include "portmap.h"
+
+static struct nd_port_map *const port_maps[] = {
+	&udp_port_map,
+	&tcp_port_map,
+};
+#define NUM_PORT_MAPS	(sizeof(port_maps) / sizeof(port_maps[0]))
+
+static struct nd_port_map *
+find_port_map(const char *proto)
+{
+	u_int i;
+
+	for (i = 0; i < NUM_PORT_MAPS; i++) {
+		if (ascii_strcasecmp(proto, port_maps[i]->proto) == 0)
+			return port_maps[i];
+	}
+	return NULL;
+}
+
+/*
+ * Have the data on a port, as source or destination, printed by the
+ * printer with the given name; this must be done before the tables
+ * are built.
+ */
+int
+nd_port_map_add(const char *proto, uint16_t port, const char *name)
+{
+	struct nd_port_map *m;
+	const struct tok *t;
+	struct nd_port_rule *r;
+
+	m = find_port_map(proto);
+	if (m == NULL)
+		return ND_PORT_MAP_BAD_PROTO;
+	for (t = m->names; t->s != NULL; t++) {
+		if (ascii_strcasecmp(name, t->s) == 0)
+			break;
+	}
+	if (t->s == NULL)
+		return ND_PORT_MAP_BAD_NAME;
+	if (m->nadded == ND_PORT_MAP_MAX_ADDED)
+		return ND_PORT_MAP_FULL;
+	r = &m->added[m->nadded++];
+	r->low = port;
+	r->high = port;
+	r->dir = ND_PORT_ANY;
+	r->app = (uint8_t)t->v;
+	return 0;
+}
+
+/*
+ * Return the names of the printers that can be used for a protocol's
+ * ports, or NULL if the protocol isn't one with ports.
+ */
+const struct tok *
+nd_port_map_names(const char *proto)
+{
+	const struct nd_port_map *m;
+
+	m = find_port_map(proto);
+	return m != NULL ? m->names : NULL;
+}
+
+/*
+ * Set the first rule for each port in a table, going through the rules
+ * from the last one.
+ */
+static void
+build_table(struct nd_port_map *m, uint8_t *first, uint8_t dir)
+{
+	const struct nd_port_rule *r;
+	u_int i, port;
+
+	memset(first, 0, 65536);
+	for (i = m->nrules; i != 0; i--) {
+		r = &m->rules[i - 1];
+		if (!(r->dir & dir))
+			continue;
+		for (port = r->low; port <= r->high; port++)
+			first[port] = (uint8_t)i;
+	}
+}
+
+static void
+build_port_map(struct nd_port_map *m)
+{
+	const struct nd_port_rule *r;
+	u_int n = 0;
+
+	for (r = m->added; r < m->added + m->nadded; r++)
+		m->rules[n++] = *r;
+	for (r = m->builtin; r->app != 0 && n < ND_PORT_MAP_MAX_RULES; r++)
+		m->rules[n++] = *r;
+	m->nrules = n;
+	build_table(m, m->first_src, ND_PORT_SRC);
+	build_table(m, m->first_dst, ND_PORT_DST);
+	m->built = 1;
+}
+
+/* Build the tables, if they haven't been built yet */
+void
+nd_port_map_init(void)
+{
+	u_int i;
+
+	for (i = 0; i < NUM_PORT_MAPS; i++) {
+		if (!port_maps[i]->built)
+			build_port_map(port_maps[i]);
+	}
+}
+
+/*
+ * Return the number of the next rule after a given one that matches
+ * a packet's ports, or 0 if there's none.
+ */
+u_int
+nd_port_map_next(const struct nd_port_map *m, u_int rule, uint16_t sport,
+		 uint16_t dport)
+{
+	const struct nd_port_rule *r;
+
+	for (; rule < m->nrules; rule++) {
+		r = &m->rules[rule];
+		if (((r->dir & ND_PORT_SRC) &&
+		     sport >= r->low && sport <= r->high) ||
+		    ((r->dir & ND_PORT_DST) &&
+		     dport >= r->low && dport <= r->high))
+			return rule + 1;
+	}
+	return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef portmap_h
+#define portmap_h
+
+/*
+ * Choice of the printer of the data of UDP and TCP by port.
+ *
+ * The printers are chosen by a list of rules, each of which gives a
+ * printer, as a value defined by the UDP or TCP printer, for a range
+ * of ports as source port, destination port or either; the first rule
+ * that matches a packet's ports is used.  So that the list isn't gone
+ * through for each packet, there's a table, for each direction, of the
+ * first rule that matches each port, and the first rule for a packet
+ * is the earlier of those of its source and destination ports.  A rule
+ * may only apply to some of the packets that it matches, which the UDP
+ * or TCP printer checks; if it doesn't apply, the next rule that
+ * matches the ports is looked for in the list.
+ *
+ * The rules added with --port-map come before the built-in ones, in
+ * the order in which they were added.  The tables are built by
+ * init_print(), before any thread is started, and are only read after
+ * that.
+ */
+
+/* Ports a rule is for */
+#define ND_PORT_SRC	0x01
+#define ND_PORT_DST	0x02
+#define ND_PORT_ANY	(ND_PORT_SRC|ND_PORT_DST)
+
+struct nd_port_rule {
+	uint16_t low;			/* first port */
+	uint16_t high;			/* last port */
+	uint8_t dir;			/* ND_PORT_ flags */
+	uint8_t app;			/* printer; 0 ends a list */
+};
+
+/* Most rules added with --port-map, for each protocol */
+#define ND_PORT_MAP_MAX_ADDED	32
+
+/* Most rules in all; the number of a rule must fit in a byte */
+#define ND_PORT_MAP_MAX_RULES	255
+
+struct nd_port_map {
+	const char *proto;		/* "udp" or "tcp" */
+	const struct tok *names;	/* of the printers --port-map can use */
+	const struct nd_port_rule *builtin;
+	int built;
+	u_int nadded;
+	struct nd_port_rule added[ND_PORT_MAP_MAX_ADDED];
+	u_int nrules;
+	struct nd_port_rule rules[ND_PORT_MAP_MAX_RULES];
+	/* 1 + index in rules of the first rule for a port, or 0 */
+	uint8_t first_src[65536];
+	uint8_t first_dst[65536];
+};
+
+/* A map with no rules added and its tables not built yet */
+#define ND_PORT_MAP_INIT(proto, names, builtin) \
+	{ (proto), (names), (builtin), 0, 0, { { 0, 0, 0, 0 } }, 0, \
+	  { { 0, 0, 0, 0 } }, { 0 }, { 0 } }
+
+extern struct nd_port_map udp_port_map;
+extern struct nd_port_map tcp_port_map;
+
+/* Errors of nd_port_map_add() */
+#define ND_PORT_MAP_BAD_PROTO	-1	/* not "udp" or "tcp" */
+#define ND_PORT_MAP_BAD_NAME	-2	/* no printer with that name */
+#define ND_PORT_MAP_FULL	-3	/* too many rules added */
+
+extern int nd_port_map_add(const char *, uint16_t, const char *);
+extern const struct tok *nd_port_map_names(const char *);
+extern void nd_port_map_init(void);
+extern u_int nd_port_map_next(const struct nd_port_map *, u_int,
+    uint16_t, uint16_t);
+
+/*
+ * Return the number of the first rule for a packet's ports, or 0 if
+ * there's none; the rules are numbered from 1.
+ */
+static inline u_int
+nd_port_map_first(const struct nd_port_map *m, uint16_t sport,
+		  uint16_t dport)
+{
+	u_int s = m->first_src[sport];
+	u_int d = m->first_dst[dport];
+
+	if (s == 0)
+		return d;
+	if (d == 0 || s < d)
+		return s;
+	return d;
+}
+
+/* The printer of a rule */
+static inline u_int
+nd_port_map_app(const struct nd_port_map *m, u_int rule)
+{
+	return m->rules[rule - 1].app;
+}
+
+#endif /* portmap_h */
@@ -43,6 +43,16 @@
 #include "netdissect-stdinc.h"
 
 #include <stdio.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ASCII_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define ASCII_NEON
+#include <arm_neon.h>
+#endif
 
 #include "netdissect-ctype.h"
 
@@ -56,13 +66,234 @@
 #define HEXDUMP_HEXSTUFF_PER_LINE \
 		(HEXDUMP_HEXSTUFF_PER_SHORT * HEXDUMP_SHORTS_PER_LINE)
 
+/*
+ * Kernels rendering a line of HEXDUMP_BYTES_PER_LINE bytes at once:
+ * as hex digits, two per byte; as ND_ASCII_ISGRAPH() characters, with
+ * '.' for the others; and as text, as ascii_print() prints it, which
+ * isn't done, and returns 0, if there's a CR in the line.
+ *
+ * The callers check once that the bytes have been captured, so the
+ * kernels read them without the GET_ macros.
+ */
+#if defined(ASCII_SSE2)
+static void
+hex_digits_line(const u_char *cp, char *out)
+{
+	const __m128i nibble = _mm_set1_epi8(0x0f);
+	const __m128i nine = _mm_set1_epi8(9);
+	const __m128i zero = _mm_set1_epi8('0');
+	const __m128i letters = _mm_set1_epi8('a' - '0' - 10);
+	__m128i v, hi, lo;
+
+	v = _mm_loadu_si128((const __m128i *)cp);
+	hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+	lo = _mm_and_si128(v, nibble);
+	hi = _mm_add_epi8(_mm_add_epi8(hi, zero),
+	    _mm_and_si128(_mm_cmpgt_epi8(hi, nine), letters));
+	lo = _mm_add_epi8(_mm_add_epi8(lo, zero),
+	    _mm_and_si128(_mm_cmpgt_epi8(lo, nine), letters));
+	_mm_storeu_si128((__m128i *)out, _mm_unpacklo_epi8(hi, lo));
+	_mm_storeu_si128((__m128i *)(out + 16), _mm_unpackhi_epi8(hi, lo));
+}
+
+/* Bytes 0x21 to 0x7e; those from 0x80 up are negative. */
+static __m128i
+graph_mask(__m128i v)
+{
+	return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x20)),
+	    _mm_cmplt_epi8(v, _mm_set1_epi8(0x7f)));
+}
+
+static __m128i
+select_dot(__m128i mask, __m128i v)
+{
+	return _mm_or_si128(_mm_and_si128(mask, v),
+	    _mm_andnot_si128(mask, _mm_set1_epi8('.')));
+}
+
+static void
+graph_chars_line(const u_char *cp, char *out)
+{
+	__m128i v;
+
+	v = _mm_loadu_si128((const __m128i *)cp);
+	_mm_storeu_si128((__m128i *)out, select_dot(graph_mask(v), v));
+}
+
+static int
+text_chars_line(const u_char *cp, char *out)
+{
+	__m128i v, mask;
+
+	v = _mm_loadu_si128((const __m128i *)cp);
+	if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))) != 0)
+		return 0;
+	mask = _mm_or_si128(graph_mask(v),
+	    _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+	    _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')),
+	    _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')))));
+	_mm_storeu_si128((__m128i *)out, select_dot(mask, v));
+	return 1;
+}
+#elif defined(ASCII_NEON)
+static void
+hex_digits_line(const u_char *cp, char *out)
+{
+	static const uint8_t hex[16] = {
+		'0', '1', '2', '3', '4', '5', '6', '7',
+		'8', '9', 'a', 'b', 'c', 'd', 'e', 'f'
+	};
+	uint8x16_t v, hi, lo, table;
+
+	table = vld1q_u8(hex);
+	v = vld1q_u8(cp);
+	hi = vqtbl1q_u8(table, vshrq_n_u8(v, 4));
+	lo = vqtbl1q_u8(table, vandq_u8(v, vdupq_n_u8(0x0f)));
+	vst1q_u8((uint8_t *)out, vzip1q_u8(hi, lo));
+	vst1q_u8((uint8_t *)(out + 16), vzip2q_u8(hi, lo));
+}
+
+static uint8x16_t
+graph_mask(uint8x16_t v)
+{
+	return vandq_u8(vcgtq_u8(v, vdupq_n_u8(0x20)),
+	    vcltq_u8(v, vdupq_n_u8(0x7f)));
+}
+
+static void
+graph_chars_line(const u_char *cp, char *out)
+{
+	uint8x16_t v;
+
+	v = vld1q_u8(cp);
+	vst1q_u8((uint8_t *)out, vbslq_u8(graph_mask(v), v, vdupq_n_u8('.')));
+}
+
+static int
+text_chars_line(const u_char *cp, char *out)
+{
+	uint8x16_t v, mask;
+
+	v = vld1q_u8(cp);
+	if (vmaxvq_u8(vceqq_u8(v, vdupq_n_u8('\r'))) != 0)
+		return 0;
+	mask = vorrq_u8(graph_mask(v),
+	    vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')),
+	    vorrq_u8(vceqq_u8(v, vdupq_n_u8('\t')),
+	    vceqq_u8(v, vdupq_n_u8('\n')))));
+	vst1q_u8((uint8_t *)out, vbslq_u8(mask, v, vdupq_n_u8('.')));
+	return 1;
+}
+#else
+static void
+hex_digits_line(const u_char *cp, char *out)
+{
+	static const char hex[] = "0123456789abcdef";
+	u_int i;
+
+	for (i = 0; i < HEXDUMP_BYTES_PER_LINE; i++) {
+		*out++ = hex[cp[i] >> 4];
+		*out++ = hex[cp[i] & 0x0f];
+	}
+}
+
+static void
+graph_chars_line(const u_char *cp, char *out)
+{
+	u_int i;
+
+	for (i = 0; i < HEXDUMP_BYTES_PER_LINE; i++)
+		out[i] = (char)(ND_ASCII_ISGRAPH(cp[i]) ? cp[i] : '.');
+}
+
+static int
+text_chars_line(const u_char *cp, char *out)
+{
+	u_int i;
+	u_char c;
+
+	for (i = 0; i < HEXDUMP_BYTES_PER_LINE; i++) {
+		c = cp[i];
+		if (c == '\r')
+			return 0;
+		if (!ND_ASCII_ISGRAPH(c) && c != '\t' && c != ' ' && c != '\n')
+			c = '.';
+		out[i] = (char)c;
+	}
+	return 1;
+}
+#endif
+
+/*
+ * Append the hex digits of a line of bytes, as a space and 4 digits
+ * for every 2 bytes.
+ */
+static void
+out_hex_line(netdissect_options *ndo, const u_char *cp)
+{
+	char digits[2 * HEXDUMP_BYTES_PER_LINE];
+	char *out;
+	u_int i;
+
+	hex_digits_line(cp, digits);
+	nd_output_grow(ndo, HEXDUMP_HEXSTUFF_PER_LINE);
+	out = ndo->ndo_outbuf + ndo->ndo_outbuf_len;
+	for (i = 0; i < HEXDUMP_SHORTS_PER_LINE; i++) {
+		*out++ = ' ';
+		memcpy(out, digits + 4 * i, 4);
+		out += 4;
+	}
+	ndo->ndo_outbuf_len += HEXDUMP_HEXSTUFF_PER_LINE;
+}
+
+/* Append the start of a line, with the offset of its first byte */
+static void
+out_line_start(netdissect_options *ndo, const char *indent, u_int offset)
+{
+	nd_out_str(ndo, indent);
+	nd_out_bytes(ndo, "0x", 2);
+	nd_out_hex(ndo, offset, 4);
+	nd_out_bytes(ndo, ": ", 2);
+}
+
+/*
+ * Print a byte of text as ascii_print() does, given the number of
+ * bytes that follow it.
+ */
+static void
+ascii_print_char(netdissect_options *ndo, const u_char *cp, u_int length)
+{
+	u_char s = *cp;
+
+	if (s == '\r') {
+		/*
+		 * Don't print CRs at the end of the line; they
+		 * don't belong at the ends of lines on UN*X,
+		 * and the standard I/O library will give us one
+		 * on Windows so we don't need to print one
+		 * ourselves.
+		 *
+		 * In the middle of a line, just print a '.'.
+		 */
+		if (length > 1 && cp[1] != '\n')
+			nd_out_char(ndo, '.');
+	} else {
+		if (!ND_ASCII_ISGRAPH(s) &&
+		    (s != '\t' && s != ' ' && s != '\n'))
+			nd_out_char(ndo, '.');
+		else
+			nd_out_char(ndo, s);
+	}
+}
+
 void
 ascii_print(netdissect_options *ndo,
             const u_char *cp, u_int length)
 {
 	u_int caplength;
-	u_char s;
+	u_int i, n;
 	int truncated = FALSE;
+	char line[HEXDUMP_BYTES_PER_LINE];
 
 	ndo->ndo_protocol = "ascii";
 	caplength = ND_BYTES_AVAILABLE_AFTER(cp);
@@ -72,27 +303,19 @@ ascii_print(netdissect_options *ndo,
 	}
 	ND_PRINT("\n");
 	while (length != 0) {
-		s = GET_U_1(cp);
-		cp++;
-		length--;
-		if (s == '\r') {
-			/*
-			 * Don't print CRs at the end of the line; they
-			 * don't belong at the ends of lines on UN*X,
-			 * and the standard I/O library will give us one
-			 * on Windows so we don't need to print one
-			 * ourselves.
-			 *
-			 * In the middle of a line, just print a '.'.
-			 */
-			if (length > 1 && GET_U_1(cp) != '\n')
-				ND_PRINT(".");
-		} else {
-			if (!ND_ASCII_ISGRAPH(s) &&
-			    (s != '\t' && s != ' ' && s != '\n'))
-				ND_PRINT(".");
-			else
-				ND_PRINT("%c", s);
+		if (length >= HEXDUMP_BYTES_PER_LINE &&
+		    text_chars_line(cp, line)) {
+			nd_out_bytes(ndo, line, HEXDUMP_BYTES_PER_LINE);
+			cp += HEXDUMP_BYTES_PER_LINE;
+			length -= HEXDUMP_BYTES_PER_LINE;
+			continue;
+		}
+		/* A CR, or the end; do these bytes one at a time */
+		n = ND_MIN(length, HEXDUMP_BYTES_PER_LINE);
+		for (i = 0; i < n; i++) {
+			length--;
+			ascii_print_char(ndo, cp, length);
+			cp++;
 		}
 	}
 	if (truncated)
@@ -116,6 +339,20 @@ hex_and_ascii_print_with_offset(netdissect_options *ndo, const char *indent,
 		length = caplength;
 		truncated = TRUE;
 	}
+	while (length >= HEXDUMP_BYTES_PER_LINE) {
+		out_line_start(ndo, indent, offset);
+		out_hex_line(ndo, cp);
+		nd_output_grow(ndo, 2 + HEXDUMP_BYTES_PER_LINE);
+		memcpy(ndo->ndo_outbuf + ndo->ndo_outbuf_len, "  ", 2);
+		graph_chars_line(cp,
+		    ndo->ndo_outbuf + ndo->ndo_outbuf_len + 2);
+		ndo->ndo_outbuf_len += 2 + HEXDUMP_BYTES_PER_LINE;
+		cp += HEXDUMP_BYTES_PER_LINE;
+		length -= HEXDUMP_BYTES_PER_LINE;
+		offset += HEXDUMP_BYTES_PER_LINE;
+	}
+
+	/* The rest of a line */
 	nshorts = length / sizeof(u_short);
 	i = 0;
 	hsp = hexstuff; asp = asciistuff;
@@ -130,14 +367,6 @@ hex_and_ascii_print_with_offset(netdissect_options *ndo, const char *indent,
 		*(asp++) = (char)(ND_ASCII_ISGRAPH(s1) ? s1 : '.');
 		*(asp++) = (char)(ND_ASCII_ISGRAPH(s2) ? s2 : '.');
 		i++;
-		if (i >= HEXDUMP_SHORTS_PER_LINE) {
-			*hsp = *asp = '\0';
-			ND_PRINT("%s0x%04x: %-*s  %s",
-			    indent, offset, HEXDUMP_HEXSTUFF_PER_LINE,
-			    hexstuff, asciistuff);
-			i = 0; hsp = hexstuff; asp = asciistuff;
-			offset += HEXDUMP_BYTES_PER_LINE;
-		}
 		nshorts--;
 	}
 	if (length & 1) {
@@ -184,6 +413,15 @@ hex_print_with_offset(netdissect_options *ndo,
 		length = caplength;
 		truncated = TRUE;
 	}
+	while (length >= HEXDUMP_BYTES_PER_LINE) {
+		out_line_start(ndo, indent, offset);
+		out_hex_line(ndo, cp);
+		cp += HEXDUMP_BYTES_PER_LINE;
+		length -= HEXDUMP_BYTES_PER_LINE;
+		offset += HEXDUMP_BYTES_PER_LINE;
+	}
+
+	/* The rest of a line */
 	nshorts = length / sizeof(u_short);
 	i = 0;
 	while (nshorts != 0) {
@@ -585,7 +585,7 @@ struct hnamemem {
 	struct hnamemem *nxt;
 };
 
-static struct hnamemem hnametable[HASHNAMESIZE];
+static ND_THREAD_LOCAL struct hnamemem hnametable[HASHNAMESIZE];
 
 static const char *
 ataddr_string(netdissect_options *ndo,
@@ -594,7 +594,7 @@ ataddr_string(netdissect_options *ndo,
 	struct hnamemem *tp, *tp2;
 	u_int i = (atnet << 8) | athost;
 	char nambuf[256+1];
-	static int first = 1;
+	static ND_THREAD_LOCAL int first = 1;
 	FILE *fp;
 
 	/*
@@ -698,7 +698,7 @@ static const char *
 ddpskt_string(netdissect_options *ndo,
               u_int skt)
 {
-	static char buf[8];
+	static ND_THREAD_LOCAL char buf[8];
 
 	if (ndo->ndo_nflag) {
 		(void)snprintf(buf, sizeof(buf), "%u", skt);
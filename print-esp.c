@@ -40,6 +40,7 @@
 #include "diag-control.h"
 
 #ifdef HAVE_LIBCRYPTO
+#include "netdissect-alloc.h"
 #include "strtoaddr.h"
 #include "ascii_strcasecmp.h"
 #endif
@@ -98,6 +99,7 @@ union inaddr_u {
 };
 struct sa_list {
 	struct sa_list	*next;
+	struct sa_list	*hash_next;   /* next SA in the same hash bucket */
 	u_int		daddr_version;
 	union inaddr_u	daddr;
 	uint32_t	spi;          /* if == 0, then IKEv2 */
@@ -111,8 +113,103 @@ struct sa_list {
 	int             authsecret_len;
 	u_char		secret[256];  /* is that big enough for all secrets? */
 	int		secretlen;
+	EVP_CIPHER_CTX	*ctx;         /* keyed context, set up on first use */
 };
 
+/*
+ * SAs with a destination address are also put into a hash table keyed
+ * by the SPI and destination address, so that finding the SA for an
+ * ESP packet doesn't require walking the list of all SAs; the table is
+ * doubled in size when it has as many SAs as buckets.
+ */
+#define SA_HASH_INITIAL_SIZE	64
+
+static u_int
+sa_hash(uint32_t spi, u_int daddr_version, const u_char *daddr)
+{
+	u_int len = daddr_version == 6 ? sizeof(nd_ipv6) : sizeof(nd_ipv4);
+	uint32_t h;
+	u_int i;
+
+	/* FNV-1a over the address, mixed with the SPI */
+	h = 2166136261U ^ spi;
+	for (i = 0; i < len; i++) {
+		h ^= daddr[i];
+		h *= 16777619U;
+	}
+	return (u_int)(h ^ (h >> 16));
+}
+
+/*
+ * Put an SA at the end of its hash chain; SAs are inserted in the order
+ * in which they're to be found, so that a later SA for the same SPI
+ * and address takes precedence, as it does on the list.
+ */
+static void
+sa_hash_append(struct sa_list **table, u_int size, struct sa_list *sa)
+{
+	struct sa_list **pp;
+
+	pp = &table[sa_hash(sa->spi, sa->daddr_version,
+	    (const u_char *)&sa->daddr) & (size - 1)];
+	while (*pp != NULL)
+		pp = &(*pp)->hash_next;
+	sa->hash_next = NULL;
+	*pp = sa;
+}
+
+static void
+sa_hash_add(netdissect_options *ndo, struct sa_list *nsa)
+{
+	struct sa_list **table, *sa;
+	u_int size;
+
+	if (ndo->ndo_sa_hash_count >= ndo->ndo_sa_hash_size) {
+		size = ndo->ndo_sa_hash_size != 0 ?
+		    ndo->ndo_sa_hash_size * 2 : SA_HASH_INITIAL_SIZE;
+		table = (struct sa_list **)calloc(size, sizeof(*table));
+		if (table == NULL)
+			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+					  "%s: calloc", __func__);
+		/* The list has the most recently added SAs first. */
+		for (sa = ndo->ndo_sa_list_head; sa != NULL; sa = sa->next) {
+			if (sa->daddr_version != 0)
+				sa_hash_append(table, size, sa);
+		}
+		free(ndo->ndo_sa_hash);
+		ndo->ndo_sa_hash = table;
+		ndo->ndo_sa_hash_size = size;
+	}
+
+	/* The new SA, not yet on the list, takes precedence. */
+	table = ndo->ndo_sa_hash;
+	table += sa_hash(nsa->spi, nsa->daddr_version,
+	    (const u_char *)&nsa->daddr) & (ndo->ndo_sa_hash_size - 1);
+	nsa->hash_next = *table;
+	*table = nsa;
+	ndo->ndo_sa_hash_count++;
+}
+
+static struct sa_list *
+sa_hash_lookup(netdissect_options *ndo, uint32_t spi, u_int daddr_version,
+	       const u_char *daddr)
+{
+	struct sa_list *sa;
+	u_int len;
+
+	if (ndo->ndo_sa_hash == NULL)
+		return NULL;
+	len = daddr_version == 6 ? sizeof(nd_ipv6) : sizeof(nd_ipv4);
+	sa = ndo->ndo_sa_hash[sa_hash(spi, daddr_version, daddr) &
+	    (ndo->ndo_sa_hash_size - 1)];
+	for (; sa != NULL; sa = sa->hash_next) {
+		if (sa->spi == spi && sa->daddr_version == daddr_version &&
+		    memcmp(&sa->daddr, daddr, len) == 0)
+			break;
+	}
+	return sa;
+}
+
 #ifndef HAVE_EVP_CIPHER_CTX_NEW
 /*
  * Allocate an EVP_CIPHER_CTX.
@@ -179,27 +276,37 @@ do_decrypt(netdissect_options *ndo, const char *caller, struct sa_list *sa,
 	u_char *pt;
 	int len;
 
-	ctx = EVP_CIPHER_CTX_new();
+	/*
+	 * The context is set up with the cipher and the key the first
+	 * time the SA is used, and kept with the SA; for each packet,
+	 * only the IV is set, which also resets the decryption state.
+	 */
+	ctx = sa->ctx;
 	if (ctx == NULL) {
-		/*
-		 * Failed to initialize the cipher context.
-		 * From a look at the OpenSSL code, this appears to
-		 * mean "couldn't allocate memory for the cipher context";
-		 * note that we're not passing any parameters, so there's
-		 * not much else it can mean.
-		 */
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-		    "%s: can't allocate memory for cipher context", caller);
-		return NULL;
-	}
+		ctx = EVP_CIPHER_CTX_new();
+		if (ctx == NULL) {
+			/*
+			 * Failed to initialize the cipher context.
+			 * From a look at the OpenSSL code, this appears to
+			 * mean "couldn't allocate memory for the cipher
+			 * context"; note that we're not passing any
+			 * parameters, so there's not much else it can mean.
+			 */
+			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+			    "%s: can't allocate memory for cipher context",
+			    caller);
+			return NULL;
+		}
 
-	if (set_cipher_parameters(ctx, sa->evp, sa->secret, NULL) < 0) {
-		EVP_CIPHER_CTX_free(ctx);
-		(*ndo->ndo_warning)(ndo, "%s: espkey init failed", caller);
-		return NULL;
+		if (set_cipher_parameters(ctx, sa->evp, sa->secret, NULL) < 0) {
+			EVP_CIPHER_CTX_free(ctx);
+			(*ndo->ndo_warning)(ndo, "%s: espkey init failed",
+			    caller);
+			return NULL;
+		}
+		sa->ctx = ctx;
 	}
 	if (set_cipher_parameters(ctx, NULL, NULL, iv) < 0) {
-		EVP_CIPHER_CTX_free(ctx);
 		(*ndo->ndo_warning)(ndo, "%s: IV init failed", caller);
 		return NULL;
 	}
@@ -213,7 +320,6 @@ do_decrypt(netdissect_options *ndo, const char *caller, struct sa_list *sa,
 	 */
 	block_size = (unsigned int)EVP_CIPHER_CTX_block_size(ctx);
 	if ((ctlen % block_size) != 0) {
-		EVP_CIPHER_CTX_free(ctx);
 		(*ndo->ndo_warning)(ndo,
 		    "%s: ciphertext size %u is not a multiple of the cipher block size %u",
 		    caller, ctlen, block_size);
@@ -222,36 +328,32 @@ do_decrypt(netdissect_options *ndo, const char *caller, struct sa_list *sa,
 
 	/*
 	 * Attempt to allocate a buffer for the decrypted data, because
-	 * we can't decrypt on top of the input buffer.
+	 * we can't decrypt on top of the input buffer.  It's per-packet
+	 * memory, released after the packet is printed.
 	 */
 	ptlen = ctlen;
-	pt = (u_char *)calloc(1, ptlen);
+	pt = (u_char *)nd_malloc(ndo, ptlen);
 	if (pt == NULL) {
-		EVP_CIPHER_CTX_free(ctx);
 		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
 		    "%s: can't allocate memory for decryption buffer", caller);
 		return NULL;
 	}
+	memset(pt, 0, ptlen);
 
 	/*
 	 * The size of the ciphertext handed to us is a multiple of the
 	 * cipher block size, so we don't need to worry about padding.
 	 */
 	if (!EVP_CIPHER_CTX_set_padding(ctx, 0)) {
-		free(pt);
-		EVP_CIPHER_CTX_free(ctx);
 		(*ndo->ndo_warning)(ndo,
 		    "%s: EVP_CIPHER_CTX_set_padding failed", caller);
 		return NULL;
 	}
 	if (!EVP_DecryptUpdate(ctx, pt, &len, ct, ctlen)) {
-		free(pt);
-		EVP_CIPHER_CTX_free(ctx);
 		(*ndo->ndo_warning)(ndo, "%s: EVP_DecryptUpdate failed",
 		    caller);
 		return NULL;
 	}
-	EVP_CIPHER_CTX_free(ctx);
 	return pt;
 }
 
@@ -265,7 +367,8 @@ do_decrypt(netdissect_options *ndo, const char *caller, struct sa_list *sa,
  *
  * Our caller must pop the buffer off the stack when it's finished
  * dissecting anything in it and before it does any dissection of
- * anything in the old buffer.  That will free the new buffer.
+ * anything in the old buffer.  The new buffer is per-packet memory,
+ * released after the packet is printed.
  */
 DIAG_OFF_DEPRECATION
 int esp_decrypt_buffer_by_ikev2_print(netdissect_options *ndo,
@@ -312,12 +415,10 @@ int esp_decrypt_buffer_by_ikev2_print(netdissect_options *ndo,
 		return 0;
 
 	/*
-	 * Switch to the output buffer for dissection, and save it
-	 * on the buffer stack so it can be freed; our caller must
+	 * Switch to the output buffer for dissection; our caller must
 	 * pop it when done.
 	 */
-	if (!nd_push_buffer(ndo, pt, pt, ctlen)) {
-		free(pt);
+	if (!nd_push_buffer(ndo, NULL, pt, ctlen)) {
 		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
 			"%s: can't push buffer on buffer stack", __func__);
 	}
@@ -344,6 +445,11 @@ static void esp_print_addsa(netdissect_options *ndo,
 	if (sa_def)
 		ndo->ndo_sa_default = nsa;
 
+	nsa->hash_next = NULL;
+	nsa->ctx = NULL;
+	if (nsa->daddr_version != 0)
+		sa_hash_add(ndo, nsa);
+
 	nsa->next = ndo->ndo_sa_list_head;
 	ndo->ndo_sa_list_head = nsa;
 }
@@ -564,6 +670,7 @@ static void esp_print_decode_ikeline(netdissect_options *ndo, char *line,
 		return;
 	}
 
+	memset(&sa1, 0, sizeof(struct sa_list));
 	sa1.spi = 0;
 	sa1.initiator = (init[0] == 'I');
 	if(espprint_decode_hex(ndo, sa1.spii, sizeof(sa1.spii), icookie+2)!=8)
@@ -705,7 +812,7 @@ void esp_decodesecret_print(netdissect_options *ndo)
 {
 	char *line;
 	char *p;
-	static int initialized = 0;
+	static ND_THREAD_LOCAL int initialized = 0;
 
 	if (!initialized) {
 		esp_init(ndo);
@@ -796,14 +903,8 @@ esp_print(netdissect_options *ndo,
 		/* if we can't get nexthdr, we do not need to decrypt it */
 
 		/* see if we can find the SA, and if so, decode it */
-		for (sa = ndo->ndo_sa_list_head; sa != NULL; sa = sa->next) {
-			if (sa->spi == GET_BE_U_4(esp->esp_spi) &&
-			    sa->daddr_version == 6 &&
-			    UNALIGNED_MEMCMP(&sa->daddr.in6, &ip6->ip6_dst,
-				   sizeof(nd_ipv6)) == 0) {
-				break;
-			}
-		}
+		sa = sa_hash_lookup(ndo, GET_BE_U_4(esp->esp_spi), 6,
+		    (const u_char *)&ip6->ip6_dst);
 		break;
 	case 4:
 		/* nexthdr & padding are in the last fragment */
@@ -811,14 +912,8 @@ esp_print(netdissect_options *ndo,
 			return;
 
 		/* see if we can find the SA, and if so, decode it */
-		for (sa = ndo->ndo_sa_list_head; sa != NULL; sa = sa->next) {
-			if (sa->spi == GET_BE_U_4(esp->esp_spi) &&
-			    sa->daddr_version == 4 &&
-			    UNALIGNED_MEMCMP(&sa->daddr.in4, &ip->ip_dst,
-				   sizeof(nd_ipv4)) == 0) {
-				break;
-			}
-		}
+		sa = sa_hash_lookup(ndo, GET_BE_U_4(esp->esp_spi), 4,
+		    (const u_char *)&ip->ip_dst);
 		break;
 	default:
 		return;
@@ -887,11 +982,9 @@ esp_print(netdissect_options *ndo,
 		return;
 
 	/*
-	 * Switch to the output buffer for dissection, and
-	 * save it on the buffer stack so it can be freed.
+	 * Switch to the output buffer for dissection.
 	 */
-	if (!nd_push_buffer(ndo, pt, pt, payloadlen)) {
-		free(pt);
+	if (!nd_push_buffer(ndo, NULL, pt, payloadlen)) {
 		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
 			"%s: can't push buffer on buffer stack", __func__);
 	}
@@ -929,7 +1022,7 @@ esp_print(netdissect_options *ndo,
 	ip_demux_print(ndo, pt, payloadlen - (padlen + 2), ver, fragmented,
 		       ttl_hl, nh, bp2);
 
-	/* Pop the buffer, freeing it. */
+	/* Pop the buffer. */
 	nd_pop_packet_info(ndo);
 	/* Pop the nd_push_snaplen */
 	nd_pop_packet_info(ndo);
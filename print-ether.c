@@ -43,7 +43,8 @@ struct	ether_header {
 /*
  * Length of an Ethernet header; note that some compilers may pad
  * "struct ether_header" to a multiple of 4 bytes, for example, so
- * "sizeof (struct ether_header)" may not give the right answer.
+ * "sizeof (struct ether_header)" may not give the right answer (and
+ * ND_VIEW_CHECK() then fails to compile).
  */
 #define ETHER_HDRLEN		14
 
@@ -105,12 +106,14 @@ const struct tok ethertype_values[] = {
     { 0, NULL}
 };
 
+/* The addresses of a header that passed ND_VIEW_CHECK() */
 static void
-ether_addresses_print(netdissect_options *ndo, const u_char *src,
-		      const u_char *dst)
+ether_addresses_print(netdissect_options *ndo,
+		      const struct ether_header *ehp)
 {
 	ND_PRINT("%s > %s, ",
-		 GET_MAC48_STRING(src), GET_MAC48_STRING(dst));
+		 V_MAC48_STRING(ehp->ether_shost),
+		 V_MAC48_STRING(ehp->ether_dhost));
 }
 
 static void
@@ -166,8 +169,11 @@ ether_common_print(netdissect_options *ndo, const u_char *p, u_int length,
 	/*
 	 * Get the source and destination addresses, skip past them,
 	 * and print them if we're printing the link-layer header.
+	 * The addresses, and the length/type field if there's no
+	 * switch tag, are extracted without checking each of them.
 	 */
 	ehp = (const struct ether_header *)p;
+	ND_VIEW_CHECK(ehp, ETHER_HDRLEN);
 	src.addr = ehp->ether_shost;
 	src.addr_string = mac48_string;
 	dst.addr = ehp->ether_dhost;
@@ -179,7 +185,7 @@ ether_common_print(netdissect_options *ndo, const u_char *p, u_int length,
 	hdrlen = 2*MAC48_LEN;
 
 	if (ndo->ndo_eflag)
-		ether_addresses_print(ndo, src.addr, dst.addr);
+		ether_addresses_print(ndo, ehp);
 
 	/*
 	 * Print the switch tag, if we have one, and skip past it.
@@ -196,9 +202,11 @@ ether_common_print(netdissect_options *ndo, const u_char *p, u_int length,
 	 * Get the length/type field, skip past it, and print it
 	 * if we're printing the link-layer header.
 	 */
+	if (switch_tag_len == 0)
+		length_type = V_BE_U_2(ehp->ether_length_type);
+	else
+		length_type = GET_BE_U_2(p);
 recurse:
-	length_type = GET_BE_U_2(p);
-
 	length -= 2;
 	caplen -= 2;
 	p += 2;
@@ -364,11 +372,12 @@ recurse:
 			length -= bytesConsumed;
 			caplen -= bytesConsumed;
 			hdrlen += bytesConsumed;
+			length_type = GET_BE_U_2(p);
 			goto recurse;
 		} else {
 			/* subtype/version not known, print raw packet */
 			if (!ndo->ndo_eflag && length_type > MAX_ETHERNET_LENGTH_VAL) {
-				ether_addresses_print(ndo, src.addr, dst.addr);
+				ether_addresses_print(ndo, ehp);
 				ether_type_print(ndo, length_type);
 				ND_PRINT(", length %u: ", orig_length);
 			}
@@ -378,8 +387,16 @@ recurse:
 	} else {
 		/*
 		 * It's a type field with some other value.
+		 *
+		 * If we're recording the fields of the packet, and the
+		 * only link-layer header printed so far is the one that
+		 * the fields cover, start the text here.
 		 */
-		if (ndo->ndo_eflag) {
+		if (nd_record_ether(ndo, src.addr, dst.addr, length_type) &&
+		    print_encap_header == NULL && print_switch_tag == NULL &&
+		    hdrlen == 2*MAC48_LEN + 2) {
+			nd_record_text_start(ndo);
+		} else if (ndo->ndo_eflag) {
 			ether_type_print(ndo, length_type);
 			if (!printed_length)
 				ND_PRINT(", length %u: ", orig_length);
@@ -396,7 +413,7 @@ recurse:
 				 * MAC addresses and the final Ethernet
 				 * type.
 				 */
-				ether_addresses_print(ndo, src.addr, dst.addr);
+				ether_addresses_print(ndo, ehp);
 				ether_type_print(ndo, length_type);
 				ND_PRINT(", length %u: ", orig_length);
 			}
@@ -522,11 +539,11 @@ netanalyzer_transparent_if_print(netdissect_options *ndo,
  * Returns non-zero if it can do so, zero if the ethertype is unknown.
  */
 
-int
-ethertype_print(netdissect_options *ndo,
-		u_short ether_type, const u_char *p,
-		u_int length, u_int caplen,
-		const struct lladdr_info *src, const struct lladdr_info *dst)
+static int
+ethertype_dispatch(netdissect_options *ndo,
+		   u_short ether_type, const u_char *p,
+		   u_int length, u_int caplen,
+		   const struct lladdr_info *src, const struct lladdr_info *dst)
 {
 	switch (ether_type) {
 
@@ -661,3 +678,18 @@ ethertype_print(netdissect_options *ndo,
 		return (0);
 	}
 }
+
+int
+ethertype_print(netdissect_options *ndo,
+		u_short ether_type, const u_char *p,
+		u_int length, u_int caplen,
+		const struct lladdr_info *src, const struct lladdr_info *dst)
+{
+	struct nd_profile_frame frame;
+	int ret;
+
+	ND_PROFILE_ENTER(ndo, &frame, length);
+	ret = ethertype_dispatch(ndo, ether_type, p, length, caplen, src, dst);
+	ND_PROFILE_LEAVE(ndo, &frame);
+	return (ret);
+}
@@ -143,9 +143,9 @@ const char *
 q922_string(netdissect_options *ndo, const u_char *p, u_int length)
 {
 
-    static u_int dlci, addr_len;
-    static uint32_t flags;
-    static char buffer[sizeof("parse_q922_header() returned XXXXXXXXXXX")];
+    static ND_THREAD_LOCAL u_int dlci, addr_len;
+    static ND_THREAD_LOCAL uint32_t flags;
+    static ND_THREAD_LOCAL char buffer[sizeof("parse_q922_header() returned XXXXXXXXXXX")];
     int ret;
     memset(buffer, 0, sizeof(buffer));
 
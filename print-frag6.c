@@ -30,14 +30,20 @@
 #include "extract.h"
 
 #include "ip6.h"
+#include "ipreasm.h"
 
-int
-frag6_print(netdissect_options *ndo, const u_char *bp, const u_char *bp2)
+/*
+ * Print the Fragment header at bp, in the IPv6 packet at bp2; return
+ * the length of the fragment data, or -1 if it's invalid.
+ */
+static int
+frag6_print_header(netdissect_options *ndo, const u_char *bp,
+		   const u_char *bp2)
 {
 	const struct ip6_frag *dp;
 	const struct ip6_hdr *ip6;
+	u_int len;
 
-	ndo->ndo_protocol = "frag6";
 	dp = (const struct ip6_frag *)bp;
 	ip6 = (const struct ip6_hdr *)bp2;
 
@@ -47,13 +53,25 @@ frag6_print(netdissect_options *ndo, const u_char *bp, const u_char *bp2)
 	else
 		ND_TCHECK_4(dp->ip6f_ident);
 	ND_PRINT("%u|", GET_BE_U_2(dp->ip6f_offlg) & IP6F_OFF_MASK);
-	if ((bp - bp2) + sizeof(struct ip6_frag) >
-	    sizeof(struct ip6_hdr) + GET_BE_U_2(ip6->ip6_plen))
+	len = (u_int)sizeof(struct ip6_hdr) + GET_BE_U_2(ip6->ip6_plen);
+	if ((bp - bp2) + sizeof(struct ip6_frag) > len) {
 		ND_PRINT("[length < 0] (invalid))");
-	else
-		ND_PRINT("%zu)",
-			 sizeof(struct ip6_hdr) + GET_BE_U_2(ip6->ip6_plen) -
-			 (bp - bp2) - sizeof(struct ip6_frag));
+		return -1;
+	}
+	len -= (u_int)(bp - bp2) + (u_int)sizeof(struct ip6_frag);
+	ND_PRINT("%u)", len);
+	return (int)len;
+}
+
+int
+frag6_print(netdissect_options *ndo, const u_char *bp, const u_char *bp2)
+{
+	const struct ip6_frag *dp;
+
+	ndo->ndo_protocol = "frag6";
+	dp = (const struct ip6_frag *)bp;
+
+	frag6_print_header(ndo, bp, bp2);
 
 	/* it is meaningless to decode non-first fragment */
 	if ((GET_BE_U_2(dp->ip6f_offlg) & IP6F_OFF_MASK) != 0)
@@ -63,3 +81,47 @@ frag6_print(netdissect_options *ndo, const u_char *bp, const u_char *bp2)
 		return sizeof(struct ip6_frag);
 	}
 }
+
+/*
+ * Print the Fragment header at bp, in the IPv6 packet at bp2, and add
+ * the fragment to its datagram, with --reassemble-ip.  nhp points to
+ * the Next Header field that names the Fragment header.
+ */
+void
+frag6_reassemble(netdissect_options *ndo, const u_char *bp,
+		 const u_char *bp2, const u_char *nhp)
+{
+	const struct ip6_frag *dp;
+	const struct ip6_hdr *ip6;
+	struct ip_reasm_frag frag;
+	uint16_t offlg;
+	int len;
+
+	ndo->ndo_protocol = "frag6";
+	dp = (const struct ip6_frag *)bp;
+	ip6 = (const struct ip6_hdr *)bp2;
+
+	len = frag6_print_header(ndo, bp, bp2);
+	if (len < 0)
+		return;
+	if (!ND_TTEST_LEN(bp + sizeof(struct ip6_frag), len)) {
+		/* Not all of it was captured. */
+		nd_print_trunc(ndo);
+		return;
+	}
+	offlg = GET_BE_U_2(dp->ip6f_offlg);
+	frag.af = 6;
+	frag.proto = 0;
+	frag.src = ip6->ip6_src;
+	frag.dst = ip6->ip6_dst;
+	frag.id = GET_BE_U_4(dp->ip6f_ident);
+	frag.offset = offlg & IP6F_OFF_MASK;
+	frag.more = (offlg & IP6F_MORE_FRAG) != 0;
+	frag.data = bp + sizeof(struct ip6_frag);
+	frag.len = len;
+	frag.hdr = bp2;
+	frag.hdr_len = (u_int)(bp - bp2);
+	frag.nh_off = (u_int)(nhp - bp2);
+	frag.nh = GET_U_1(dp->ip6f_nxt);
+	ip_reasm_fragment(ndo, &frag);
+}
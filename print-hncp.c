@@ -156,8 +156,8 @@ is_ipv4_mapped_address(const u_char *addr)
 static const char *
 format_nid(netdissect_options *ndo, const u_char *data)
 {
-    static char buf[4][sizeof("01:01:01:01")];
-    static int i = 0;
+    static ND_THREAD_LOCAL char buf[4][sizeof("01:01:01:01")];
+    static ND_THREAD_LOCAL int i = 0;
     i = (i + 1) % 4;
     snprintf(buf[i], sizeof(buf[i]), "%02x:%02x:%02x:%02x",
              GET_U_1(data), GET_U_1(data + 1), GET_U_1(data + 2),
@@ -168,8 +168,8 @@ format_nid(netdissect_options *ndo, const u_char *data)
 static const char *
 format_256(netdissect_options *ndo, const u_char *data)
 {
-    static char buf[4][sizeof("0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef")];
-    static int i = 0;
+    static ND_THREAD_LOCAL char buf[4][sizeof("0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef")];
+    static ND_THREAD_LOCAL int i = 0;
     i = (i + 1) % 4;
     snprintf(buf[i], sizeof(buf[i]), "%016" PRIx64 "%016" PRIx64 "%016" PRIx64 "%016" PRIx64,
          GET_BE_U_8(data),
@@ -183,8 +183,8 @@ format_256(netdissect_options *ndo, const u_char *data)
 static const char *
 format_interval(const uint32_t n)
 {
-    static char buf[4][sizeof("0000000.000s")];
-    static int i = 0;
+    static ND_THREAD_LOCAL char buf[4][sizeof("0000000.000s")];
+    static ND_THREAD_LOCAL int i = 0;
     i = (i + 1) % 4;
     snprintf(buf[i], sizeof(buf[i]), "%u.%03us", n / 1000, n % 1000);
     return buf[i];
@@ -32,11 +32,11 @@
 #include "ip.h"
 #include "ipproto.h"
 
-void
-ip_demux_print(netdissect_options *ndo,
-	       const u_char *bp,
-	       u_int length, u_int ver, int fragmented, u_int ttl_hl,
-	       uint8_t nh, const u_char *iph)
+static void
+ip_demux_dispatch(netdissect_options *ndo,
+		  const u_char *bp,
+		  u_int length, u_int ver, int fragmented, u_int ttl_hl,
+		  uint8_t nh, const u_char *iph)
 {
 	int advance;
 	const char *p_name;
@@ -231,3 +231,16 @@ again:
 		break;
 	}
 }
+
+void
+ip_demux_print(netdissect_options *ndo,
+	       const u_char *bp,
+	       u_int length, u_int ver, int fragmented, u_int ttl_hl,
+	       uint8_t nh, const u_char *iph)
+{
+	struct nd_profile_frame frame;
+
+	ND_PROFILE_ENTER(ndo, &frame, length);
+	ip_demux_dispatch(ndo, bp, length, ver, fragmented, ttl_hl, nh, iph);
+	ND_PROFILE_LEAVE(ndo, &frame);
+}
@@ -31,6 +31,7 @@
 
 #include "ip.h"
 #include "ipproto.h"
+#include "ipreasm.h"
 
 
 static const struct tok ip_option_values[] = {
@@ -310,6 +311,38 @@ static const struct tok ip_frag_values[] = {
 };
 
 
+/*
+ * Add a fragment of len bytes to its datagram, with --reassemble-ip.
+ */
+static void
+ip_reassemble(netdissect_options *ndo, const struct ip *ip, u_int hlen,
+	      u_int len, u_int off)
+{
+	struct ip_reasm_frag frag;
+
+	ND_PRINT(" (frag %u:%u@%u%s)", GET_BE_U_2(ip->ip_id), len,
+	    (off & IP_OFFMASK) * 8, (off & IP_MF) ? "+" : "");
+	if (!ND_TTEST_LEN((const u_char *)ip, hlen + len)) {
+		/* Not all of it was captured. */
+		nd_print_trunc(ndo);
+		return;
+	}
+	frag.af = 4;
+	frag.proto = GET_U_1(ip->ip_p);
+	frag.src = ip->ip_src;
+	frag.dst = ip->ip_dst;
+	frag.id = GET_BE_U_2(ip->ip_id);
+	frag.offset = (off & IP_OFFMASK) * 8;
+	frag.more = (off & IP_MF) != 0;
+	frag.data = (const u_char *)ip + hlen;
+	frag.len = len;
+	frag.hdr = (const u_char *)ip;
+	frag.hdr_len = hlen;
+	frag.nh_off = 0;
+	frag.nh = 0;
+	ip_reasm_fragment(ndo, &frag);
+}
+
 /*
  * print an IP datagram.
  */
@@ -328,6 +361,7 @@ ip_print(netdissect_options *ndo,
 	const char *p_name;
 	int truncated = 0;
 	int presumed_offload = 0;
+	int recorded;
 
 	ndo->ndo_protocol = "ip";
 	ip = (const struct ip *)bp;
@@ -364,7 +398,13 @@ ip_print(netdissect_options *ndo,
 		goto invalid;
 	}
 
-	ND_TCHECK_SIZE(ip);
+	/*
+	 * The fields of the fixed part of the header are extracted
+	 * without checking each of them from here on.
+	 */
+	if (!ND_VIEW_TTEST(ip, IP_HDRLEN))
+		goto trunc;
+	recorded = nd_record_ip(ndo, bp);
 	/*
 	 * Cut off the snapshot length to the end of the IP payload
 	 * or the end of the data in which it's contained, whichever
@@ -377,12 +417,12 @@ ip_print(netdissect_options *ndo,
 
 	len -= hlen;
 
-	off = GET_BE_U_2(ip->ip_off);
+	off = V_BE_U_2(ip->ip_off);
 
-	ip_proto = GET_U_1(ip->ip_p);
+	ip_proto = V_U_1(ip->ip_p);
 
 	if (ndo->ndo_vflag) {
-		ip_tos = GET_U_1(ip->ip_tos);
+		ip_tos = V_U_1(ip->ip_tos);
 		ND_PRINT("(tos 0x%x", ip_tos);
 		/* ECN bits */
 		switch (ip_tos & 0x03) {
@@ -403,7 +443,7 @@ ip_print(netdissect_options *ndo,
 			break;
 		}
 
-		ip_ttl = GET_U_1(ip->ip_ttl);
+		ip_ttl = V_U_1(ip->ip_ttl);
 		if (ip_ttl >= 1)
 			ND_PRINT(", ttl %u", ip_ttl);
 
@@ -413,7 +453,7 @@ ip_print(netdissect_options *ndo,
 		 * For unfragmented datagrams, note the don't fragment flag.
 		 */
 		ND_PRINT(", id %u, offset %u, flags [%s], proto %s (%u)",
-		    GET_BE_U_2(ip->ip_id),
+		    V_BE_U_2(ip->ip_id),
 		    (off & IP_OFFMASK) * 8,
 		    bittok2str(ip_frag_values, "none", off & (IP_RES|IP_DF|IP_MF)),
 		    tok2str(ipproto_values, "unknown", ip_proto),
@@ -425,7 +465,7 @@ ip_print(netdissect_options *ndo,
 			else
 				ND_PRINT(", length %u [was 0, presumed TSO]", length);
 		else
-			ND_PRINT(", length %u", GET_BE_U_2(ip->ip_len));
+			ND_PRINT(", length %u", V_BE_U_2(ip->ip_len));
 
 		if ((hlen > sizeof(struct ip))) {
 			ND_PRINT(", options (");
@@ -442,7 +482,7 @@ ip_print(netdissect_options *ndo,
 			vec[0].len = hlen;
 			sum = in_cksum(vec, 1);
 			if (sum != 0) {
-				ip_sum = GET_BE_U_2(ip->ip_sum);
+				ip_sum = V_BE_U_2(ip->ip_sum);
 				ND_PRINT(", bad cksum %x (->%x)!", ip_sum,
 				    in_cksum_shouldbe(ip_sum, sum));
 			}
@@ -454,27 +494,50 @@ ip_print(netdissect_options *ndo,
 			ND_PRINT(")\n    ");
 		if (truncated) {
 			ND_PRINT("%s > %s: ",
-			    GET_IPADDR_STRING(ip->ip_src),
-			    GET_IPADDR_STRING(ip->ip_dst));
+			    V_IPADDR_STRING(ip->ip_src),
+			    V_IPADDR_STRING(ip->ip_dst));
+			if (recorded)
+				nd_record_text_start(ndo);
 			nd_print_trunc(ndo);
 			nd_pop_packet_info(ndo);
 			return;
 		}
 	}
 
+	/*
+	 * With --reassemble-ip, fragments, including the first one,
+	 * are only added to their datagram, which is dissected once
+	 * it's complete.
+	 */
+	if (ndo->ndo_reassemble_ip && (off & (IP_MF|IP_OFFMASK)) != 0) {
+		ND_PRINT("%s > %s:", V_IPADDR_STRING(ip->ip_src),
+		    V_IPADDR_STRING(ip->ip_dst));
+		if (recorded)
+			nd_record_text_start(ndo);
+		if (!ndo->ndo_nflag && (p_name = netdb_protoname(ip_proto)) != NULL)
+			ND_PRINT(" %s", p_name);
+		else
+			ND_PRINT(" ip-proto-%u", ip_proto);
+		ip_reassemble(ndo, ip, hlen, ND_MIN(length - hlen, len), off);
+		nd_pop_packet_info(ndo);
+		return;
+	}
+
 	/*
 	 * If this is fragment zero, hand it to the next higher
 	 * level protocol.  Let them know whether there are more
 	 * fragments.
 	 */
 	if ((off & IP_OFFMASK) == 0) {
-		uint8_t nh = GET_U_1(ip->ip_p);
+		uint8_t nh = ip_proto;
 
 		if (nh != IPPROTO_TCP && nh != IPPROTO_UDP &&
 		    nh != IPPROTO_SCTP && nh != IPPROTO_DCCP) {
 			ND_PRINT("%s > %s: ",
-			    GET_IPADDR_STRING(ip->ip_src),
-			    GET_IPADDR_STRING(ip->ip_dst));
+			    V_IPADDR_STRING(ip->ip_src),
+			    V_IPADDR_STRING(ip->ip_dst));
+			if (recorded)
+				nd_record_text_start(ndo);
 		}
 		/*
 		 * Do a bounds check before calling ip_demux_print().
@@ -492,7 +555,7 @@ ip_print(netdissect_options *ndo,
 		 */
 		ip_demux_print(ndo, (const u_char *)ip + hlen,
 			       ND_MIN(length - hlen, len), 4, off & IP_MF,
-			       GET_U_1(ip->ip_ttl), nh, bp);
+			       V_U_1(ip->ip_ttl), nh, bp);
 	} else {
 		/*
 		 * Ultra quiet now means that all this stuff should be
@@ -508,8 +571,10 @@ ip_print(netdissect_options *ndo,
 		 * next level protocol header.  print the ip addr
 		 * and the protocol.
 		 */
-		ND_PRINT("%s > %s:", GET_IPADDR_STRING(ip->ip_src),
-		    GET_IPADDR_STRING(ip->ip_dst));
+		ND_PRINT("%s > %s:", V_IPADDR_STRING(ip->ip_src),
+		    V_IPADDR_STRING(ip->ip_dst));
+		if (recorded)
+			nd_record_text_start(ndo);
 		if (!ndo->ndo_nflag && (p_name = netdb_protoname(ip_proto)) != NULL)
 			ND_PRINT(" %s", p_name);
 		else
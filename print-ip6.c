@@ -228,6 +228,7 @@ ip6_print(netdissect_options *ndo, const u_char *bp, u_int length)
 	u_int len;
 	u_int total_advance;
 	const u_char *cp;
+	const u_char *nhp;
 	uint32_t payload_len;
 	uint8_t ph, nh;
 	int fragmented = 0;
@@ -235,6 +236,7 @@ ip6_print(netdissect_options *ndo, const u_char *bp, u_int length)
 	int found_extension_header;
 	int found_jumbo;
 	int found_hbh;
+	int recorded;
 
 	ndo->ndo_protocol = "ip6";
 	ip6 = (const struct ip6_hdr *)bp;
@@ -299,6 +301,7 @@ ip6_print(netdissect_options *ndo, const u_char *bp, u_int length)
 	                 payload_len);
 	}
 	ND_TCHECK_SIZE(ip6);
+	recorded = nd_record_ip(ndo, bp);
 
 	/*
 	 * Cut off the snapshot length to the end of the IP payload
@@ -311,6 +314,7 @@ ip6_print(netdissect_options *ndo, const u_char *bp, u_int length)
 	}
 
 	cp = (const u_char *)ip6;
+	nhp = ip6->ip6_nxt;
 	advance = sizeof(struct ip6_hdr);
 	total_advance = 0;
 	/* Process extension headers */
@@ -329,6 +333,8 @@ ip6_print(netdissect_options *ndo, const u_char *bp, u_int length)
 		    nh != IPPROTO_DCCP && nh != IPPROTO_SCTP) {
 			ND_PRINT("%s > %s: ", GET_IP6ADDR_STRING(ip6->ip6_src),
 				 GET_IP6ADDR_STRING(ip6->ip6_dst));
+			if (recorded)
+				nd_record_text_start(ndo);
 		}
 
 		switch (nh) {
@@ -374,6 +380,12 @@ ip6_print(netdissect_options *ndo, const u_char *bp, u_int length)
 			break;
 
 		case IPPROTO_FRAGMENT:
+			if (ndo->ndo_reassemble_ip) {
+				frag6_reassemble(ndo, cp, (const u_char *)ip6,
+						 nhp);
+				nd_pop_packet_info(ndo);
+				return;
+			}
 			advance = frag6_print(ndo, cp, (const u_char *)ip6);
 			if (advance < 0 || ndo->ndo_snapend <= cp + advance) {
 				nd_pop_packet_info(ndo);
@@ -499,12 +511,16 @@ ip6_print(netdissect_options *ndo, const u_char *bp, u_int length)
 					len -= total_advance;
 				}
 			}
+			/* Record the protocol after the extension headers. */
+			if (recorded)
+				ndo->ndo_record.nr_ip_proto = nh;
 			ip_demux_print(ndo, cp, len, 6, fragmented,
 				       GET_U_1(ip6->ip6_hlim), nh, bp);
 			nd_pop_packet_info(ndo);
 			return;
 		}
 		ph = nh;
+		nhp = cp;
 
 		/* ndo_protocol reassignment after xxx_print() calls */
 		ndo->ndo_protocol = "ip6";
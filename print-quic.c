@@ -29,16 +29,13 @@
 #include "netdissect-alloc.h"
 #include "netdissect.h"
 #include "extract.h"
+#include "ipproto.h"
+#include "flowtable.h"
 
 #define QUIC_MAX_CID_LENGTH	20
 
 typedef uint8_t quic_cid[QUIC_MAX_CID_LENGTH];
 
-struct quic_cid_array {
-	uint8_t cid[QUIC_MAX_CID_LENGTH];
-	uint8_t length;
-};
-
 enum quic_lh_packet_type {
 	QUIC_LH_TYPE_INITIAL = 0,
 	QUIC_LH_TYPE_0RTT = 1,
@@ -55,51 +52,58 @@ hexprint(netdissect_options *ndo, const uint8_t *cp, size_t len)
 		ND_PRINT("%02x", cp[i]);
 }
 
-#define QUIC_CID_LIST_MAX	512
+/*
+ * The connection IDs seen in long headers, so that they can be found at
+ * the start of short headers, which don't have their length; flows with
+ * no data, keyed by the connection ID alone, as connections may move to
+ * other addresses.
+ */
+struct nd_flow_type quic_cid_flow_type =
+    ND_FLOW_TYPE_INIT(ND_FLOW_TYPE_QUIC_CID, "QUIC connection ID", 0);
 
-static struct quic_cid_array quic_cid_array[QUIC_CID_LIST_MAX];
+/* Bit n is set if a connection ID of length n has been seen */
+static ND_THREAD_LOCAL uint32_t quic_cid_lengths;
 
-static struct quic_cid_array *
-lookup_quic_cid(const u_char *cid, size_t length)
+static void
+quic_cid_key(struct nd_flow_key *key, const u_char *cid, u_int length)
 {
-	for (unsigned int i = 0; i < QUIC_CID_LIST_MAX; i++) {
-		if (quic_cid_array[i].length > length) {
-			continue;
-		}
-		if (quic_cid_array[i].length == 0) {
-			break;
-		}
-		if (memcmp(quic_cid_array[i].cid, cid,
-			   quic_cid_array[i].length) == 0) {
-			/*
-			 * Swap the entries so that it behaves like an
-			 * LRU cache.
-			 */
-			if (i != 0) {
-				struct quic_cid_array tmp = quic_cid_array[i];
-				quic_cid_array[i] = quic_cid_array[0];
-				quic_cid_array[0] = tmp;
-			}
+	memset(key, 0, sizeof(*key));
+	key->proto = IPPROTO_UDP;
+	nd_flow_key_set_id(key, cid, length);
+}
 
-			return &quic_cid_array[0];
-		}
-	}
+/*
+ * Find the longest connection ID seen that starts the length bytes at
+ * cid.
+ */
+static const struct nd_flow *
+lookup_quic_cid(netdissect_options *ndo, const u_char *cid, size_t length)
+{
+	struct nd_flow_key key;
+	const struct nd_flow *flow;
+	u_int i;
 
+	for (i = ND_MIN(length, QUIC_MAX_CID_LENGTH); i != 0; i--) {
+		if (!(quic_cid_lengths & (1U << i)))
+			continue;
+		quic_cid_key(&key, cid, i);
+		flow = nd_flow_lookup(ndo, &quic_cid_flow_type, &key, 0);
+		if (flow != NULL)
+			return flow;
+	}
 	return NULL;
 }
 
 static void
-register_quic_cid(const quic_cid cid, uint8_t length)
+register_quic_cid(netdissect_options *ndo, const quic_cid cid, uint8_t length)
 {
-	static uint16_t next_cid = 0;
+	struct nd_flow_key key;
 
-	if (length == 0 ||
-	    lookup_quic_cid(cid, length) != NULL) {
+	if (length == 0)
 		return;
-	}
-	memcpy(&quic_cid_array[next_cid].cid, cid, QUIC_MAX_CID_LENGTH);
-	quic_cid_array[next_cid].length = length;
-	next_cid = (next_cid + 1) % QUIC_CID_LIST_MAX;
+	quic_cid_key(&key, cid, length);
+	(void)nd_flow_lookup(ndo, &quic_cid_flow_type, &key, 1);
+	quic_cid_lengths |= 1U << length;
 }
 
 /* Returns 1 if the first octet looks like a QUIC packet. */
@@ -186,7 +190,7 @@ quic_print_packet(netdissect_options *ndo, const u_char *bp, const u_char *end)
 			bp += dcil;
 			ND_PRINT(", dcid ");
 			hexprint(ndo, dcid, dcil);
-			register_quic_cid(dcid, dcil);
+			register_quic_cid(ndo, dcid, dcil);
 		}
 		scil = GET_U_1(bp);
 		bp += 1;
@@ -196,7 +200,7 @@ quic_print_packet(netdissect_options *ndo, const u_char *bp, const u_char *end)
 			bp += scil;
 			ND_PRINT(", scid ");
 			hexprint(ndo, scid, scil);
-			register_quic_cid(scid, scil);
+			register_quic_cid(ndo, scid, scil);
 		}
 		if (version == 0) {
 			/* Version Negotiation packet */
@@ -253,12 +257,11 @@ quic_print_packet(netdissect_options *ndo, const u_char *bp, const u_char *end)
 		ND_PRINT(", protected");
 		if (end > bp && end - bp > 16 &&
 		    ND_TTEST_LEN(bp, end - bp)) {
-			struct quic_cid_array *cid_array =
-				lookup_quic_cid(bp, end - bp);
-			if (cid_array != NULL) {
+			const struct nd_flow *flow =
+				lookup_quic_cid(ndo, bp, end - bp);
+			if (flow != NULL) {
 				ND_PRINT(", dcid ");
-				hexprint(ndo, cid_array->cid,
-					 cid_array->length);
+				hexprint(ndo, flow->key.id, flow->key.id_len);
 			}
 		} else {
 			nd_print_trunc(ndo);
@@ -46,6 +46,8 @@
 #include "extract.h"
 
 #include "ip.h"
+#include "ipproto.h"
+#include "flowtable.h"
 
 #define FS_RX_PORT	7000
 #define CB_RX_PORT	7001
@@ -476,24 +478,23 @@ static const struct tok rx_ack_reasons[] = {
  * numbers for replies.  This allows us to make sense of RX reply packets.
  */
 
+/*
+ * The opcodes of the recent calls, in flows keyed by the addresses and
+ * ports of the client and the server, and by the epoch and ID of the
+ * connection, the call number and the service ID.  They aren't closed
+ * when the reply is seen, as replies are retransmitted.
+ */
 struct rx_cache_entry {
-	uint32_t	callnum;	/* Call number (net order) */
-	uint32_t	client;		/* client IP address (net order) */
-	uint32_t	server;		/* server IP address (net order) */
-	uint16_t	dport;		/* server UDP port (host order) */
-	uint16_t	serviceId;	/* Service identifier (net order) */
 	uint32_t	opcode;		/* RX opcode (host order) */
 };
 
-#define RX_CACHE_SIZE	64
-
-static struct rx_cache_entry	rx_cache[RX_CACHE_SIZE];
+struct nd_flow_type rx_call_flow_type =
+    ND_FLOW_TYPE_INIT(ND_FLOW_TYPE_RX_CALL, "Rx call",
+		      sizeof(struct rx_cache_entry));
 
-static uint32_t	rx_cache_next = 0;
-static uint32_t	rx_cache_hint = 0;
-static void	rx_cache_insert(netdissect_options *, const u_char *, const struct ip *, uint16_t);
+static void	rx_cache_insert(netdissect_options *, const u_char *, const struct ip *, uint16_t, uint16_t);
 static int	rx_cache_find(netdissect_options *, const struct rx_header *,
-			      const struct ip *, uint16_t, uint32_t *);
+			      const struct ip *, uint16_t, uint16_t, uint32_t *);
 
 static void fs_print(netdissect_options *, const u_char *, u_int);
 static void fs_reply_print(netdissect_options *, const u_char *, u_int, uint32_t);
@@ -595,7 +596,7 @@ rx_print(netdissect_options *ndo,
 		 * have a chance to print out replies
 		 */
 
-		rx_cache_insert(ndo, bp, (const struct ip *) bp2, dport);
+		rx_cache_insert(ndo, bp, (const struct ip *) bp2, sport, dport);
 
 		switch (dport) {
 			case FS_RX_PORT:	/* AFS file service */
@@ -635,7 +636,7 @@ rx_print(netdissect_options *ndo,
 		    type == RX_PACKET_TYPE_ABORT) &&
 		   (flags & RX_CLIENT_INITIATED) == 0 &&
 		   rx_cache_find(ndo, rxh, (const struct ip *) bp2,
-				 sport, &opcode)) {
+				 sport, dport, &opcode)) {
 
 		switch (sport) {
 			case FS_RX_PORT:	/* AFS file service */
@@ -677,74 +678,66 @@ rx_print(netdissect_options *ndo,
 }
 
 /*
- * Insert an entry into the cache.  Taken from print-nfs.c
+ * Set the key of a call from the header of a packet of it, which has
+ * been checked by the caller.
+ */
+static void
+rx_cache_key(const struct rx_header *rxh, const struct ip *ip,
+	     uint16_t sport, uint16_t dport, struct nd_flow_key *key)
+{
+	u_char id[14];
+
+	nd_flow_key_set(key, (const u_char *)ip, IPPROTO_UDP, sport, dport);
+	memcpy(id, rxh->epoch, 4);
+	memcpy(id + 4, rxh->cid, 4);
+	memcpy(id + 8, rxh->callNumber, 4);
+	memcpy(id + 12, rxh->serviceId, 2);
+	nd_flow_key_set_id(key, id, sizeof(id));
+}
+
+/*
+ * Insert an entry into the cache.
  */
 
 static void
 rx_cache_insert(netdissect_options *ndo,
-                const u_char *bp, const struct ip *ip, uint16_t dport)
+                const u_char *bp, const struct ip *ip, uint16_t sport,
+                uint16_t dport)
 {
-	struct rx_cache_entry *rxent;
 	const struct rx_header *rxh = (const struct rx_header *) bp;
+	struct nd_flow_key key;
+	struct nd_flow *flow;
+	struct rx_cache_entry *rxent;
 
 	if (!ND_TTEST_4(bp + sizeof(struct rx_header)))
 		return;
 
-	rxent = &rx_cache[rx_cache_next];
-
-	if (++rx_cache_next >= RX_CACHE_SIZE)
-		rx_cache_next = 0;
-
-	rxent->callnum = GET_BE_U_4(rxh->callNumber);
-	rxent->client = GET_IPV4_TO_NETWORK_ORDER(ip->ip_src);
-	rxent->server = GET_IPV4_TO_NETWORK_ORDER(ip->ip_dst);
-	rxent->dport = dport;
-	rxent->serviceId = GET_BE_U_2(rxh->serviceId);
+	rx_cache_key(rxh, ip, sport, dport, &key);
+	flow = nd_flow_lookup(ndo, &rx_call_flow_type, &key, 1);
+	rxent = ND_FLOW_DATA(flow);
 	rxent->opcode = GET_BE_U_4(bp + sizeof(struct rx_header));
 }
 
 /*
- * Lookup an entry in the cache.  Also taken from print-nfs.c
- *
- * Note that because this is a reply, we're looking at the _source_
- * port.
+ * Lookup an entry in the cache.
  */
 
 static int
 rx_cache_find(netdissect_options *ndo, const struct rx_header *rxh,
-	      const struct ip *ip, uint16_t sport, uint32_t *opcode)
+	      const struct ip *ip, uint16_t sport, uint16_t dport,
+	      uint32_t *opcode)
 {
-	uint32_t i;
+	struct nd_flow_key key;
+	struct nd_flow *flow;
 	struct rx_cache_entry *rxent;
-	uint32_t clip;
-	uint32_t sip;
-
-	clip = GET_IPV4_TO_NETWORK_ORDER(ip->ip_dst);
-	sip = GET_IPV4_TO_NETWORK_ORDER(ip->ip_src);
-
-	/* Start the search where we last left off */
 
-	i = rx_cache_hint;
-	do {
-		rxent = &rx_cache[i];
-		if (rxent->callnum == GET_BE_U_4(rxh->callNumber) &&
-		    rxent->client == clip &&
-		    rxent->server == sip &&
-		    rxent->serviceId == GET_BE_U_2(rxh->serviceId) &&
-		    rxent->dport == sport) {
-
-			/* We got a match! */
-
-			rx_cache_hint = i;
-			*opcode = rxent->opcode;
-			return(1);
-		}
-		if (++i >= RX_CACHE_SIZE)
-			i = 0;
-	} while (i != rx_cache_hint);
-
-	/* Our search failed */
-	return(0);
+	rx_cache_key(rxh, ip, sport, dport, &key);
+	flow = nd_flow_lookup(ndo, &rx_call_flow_type, &key, 0);
+	if (flow == NULL)
+		return(0);
+	rxent = ND_FLOW_DATA(flow);
+	*opcode = rxent->opcode;
+	return(1);
 }
 
 /*
@@ -792,12 +785,12 @@ rx_cache_find(netdissect_options *ndo, const struct rx_header *rxh,
 			ND_PRINT(" %" PRIu64, _i); \
 		}
 
-#define DATEOUT() { time_t _t; char str[256]; \
+#define DATEOUT() { time_t _t; struct tm _tm; char str[256]; \
 			_t = (time_t) GET_BE_S_4(bp); \
 			bp += sizeof(int32_t); \
 			ND_PRINT(" %s", \
 			    nd_format_time(str, sizeof(str), \
-			      "%Y-%m-%d %H:%M:%S", localtime(&_t))); \
+			      "%Y-%m-%d %H:%M:%S", nd_localtime(&_t, &_tm))); \
 		}
 
 #define STOREATTROUT() { uint32_t mask, _i; \
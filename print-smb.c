@@ -19,12 +19,12 @@
 #include "smb.h"
 
 
-static int request = 0;
-static int unicodestr = 0;
+static ND_THREAD_LOCAL int request = 0;
+static ND_THREAD_LOCAL int unicodestr = 0;
 
-extern const u_char *startbuf;
+extern ND_THREAD_LOCAL const u_char *startbuf;
 
-const u_char *startbuf = NULL;
+ND_THREAD_LOCAL const u_char *startbuf = NULL;
 
 struct smbdescript {
     const char *req_f1;
@@ -108,7 +108,7 @@ static void
 trans2_qfsinfo(netdissect_options *ndo,
                const u_char *param, const u_char *data, u_int pcnt, u_int dcnt)
 {
-    static u_int level = 0;
+    static ND_THREAD_LOCAL u_int level = 0;
     const char *fmt="";
 
     if (request) {
@@ -59,6 +59,7 @@
 
 #include "rpc_auth.h"
 #include "rpc_msg.h"
+#include "flowtable.h"
 
 /*
  * Copyright (c) 2009, Sun Microsystems, Inc.
@@ -150,6 +151,103 @@ static const struct tok proc2str[] = {
 /* Forwards */
 static char *progstr(uint32_t);
 
+/*
+ * The program, version and procedure of the recent calls, in flows
+ * keyed by the addresses of the client and the server and by the XID,
+ * to allow us to match up replies with calls and thus to know how to
+ * parse the reply.  They're shared with the NFS printer, and aren't
+ * closed when the reply is seen, as replies are retransmitted.
+ */
+struct sunrpc_call {
+	u_int		client;		/* endpoint of the client in the key */
+	uint32_t	prog;		/* host order */
+	uint32_t	vers;
+	uint32_t	proc;
+};
+
+struct nd_flow_type sunrpc_call_flow_type =
+    ND_FLOW_TYPE_INIT(ND_FLOW_TYPE_SUNRPC_CALL, "RPC call",
+		      sizeof(struct sunrpc_call));
+
+/*
+ * Set the key of the call of an RPC message; returns the endpoint of
+ * the source of the packet in the key, or -1 if it's neither IPv4 nor
+ * IPv6.
+ */
+static int
+sunrpc_call_key(netdissect_options *ndo, const struct sunrpc_msg *rp,
+		const u_char *bp2, struct nd_flow_key *key)
+{
+	int rev;
+
+	if (IP_V((const struct ip *)bp2) != 4 &&
+	    IP_V((const struct ip *)bp2) != 6)
+		return (-1);
+	rev = nd_flow_key_set(key, bp2, 0, 0, 0);
+	nd_flow_key_set_id(key, rp->rm_xid, sizeof(rp->rm_xid));
+	return (rev);
+}
+
+/*
+ * Record the call in the RPC message at bp, sent in the IP packet at
+ * bp2; returns 0 if the message is truncated before the procedure.
+ */
+int
+sunrpc_call_enter(netdissect_options *ndo, const u_char *bp,
+		  const u_char *bp2)
+{
+	const struct sunrpc_msg *rp = (const struct sunrpc_msg *)bp;
+	struct nd_flow_key key;
+	struct nd_flow *flow;
+	struct sunrpc_call *call;
+	int client;
+
+	if (!ND_TTEST_4(rp->rm_call.cb_proc))
+		return (0);
+	if ((client = sunrpc_call_key(ndo, rp, bp2, &key)) < 0)
+		return (1);
+
+	flow = nd_flow_lookup(ndo, &sunrpc_call_flow_type, &key, 1);
+	call = ND_FLOW_DATA(flow);
+	call->client = client;
+	call->prog = GET_BE_U_4(rp->rm_call.cb_prog);
+	call->vers = GET_BE_U_4(rp->rm_call.cb_vers);
+	call->proc = GET_BE_U_4(rp->rm_call.cb_proc);
+	return (1);
+}
+
+/*
+ * Find the call that the RPC reply at bp, sent in the IP packet at
+ * bp2, is for; returns 0 and puts its program, version and procedure
+ * in *progp, *versp and *procp, or returns -1 if there's none.
+ */
+int
+sunrpc_call_find(netdissect_options *ndo, const u_char *bp,
+		 const u_char *bp2, uint32_t *progp, uint32_t *versp,
+		 uint32_t *procp)
+{
+	const struct sunrpc_msg *rp = (const struct sunrpc_msg *)bp;
+	struct nd_flow_key key;
+	struct nd_flow *flow;
+	struct sunrpc_call *call;
+	int server;
+
+	if ((server = sunrpc_call_key(ndo, rp, bp2, &key)) < 0)
+		return (-1);
+	flow = nd_flow_lookup(ndo, &sunrpc_call_flow_type, &key, 0);
+	if (flow == NULL)
+		return (-1);
+	/* The reply must come from the server, unless they're the same. */
+	call = ND_FLOW_DATA(flow);
+	if (call->client == (u_int)server &&
+	    memcmp(key.addr[0], key.addr[1], sizeof(key.addr[0])) != 0)
+		return (-1);
+	*progp = call->prog;
+	*versp = call->vers;
+	*procp = call->proc;
+	return (0);
+}
+
 void
 sunrpc_print(netdissect_options *ndo, const u_char *bp,
                     u_int length, const u_char *bp2)
@@ -163,6 +261,8 @@ sunrpc_print(netdissect_options *ndo, const u_char *bp,
 	ndo->ndo_protocol = "sunrpc";
 	rp = (const struct sunrpc_msg *)bp;
 	ND_TCHECK_SIZE(rp);
+	if (GET_BE_U_4(rp->rm_call.cb_prog) == SUNRPC_PMAPPROG)
+		sunrpc_call_enter(ndo, bp, bp2);
 
 	if (!ndo->ndo_nflag) {
 		snprintf(srcid, sizeof(srcid), "0x%x",
@@ -214,14 +314,57 @@ sunrpc_print(netdissect_options *ndo, const u_char *bp,
 	}
 }
 
+/*
+ * Print the results of an accepted reply to a portmapper call, found
+ * with sunrpc_call_find(); replies to other programs aren't decoded.
+ */
+void
+sunrpc_reply_print(netdissect_options *ndo, const u_char *bp,
+		   u_int length, uint32_t prog, uint32_t vers _U_,
+		   uint32_t proc)
+{
+	const struct sunrpc_msg *rp = (const struct sunrpc_msg *)bp;
+	const u_char *dp;
+	u_int len;
+
+	ndo->ndo_protocol = "sunrpc";
+	if (prog != SUNRPC_PMAPPROG)
+		return;
+	ND_PRINT(" %s", tok2str(proc2str, "proc #%u", proc));
+
+	/*
+	 * Skip the reply status and the verifier; see parserep() in
+	 * print-nfs.c for why the structure can't be used for that.
+	 */
+	dp = (const u_char *)&rp->rm_reply + 4;
+	len = GET_BE_U_4(dp + 4);
+	if (len >= length)
+		return;
+	dp += 8 + roundup2(len, 4);
+	if (GET_BE_U_4(dp) != SUNRPC_SUCCESS)
+		return;
+	dp += 4;
+	switch (proc) {
+
+	case SUNRPC_PMAPPROC_SET:
+	case SUNRPC_PMAPPROC_UNSET:
+		ND_PRINT(" %s", GET_BE_U_4(dp) ? "true" : "false");
+		break;
+
+	case SUNRPC_PMAPPROC_GETPORT:
+		ND_PRINT(" port %u", GET_BE_U_4(dp));
+		break;
+	}
+}
+
 static char *
 progstr(uint32_t prog)
 {
 #if defined(HAVE_GETRPCBYNUMBER) && defined(HAVE_RPC_RPC_H)
 	struct rpcent *rp;
 #endif
-	static char buf[32];
-	static uint32_t lastprog = 0;
+	static ND_THREAD_LOCAL char buf[32];
+	static ND_THREAD_LOCAL uint32_t lastprog = 0;
 
 	if (lastprog != 0 && prog == lastprog)
 		return (buf);
@@ -41,6 +41,9 @@ __RCSID("$NetBSD: print-tcp.c,v 1.8 2007/07/24 11:53:48 drochner Exp $");
 #include "netdissect.h"
 #include "addrtoname.h"
 #include "extract.h"
+#include "flowtable.h"
+#include "portmap.h"
+#include "tcpreasm.h"
 
 #include "diag-control.h"
 
@@ -62,45 +65,134 @@ static int tcp_verify_signature(netdissect_options *ndo,
 #endif
 
 static void print_tcp_rst_data(netdissect_options *, const u_char *sp, u_int length);
+static void tcp_payload_print(netdissect_options *, const u_char *, u_int,
+                              const u_char *, uint16_t, uint16_t);
 static void print_tcp_fastopen_option(netdissect_options *ndo, const u_char *cp,
                                       u_int datalen);
 
 #define MAX_RST_DATA_LEN	30
 
 
-struct tha {
-        nd_ipv4 src;
-        nd_ipv4 dst;
-        u_int port;
+/*
+ * The initial sequence numbers of a conversation, for printing relative
+ * sequence numbers; endpoint 0 is the first one in the flow key.
+ */
+struct tcp_seq_data {
+        uint32_t seq;           /* initial sequence number of endpoint 0 */
+        uint32_t ack;           /* initial sequence number of endpoint 1 */
+        uint32_t fin_end[2];    /* sequence number after each FIN */
+        u_char valid;           /* seq and ack have been set */
+        u_char fin_seen;        /* bit per endpoint that sent a FIN */
+        u_char fin_acked;       /* bit per endpoint whose FIN was acked */
 };
 
-struct tcp_seq_hash {
-        struct tcp_seq_hash *nxt;
-        struct tha addr;
-        uint32_t seq;
-        uint32_t ack;
-};
+/* These tcp options do not have the size octet */
+#define ZEROLENOPT(o) ((o) == TCPOPT_EOL || (o) == TCPOPT_NOP)
 
-struct tha6 {
-        nd_ipv6 src;
-        nd_ipv6 dst;
-        u_int port;
-};
+struct nd_flow_type tcp_seq_flow_type =
+    ND_FLOW_TYPE_INIT(ND_FLOW_TYPE_TCP_SEQ, "TCP connection",
+                      sizeof(struct tcp_seq_data));
 
-struct tcp_seq_hash6 {
-        struct tcp_seq_hash6 *nxt;
-        struct tha6 addr;
-        uint32_t seq;
-        uint32_t ack;
-};
+/*
+ * The lengths of the PDUs of the protocols that can be reassembled
+ * with --reassemble-tcp, from their first bytes.
+ */
+static u_int
+bgp_pdu_len(const u_char *p)
+{
+        u_int i, len;
+
+        /* A marker of all ones, then the length of the message */
+        for (i = 0; i < 16; i++)
+                if (EXTRACT_U_1(p + i) != 0xff)
+                        return 0;
+        len = EXTRACT_BE_U_2(p + 16);
+        return len >= 19 ? len : 0;
+}
 
-#define TSEQ_HASHSIZE 919
+static u_int
+dns_pdu_len(const u_char *p)
+{
+        return 2 + EXTRACT_BE_U_2(p);
+}
 
-/* These tcp options do not have the size octet */
-#define ZEROLENOPT(o) ((o) == TCPOPT_EOL || (o) == TCPOPT_NOP)
+static u_int
+ldp_pdu_len(const u_char *p)
+{
+        /* The PDU length doesn't count the version and itself. */
+        return 4 + EXTRACT_BE_U_2(p + 2);
+}
 
-static struct tcp_seq_hash tcp_seq_hash4[TSEQ_HASHSIZE];
-static struct tcp_seq_hash6 tcp_seq_hash6[TSEQ_HASHSIZE];
+static u_int
+nfs_pdu_len(const u_char *p)
+{
+        /* An RPC record marking fragment */
+        return 4 + (EXTRACT_BE_U_4(p) & 0x7FFFFFFF);
+}
+
+static u_int
+openflow_pdu_len(const u_char *p)
+{
+        return EXTRACT_BE_U_2(p + 2);
+}
+
+static u_int
+rpki_rtr_pdu_len(const u_char *p)
+{
+        return EXTRACT_BE_U_4(p + 4);
+}
+
+#ifdef ENABLE_SMB
+static u_int
+nbt_pdu_len(const u_char *p)
+{
+        /* The low bit of the flags extends the length. */
+        return 4 + ((EXTRACT_U_1(p + 1) & 0x01) << 16) +
+            EXTRACT_BE_U_2(p + 2);
+}
+
+static u_int
+smb_pdu_len(const u_char *p)
+{
+        return 4 + EXTRACT_BE_U_3(p + 1);
+}
+#endif
+
+static const struct {
+        uint16_t port;
+        struct tcp_framing framing;
+} tcp_framings[] = {
+        { NAMESERVER_PORT,      { 2, dns_pdu_len, 1 } },
+#ifdef ENABLE_SMB
+        { NETBIOS_SSN_PORT,     { 4, nbt_pdu_len, 1 } },
+#endif
+        { BGP_PORT,             { 19, bgp_pdu_len, 0 } },
+        { RPKI_RTR_PORT,        { 8, rpki_rtr_pdu_len, 0 } },
+#ifdef ENABLE_SMB
+        { SMB_PORT,             { 4, smb_pdu_len, 1 } },
+#endif
+        { LDP_PORT,             { 4, ldp_pdu_len, 0 } },
+        { OPENFLOW_PORT_OLD,    { 8, openflow_pdu_len, 0 } },
+        { OPENFLOW_PORT_IANA,   { 8, openflow_pdu_len, 0 } },
+        { NFS_PORT,             { 4, nfs_pdu_len, 1 } },
+        { 0,                    { 0, NULL, 0 } }
+};
+
+/*
+ * Return the framing of the protocol of a connection, or NULL if it
+ * can't be reassembled.
+ */
+static const struct tcp_framing *
+tcp_framing_lookup(uint16_t sport, uint16_t dport)
+{
+        u_int i;
+
+        for (i = 0; tcp_framings[i].port != 0; i++) {
+                if (IS_SRC_OR_DST_PORT(tcp_framings[i].port))
+                        return &tcp_framings[i].framing;
+        }
+        return NULL;
+}
 
 const struct tok tcp_flag_values[] = {
         { TH_FIN, "F" },
@@ -180,6 +272,31 @@ tcp6_cksum(netdissect_options *ndo,
                                 IPPROTO_TCP);
 }
 
+/*
+ * Close the flow of a conversation once it's been reset, or once both
+ * endpoints have sent a FIN and had it acknowledged.
+ */
+static void
+tcp_seq_update(netdissect_options *ndo, struct nd_flow *flow, uint16_t flags,
+               int endpoint, uint32_t seq, uint32_t ack, u_int datalen)
+{
+        struct tcp_seq_data *th = ND_FLOW_DATA(flow);
+
+        if (flags & TH_RST) {
+                nd_flow_close(ndo, flow);
+                return;
+        }
+        if (flags & TH_FIN) {
+                th->fin_seen |= 1 << endpoint;
+                th->fin_end[endpoint] = seq + datalen + 1;
+        }
+        if ((flags & TH_ACK) && (th->fin_seen & (1 << !endpoint)) &&
+            ack == th->fin_end[!endpoint])
+                th->fin_acked |= 1 << !endpoint;
+        if (th->fin_acked == 3)
+                nd_flow_close(ndo, flow);
+}
+
 void
 tcp_print(netdissect_options *ndo,
           const u_char *bp, u_int length,
@@ -195,8 +312,12 @@ tcp_print(netdissect_options *ndo,
         u_int utoval;
         uint16_t magic;
         int rev;
+        struct nd_flow *flow;
         const struct ip6_hdr *ip6;
+        const char *src, *dst;
         u_int header_len;	/* Header length in bytes */
+        struct nd_record *rec;
+        const struct tcp_framing *framing;
 
         ndo->ndo_protocol = "tcp";
         tp = (const struct tcphdr *)bp;
@@ -222,29 +343,46 @@ tcp_print(netdissect_options *ndo,
         sport = GET_BE_U_2(tp->th_sport);
         dport = GET_BE_U_2(tp->th_dport);
 
+        /*
+         * This is printed for every TCP packet, so append the fields
+         * directly rather than formatting them with ND_PRINT().
+         */
+        src = dst = NULL;
         if (ip6) {
-                if (GET_U_1(ip6->ip6_nxt) == IPPROTO_TCP) {
-                        ND_PRINT("%s.%s > %s.%s: ",
-                                 GET_IP6ADDR_STRING(ip6->ip6_src),
-                                 tcpport_string(ndo, sport),
-                                 GET_IP6ADDR_STRING(ip6->ip6_dst),
-                                 tcpport_string(ndo, dport));
-                } else {
-                        ND_PRINT("%s > %s: ",
-                                 tcpport_string(ndo, sport), tcpport_string(ndo, dport));
+                ND_VIEW_CHECK(ip6, IP6_HDRLEN);
+                if (V_U_1(ip6->ip6_nxt) == IPPROTO_TCP) {
+                        src = V_IP6ADDR_STRING(ip6->ip6_src);
+                        dst = V_IP6ADDR_STRING(ip6->ip6_dst);
                 }
         } else {
-                if (GET_U_1(ip->ip_p) == IPPROTO_TCP) {
-                        ND_PRINT("%s.%s > %s.%s: ",
-                                 GET_IPADDR_STRING(ip->ip_src),
-                                 tcpport_string(ndo, sport),
-                                 GET_IPADDR_STRING(ip->ip_dst),
-                                 tcpport_string(ndo, dport));
-                } else {
-                        ND_PRINT("%s > %s: ",
-                                 tcpport_string(ndo, sport), tcpport_string(ndo, dport));
+                ND_VIEW_CHECK(ip, IP_HDRLEN);
+                if (V_U_1(ip->ip_p) == IPPROTO_TCP) {
+                        src = V_IPADDR_STRING(ip->ip_src);
+                        dst = V_IPADDR_STRING(ip->ip_dst);
                 }
         }
+        if (src != NULL) {
+                nd_out_str(ndo, src);
+                nd_out_char(ndo, '.');
+        }
+        nd_out_str(ndo, tcpport_string(ndo, sport));
+        nd_out_bytes(ndo, " > ", 3);
+        if (dst != NULL) {
+                nd_out_str(ndo, dst);
+                nd_out_char(ndo, '.');
+        }
+        nd_out_str(ndo, tcpport_string(ndo, dport));
+        nd_out_bytes(ndo, ": ", 2);
+
+        /*
+         * If we're recording the fields of the packet, and this is
+         * the TCP header of the recorded IP packet, the text starts
+         * after the fields of this header.
+         */
+        if (nd_record_l4(ndo, ND_REC_TCP, bp2, sport, dport))
+                rec = &ndo->ndo_record;
+        else
+                rec = NULL;
 
         hlen = TH_OFF(tp) * 4;
 
@@ -254,13 +392,22 @@ tcp_print(netdissect_options *ndo,
                 goto invalid;
         }
 
-        seq = GET_BE_U_4(tp->th_seq);
-        ack = GET_BE_U_4(tp->th_ack);
-        win = GET_BE_U_2(tp->th_win);
-        urp = GET_BE_U_2(tp->th_urp);
+        /*
+         * The fields of the fixed part of the header are extracted
+         * without checking each of them from here on.
+         */
+        ND_VIEW_CHECK(tp, TCP_HDRLEN);
+        seq = V_BE_U_4(tp->th_seq);
+        ack = V_BE_U_4(tp->th_ack);
+        win = V_BE_U_2(tp->th_win);
+        urp = V_BE_U_2(tp->th_urp);
 
         if (ndo->ndo_qflag) {
                 ND_PRINT("tcp %u", length - hlen);
+                if (rec != NULL) {
+                        rec->nr_l4_len = length - hlen;
+                        nd_record_text_start(ndo);
+                }
                 if (hlen > length) {
                         ND_PRINT(" [bad hdr length %u - too long, > %u]",
                                  hlen, length);
@@ -269,149 +416,63 @@ tcp_print(netdissect_options *ndo,
                 return;
         }
 
-        flags = tcp_get_flags(tp);
-        ND_PRINT("Flags [%s]", bittok2str_nosep(tcp_flag_values, "none", flags));
-
-        if (!ndo->ndo_Sflag && (flags & TH_ACK)) {
-                /*
-                 * Find (or record) the initial sequence numbers for
-                 * this conversation.  (we pick an arbitrary
-                 * collating order so there's only one entry for
-                 * both directions).
-                 */
-                rev = 0;
-                if (ip6) {
-                        struct tcp_seq_hash6 *th;
-                        struct tcp_seq_hash6 *tcp_seq_hash;
-                        const void *src, *dst;
-                        struct tha6 tha;
-
-                        tcp_seq_hash = tcp_seq_hash6;
-                        src = (const void *)ip6->ip6_src;
-                        dst = (const void *)ip6->ip6_dst;
-                        if (sport > dport)
-                                rev = 1;
-                        else if (sport == dport) {
-                                if (UNALIGNED_MEMCMP(src, dst, sizeof(ip6->ip6_dst)) > 0)
-                                        rev = 1;
-                        }
-                        if (rev) {
-                                UNALIGNED_MEMCPY(&tha.src, dst, sizeof(ip6->ip6_dst));
-                                UNALIGNED_MEMCPY(&tha.dst, src, sizeof(ip6->ip6_src));
-                                tha.port = ((u_int)dport) << 16 | sport;
-                        } else {
-                                UNALIGNED_MEMCPY(&tha.dst, dst, sizeof(ip6->ip6_dst));
-                                UNALIGNED_MEMCPY(&tha.src, src, sizeof(ip6->ip6_src));
-                                tha.port = ((u_int)sport) << 16 | dport;
-                        }
+        flags = tcp_v_get_flags(tp);
+        nd_out_bytes(ndo, "Flags [", 7);
+        nd_out_str(ndo, bittok2str_nosep(tcp_flag_values, "none", flags));
+        nd_out_char(ndo, ']');
+        if (rec != NULL) {
+                rec->nr_tcp_flags = flags;
+                rec->nr_tcp_win = win;
+                rec->nr_tcp_urp = urp;
+                rec->nr_present |= ND_REC_TCP_HDR;
+        }
 
-                        for (th = &tcp_seq_hash[tha.port % TSEQ_HASHSIZE];
-                             th->nxt; th = th->nxt)
-                                if (memcmp((char *)&tha, (char *)&th->addr,
-                                           sizeof(th->addr)) == 0)
-                                        break;
+        /*
+         * Find (or record) the initial sequence numbers for this
+         * conversation; the flow has both directions.  RSTs without
+         * ACK are only looked up, to close the flow.
+         */
+        flow = NULL;
+        thseq = thack = rev = 0;
+        if (!ndo->ndo_Sflag && (flags & (TH_ACK|TH_RST))) {
+                struct nd_flow_key key;
+
+                rev = nd_flow_key_set(&key, bp2, IPPROTO_TCP, sport, dport);
+                flow = nd_flow_lookup(ndo, &tcp_seq_flow_type, &key,
+                                      flags & TH_ACK);
+        }
+        if (flow != NULL && (flags & TH_ACK)) {
+                struct tcp_seq_data *th = ND_FLOW_DATA(flow);
 
-                        if (!th->nxt || (flags & TH_SYN)) {
-                                /* didn't find it or new conversation */
-                                /* calloc() return used by the 'tcp_seq_hash6'
-                                   hash table: do not free() */
-                                if (th->nxt == NULL) {
-                                        th->nxt = (struct tcp_seq_hash6 *)
-                                                calloc(1, sizeof(*th));
-                                        if (th->nxt == NULL)
-                                                (*ndo->ndo_error)(ndo,
-                                                        S_ERR_ND_MEM_ALLOC,
-                                                        "%s: calloc", __func__);
-                                }
-                                th->addr = tha;
-                                if (rev) {
-                                        th->ack = seq;
-                                        th->seq = ack - 1;
-                                } else {
-                                        th->seq = seq;
-                                        th->ack = ack - 1;
-                                }
+                if (!th->valid || (flags & TH_SYN)) {
+                        /* new conversation */
+                        memset(th, 0, sizeof(*th));
+                        th->valid = 1;
+                        if (rev) {
+                                th->ack = seq;
+                                th->seq = ack - 1;
                         } else {
-                                if (rev) {
-                                        seq -= th->ack;
-                                        ack -= th->seq;
-                                } else {
-                                        seq -= th->seq;
-                                        ack -= th->ack;
-                                }
+                                th->seq = seq;
+                                th->ack = ack - 1;
                         }
-
-                        thseq = th->seq;
-                        thack = th->ack;
+                        nd_flow_reopen(ndo, flow);
                 } else {
-                        struct tcp_seq_hash *th;
-                        struct tcp_seq_hash *tcp_seq_hash;
-                        struct tha tha;
-
-                        tcp_seq_hash = tcp_seq_hash4;
-                        if (sport > dport)
-                                rev = 1;
-                        else if (sport == dport) {
-                                if (UNALIGNED_MEMCMP(ip->ip_src, ip->ip_dst, sizeof(ip->ip_dst)) > 0)
-                                        rev = 1;
-                        }
                         if (rev) {
-                                UNALIGNED_MEMCPY(&tha.src, ip->ip_dst,
-                                                 sizeof(ip->ip_dst));
-                                UNALIGNED_MEMCPY(&tha.dst, ip->ip_src,
-                                                 sizeof(ip->ip_src));
-                                tha.port = ((u_int)dport) << 16 | sport;
-                        } else {
-                                UNALIGNED_MEMCPY(&tha.dst, ip->ip_dst,
-                                                 sizeof(ip->ip_dst));
-                                UNALIGNED_MEMCPY(&tha.src, ip->ip_src,
-                                                 sizeof(ip->ip_src));
-                                tha.port = ((u_int)sport) << 16 | dport;
-                        }
-
-                        for (th = &tcp_seq_hash[tha.port % TSEQ_HASHSIZE];
-                             th->nxt; th = th->nxt)
-                                if (memcmp((char *)&tha, (char *)&th->addr,
-                                           sizeof(th->addr)) == 0)
-                                        break;
-
-                        if (!th->nxt || (flags & TH_SYN)) {
-                                /* didn't find it or new conversation */
-                                /* calloc() return used by the 'tcp_seq_hash4'
-                                   hash table: do not free() */
-                                if (th->nxt == NULL) {
-                                        th->nxt = (struct tcp_seq_hash *)
-                                                calloc(1, sizeof(*th));
-                                        if (th->nxt == NULL)
-                                                (*ndo->ndo_error)(ndo,
-                                                        S_ERR_ND_MEM_ALLOC,
-                                                        "%s: calloc", __func__);
-                                }
-                                th->addr = tha;
-                                if (rev) {
-                                        th->ack = seq;
-                                        th->seq = ack - 1;
-                                } else {
-                                        th->seq = seq;
-                                        th->ack = ack - 1;
-                                }
+                                seq -= th->ack;
+                                ack -= th->seq;
                         } else {
-                                if (rev) {
-                                        seq -= th->ack;
-                                        ack -= th->seq;
-                                } else {
-                                        seq -= th->seq;
-                                        ack -= th->ack;
-                                }
+                                seq -= th->seq;
+                                ack -= th->ack;
                         }
-
-                        thseq = th->seq;
-                        thack = th->ack;
                 }
-        } else {
-                /*fool gcc*/
-                thseq = thack = rev = 0;
+
+                thseq = th->seq;
+                thack = th->ack;
         }
+        if (flow != NULL)
+                tcp_seq_update(ndo, flow, flags, rev, V_BE_U_4(tp->th_seq),
+                               V_BE_U_4(tp->th_ack),
+                               length > hlen ? length - hlen : 0);
         if (hlen > length) {
                 ND_PRINT(" [bad hdr length %u - too long, > %u]",
                          hlen, length);
@@ -425,7 +486,7 @@ tcp_print(netdissect_options *ndo,
                 if (IP_V(ip) == 4) {
                         if (ND_TTEST_LEN(tp->th_sport, length)) {
                                 sum = tcp_cksum(ndo, ip, tp, length);
-                                tcp_sum = GET_BE_U_2(tp->th_sum);
+                                tcp_sum = V_BE_U_2(tp->th_sum);
 
                                 ND_PRINT(", cksum 0x%04x", tcp_sum);
                                 if (sum != 0)
@@ -437,7 +498,7 @@ tcp_print(netdissect_options *ndo,
                 } else if (IP_V(ip) == 6) {
                         if (ND_TTEST_LEN(tp->th_sport, length)) {
                                 sum = tcp6_cksum(ndo, ip6, tp, length);
-                                tcp_sum = GET_BE_U_2(tp->th_sum);
+                                tcp_sum = V_BE_U_2(tp->th_sum);
 
                                 ND_PRINT(", cksum 0x%04x", tcp_sum);
                                 if (sum != 0)
@@ -452,20 +513,32 @@ tcp_print(netdissect_options *ndo,
 
         length -= hlen;
         if (ndo->ndo_vflag > 1 || length > 0 || flags & (TH_SYN | TH_FIN | TH_RST)) {
-                ND_PRINT(", seq %u", seq);
+                nd_out_bytes(ndo, ", seq ", 6);
+                nd_out_uint(ndo, seq, 0);
+                if (rec != NULL) {
+                        rec->nr_tcp_seq = seq;
+                        rec->nr_present |= ND_REC_TCP_SEQ;
+                }
 
                 if (length > 0) {
-                        ND_PRINT(":%u", seq + length);
+                        nd_out_char(ndo, ':');
+                        nd_out_uint(ndo, seq + length, 0);
                 }
         }
 
-        if (flags & TH_ACK)
-                ND_PRINT(", ack %u", ack);
-        else
+        if (flags & TH_ACK) {
+                nd_out_bytes(ndo, ", ack ", 6);
+                nd_out_uint(ndo, ack, 0);
+                if (rec != NULL) {
+                        rec->nr_tcp_ack = ack;
+                        rec->nr_present |= ND_REC_TCP_ACK;
+                }
+        } else
                 if (ndo->ndo_vflag > 1 && ack != 0)
                         ND_PRINT(", [ack %u != 0 while ACK flag not set]", ack);
 
-        ND_PRINT(", win %u", win);
+        nd_out_bytes(ndo, ", win ", 6);
+        nd_out_uint(ndo, win, 0);
 
         if (flags & TH_URG)
                 ND_PRINT(", urg %u", urp);
@@ -483,6 +556,8 @@ tcp_print(netdissect_options *ndo,
                 hlen -= sizeof(*tp);
                 cp = (const u_char *)tp + sizeof(*tp);
                 ND_PRINT(", options [");
+                if (rec != NULL)
+                        rec->nr_tcp_opt_off = ndo->ndo_outbuf_len;
                 while (hlen != 0) {
                         if (ch != '\0')
                                 ND_PRINT("%c", ch);
@@ -738,13 +813,35 @@ tcp_print(netdissect_options *ndo,
                         if (opt == TCPOPT_EOL)
                                 break;
                 }
+                if (rec != NULL) {
+                        rec->nr_tcp_opt_len = ndo->ndo_outbuf_len -
+                            rec->nr_tcp_opt_off;
+                        rec->nr_present |= ND_REC_TCP_OPTS;
+                }
                 ND_PRINT("]");
         }
 
         /*
          * Print length field before crawling down the stack.
          */
-        ND_PRINT(", length %u", length);
+        nd_out_bytes(ndo, ", length ", 9);
+        nd_out_uint(ndo, length, 0);
+        if (rec != NULL) {
+                rec->nr_l4_len = length;
+                nd_record_text_start(ndo);
+        }
+
+        /*
+         * Let the reassembly of the stream see the SYNs, FINs and RSTs
+         * that don't carry data for it.
+         */
+        framing = NULL;
+        if (ndo->ndo_reassemble_tcp && !ndo->ndo_packettype)
+                framing = tcp_framing_lookup(sport, dport);
+        if (framing != NULL && (length == 0 || (flags & TH_RST)))
+                tcp_reasm_segment(ndo, bp2, sport, dport,
+                                  V_BE_U_4(tp->th_seq), flags, NULL, 0,
+                                  framing, tcp_payload_print);
 
         if (length == 0)
                 return;
@@ -787,60 +884,193 @@ tcp_print(netdissect_options *ndo,
                 return;
         }
 
-        if (IS_SRC_OR_DST_PORT(FTP_PORT)) {
+        if (framing != NULL) {
+                tcp_reasm_segment(ndo, bp2, sport, dport,
+                                  V_BE_U_4(tp->th_seq), flags, bp, length,
+                                  framing, tcp_payload_print);
+                return;
+        }
+        tcp_payload_print(ndo, bp, length, bp2, sport, dport);
+        return;
+bad:
+        ND_PRINT("[bad opt]");
+        if (ch != '\0')
+                ND_PRINT("]");
+        return;
+invalid:
+        nd_print_invalid(ndo);
+}
+
+/*
+ * The printers of TCP data chosen by port; see portmap.h.
+ */
+enum tcp_app {
+        TCP_APP_NONE,
+        TCP_APP_BEEP,
+        TCP_APP_BGP,
+        TCP_APP_DOMAIN,
+        TCP_APP_FTP,
+        TCP_APP_HTTP,
+        TCP_APP_LDP,
+        TCP_APP_MSDP,
+        TCP_APP_NBT_SSN,
+        TCP_APP_NFS,
+        TCP_APP_OPENFLOW,
+        TCP_APP_PPTP,
+        TCP_APP_RESP,
+        TCP_APP_RPKI_RTR,
+        TCP_APP_RTSP,
+        TCP_APP_SMB,
+        TCP_APP_SMTP,
+        TCP_APP_SSH,
+        TCP_APP_TELNET,
+        TCP_APP_WHOIS,
+        TCP_APP_ZMTP1
+};
+
+static const struct tok tcp_app_names[] = {
+        { TCP_APP_BEEP,         "beep" },
+        { TCP_APP_BGP,          "bgp" },
+        { TCP_APP_DOMAIN,       "domain" },
+        { TCP_APP_FTP,          "ftp" },
+        { TCP_APP_HTTP,         "http" },
+        { TCP_APP_LDP,          "ldp" },
+        { TCP_APP_MSDP,         "msdp" },
+#ifdef ENABLE_SMB
+        { TCP_APP_NBT_SSN,      "netbios-ssn" },
+#endif
+        { TCP_APP_NFS,          "nfs" },
+        { TCP_APP_OPENFLOW,     "openflow" },
+        { TCP_APP_PPTP,         "pptp" },
+        { TCP_APP_RESP,         "resp" },
+        { TCP_APP_RPKI_RTR,     "rpki-rtr" },
+        { TCP_APP_RTSP,         "rtsp" },
+#ifdef ENABLE_SMB
+        { TCP_APP_SMB,          "smb" },
+#endif
+        { TCP_APP_SMTP,         "smtp" },
+        { TCP_APP_SSH,          "ssh" },
+        { TCP_APP_TELNET,       "telnet" },
+        { TCP_APP_WHOIS,        "whois" },
+        { TCP_APP_ZMTP1,        "zmtp1" },
+        { 0, NULL }
+};
+
+/*
+ * The built-in rules, in the order in which they're tried.
+ */
+#define TCP_RULE(port, app)     { (port), (port), ND_PORT_ANY, (app) }
+static const struct nd_port_rule tcp_port_rules[] = {
+        TCP_RULE(FTP_PORT,              TCP_APP_FTP),
+        TCP_RULE(SSH_PORT,              TCP_APP_SSH),
+        TCP_RULE(TELNET_PORT,           TCP_APP_TELNET),
+        TCP_RULE(SMTP_PORT,             TCP_APP_SMTP),
+        TCP_RULE(WHOIS_PORT,            TCP_APP_WHOIS),
+        TCP_RULE(NAMESERVER_PORT,       TCP_APP_DOMAIN),
+        TCP_RULE(HTTP_PORT,             TCP_APP_HTTP),
+#ifdef ENABLE_SMB
+        TCP_RULE(NETBIOS_SSN_PORT,      TCP_APP_NBT_SSN),
+#endif
+        TCP_RULE(BGP_PORT,              TCP_APP_BGP),
+        TCP_RULE(RPKI_RTR_PORT,         TCP_APP_RPKI_RTR),
+#ifdef ENABLE_SMB
+        TCP_RULE(SMB_PORT,              TCP_APP_SMB),
+#endif
+        TCP_RULE(RTSP_PORT,             TCP_APP_RTSP),
+        TCP_RULE(MSDP_PORT,             TCP_APP_MSDP),
+        TCP_RULE(LDP_PORT,              TCP_APP_LDP),
+        TCP_RULE(PPTP_PORT,             TCP_APP_PPTP),
+        TCP_RULE(REDIS_PORT,            TCP_APP_RESP),
+        TCP_RULE(BEEP_PORT,             TCP_APP_BEEP),
+        TCP_RULE(OPENFLOW_PORT_OLD,     TCP_APP_OPENFLOW),
+        TCP_RULE(OPENFLOW_PORT_IANA,    TCP_APP_OPENFLOW),
+        TCP_RULE(HTTP_PORT_ALT,         TCP_APP_HTTP),
+        TCP_RULE(RTSP_PORT_ALT,         TCP_APP_RTSP),
+        TCP_RULE(NFS_PORT,              TCP_APP_NFS),
+        { 0, 0, 0, TCP_APP_NONE }
+};
+
+struct nd_port_map tcp_port_map =
+        ND_PORT_MAP_INIT("tcp", tcp_app_names, tcp_port_rules);
+
+/*
+ * Print the data with the printer of a rule; returns 0, having printed
+ * nothing, if the data isn't for that printer after all.
+ */
+static int
+tcp_app_print(netdissect_options *ndo, u_int app, const u_char *bp,
+              u_int length, const u_char *bp2, uint16_t sport, uint16_t dport)
+{
+        switch (app) {
+
+        case TCP_APP_FTP:
                 ND_PRINT(": ");
                 ftp_print(ndo, bp, length);
-        } else if (IS_SRC_OR_DST_PORT(SSH_PORT)) {
+                break;
+        case TCP_APP_SSH:
                 ssh_print(ndo, bp, length);
-        } else if (IS_SRC_OR_DST_PORT(TELNET_PORT)) {
+                break;
+        case TCP_APP_TELNET:
                 telnet_print(ndo, bp, length);
-        } else if (IS_SRC_OR_DST_PORT(SMTP_PORT)) {
+                break;
+        case TCP_APP_SMTP:
                 ND_PRINT(": ");
                 smtp_print(ndo, bp, length);
-        } else if (IS_SRC_OR_DST_PORT(WHOIS_PORT)) {
+                break;
+        case TCP_APP_WHOIS:
                 ND_PRINT(": ");
                 whois_print(ndo, bp, length);
-        } else if (IS_SRC_OR_DST_PORT(NAMESERVER_PORT)) {
+                break;
+        case TCP_APP_DOMAIN:
                 /* over_tcp: TRUE, is_mdns: FALSE */
                 domain_print(ndo, bp, length, TRUE, FALSE);
-        } else if (IS_SRC_OR_DST_PORT(HTTP_PORT)) {
+                break;
+        case TCP_APP_HTTP:
                 ND_PRINT(": ");
                 http_print(ndo, bp, length);
+                break;
 #ifdef ENABLE_SMB
-        } else if (IS_SRC_OR_DST_PORT(NETBIOS_SSN_PORT)) {
+        case TCP_APP_NBT_SSN:
                 nbt_tcp_print(ndo, bp, length);
+                break;
 #endif
-        } else if (IS_SRC_OR_DST_PORT(BGP_PORT)) {
+        case TCP_APP_BGP:
                 bgp_print(ndo, bp, length);
-        } else if (IS_SRC_OR_DST_PORT(RPKI_RTR_PORT)) {
+                break;
+        case TCP_APP_RPKI_RTR:
                 rpki_rtr_print(ndo, bp, length);
+                break;
 #ifdef ENABLE_SMB
-        } else if (IS_SRC_OR_DST_PORT(SMB_PORT)) {
+        case TCP_APP_SMB:
                 smb_tcp_print(ndo, bp, length);
+                break;
 #endif
-        } else if (IS_SRC_OR_DST_PORT(RTSP_PORT)) {
+        case TCP_APP_RTSP:
                 ND_PRINT(": ");
                 rtsp_print(ndo, bp, length);
-        } else if (IS_SRC_OR_DST_PORT(MSDP_PORT)) {
+                break;
+        case TCP_APP_MSDP:
                 msdp_print(ndo, bp, length);
-        } else if (IS_SRC_OR_DST_PORT(LDP_PORT)) {
+                break;
+        case TCP_APP_LDP:
                 ldp_print(ndo, bp, length);
-        } else if (IS_SRC_OR_DST_PORT(PPTP_PORT))
+                break;
+        case TCP_APP_PPTP:
                 pptp_print(ndo, bp);
-        else if (IS_SRC_OR_DST_PORT(REDIS_PORT))
+                break;
+        case TCP_APP_RESP:
                 resp_print(ndo, bp, length);
-        else if (IS_SRC_OR_DST_PORT(BEEP_PORT))
+                break;
+        case TCP_APP_BEEP:
                 beep_print(ndo, bp, length);
-        else if (IS_SRC_OR_DST_PORT(OPENFLOW_PORT_OLD) || IS_SRC_OR_DST_PORT(OPENFLOW_PORT_IANA)) {
+                break;
+        case TCP_APP_OPENFLOW:
                 openflow_print(ndo, bp, length);
-        } else if (IS_SRC_OR_DST_PORT(HTTP_PORT_ALT)) {
-                ND_PRINT(": ");
-                http_print(ndo, bp, length);
-        } else if (IS_SRC_OR_DST_PORT(RTSP_PORT_ALT)) {
-                ND_PRINT(": ");
-                rtsp_print(ndo, bp, length);
-        } else if ((IS_SRC_OR_DST_PORT(NFS_PORT)) &&
-                 length >= 4) {
+                break;
+        case TCP_APP_ZMTP1:
+                zmtp1_print(ndo, bp, length);
+                break;
+        case TCP_APP_NFS: {
                 /*
                  * If data present, header length valid, and NFS port used,
                  * assume NFS.
@@ -851,6 +1081,8 @@ tcp_print(netdissect_options *ndo,
                 const struct sunrpc_msg *rp;
                 enum sunrpc_msg_type direction;
 
+                if (length < 4)
+                        return 0;
                 fraglen = GET_BE_U_4(bp) & 0x7FFFFFFF;
                 if (fraglen > (length) - 4)
                         fraglen = (length) - 4;
@@ -860,26 +1092,47 @@ tcp_print(netdissect_options *ndo,
                         if (dport == NFS_PORT && direction == SUNRPC_CALL) {
                                 ND_PRINT(": NFS request xid %u ",
                                          GET_BE_U_4(rp->rm_xid));
-                                nfsreq_noaddr_print(ndo, (const u_char *)rp, fraglen, (const u_char *)ip);
-                                return;
-                        }
-                        if (sport == NFS_PORT && direction == SUNRPC_REPLY) {
+                                nfsreq_noaddr_print(ndo, (const u_char *)rp, fraglen, bp2);
+                        } else if (sport == NFS_PORT && direction == SUNRPC_REPLY) {
                                 ND_PRINT(": NFS reply xid %u ",
                                          GET_BE_U_4(rp->rm_xid));
-                                nfsreply_noaddr_print(ndo, (const u_char *)rp, fraglen, (const u_char *)ip);
-                                return;
+                                nfsreply_noaddr_print(ndo, (const u_char *)rp, fraglen, bp2);
                         }
                 }
+                break;
+        }
+        default:
+                return 0;
         }
+        return 1;
+}
 
-        return;
-bad:
-        ND_PRINT("[bad opt]");
-        if (ch != '\0')
-                ND_PRINT("]");
-        return;
-invalid:
-        nd_print_invalid(ndo);
+/*
+ * Print the data of a segment, or of a PDU reassembled from several
+ * segments, according to the ports of the connection.
+ */
+static void
+tcp_port_dispatch(netdissect_options *ndo, const u_char *bp, u_int length,
+                  const u_char *bp2, uint16_t sport, uint16_t dport)
+{
+        u_int rule;
+
+        rule = nd_port_map_first(&tcp_port_map, sport, dport);
+        while (rule != 0 &&
+               !tcp_app_print(ndo, nd_port_map_app(&tcp_port_map, rule),
+                              bp, length, bp2, sport, dport))
+                rule = nd_port_map_next(&tcp_port_map, rule, sport, dport);
+}
+
+static void
+tcp_payload_print(netdissect_options *ndo, const u_char *bp, u_int length,
+                  const u_char *bp2, uint16_t sport, uint16_t dport)
+{
+        struct nd_profile_frame frame;
+
+        ND_PROFILE_ENTER(ndo, &frame, length);
+        tcp_port_dispatch(ndo, bp, length, bp2, sport, dport);
+        ND_PROFILE_LEAVE(ndo, &frame);
 }
 
 /*
@@ -39,6 +39,7 @@
 #include "rpc_msg.h"
 
 #include "nfs.h"
+#include "portmap.h"
 
 
 struct rtcphdr {
@@ -303,22 +304,39 @@ udpipaddr_print(netdissect_options *ndo,
                 const struct ip *ip, const uint16_t sport, const uint16_t dport)
 {
 	const struct ip6_hdr *ip6 = (const struct ip6_hdr *)ip;
+	const char *src = NULL, *dst = NULL;
 
-	if (IP_V(ip) == 4 && GET_U_1(ip->ip_p) == IPPROTO_UDP) {
-		ND_PRINT("%s.%s > %s.%s: ",
-			GET_IPADDR_STRING(ip->ip_src),
-			udpport_string(ndo, sport),
-			GET_IPADDR_STRING(ip->ip_dst),
-			udpport_string(ndo, dport));
-	} else if (IP_V(ip) == 6 && GET_U_1(ip6->ip6_nxt) == IPPROTO_UDP) {
-		ND_PRINT("%s.%s > %s.%s: ",
-			GET_IP6ADDR_STRING(ip6->ip6_src),
-			udpport_string(ndo, sport),
-			GET_IP6ADDR_STRING(ip6->ip6_dst),
-			udpport_string(ndo, dport));
-	} else
-		ND_PRINT("%s > %s: ",
-			udpport_string(ndo, sport), udpport_string(ndo, dport));
+	/*
+	 * This is printed for every UDP packet, so append the fields
+	 * directly rather than formatting them with ND_PRINT().  The
+	 * IP header has been checked by its printer; check it once
+	 * rather than for each field.
+	 */
+	if (IP_V(ip) == 4) {
+		ND_VIEW_CHECK(ip, IP_HDRLEN);
+		if (V_U_1(ip->ip_p) == IPPROTO_UDP) {
+			src = V_IPADDR_STRING(ip->ip_src);
+			dst = V_IPADDR_STRING(ip->ip_dst);
+		}
+	} else if (IP_V(ip) == 6) {
+		ND_VIEW_CHECK(ip6, IP6_HDRLEN);
+		if (V_U_1(ip6->ip6_nxt) == IPPROTO_UDP) {
+			src = V_IP6ADDR_STRING(ip6->ip6_src);
+			dst = V_IP6ADDR_STRING(ip6->ip6_dst);
+		}
+	}
+	if (src != NULL) {
+		nd_out_str(ndo, src);
+		nd_out_char(ndo, '.');
+	}
+	nd_out_str(ndo, udpport_string(ndo, sport));
+	nd_out_bytes(ndo, " > ", 3);
+	if (dst != NULL) {
+		nd_out_str(ndo, dst);
+		nd_out_char(ndo, '.');
+	}
+	nd_out_str(ndo, udpport_string(ndo, dport));
+	nd_out_bytes(ndo, ": ", 2);
 }
 
 static void
@@ -337,6 +355,414 @@ udpipaddr_noport_print(netdissect_options *ndo, const struct ip *ip)
 	}
 }
 
+/*
+ * The printers of UDP data chosen by port; see portmap.h.
+ */
+enum udp_app {
+	UDP_APP_NONE,
+	UDP_APP_AHCP,
+	UDP_APP_AODV,
+	UDP_APP_BABEL,
+	UDP_APP_BCM_LI,
+	UDP_APP_BFD,
+	UDP_APP_BOOTP,
+	UDP_APP_CISCO_AUTORP,
+	UDP_APP_CNFP,
+	UDP_APP_DHCP6,
+	UDP_APP_DOMAIN,
+	UDP_APP_GENEVE,
+	UDP_APP_HNCP,
+	UDP_APP_HSRP,
+	UDP_APP_ISAKMP,
+	UDP_APP_ISAKMP_NATT,
+	UDP_APP_KIP,
+	UDP_APP_KRB,
+	UDP_APP_L2TP,
+	UDP_APP_LDP,
+	UDP_APP_LISP,
+	UDP_APP_LMP,
+	UDP_APP_LSPPING,
+	UDP_APP_LWAPP,
+	UDP_APP_LWAPP_CONTROL,
+	UDP_APP_LWRES,
+	UDP_APP_MDNS,
+	UDP_APP_MPLS,
+	UDP_APP_NBT_DGRAM,
+	UDP_APP_NBT_NS,
+	UDP_APP_NTP,
+	UDP_APP_OLSR,
+	UDP_APP_PGM,
+	UDP_APP_PTP,
+	UDP_APP_QUIC,
+	UDP_APP_RADIUS,
+	UDP_APP_RIP,
+	UDP_APP_RIPNG,
+	UDP_APP_RTCP,
+	UDP_APP_RTP,
+	UDP_APP_RX,
+	UDP_APP_SBFD_REFLECTED,		/* source port of a BFD reflector */
+	UDP_APP_SFLOW,
+	UDP_APP_SIP,
+	UDP_APP_SNMP,
+	UDP_APP_SOMEIP,
+	UDP_APP_SYSLOG,
+	UDP_APP_TFTP,
+	UDP_APP_TIMED,
+	UDP_APP_VAT,
+	UDP_APP_VQP,
+	UDP_APP_VXLAN,
+	UDP_APP_VXLAN_GPE,
+	UDP_APP_WB,
+	UDP_APP_ZEP,
+	UDP_APP_ZEPHYR
+};
+
+static const struct tok udp_app_names[] = {
+	{ UDP_APP_AHCP,		"ahcp" },
+	{ UDP_APP_AODV,		"aodv" },
+	{ UDP_APP_BABEL,	"babel" },
+	{ UDP_APP_BCM_LI,	"bcm-li" },
+	{ UDP_APP_BFD,		"bfd" },
+	{ UDP_APP_BOOTP,	"bootp" },
+	{ UDP_APP_CISCO_AUTORP,	"cisco-autorp" },
+	{ UDP_APP_CNFP,		"cnfp" },
+	{ UDP_APP_DHCP6,	"dhcp6" },
+	{ UDP_APP_DOMAIN,	"domain" },
+	{ UDP_APP_GENEVE,	"geneve" },
+	{ UDP_APP_HNCP,		"hncp" },
+	{ UDP_APP_HSRP,		"hsrp" },
+	{ UDP_APP_ISAKMP,	"isakmp" },
+	{ UDP_APP_ISAKMP_NATT,	"isakmp-natt" },
+	{ UDP_APP_KIP,		"kip" },
+	{ UDP_APP_KRB,		"krb" },
+	{ UDP_APP_L2TP,		"l2tp" },
+	{ UDP_APP_LDP,		"ldp" },
+	{ UDP_APP_LISP,		"lisp" },
+	{ UDP_APP_LMP,		"lmp" },
+	{ UDP_APP_LSPPING,	"lspping" },
+	{ UDP_APP_LWAPP,	"lwapp" },
+	{ UDP_APP_LWAPP_CONTROL,	"lwapp-control" },
+	{ UDP_APP_LWRES,	"lwres" },
+	{ UDP_APP_MDNS,		"mdns" },
+	{ UDP_APP_MPLS,		"mpls" },
+#ifdef ENABLE_SMB
+	{ UDP_APP_NBT_DGRAM,	"netbios-dgm" },
+	{ UDP_APP_NBT_NS,	"netbios-ns" },
+#endif
+	{ UDP_APP_NTP,		"ntp" },
+	{ UDP_APP_OLSR,		"olsr" },
+	{ UDP_APP_PGM,		"pgm" },
+	{ UDP_APP_PTP,		"ptp" },
+	{ UDP_APP_QUIC,		"quic" },
+	{ UDP_APP_RADIUS,	"radius" },
+	{ UDP_APP_RIP,		"rip" },
+	{ UDP_APP_RIPNG,	"ripng" },
+	{ UDP_APP_RTCP,		"rtcp" },
+	{ UDP_APP_RTP,		"rtp" },
+	{ UDP_APP_RX,		"rx" },
+	{ UDP_APP_SFLOW,	"sflow" },
+	{ UDP_APP_SIP,		"sip" },
+	{ UDP_APP_SNMP,		"snmp" },
+	{ UDP_APP_SOMEIP,	"someip" },
+	{ UDP_APP_SYSLOG,	"syslog" },
+	{ UDP_APP_TFTP,		"tftp" },
+	{ UDP_APP_TIMED,	"timed" },
+	{ UDP_APP_VAT,		"vat" },
+	{ UDP_APP_VQP,		"vqp" },
+	{ UDP_APP_VXLAN,	"vxlan" },
+	{ UDP_APP_VXLAN_GPE,	"vxlan-gpe" },
+	{ UDP_APP_WB,		"wb" },
+	{ UDP_APP_ZEP,		"zep" },
+	{ UDP_APP_ZEPHYR,	"zephyr" },
+	{ 0, NULL }
+};
+
+/*
+ * The built-in rules, in the order in which they're tried.
+ */
+#define UDP_RULE(port, dir, app)	{ (port), (port), (dir), (app) }
+static const struct nd_port_rule udp_port_rules[] = {
+	UDP_RULE(NAMESERVER_PORT,	ND_PORT_ANY, UDP_APP_DOMAIN),
+	UDP_RULE(BOOTPC_PORT,		ND_PORT_ANY, UDP_APP_BOOTP),
+	UDP_RULE(BOOTPS_PORT,		ND_PORT_ANY, UDP_APP_BOOTP),
+	UDP_RULE(TFTP_PORT,		ND_PORT_ANY, UDP_APP_TFTP),
+	UDP_RULE(KERBEROS_PORT,		ND_PORT_ANY, UDP_APP_KRB),
+	UDP_RULE(NTP_PORT,		ND_PORT_ANY, UDP_APP_NTP),
+#ifdef ENABLE_SMB
+	UDP_RULE(NETBIOS_NS_PORT,	ND_PORT_ANY, UDP_APP_NBT_NS),
+	UDP_RULE(NETBIOS_DGRAM_PORT,	ND_PORT_ANY, UDP_APP_NBT_DGRAM),
+#endif
+	UDP_RULE(SNMP_PORT,		ND_PORT_ANY, UDP_APP_SNMP),
+	UDP_RULE(SNMPTRAP_PORT,		ND_PORT_ANY, UDP_APP_SNMP),
+	UDP_RULE(PTP_EVENT_PORT,	ND_PORT_ANY, UDP_APP_PTP),
+	UDP_RULE(PTP_GENERAL_PORT,	ND_PORT_ANY, UDP_APP_PTP),
+	UDP_RULE(CISCO_AUTORP_PORT,	ND_PORT_ANY, UDP_APP_CISCO_AUTORP),
+	UDP_RULE(ISAKMP_PORT,		ND_PORT_ANY, UDP_APP_ISAKMP),
+	UDP_RULE(SYSLOG_PORT,		ND_PORT_ANY, UDP_APP_SYSLOG),
+	UDP_RULE(RIP_PORT,		ND_PORT_ANY, UDP_APP_RIP),
+	UDP_RULE(RIPNG_PORT,		ND_PORT_ANY, UDP_APP_RIPNG),
+	UDP_RULE(TIMED_PORT,		ND_PORT_ANY, UDP_APP_TIMED),
+	UDP_RULE(DHCP6_SERV_PORT,	ND_PORT_ANY, UDP_APP_DHCP6),
+	UDP_RULE(DHCP6_CLI_PORT,	ND_PORT_ANY, UDP_APP_DHCP6),
+	UDP_RULE(LDP_PORT,		ND_PORT_ANY, UDP_APP_LDP),
+	UDP_RULE(AODV_PORT,		ND_PORT_ANY, UDP_APP_AODV),
+	UDP_RULE(OLSR_PORT,		ND_PORT_ANY, UDP_APP_OLSR),
+	UDP_RULE(LMP_PORT,		ND_PORT_ANY, UDP_APP_LMP),
+	UDP_RULE(KERBEROS_SEC_PORT,	ND_PORT_ANY, UDP_APP_KRB),
+	UDP_RULE(LWRES_PORT,		ND_PORT_ANY, UDP_APP_LWRES),
+	UDP_RULE(MULTICASTDNS_PORT,	ND_PORT_ANY, UDP_APP_MDNS),
+	UDP_RULE(ISAKMP_PORT_NATT,	ND_PORT_ANY, UDP_APP_ISAKMP_NATT),
+	UDP_RULE(ISAKMP_PORT_USER1,	ND_PORT_ANY, UDP_APP_ISAKMP),
+	UDP_RULE(ISAKMP_PORT_USER2,	ND_PORT_ANY, UDP_APP_ISAKMP),
+	UDP_RULE(L2TP_PORT,		ND_PORT_ANY, UDP_APP_L2TP),
+	UDP_RULE(VAT_PORT,		ND_PORT_DST, UDP_APP_VAT),
+	UDP_RULE(ZEPHYR_SRV_PORT,	ND_PORT_ANY, UDP_APP_ZEPHYR),
+	UDP_RULE(ZEPHYR_CLT_PORT,	ND_PORT_ANY, UDP_APP_ZEPHYR),
+	{ RX_PORT_LOW, RX_PORT_HIGH,	ND_PORT_ANY, UDP_APP_RX },
+	UDP_RULE(AHCP_PORT,		ND_PORT_ANY, UDP_APP_AHCP),
+	UDP_RULE(BABEL_PORT,		ND_PORT_ANY, UDP_APP_BABEL),
+	UDP_RULE(BABEL_PORT_OLD,	ND_PORT_ANY, UDP_APP_BABEL),
+	UDP_RULE(HNCP_PORT,		ND_PORT_ANY, UDP_APP_HNCP),
+	/*
+	 * Kludge in test for whiteboard packets.
+	 */
+	UDP_RULE(WB_PORT,		ND_PORT_DST, UDP_APP_WB),
+	UDP_RULE(RADIUS_PORT,		ND_PORT_ANY, UDP_APP_RADIUS),
+	UDP_RULE(RADIUS_NEW_PORT,	ND_PORT_ANY, UDP_APP_RADIUS),
+	UDP_RULE(RADIUS_ACCOUNTING_PORT, ND_PORT_ANY, UDP_APP_RADIUS),
+	UDP_RULE(RADIUS_NEW_ACCOUNTING_PORT, ND_PORT_ANY, UDP_APP_RADIUS),
+	UDP_RULE(RADIUS_CISCO_COA_PORT,	ND_PORT_ANY, UDP_APP_RADIUS),
+	UDP_RULE(RADIUS_COA_PORT,	ND_PORT_ANY, UDP_APP_RADIUS),
+	UDP_RULE(HSRP_PORT,		ND_PORT_DST, UDP_APP_HSRP),
+	UDP_RULE(MPLS_LSP_PING_PORT,	ND_PORT_ANY, UDP_APP_LSPPING),
+	UDP_RULE(BFD_CONTROL_PORT,	ND_PORT_DST, UDP_APP_BFD),
+	UDP_RULE(BFD_MULTIHOP_PORT,	ND_PORT_DST, UDP_APP_BFD),
+	UDP_RULE(BFD_LAG_PORT,		ND_PORT_DST, UDP_APP_BFD),
+	UDP_RULE(SBFD_PORT,		ND_PORT_DST, UDP_APP_BFD),
+	UDP_RULE(BFD_ECHO_PORT,		ND_PORT_DST, UDP_APP_BFD),
+	UDP_RULE(SBFD_PORT,		ND_PORT_SRC, UDP_APP_SBFD_REFLECTED),
+	UDP_RULE(VQP_PORT,		ND_PORT_ANY, UDP_APP_VQP),
+	UDP_RULE(SFLOW_PORT,		ND_PORT_ANY, UDP_APP_SFLOW),
+	UDP_RULE(LWAPP_CONTROL_PORT,	ND_PORT_DST, UDP_APP_LWAPP_CONTROL),
+	UDP_RULE(LWAPP_CONTROL_PORT,	ND_PORT_SRC, UDP_APP_LWAPP),
+	UDP_RULE(LWAPP_DATA_PORT,	ND_PORT_ANY, UDP_APP_LWAPP),
+	UDP_RULE(SIP_PORT,		ND_PORT_ANY, UDP_APP_SIP),
+	UDP_RULE(VXLAN_LINUX_PORT,	ND_PORT_ANY, UDP_APP_VXLAN),
+	UDP_RULE(VXLAN_PORT,		ND_PORT_ANY, UDP_APP_VXLAN),
+	UDP_RULE(GENEVE_PORT,		ND_PORT_DST, UDP_APP_GENEVE),
+	UDP_RULE(LISP_CONTROL_PORT,	ND_PORT_ANY, UDP_APP_LISP),
+	UDP_RULE(VXLAN_GPE_PORT,	ND_PORT_ANY, UDP_APP_VXLAN_GPE),
+	UDP_RULE(ZEP_PORT,		ND_PORT_ANY, UDP_APP_ZEP),
+	UDP_RULE(MPLS_PORT,		ND_PORT_ANY, UDP_APP_MPLS),
+	/* The ports for which atalk_port() is true */
+	{ 16512, 16512 + 127,		ND_PORT_ANY, UDP_APP_KIP },
+	{ 200, 200 + 127,		ND_PORT_ANY, UDP_APP_KIP },
+	{ 768, 768 + 127,		ND_PORT_ANY, UDP_APP_KIP },
+	UDP_RULE(SOMEIP_PORT,		ND_PORT_ANY, UDP_APP_SOMEIP),
+	UDP_RULE(HTTPS_PORT,		ND_PORT_ANY, UDP_APP_QUIC),
+	UDP_RULE(BCM_LI_PORT,		ND_PORT_SRC, UDP_APP_BCM_LI),
+	{ 0, 0, 0, UDP_APP_NONE }
+};
+
+struct nd_port_map udp_port_map =
+	ND_PORT_MAP_INIT("udp", udp_app_names, udp_port_rules);
+
+/*
+ * Print the data with the printer of a rule; returns 0, having printed
+ * nothing, if the data isn't for that printer after all.
+ */
+static int
+udp_app_print(netdissect_options *ndo, u_int app, const u_char *cp,
+	      u_int length, const u_char *bp2, uint16_t sport, uint16_t dport,
+	      int fragmented, u_int ttl_hl)
+{
+	const struct ip *ip = (const struct ip *)bp2;
+
+	switch (app) {
+
+	case UDP_APP_DOMAIN:
+		/* over_tcp: FALSE, is_mdns: FALSE */
+		domain_print(ndo, cp, length, FALSE, FALSE);
+		break;
+	case UDP_APP_BOOTP:
+		bootp_print(ndo, cp, length);
+		break;
+	case UDP_APP_TFTP:
+		tftp_print(ndo, cp, length);
+		break;
+	case UDP_APP_KRB:
+		krb_print(ndo, (const u_char *)cp);
+		break;
+	case UDP_APP_NTP:
+		ntp_print(ndo, cp, length);
+		break;
+#ifdef ENABLE_SMB
+	case UDP_APP_NBT_NS:
+		nbt_udp137_print(ndo, cp, length);
+		break;
+	case UDP_APP_NBT_DGRAM:
+		nbt_udp138_print(ndo, cp, length);
+		break;
+#endif
+	case UDP_APP_SNMP:
+		snmp_print(ndo, cp, length);
+		break;
+	case UDP_APP_PTP:
+		ptp_print(ndo, cp, length);
+		break;
+	case UDP_APP_CISCO_AUTORP:
+		cisco_autorp_print(ndo, cp, length);
+		break;
+	case UDP_APP_ISAKMP:
+		isakmp_print(ndo, cp, length, bp2);
+		break;
+	case UDP_APP_SYSLOG:
+		syslog_print(ndo, cp, length);
+		break;
+	case UDP_APP_RIP:
+		rip_print(ndo, cp, length);
+		break;
+	case UDP_APP_RIPNG:
+		ripng_print(ndo, cp, length);
+		break;
+	case UDP_APP_TIMED:
+		timed_print(ndo, (const u_char *)cp);
+		break;
+	case UDP_APP_DHCP6:
+		dhcp6_print(ndo, cp, length);
+		break;
+	case UDP_APP_LDP:
+		ldp_print(ndo, cp, length);
+		break;
+	case UDP_APP_AODV:
+		aodv_print(ndo, cp, length, IP_V(ip) == 6);
+		break;
+	case UDP_APP_OLSR:
+		olsr_print(ndo, cp, length, IP_V(ip) == 6);
+		break;
+	case UDP_APP_LMP:
+		lmp_print(ndo, cp, length);
+		break;
+	case UDP_APP_LWRES:
+		lwres_print(ndo, cp, length);
+		break;
+	case UDP_APP_MDNS:
+		/* over_tcp: FALSE, is_mdns: TRUE */
+		domain_print(ndo, cp, length, FALSE, TRUE);
+		break;
+	case UDP_APP_ISAKMP_NATT:
+		isakmp_rfc3948_print(ndo, cp, length, bp2, IP_V(ip), fragmented, ttl_hl);
+		break;
+	case UDP_APP_L2TP:
+		l2tp_print(ndo, cp, length);
+		break;
+	case UDP_APP_VAT:
+		vat_print(ndo, cp, length);
+		break;
+	case UDP_APP_ZEPHYR:
+		zephyr_print(ndo, cp, length);
+		break;
+	case UDP_APP_RX:
+		rx_print(ndo, cp, length, sport, dport,
+			 (const u_char *) ip);
+		break;
+	case UDP_APP_AHCP:
+		ahcp_print(ndo, cp, length);
+		break;
+	case UDP_APP_BABEL:
+		babel_print(ndo, cp, length);
+		break;
+	case UDP_APP_HNCP:
+		hncp_print(ndo, cp, length);
+		break;
+	case UDP_APP_WB:
+		wb_print(ndo, cp, length);
+		break;
+	case UDP_APP_RADIUS:
+		radius_print(ndo, cp, length);
+		break;
+	case UDP_APP_HSRP:
+		hsrp_print(ndo, cp, length);
+		break;
+	case UDP_APP_LSPPING:
+		lspping_print(ndo, cp, length);
+		break;
+	case UDP_APP_BFD:
+		bfd_print(ndo, cp, length, dport);
+		break;
+	case UDP_APP_SBFD_REFLECTED:
+		bfd_print(ndo, cp, length, sport);
+		break;
+	case UDP_APP_VQP:
+		vqp_print(ndo, cp, length);
+		break;
+	case UDP_APP_SFLOW:
+		sflow_print(ndo, cp, length);
+		break;
+	case UDP_APP_LWAPP_CONTROL:
+		lwapp_print(ndo, cp, length, 1);
+		break;
+	case UDP_APP_LWAPP:
+		lwapp_print(ndo, cp, length, 0);
+		break;
+	case UDP_APP_SIP:
+		sip_print(ndo, cp, length);
+		break;
+	case UDP_APP_VXLAN:
+		vxlan_print(ndo, cp, length);
+		break;
+	case UDP_APP_GENEVE:
+		geneve_print(ndo, cp, length);
+		break;
+	case UDP_APP_LISP:
+		lisp_print(ndo, cp, length);
+		break;
+	case UDP_APP_VXLAN_GPE:
+		vxlan_gpe_print(ndo, cp, length);
+		break;
+	case UDP_APP_ZEP:
+		zep_print(ndo, cp, length);
+		break;
+	case UDP_APP_MPLS:
+		mpls_print(ndo, cp, length);
+		break;
+	case UDP_APP_KIP:
+		if (GET_U_1(((const struct LAP *)cp)->type) != lapDDP)
+			return 0;
+		if (ndo->ndo_vflag)
+			ND_PRINT("kip ");
+		llap_print(ndo, cp, length);
+		break;
+	case UDP_APP_SOMEIP:
+		someip_print(ndo, cp, length);
+		break;
+	case UDP_APP_QUIC:
+		if (!quic_detect(ndo, cp, length))
+			return 0;
+		quic_print(ndo, cp);
+		break;
+	case UDP_APP_BCM_LI:
+		bcm_li_print(ndo, cp, length);
+		break;
+	case UDP_APP_RTP:
+		rtp_print(ndo, cp, length);
+		break;
+	case UDP_APP_RTCP:
+		while (cp < ndo->ndo_snapend)
+			cp = rtcp_print(ndo, cp);
+		break;
+	case UDP_APP_CNFP:
+		cnfp_print(ndo, cp);
+		break;
+	case UDP_APP_PGM:
+		pgm_print(ndo, cp, length, bp2);
+		break;
+	default:
+		return 0;
+	}
+	return 1;
+}
+
 void
 udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
 	  const u_char *bp2, int fragmented, u_int ttl_hl)
@@ -349,6 +775,9 @@ udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
 	u_int ulen;
 	uint16_t udp_sum;
 	const struct ip6_hdr *ip6;
+	int recorded;
+	u_int rule;
+	struct nd_profile_frame frame;
 
 	ndo->ndo_protocol = "udp";
 	up = (const struct udphdr *)bp;
@@ -367,9 +796,19 @@ udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
 	if (ndo->ndo_packettype != PT_RPC)
 		udpipaddr_print(ndo, ip, sport, dport);
 
+	/*
+	 * If we're recording the fields of the packet, and this is
+	 * the UDP header of the recorded IP packet, the text starts
+	 * after the addresses and ports.
+	 */
+	recorded = nd_record_l4(ndo, ND_REC_UDP, bp2, sport, dport);
+	if (recorded)
+		nd_record_text_start(ndo);
+
 	ND_ICHECKMSG_ZU("undersized-udp", length, <, sizeof(struct udphdr));
-	ulen = GET_BE_U_2(up->uh_ulen);
-	udp_sum = GET_BE_U_2(up->uh_sum);
+	ND_VIEW_CHECK(up, UDP_HDRLEN);
+	ulen = V_BE_U_2(up->uh_ulen);
+	udp_sum = V_BE_U_2(up->uh_sum);
 	/*
 	 * IPv6 Jumbo Datagrams; see RFC 2675.
 	 * If the length is zero, and the length provided to us is
@@ -381,6 +820,8 @@ udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
 			sizeof(struct udphdr));
 	ulen -= sizeof(struct udphdr);
 	length -= sizeof(struct udphdr);
+	if (recorded)
+		ndo->ndo_record.nr_l4_len = ulen;
 	if (ulen < length)
 		length = ulen;
 
@@ -535,153 +976,21 @@ udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
 	}
 
 	if (!ndo->ndo_qflag) {
-		if (IS_SRC_OR_DST_PORT(NAMESERVER_PORT))
-			/* over_tcp: FALSE, is_mdns: FALSE */
-			domain_print(ndo, cp, length, FALSE, FALSE);
-		else if (IS_SRC_OR_DST_PORT(BOOTPC_PORT) ||
-			 IS_SRC_OR_DST_PORT(BOOTPS_PORT))
-			bootp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(TFTP_PORT))
-			tftp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(KERBEROS_PORT))
-			krb_print(ndo, (const u_char *)cp);
-		else if (IS_SRC_OR_DST_PORT(NTP_PORT))
-			ntp_print(ndo, cp, length);
-#ifdef ENABLE_SMB
-		else if (IS_SRC_OR_DST_PORT(NETBIOS_NS_PORT))
-			nbt_udp137_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(NETBIOS_DGRAM_PORT))
-			nbt_udp138_print(ndo, cp, length);
-#endif
-		else if (IS_SRC_OR_DST_PORT(SNMP_PORT) ||
-			 IS_SRC_OR_DST_PORT(SNMPTRAP_PORT))
-			snmp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(PTP_EVENT_PORT) ||
-			 IS_SRC_OR_DST_PORT(PTP_GENERAL_PORT))
-			ptp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(CISCO_AUTORP_PORT))
-			cisco_autorp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(ISAKMP_PORT))
-			 isakmp_print(ndo, cp, length, bp2);
-		else if (IS_SRC_OR_DST_PORT(SYSLOG_PORT))
-			syslog_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(RIP_PORT))
-			rip_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(RIPNG_PORT))
-			ripng_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(TIMED_PORT))
-			timed_print(ndo, (const u_char *)cp);
-		else if (IS_SRC_OR_DST_PORT(DHCP6_SERV_PORT) ||
-			 IS_SRC_OR_DST_PORT(DHCP6_CLI_PORT))
-			dhcp6_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(LDP_PORT))
-			ldp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(AODV_PORT))
-			aodv_print(ndo, cp, length, IP_V(ip) == 6);
-		else if (IS_SRC_OR_DST_PORT(OLSR_PORT))
-			olsr_print(ndo, cp, length, IP_V(ip) == 6);
-		else if (IS_SRC_OR_DST_PORT(LMP_PORT))
-			lmp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(KERBEROS_SEC_PORT))
-			krb_print(ndo, (const u_char *)cp);
-		else if (IS_SRC_OR_DST_PORT(LWRES_PORT))
-			lwres_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(MULTICASTDNS_PORT))
-			/* over_tcp: FALSE, is_mdns: TRUE */
-			domain_print(ndo, cp, length, FALSE, TRUE);
-		else if (IS_SRC_OR_DST_PORT(ISAKMP_PORT_NATT))
-			 isakmp_rfc3948_print(ndo, cp, length, bp2, IP_V(ip), fragmented, ttl_hl);
-		else if (IS_SRC_OR_DST_PORT(ISAKMP_PORT_USER1) || IS_SRC_OR_DST_PORT(ISAKMP_PORT_USER2))
-			isakmp_print(ndo, cp, length, bp2);
-		else if (IS_SRC_OR_DST_PORT(L2TP_PORT))
-			l2tp_print(ndo, cp, length);
-		else if (dport == VAT_PORT)
-			vat_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(ZEPHYR_SRV_PORT) || IS_SRC_OR_DST_PORT(ZEPHYR_CLT_PORT))
-			zephyr_print(ndo, cp, length);
-		/*
-		 * Since there are 10 possible ports to check, I think
-		 * a <> test would be more efficient
-		 */
-		else if ((sport >= RX_PORT_LOW && sport <= RX_PORT_HIGH) ||
-			 (dport >= RX_PORT_LOW && dport <= RX_PORT_HIGH))
-			rx_print(ndo, cp, length, sport, dport,
-				 (const u_char *) ip);
-		else if (IS_SRC_OR_DST_PORT(AHCP_PORT))
-			ahcp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(BABEL_PORT) || IS_SRC_OR_DST_PORT(BABEL_PORT_OLD))
-			babel_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(HNCP_PORT))
-			hncp_print(ndo, cp, length);
-		/*
-		 * Kludge in test for whiteboard packets.
-		 */
-		else if (dport == WB_PORT)
-			wb_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(RADIUS_PORT) ||
-			 IS_SRC_OR_DST_PORT(RADIUS_NEW_PORT) ||
-			 IS_SRC_OR_DST_PORT(RADIUS_ACCOUNTING_PORT) ||
-			 IS_SRC_OR_DST_PORT(RADIUS_NEW_ACCOUNTING_PORT) ||
-			 IS_SRC_OR_DST_PORT(RADIUS_CISCO_COA_PORT) ||
-			 IS_SRC_OR_DST_PORT(RADIUS_COA_PORT) )
-			radius_print(ndo, cp, length);
-		else if (dport == HSRP_PORT)
-			hsrp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(MPLS_LSP_PING_PORT))
-			lspping_print(ndo, cp, length);
-		else if (dport == BFD_CONTROL_PORT ||
-			 dport == BFD_MULTIHOP_PORT ||
-			 dport == BFD_LAG_PORT ||
-			 dport == SBFD_PORT ||
-			 dport == BFD_ECHO_PORT )
-			bfd_print(ndo, cp, length, dport);
-		else if (sport == SBFD_PORT)
-			bfd_print(ndo, cp, length, sport);
-		else if (IS_SRC_OR_DST_PORT(VQP_PORT))
-			vqp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(SFLOW_PORT))
-			sflow_print(ndo, cp, length);
-		else if (dport == LWAPP_CONTROL_PORT)
-			lwapp_print(ndo, cp, length, 1);
-		else if (sport == LWAPP_CONTROL_PORT)
-			lwapp_print(ndo, cp, length, 0);
-		else if (IS_SRC_OR_DST_PORT(LWAPP_DATA_PORT))
-			lwapp_print(ndo, cp, length, 0);
-		else if (IS_SRC_OR_DST_PORT(SIP_PORT))
-			sip_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(VXLAN_LINUX_PORT))
-			vxlan_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(VXLAN_PORT))
-			vxlan_print(ndo, cp, length);
-		else if (dport == GENEVE_PORT)
-			geneve_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(LISP_CONTROL_PORT))
-			lisp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(VXLAN_GPE_PORT))
-			vxlan_gpe_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(ZEP_PORT))
-			zep_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(MPLS_PORT))
-			mpls_print(ndo, cp, length);
-		else if ((atalk_port(sport) || atalk_port(dport)) &&
-			 GET_U_1(((const struct LAP *)cp)->type) == lapDDP) {
-			if (ndo->ndo_vflag)
-				ND_PRINT("kip ");
-			llap_print(ndo, cp, length);
-		} else if (IS_SRC_OR_DST_PORT(SOMEIP_PORT))
-			someip_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(HTTPS_PORT) &&
-			 quic_detect(ndo, cp, length))
-			quic_print(ndo, cp);
-		else if (sport == BCM_LI_PORT)
-			bcm_li_print(ndo, cp, length);
-		else {
+		ND_PROFILE_ENTER(ndo, &frame, length);
+		rule = nd_port_map_first(&udp_port_map, sport, dport);
+		while (rule != 0 &&
+		       !udp_app_print(ndo, nd_port_map_app(&udp_port_map, rule),
+				      cp, length, bp2, sport, dport, fragmented,
+				      ttl_hl))
+			rule = nd_port_map_next(&udp_port_map, rule, sport, dport);
+		if (rule == 0) {
 			if (ulen > length && !fragmented)
 				ND_PRINT("UDP, bad length %u > %u",
 				    ulen, length);
 			else
 				ND_PRINT("UDP, length %u", ulen);
 		}
+		ND_PROFILE_LEAVE(ndo, &frame);
 	} else {
 		if (ulen > length && !fragmented)
 			ND_PRINT("UDP, bad length %u > %u",
@@ -37,6 +37,7 @@
 #include "addrtoname.h"
 #include "print.h"
 #include "netdissect-alloc.h"
+#include "portmap.h"
 
 struct printer {
 	if_printer f;
@@ -244,6 +245,7 @@ void
 init_print(netdissect_options *ndo, uint32_t localnet, uint32_t mask)
 {
 	init_addrtoname(ndo, localnet, mask);
+	nd_port_map_init();
 }
 
 if_printer
@@ -312,6 +314,14 @@ pretty_print_packet(netdissect_options *ndo, const struct pcap_pkthdr *h,
 	u_int hdrlen = 0;
 	int invalid_header = 0;
 
+	/*
+	 * State kept across packets expires against the latest time
+	 * stamp so far, as time stamps can go backwards; with --threads,
+	 * the reader has set it to that of the packets it has read.
+	 */
+	if (h->ts.tv_sec > ndo->ndo_latest_time)
+		ndo->ndo_latest_time = h->ts.tv_sec;
+
 	if (ndo->ndo_print_sampling && packets_captured % ndo->ndo_print_sampling != 0)
 		return;
 
@@ -320,6 +330,12 @@ pretty_print_packet(netdissect_options *ndo, const struct pcap_pkthdr *h,
 		pretty_print_packet_level = profile_func_level;
 #endif
 
+	addrtoname_new_packet(ndo);
+	ndo->ndo_packet_time = h->ts.tv_sec;
+
+	if (ND_RECORDING(ndo))
+		nd_record_begin(ndo, h, packets_captured);
+
 	if (ndo->ndo_packet_number)
 		ND_PRINT("%5u  ", packets_captured);
 
@@ -363,7 +379,13 @@ pretty_print_packet(netdissect_options *ndo, const struct pcap_pkthdr *h,
 		ND_PRINT(" len(%u) > %u", h->len, MAXIMUM_SNAPLEN);
 	}
 	if (invalid_header) {
-		ND_PRINT("]\n");
+		ND_PRINT("]");
+		if (ND_RECORDING(ndo))
+			nd_record_end(ndo);
+		else
+			ND_PRINT("\n");
+		nd_output_flush(ndo);
+		nd_free_all(ndo);
 		return;
 	}
 
@@ -390,6 +412,13 @@ pretty_print_packet(netdissect_options *ndo, const struct pcap_pkthdr *h,
 	tvbuf.tv_usec = h->ts.tv_usec;
 	ts_print(ndo, &tvbuf);
 
+	/*
+	 * The packet number, lengths and time stamp are fields of
+	 * the record.
+	 */
+	if (ND_RECORDING(ndo))
+		nd_record_text_start(ndo);
+
 	/*
 	 * Printers must check that they're not walking off the end of
 	 * the packet.
@@ -401,10 +430,13 @@ pretty_print_packet(netdissect_options *ndo, const struct pcap_pkthdr *h,
 
 	ndo->ndo_protocol = "";
 	ndo->ndo_ll_hdr_len = 0;
+	if (ndo->ndo_profile != NULL)
+		nd_profile_packet_begin(ndo, h->len);
 	switch (setjmp(ndo->ndo_early_end)) {
 	case 0:
 		/* Print the packet. */
-		(ndo->ndo_if_printer)(ndo, h, sp);
+		if (!nd_summary_print(ndo, h, sp))
+			(ndo->ndo_if_printer)(ndo, h, sp);
 		break;
 	case ND_TRUNCATED:
 		/* A printer quit because the packet was truncated; report it */
@@ -417,6 +449,8 @@ pretty_print_packet(netdissect_options *ndo, const struct pcap_pkthdr *h,
 #endif
 		break;
 	}
+	if (ndo->ndo_profile != NULL)
+		nd_profile_packet_end(ndo);
 	hdrlen = ndo->ndo_ll_hdr_len;
 
 	/*
@@ -494,7 +528,11 @@ pretty_print_packet(netdissect_options *ndo, const struct pcap_pkthdr *h,
 		}
 	}
 
-	ND_PRINT("\n");
+	if (ND_RECORDING(ndo))
+		nd_record_end(ndo);
+	else
+		ND_PRINT("\n");
+	nd_output_flush(ndo);
 	nd_free_all(ndo);
 }
 
@@ -514,6 +552,8 @@ ndo_error(netdissect_options *ndo, status_exit_codes_t status,
 {
 	va_list ap;
 
+	/* Don't lose the output for the packet being printed. */
+	nd_output_flush(ndo);
 	if (ndo->program_name)
 		(void)fprintf(stderr, "%s: ", ndo->program_name);
 	va_start(ap, fmt);
@@ -548,6 +588,10 @@ ndo_warning(netdissect_options *ndo, FORMAT_STRING(const char *fmt), ...)
 	}
 }
 
+/*
+ * Format into the output buffer; it's written out by
+ * ndo_output_stdout() once the packet has been printed.
+ */
 /* VARARGS */
 static int PRINTFLIKE(2, 3)
 ndo_printf(netdissect_options *ndo, FORMAT_STRING(const char *fmt), ...)
@@ -556,13 +600,24 @@ ndo_printf(netdissect_options *ndo, FORMAT_STRING(const char *fmt), ...)
 	int ret;
 
 	va_start(args, fmt);
-	ret = vfprintf(stdout, fmt, args);
+	ret = nd_output_vprintf(ndo, fmt, args);
 	va_end(args);
+	return (ret);
+}
 
-	if (ret < 0)
+/*
+ * Write the output buffer to the standard output.
+ */
+static void
+ndo_output_stdout(netdissect_options *ndo)
+{
+	size_t len = ndo->ndo_outbuf_len;
+
+	/* Empty the buffer first, so that ndo_error() doesn't retry. */
+	ndo->ndo_outbuf_len = 0;
+	if (fwrite(ndo->ndo_outbuf, 1, len, stdout) != len)
 		ndo_error(ndo, S_ERR_ND_WRITE_FILE,
 			  "Unable to write output: %s", pcap_strerror(errno));
-	return (ret);
 }
 
 void
@@ -572,4 +627,5 @@ ndo_set_function_pointers(netdissect_options *ndo)
 	ndo->ndo_printf=ndo_printf;
 	ndo->ndo_error=ndo_error;
 	ndo->ndo_warning=ndo_warning;
+	ndo->ndo_output_sink=ndo_output_stdout;
 }
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "resolver.h"
+
+#ifdef RESOLVER_THREAD
+
+#include <pthread.h>
+
+struct request {
+	struct resolver_client *client;
+	int af;
+	u_char addr[16];
+};
+
+struct resolver_client {
+	struct resolver_answer *answers;
+	struct resolver_answer **last_answer;
+};
+
+/*
+ * Everything below is protected by lock.
+ */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static struct request queue[RESOLVER_QUEUE_LEN];
+static u_int queue_first;
+static u_int queue_count;
+static struct resolver_stats stats;
+static int stopping;
+
+/*
+ * Look up the name for an address; returns NULL if there's no name,
+ * or if we're out of memory, which is treated as no name.
+ */
+static char *
+lookup(const struct request *req)
+{
+	struct sockaddr_storage ss;
+	struct sockaddr_in *sin;
+	struct sockaddr_in6 *sin6;
+	socklen_t sslen;
+	char host[NI_MAXHOST];
+
+	memset(&ss, 0, sizeof(ss));
+	if (req->af == AF_INET6) {
+		sin6 = (struct sockaddr_in6 *)&ss;
+		sin6->sin6_family = AF_INET6;
+		memcpy(&sin6->sin6_addr, req->addr, 16);
+		sslen = sizeof(*sin6);
+	} else {
+		sin = (struct sockaddr_in *)&ss;
+		sin->sin_family = AF_INET;
+		memcpy(&sin->sin_addr, req->addr, 4);
+		sslen = sizeof(*sin);
+	}
+	if (getnameinfo((struct sockaddr *)&ss, sslen, host, sizeof(host),
+	    NULL, 0, NI_NAMEREQD) != 0)
+		return NULL;
+	return strdup(host);
+}
+
+static void *
+resolver_main(void *arg _U_)
+{
+	struct request req;
+	struct resolver_answer *ans;
+
+	pthread_mutex_lock(&lock);
+	for (;;) {
+		while (queue_count == 0 && !stopping)
+			pthread_cond_wait(&queue_cond, &lock);
+		if (stopping)
+			break;
+		req = queue[queue_first];
+		queue_first = (queue_first + 1) % RESOLVER_QUEUE_LEN;
+		queue_count--;
+		pthread_mutex_unlock(&lock);
+
+		ans = malloc(sizeof(*ans));
+		if (ans != NULL) {
+			ans->next = NULL;
+			ans->af = req.af;
+			memcpy(ans->addr, req.addr, sizeof(ans->addr));
+			ans->name = lookup(&req);
+		}
+
+		pthread_mutex_lock(&lock);
+		stats.lookups++;
+		if (ans == NULL)
+			continue;
+		if (ans->name != NULL)
+			stats.resolved++;
+		if (stopping) {
+			resolver_answer_free(ans);
+			break;
+		}
+		*req.client->last_answer = ans;
+		req.client->last_answer = &ans->next;
+	}
+	pthread_mutex_unlock(&lock);
+	return NULL;
+}
+
+/*
+ * Start the threads doing the lookups.
+ *
+ * Returns 0 on success and an errno value on failure.
+ */
+int
+resolver_start(void)
+{
+	pthread_attr_t attr;
+	pthread_t thread;
+	int i, err;
+
+	/*
+	 * The threads are detached, as they aren't waited for when
+	 * stopping: a lookup in progress might take a long time.
+	 */
+	err = pthread_attr_init(&attr);
+	if (err != 0)
+		return err;
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	for (i = 0; i < RESOLVER_THREADS; i++) {
+		err = pthread_create(&thread, &attr, resolver_main, NULL);
+		if (err != 0)
+			break;
+	}
+	pthread_attr_destroy(&attr);
+	/* Make do with fewer threads if we have at least one. */
+	return i != 0 ? 0 : err;
+}
+
+/*
+ * Create a client, to request lookups and get their answers; it's used
+ * by one thread.  Returns NULL if we're out of memory.
+ */
+struct resolver_client *
+resolver_client_new(void)
+{
+	struct resolver_client *client;
+
+	client = malloc(sizeof(*client));
+	if (client == NULL)
+		return NULL;
+	client->answers = NULL;
+	client->last_answer = &client->answers;
+	return client;
+}
+
+/*
+ * Queue a lookup of the name for the address at addr, of address family
+ * af, in network byte order.  Returns 1 if it was queued and 0 if the
+ * queue was full.
+ */
+int
+resolver_request(struct resolver_client *client, int af, const void *addr)
+{
+	struct request *req;
+
+	pthread_mutex_lock(&lock);
+	if (queue_count == RESOLVER_QUEUE_LEN || stopping) {
+		stats.dropped++;
+		pthread_mutex_unlock(&lock);
+		return 0;
+	}
+	req = &queue[(queue_first + queue_count) % RESOLVER_QUEUE_LEN];
+	queue_count++;
+	req->client = client;
+	req->af = af;
+	memset(req->addr, 0, sizeof(req->addr));
+	memcpy(req->addr, addr, af == AF_INET6 ? 16 : 4);
+	pthread_cond_signal(&queue_cond);
+	pthread_mutex_unlock(&lock);
+	return 1;
+}
+
+/*
+ * Return the list of answers that have arrived for a client since the
+ * last call, oldest first; the caller frees them with
+ * resolver_answer_free().
+ */
+struct resolver_answer *
+resolver_answers(struct resolver_client *client)
+{
+	struct resolver_answer *answers;
+
+	pthread_mutex_lock(&lock);
+	answers = client->answers;
+	client->answers = NULL;
+	client->last_answer = &client->answers;
+	pthread_mutex_unlock(&lock);
+	return answers;
+}
+
+void
+resolver_answer_free(struct resolver_answer *ans)
+{
+	free(ans->name);
+	free(ans);
+}
+
+void
+resolver_get_stats(struct resolver_stats *sp)
+{
+	pthread_mutex_lock(&lock);
+	*sp = stats;
+	pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Discard the queued lookups and tell the threads to exit; the threads
+ * doing a lookup exit once it's done, and its answer is discarded.
+ */
+void
+resolver_stop(void)
+{
+	pthread_mutex_lock(&lock);
+	stopping = 1;
+	queue_count = 0;
+	pthread_cond_broadcast(&queue_cond);
+	pthread_mutex_unlock(&lock);
+}
+#endif /* RESOLVER_THREAD */
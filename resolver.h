@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef resolver_h
+#define resolver_h
+
+/*
+ * Reverse DNS lookups in the background ("--async-dns").
+ *
+ * Lookups are queued, in a queue of bounded length, to a pool of
+ * threads that call getnameinfo(); if the queue is full, the lookup is
+ * dropped and counted.  Each thread that requests lookups has a
+ * client, to which the answers are handed back, so that the thread
+ * can put them into its own tables of names.
+ */
+#ifdef HAVE_PTHREAD
+#define RESOLVER_THREAD
+
+/* Number of threads doing lookups and length of the queue. */
+#define RESOLVER_THREADS	4
+#define RESOLVER_QUEUE_LEN	1024
+
+/* Default time before a failed lookup is tried again, in seconds. */
+#define RESOLVER_DEFAULT_NEGATIVE_TTL	300
+
+struct resolver_client;
+
+struct resolver_answer {
+	struct resolver_answer *next;
+	int af;				/* AF_INET or AF_INET6 */
+	u_char addr[16];		/* in network byte order */
+	char *name;			/* NULL if the lookup failed */
+};
+
+struct resolver_stats {
+	u_int lookups;			/* lookups done */
+	u_int resolved;			/* lookups that found a name */
+	u_int dropped;			/* lookups dropped, the queue was full */
+};
+
+extern int resolver_start(void);
+extern struct resolver_client *resolver_client_new(void);
+extern int resolver_request(struct resolver_client *, int, const void *);
+extern struct resolver_answer *resolver_answers(struct resolver_client *);
+extern void resolver_answer_free(struct resolver_answer *);
+extern void resolver_get_stats(struct resolver_stats *);
+extern void resolver_stop(void);
+#endif /* HAVE_PTHREAD */
+
+#endif /* resolver_h */
@@ -39,6 +39,9 @@
 
 #define SUNRPC_MSG_VERSION	((uint32_t) 2)
 
+/* Program number of the portmapper */
+#define SUNRPC_PMAPPROG		((uint32_t) 100000)
+
 /*
  * Bottom up definition of an rpc message.
  * NOTE: call and reply use the same overall struct but
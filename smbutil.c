@@ -20,9 +20,9 @@
 #include "extract.h"
 #include "smb.h"
 
-static int stringlen_is_set;
-static uint32_t stringlen;
-extern const u_char *startbuf;
+static ND_THREAD_LOCAL int stringlen_is_set;
+static ND_THREAD_LOCAL uint32_t stringlen;
+extern ND_THREAD_LOCAL const u_char *startbuf;
 
 /*
  * Reset SMB state.
@@ -760,6 +760,7 @@ smb_fdata1(netdissect_options *ndo,
 	case 'T':
 	  {
 	    time_t t;
+	    struct tm tm;
 	    const char *tstring;
 	    char buffer[sizeof("Www Mmm dd hh:mm:ss yyyyy")];
 	    uint32_t x;
@@ -792,7 +793,7 @@ smb_fdata1(netdissect_options *ndo,
 	    }
 	    if (t != 0) {
 		tstring = nd_format_time(buffer, sizeof(buffer), "%Y-%m-%d %T",
-					 localtime(&t));
+					 nd_localtime(&t, &tm));
 	    } else
 		tstring = "NULL";
 	    ND_PRINT("%s\n", tstring);
@@ -823,7 +824,7 @@ smb_fdata(netdissect_options *ndo,
           const u_char *buf, const char *fmt, const u_char *maxbuf,
           int unicodestr)
 {
-    static int depth = 0;
+    static ND_THREAD_LOCAL int depth = 0;
     char s[128];
     char *p;
 
@@ -1052,7 +1053,7 @@ static const struct {
 const char *
 smb_errstr(int class, int num)
 {
-    static char ret[128];
+    static ND_THREAD_LOCAL char ret[128];
     int i, j;
 
     ret[0] = 0;
@@ -1944,7 +1945,7 @@ static const nt_err_code_struct nt_errors[] = {
 const char *
 nt_errstr(uint32_t err)
 {
-    static char ret[128];
+    static ND_THREAD_LOCAL char ret[128];
     int i;
 
     ret[0] = 0;
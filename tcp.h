@@ -49,9 +49,13 @@ struct tcphdr {
 	nd_uint16_t	th_urp;			/* urgent pointer */
 };
 
+#define TCP_HDRLEN	20		/* "struct tcphdr" on the wire */
+
 #define TH_OFF(th)	((GET_U_1((th)->th_offx2) & 0xf0) >> 4)
 #define tcp_get_flags(th)	((GET_U_1((th)->th_flags)) | \
 			((GET_U_1((th)->th_offx2) & 0x0f) << 8))
+#define tcp_v_get_flags(th)	((V_U_1((th)->th_flags)) | \
+			((V_U_1((th)->th_offx2) & 0x0f) << 8))
 
 /* TCP flags */
 #define	TH_FIN     0x01
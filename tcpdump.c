@@ -154,6 +154,16 @@ The Regents of the University of California.  All rights reserved.\n";
 #include "diag-control.h"
 
 #include "fptype.h"
+#include "parallel.h"
+#include "dumpwriter.h"
+#include "zfile.h"
+#include "resolver.h"
+#include "namecache.h"
+#include "flowtable.h"
+#include "ipreasm.h"
+#include "tcpreasm.h"
+#include "portmap.h"
+#include "namedb.h"
 
 #ifndef PATH_MAX
 #define PATH_MAX 1024
@@ -215,6 +225,27 @@ static int immediate_mode;
 #endif
 static int count_mode;
 static u_int packets_to_skip;
+#ifdef PARALLEL_THREADS
+static u_int nthreads;			/* number of dissection threads */
+#endif
+#ifdef DUMPWRITER_THREAD
+static u_int async_write_kb;		/* size of the savefile writer ring */
+#endif
+#ifdef HAVE_ZFILE
+static int compress_method;		/* compress savefiles with this ZFILE_ method */
+static int compress_level;
+#endif
+#ifdef RESOLVER_THREAD
+static int async_dns;			/* look up host names in the background */
+static int dns_negative_ttl = -1;
+#endif
+static const char *name_db_file;	/* --name-db database */
+static const char *build_name_db_file;	/* --build-name-db database */
+static const char *name_db_source;	/* --name-db-source directory */
+static u_int max_flows = ND_FLOW_DEFAULT_MAX;	/* --max-flows */
+static u_int flow_timeout = ND_FLOW_DEFAULT_TIMEOUT; /* --flow-timeout */
+static int flow_stats;			/* --flow-stats */
+static int profile;			/* --profile */
 
 static int infodelay;
 static int infoprint;
@@ -248,6 +279,9 @@ static void print_usage(FILE *);
 static void print_packet(u_char *, const struct pcap_pkthdr *, const u_char *);
 static void dump_packet_and_trunc(u_char *, const struct pcap_pkthdr *, const u_char *);
 static void dump_packet(u_char *, const struct pcap_pkthdr *, const u_char *);
+static void write_dump_packet(u_char *, const struct pcap_pkthdr *, const u_char *);
+static pcap_dumper_t *dump_open(pcap_t *, const char *);
+static pcap_t *open_offline(const char *, int, char *);
 
 #ifdef SIGNAL_REQ_INFO
 static void requestinfo(int);
@@ -265,6 +299,12 @@ static void flushpcap(int);
 #endif /* _WIN32 */
 
 static void info(int);
+static int print_flow_stats(int, int);
+static void print_profile(void);
+static void add_port_map(const char *);
+#ifdef RESOLVER_THREAD
+static void print_resolver_stats(void);
+#endif
 static u_int packets_captured;
 
 static const struct tok status_flags[] = {
@@ -301,6 +341,11 @@ struct dump_info {
 #endif
 };
 
+#ifdef DUMPWRITER_THREAD
+static void flush_dump_file(u_char *);
+static void sync_dump_file(struct dump_info *);
+#endif
+
 #if defined(HAVE_PCAP_SET_PARSER_DEBUG)
 /*
  * We have pcap_set_parser_debug() in libpcap; declare it (it's not declared
@@ -684,6 +729,25 @@ show_remote_devices_and_exit(void)
 #define OPTION_LENGTHS			138
 #define OPTION_TIME_T_SIZE		139
 #define OPTION_SKIP			140
+#define OPTION_THREADS			141
+#define OPTION_OUTPUT_FORMAT		142
+#define OPTION_ASYNC_WRITE		143
+#define OPTION_COMPRESS			144
+#define OPTION_ASYNC_DNS		145
+#define OPTION_DNS_NEGATIVE_TTL		146
+#define OPTION_NAME_CACHE_SIZE		147
+#define OPTION_NAME_DB			148
+#define OPTION_BUILD_NAME_DB		149
+#define OPTION_MAX_FLOWS		150
+#define OPTION_FLOW_TIMEOUT		151
+#define OPTION_RPC_CALLS		152
+#define OPTION_FLOW_STATS		153
+#define OPTION_REASSEMBLE_IP		154
+#define OPTION_REASSEMBLY_MEMORY	155
+#define OPTION_REASSEMBLE_TCP		156
+#define OPTION_PROFILE			157
+#define OPTION_PORT_MAP			158
+#define OPTION_NAME_DB_SOURCE		159
 
 static const struct option longopts[] = {
 	{ "buffer-size", required_argument, NULL, 'B' },
@@ -728,6 +792,33 @@ static const struct option longopts[] = {
 	{ "time-t-size", no_argument, NULL, OPTION_TIME_T_SIZE },
 	{ "ip-oneline", no_argument, NULL, 'g' },
 	{ "skip", required_argument, NULL, OPTION_SKIP },
+	{ "output-format", required_argument, NULL, OPTION_OUTPUT_FORMAT },
+	{ "name-cache-size", required_argument, NULL, OPTION_NAME_CACHE_SIZE },
+	{ "name-db", required_argument, NULL, OPTION_NAME_DB },
+	{ "build-name-db", required_argument, NULL, OPTION_BUILD_NAME_DB },
+	{ "name-db-source", required_argument, NULL, OPTION_NAME_DB_SOURCE },
+	{ "max-flows", required_argument, NULL, OPTION_MAX_FLOWS },
+	{ "flow-timeout", required_argument, NULL, OPTION_FLOW_TIMEOUT },
+	{ "rpc-calls", required_argument, NULL, OPTION_RPC_CALLS },
+	{ "flow-stats", no_argument, NULL, OPTION_FLOW_STATS },
+	{ "reassemble-ip", no_argument, NULL, OPTION_REASSEMBLE_IP },
+	{ "reassemble-tcp", no_argument, NULL, OPTION_REASSEMBLE_TCP },
+	{ "reassembly-memory", required_argument, NULL, OPTION_REASSEMBLY_MEMORY },
+	{ "profile", no_argument, NULL, OPTION_PROFILE },
+	{ "port-map", required_argument, NULL, OPTION_PORT_MAP },
+#ifdef PARALLEL_THREADS
+	{ "threads", required_argument, NULL, OPTION_THREADS },
+#endif
+#ifdef DUMPWRITER_THREAD
+	{ "async-write", required_argument, NULL, OPTION_ASYNC_WRITE },
+#endif
+#ifdef HAVE_ZFILE
+	{ "compress", required_argument, NULL, OPTION_COMPRESS },
+#endif
+#ifdef RESOLVER_THREAD
+	{ "async-dns", no_argument, NULL, OPTION_ASYNC_DNS },
+	{ "dns-negative-ttl", required_argument, NULL, OPTION_DNS_NEGATIVE_TTL },
+#endif
 	{ "version", no_argument, NULL, OPTION_VERSION },
 	{ NULL, 0, NULL, 0 }
 };
@@ -744,6 +835,24 @@ static const struct option longopts[] = {
 #define IMMEDIATE_MODE_USAGE ""
 #endif
 
+#ifdef PARALLEL_THREADS
+#define THREADS_USAGE "[ --threads count ] "
+#else
+#define THREADS_USAGE
+#endif
+
+#ifdef DUMPWRITER_THREAD
+#define ASYNC_WRITE_USAGE "[ --async-write size ] "
+#else
+#define ASYNC_WRITE_USAGE
+#endif
+
+#ifdef HAVE_ZFILE
+#define COMPRESS_USAGE "[ --compress method[:level] ] "
+#else
+#define COMPRESS_USAGE
+#endif
+
 #ifndef _WIN32
 /* Drop root privileges and chroot if necessary */
 static void
@@ -864,6 +973,23 @@ MakeFilename(char *buffer, char *orig_name, int cnt, int max_chars)
                   /* Report an error if the filename is too large */
                   error("too many output files or filename is too long (> %d)", PATH_MAX);
         free(filename);
+#ifdef HAVE_ZFILE
+	/*
+	 * Add the suffix of the compression method, unless it's
+	 * already there.
+	 */
+	if (compress_method != 0 && strcmp(buffer, "-") != 0) {
+		const char *suffix = zfile_suffix(compress_method);
+		size_t len = strlen(buffer), suffix_len = strlen(suffix);
+
+		if (len < suffix_len ||
+		    strcmp(buffer + len - suffix_len, suffix) != 0) {
+			if (len + suffix_len > PATH_MAX)
+				error("filename is too long (> %d)", PATH_MAX);
+			memcpy(buffer + len, suffix, suffix_len + 1);
+		}
+	}
+#endif
 }
 
 static char *
@@ -1484,6 +1610,7 @@ main(int argc, char **argv)
 	const char *yflag_dlt_name = NULL;
 	int print = 0;
 	long Cflagmult;
+	size_t reasm_limit;
 
 	netdissect_options Ndo;
 	netdissect_options *ndo = &Ndo;
@@ -2117,6 +2244,125 @@ main(int argc, char **argv)
 			    optarg, NULL, 0, INT_MAX, 0);
 			break;
 
+		case OPTION_OUTPUT_FORMAT:
+			if (strcmp(optarg, "text") == 0)
+				ndo->ndo_output_format = ND_OUTPUT_TEXT;
+			else if (strcmp(optarg, "json") == 0)
+				ndo->ndo_output_format = ND_OUTPUT_JSON;
+			else if (strcmp(optarg, "binary") == 0)
+				ndo->ndo_output_format = ND_OUTPUT_BINARY;
+			else
+				error("unsupported output format \"%s\"",
+				    optarg);
+			break;
+
+#ifdef PARALLEL_THREADS
+		case OPTION_THREADS:
+			nthreads = parse_u_int("number of threads", optarg,
+			    NULL, 1, PARALLEL_MAX_THREADS, 10);
+			break;
+#endif
+
+#ifdef HAVE_ZFILE
+		case OPTION_COMPRESS: {
+			char *level = strchr(optarg, ':');
+
+			if (level != NULL)
+				*level++ = '\0';
+			compress_method = zfile_method(optarg);
+			if (compress_method == -1)
+				error("unsupported compression method \"%s\"",
+				    optarg);
+			if (level != NULL)
+				compress_level = parse_int("compression level",
+				    level, NULL, 1,
+				    zfile_max_level(compress_method), 10);
+			break;
+		}
+#endif
+
+		case OPTION_NAME_CACHE_SIZE:
+			name_cache_set_limit(parse_u_int("name cache size",
+			    optarg, NULL, NAME_CACHE_MIN_LIMIT_KB,
+			    UINT_MAX / 1024, 10) * (size_t)1024);
+			break;
+
+		case OPTION_NAME_DB:
+			name_db_file = optarg;
+			break;
+
+		case OPTION_BUILD_NAME_DB:
+			build_name_db_file = optarg;
+			break;
+
+		case OPTION_NAME_DB_SOURCE:
+			name_db_source = optarg;
+			break;
+
+		case OPTION_MAX_FLOWS:
+			max_flows = parse_u_int("maximum number of flows",
+			    optarg, NULL, 1, UINT_MAX, 10);
+			break;
+
+		case OPTION_FLOW_TIMEOUT:
+			flow_timeout = parse_u_int("flow timeout", optarg,
+			    NULL, 0, UINT_MAX, 10);
+			break;
+
+		case OPTION_RPC_CALLS:
+			nd_flow_set_type_limit(&sunrpc_call_flow_type,
+			    parse_u_int("number of RPC calls", optarg, NULL,
+			    1, UINT_MAX, 10));
+			break;
+
+		case OPTION_FLOW_STATS:
+			flow_stats = 1;
+			break;
+
+		case OPTION_REASSEMBLE_IP:
+			ndo->ndo_reassemble_ip = 1;
+			break;
+
+		case OPTION_REASSEMBLE_TCP:
+			ndo->ndo_reassemble_tcp = 1;
+			break;
+
+		case OPTION_REASSEMBLY_MEMORY:
+			reasm_limit = parse_u_int("reassembly memory", optarg,
+			    NULL, ND_MAX(IP_REASM_MIN_LIMIT_KB,
+			    TCP_REASM_MIN_LIMIT_KB), UINT_MAX / 1024, 10) *
+			    (size_t)1024;
+			ip_reasm_set_limit(reasm_limit);
+			tcp_reasm_set_limit(reasm_limit);
+			break;
+
+		case OPTION_PROFILE:
+			profile = 1;
+			break;
+
+		case OPTION_PORT_MAP:
+			add_port_map(optarg);
+			break;
+
+#ifdef RESOLVER_THREAD
+		case OPTION_ASYNC_DNS:
+			async_dns = 1;
+			break;
+
+		case OPTION_DNS_NEGATIVE_TTL:
+			dns_negative_ttl = parse_int("negative cache TTL",
+			    optarg, NULL, 0, INT_MAX, 10);
+			break;
+#endif
+
+#ifdef DUMPWRITER_THREAD
+		case OPTION_ASYNC_WRITE:
+			async_write_kb = parse_u_int("savefile writer ring size",
+			    optarg, NULL, DUMPWRITER_MIN_RING_KB,
+			    DUMPWRITER_MAX_RING_KB, 10);
+			break;
+#endif
+
 #ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
 		case OPTION_TSTAMP_MICRO:
 			ndo->ndo_tstamp_precision = PCAP_TSTAMP_PRECISION_MICRO;
@@ -2160,6 +2406,43 @@ main(int argc, char **argv)
 		error("-G cannot be used without -w.");
 	if (count_mode && RFileName == NULL && VFileName == NULL)
 		error("--count cannot be used without -r or -V.");
+#ifdef PARALLEL_THREADS
+	if (nthreads > 1) {
+		if (RFileName == NULL && VFileName == NULL)
+			error("--threads cannot be used without -r or -V.");
+		if (WFileName != NULL)
+			error("--threads cannot be used with -w.");
+		/*
+		 * The resolver routines used to look up names aren't
+		 * necessarily reentrant.
+		 */
+		if (!ndo->ndo_nflag)
+			error("--threads cannot be used without -n.");
+	}
+#endif
+#ifdef DUMPWRITER_THREAD
+	if (async_write_kb != 0 && WFileName == NULL)
+		error("--async-write cannot be used without -w.");
+#endif
+#ifdef HAVE_ZFILE
+	if (compress_method != 0) {
+		if (WFileName == NULL)
+			error("--compress cannot be used without -w.");
+#if defined(HAVE_FORK) || defined(HAVE_VFORK)
+		if (zflag != NULL)
+			error("-z and --compress are mutually exclusive.");
+#endif
+#ifdef DUMPWRITER_THREAD
+		/* Compress on the writer thread. */
+		if (async_write_kb == 0)
+			async_write_kb = DUMPWRITER_DEFAULT_RING_KB;
+#endif
+	}
+#endif
+#ifdef RESOLVER_THREAD
+	if (dns_negative_ttl != -1 && !async_dns)
+		error("--dns-negative-ttl cannot be used without --async-dns.");
+#endif
 #if defined(HAVE_FORK) || defined(HAVE_VFORK)
 	if (zflag != NULL && (WFileName == NULL || (Cflag == 0 && Gflag == 0)))
 		error("-z cannot be used without -w and (-C or -G).");
@@ -2173,6 +2456,21 @@ main(int argc, char **argv)
 
 	if (Dflag)
 		show_devices_and_exit();
+	if (name_db_source != NULL && build_name_db_file == NULL)
+		error("--name-db-source cannot be used without --build-name-db.");
+	if (build_name_db_file != NULL) {
+		if (namedb_build(build_name_db_file, name_db_source, ebuf,
+		    sizeof(ebuf)) != 0)
+			error("can't build the name database: %s", ebuf);
+		exit_tcpdump(S_SUCCESS);
+	}
+	/* With -n, there's nothing to look up. */
+	if (name_db_file != NULL && !ndo->ndo_nflag) {
+		ndo->ndo_name_db = namedb_open(name_db_file, ebuf,
+		    sizeof(ebuf));
+		if (ndo->ndo_name_db == NULL)
+			error("%s", ebuf);
+	}
 #ifdef HAVE_PCAP_FINDALLDEVS_EX
 	if (remote_interfaces_source != NULL)
 		show_remote_devices_and_exit();
@@ -2270,16 +2568,10 @@ main(int argc, char **argv)
 			RFileName = VFileLine;
 		}
 
-#ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
-		pd = pcap_open_offline_with_tstamp_precision(RFileName,
-		    ndo->ndo_tstamp_precision, ebuf);
-#else
-		pd = pcap_open_offline(RFileName, ebuf);
-#endif
-
+		pd = open_offline(RFileName, ndo->ndo_tstamp_precision, ebuf);
 		if (pd == NULL)
 			error("%s", ebuf);
-#ifdef HAVE_CAPSICUM
+#if defined(HAVE_CAPSICUM) && !defined(HAVE_ZFILE)
 		cap_rights_init(&rights, CAP_READ);
 		if (cap_rights_limit(fileno(pcap_file(pd)), &rights) < 0 &&
 		    errno != ENOSYS) {
@@ -2455,11 +2747,35 @@ DIAG_ON_WARN_UNUSED_RESULT
 		exit_tcpdump(S_SUCCESS);
 	}
 
+#ifdef RESOLVER_THREAD
+	/* With -n, there's nothing to look up. */
+	if (ndo->ndo_nflag)
+		async_dns = 0;
+	if (async_dns) {
+		int err;
+
+		err = resolver_start();
+		if (err != 0)
+			error("can't start the name lookup threads: %s",
+			    strerror(err));
+		ndo->ndo_async_dns = 1;
+		ndo->ndo_dns_negative_ttl = dns_negative_ttl != -1 ?
+		    (u_int)dns_negative_ttl : RESOLVER_DEFAULT_NEGATIVE_TTL;
+	}
+#endif
 #ifdef HAVE_CASPER
-	if (!ndo->ndo_nflag)
+	/*
+	 * With --async-dns, the lookups can't be done in capability
+	 * mode, so we don't enter it.
+	 */
+	if (!ndo->ndo_nflag && !ndo->ndo_async_dns)
 		capdns = capdns_setup();
 #endif	/* HAVE_CASPER */
 
+	nd_flow_set_limits(max_flows, flow_timeout);
+	if (profile)
+		ndo->ndo_profile = nd_profile_new(ndo);
+
 	// Both localnet and netmask are in network byte order.
 	init_print(ndo, localnet, netmask);
 
@@ -2573,6 +2889,14 @@ DIAG_ON_ASSIGN_ENUM
 		}
 	}
 #endif
+	/*
+	 * The binary record stream starts with a file header.
+	 */
+	if (WFileName == NULL || print) {
+		nd_record_file_header(ndo);
+		nd_output_flush(ndo);
+	}
+
 	if (WFileName) {
 		/* Do not exceed the default PATH_MAX for files. */
 		dumpinfo.CurrentFileName = (char *)malloc(PATH_MAX + 1);
@@ -2586,7 +2910,7 @@ DIAG_ON_ASSIGN_ENUM
 		else
 		  MakeFilename(dumpinfo.CurrentFileName, WFileName, 0, 0);
 
-		pdd = pcap_dump_open(pd, dumpinfo.CurrentFileName);
+		pdd = dump_open(pd, dumpinfo.CurrentFileName);
 #ifdef HAVE_LIBCAP_NG
 		/* Give up CAP_DAC_OVERRIDE capability.
 		 * Only allow it to be restored if the -C or -G flag have been
@@ -2672,15 +2996,51 @@ DIAG_ON_ASSIGN_ENUM
 		if (print) {
 			dlt = pcap_datalink(pd);
 			ndo->ndo_if_printer = get_if_printer(dlt);
+			ndo->ndo_dlt = dlt;
 			dumpinfo.ndo = ndo;
 		} else
 			dumpinfo.ndo = NULL;
 
 		if (Uflag)
 			pcap_dump_flush(pdd);
+#ifdef DUMPWRITER_THREAD
+		if (async_write_kb != 0) {
+			int err;
+
+			/*
+			 * The writer thread opens savefiles after pd
+			 * has been closed, so give it a handle of its own.
+			 */
+#ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
+			dumpinfo.pd = pcap_open_dead_with_tstamp_precision(
+			    pcap_datalink(pd), pcap_snapshot(pd),
+			    pcap_get_tstamp_precision(pd));
+#else
+			dumpinfo.pd = pcap_open_dead(pcap_datalink(pd),
+			    pcap_snapshot(pd));
+#endif
+			if (dumpinfo.pd == NULL)
+				error("%s: pcap_open_dead failed", __func__);
+			/*
+			 * When reading savefiles, wait for the writer
+			 * rather than dropping packets.
+			 */
+			err = dumpwriter_start(async_write_kb,
+			    RFileName != NULL, write_dump_packet,
+			    flush_dump_file, (u_char *)&dumpinfo);
+			if (err != 0)
+				error("unable to start the savefile writer: %s",
+				    strerror(err));
+		}
+#endif
 	} else {
 		dlt = pcap_datalink(pd);
 		ndo->ndo_if_printer = get_if_printer(dlt);
+		ndo->ndo_dlt = dlt;
+#ifdef PARALLEL_THREADS
+		if (nthreads > 1)
+			parallel_start(ndo, nthreads, dlt, localnet, netmask);
+#endif
 		callback = print_packet;
 		pcap_userdata = (u_char *)ndo;
 	}
@@ -2777,6 +3137,15 @@ DIAG_ON_ASSIGN_ENUM
 		status = pcap_loop(pd,
 				   (cnt == -1 ? -1 : cnt + (int)packets_to_skip),
 				   callback, pcap_userdata);
+#ifdef PARALLEL_THREADS
+		/*
+		 * Write out whatever the dissection threads haven't
+		 * finished with; we might be about to switch to a file
+		 * with a different link-layer header type.
+		 */
+		if (nthreads > 1)
+			parallel_drain();
+#endif
 		if (WFileName == NULL) {
 			/*
 			 * We're printing packets.  Flush the printed output,
@@ -2822,10 +3191,11 @@ DIAG_ON_ASSIGN_ENUM
 				int new_dlt;
 
 				RFileName = VFileLine;
-				pd = pcap_open_offline(RFileName, ebuf);
+				pd = open_offline(RFileName,
+				    ndo->ndo_tstamp_precision, ebuf);
 				if (pd == NULL)
 					error("%s", ebuf);
-#ifdef HAVE_CAPSICUM
+#if defined(HAVE_CAPSICUM) && !defined(HAVE_ZFILE)
 				cap_rights_init(&rights, CAP_READ);
 				if (cap_rights_limit(fileno(pcap_file(pd)),
 				    &rights) < 0 && errno != ENOSYS) {
@@ -2863,6 +3233,11 @@ DIAG_ON_ASSIGN_ENUM
 					 */
 					dlt = new_dlt;
 					ndo->ndo_if_printer = get_if_printer(dlt);
+					ndo->ndo_dlt = dlt;
+#ifdef PARALLEL_THREADS
+					if (nthreads > 1)
+						parallel_set_linktype(dlt);
+#endif
 					/* Free the old filter */
 					pcap_freecode(&fcode);
 					/*
@@ -2897,6 +3272,37 @@ DIAG_ON_ASSIGN_ENUM
 	}
 	while (ret != NULL);
 
+#ifdef PARALLEL_THREADS
+	if (nthreads > 1)
+		parallel_stop();
+#endif
+#ifdef DUMPWRITER_THREAD
+	if (async_write_kb != 0) {
+		dumpwriter_stop();
+		sync_dump_file(&dumpinfo);
+	}
+#endif
+#ifdef HAVE_ZFILE
+	/* End the compressed stream of the last savefile. */
+	if (compress_method != 0)
+		pcap_dump_close(dumpinfo.pdd);
+#endif
+#ifdef RESOLVER_THREAD
+	if (async_dns) {
+		/* For a capture, info() has reported them. */
+		if (RFileName != NULL) {
+			print_resolver_stats();
+			putc('\n', stderr);
+		}
+		resolver_stop();
+	}
+#endif
+	/* For a capture, info() has reported them. */
+	if (flow_stats && RFileName != NULL && print_flow_stats(1, 0))
+		putc('\n', stderr);
+	if (profile && RFileName != NULL)
+		print_profile();
+
 	if (count_mode && RFileName != NULL)
 		fprintf(stdout, "%u packet%s\n", packets_captured,
 			PLURAL_SUFFIX(packets_captured));
@@ -3113,6 +3519,142 @@ child_cleanup(int signo _U_)
 }
 #endif /* HAVE_FORK && HAVE_VFORK */
 
+#ifdef RESOLVER_THREAD
+static void
+print_resolver_stats(void)
+{
+	struct resolver_stats rstats;
+
+	resolver_get_stats(&rstats);
+	(void)fprintf(stderr, "%u host name lookup%s (%u found, %u dropped)",
+	    rstats.lookups, PLURAL_SUFFIX(rstats.lookups), rstats.resolved,
+	    rstats.dropped);
+}
+#endif
+
+/*
+ * Print the counters of the flows of each type that has been looked
+ * up, preceded by a separator if sep is set; returns 1 if anything was
+ * printed and sep otherwise.
+ */
+static int
+print_flow_stats(int verbose, int sep)
+{
+	struct nd_flow_stats fst;
+	u_int i;
+
+	for (i = 0; nd_flow_types[i] != NULL; i++) {
+		nd_flow_get_stats(nd_flow_types[i], &fst);
+		if (fst.hits == 0 && fst.misses == 0)
+			continue;
+		if (sep) {
+			if (!verbose)
+				fputs(", ", stderr);
+			else
+				putc('\n', stderr);
+		}
+		(void)fprintf(stderr,
+		    "%u %s%s tracked (%u hits, %u misses, %u closed, %u timed out, %u evicted)",
+		    fst.created, nd_flow_types[i]->name,
+		    PLURAL_SUFFIX(fst.created), fst.hits, fst.misses,
+		    fst.closed, fst.expired, fst.evicted);
+		sep = 1;
+	}
+	return sep;
+}
+
+static int
+profile_row_cmp(const void *a, const void *b)
+{
+	const struct nd_profile_row *ra = a, *rb = b;
+
+	if (ra->ticks != rb->ticks)
+		return ra->ticks < rb->ticks ? 1 : -1;
+	return strcmp(ra->protocol, rb->protocol);
+}
+
+/*
+ * Print the --profile counters of each printer, the most expensive
+ * first.
+ */
+static void
+print_profile(void)
+{
+	static struct nd_profile_row rows[1024];
+	const struct nd_profile_row *r;
+	const char *unit;
+	uint64_t total = 0;
+	u_int i, n;
+
+	n = nd_profile_collect(rows, sizeof(rows) / sizeof(rows[0]));
+	qsort(rows, n, sizeof(rows[0]), profile_row_cmp);
+	for (i = 0; i < n; i++)
+		total += rows[i].ticks;
+	unit = nd_profile_unit();
+	(void)fprintf(stderr, "%-16s %10s %12s %14s %8s/pkt %6s %9s %7s\n",
+	    "protocol", "packets", "bytes", unit, unit, "%", "truncated",
+	    "invalid");
+	for (i = 0; i < n; i++) {
+		r = &rows[i];
+		if (r->packets == 0 && r->ticks == 0 && r->truncated == 0 &&
+		    r->invalid == 0)
+			continue;
+		(void)fprintf(stderr,
+		    "%-16s %10" PRIu64 " %12" PRIu64 " %14" PRIu64
+		    " %12" PRIu64 " %6.2f %9" PRIu64 " %7" PRIu64 "\n",
+		    r->protocol[0] != '\0' ? r->protocol : "-",
+		    r->packets, r->bytes, r->ticks,
+		    r->packets != 0 ? r->ticks / r->packets : 0,
+		    total != 0 ? 100.0 * (double)r->ticks / (double)total : 0.0,
+		    r->truncated, r->invalid);
+	}
+}
+
+/*
+ * Handle a --port-map argument, "proto:port=printer".
+ */
+static void
+add_port_map(const char *arg)
+{
+	char proto[8], *endp;
+	const char *colon;
+	const struct tok *t;
+	u_int port;
+	size_t len;
+
+	colon = strchr(arg, ':');
+	if (colon == NULL || (len = colon - arg) >= sizeof(proto))
+		error("invalid port map \"%s\" (must be proto:port=printer)",
+		    arg);
+	memcpy(proto, arg, len);
+	proto[len] = '\0';
+	port = parse_u_int("port", colon + 1, &endp, 0, 65535, 10);
+	if (*endp != '=')
+		error("invalid port map \"%s\" (must be proto:port=printer)",
+		    arg);
+	switch (nd_port_map_add(proto, (uint16_t)port, endp + 1)) {
+
+	case 0:
+		break;
+
+	case ND_PORT_MAP_BAD_PROTO:
+		error("invalid port map protocol \"%s\" (must be udp or tcp)",
+		    proto);
+
+	case ND_PORT_MAP_BAD_NAME:
+		(void)fprintf(stderr, "%s: the printers for %s ports are:",
+		    program_name, proto);
+		for (t = nd_port_map_names(proto); t->s != NULL; t++)
+			(void)fprintf(stderr, " %s", t->s);
+		(void)fputc('\n', stderr);
+		error("unknown printer \"%s\" for %s ports", endp + 1, proto);
+
+	case ND_PORT_MAP_FULL:
+		error("too many port maps for %s (at most %u)", proto,
+		    ND_PORT_MAP_MAX_ADDED);
+	}
+}
+
 static void
 info(int verbose)
 {
@@ -3151,10 +3693,34 @@ info(int verbose)
 			fputs(", ", stderr);
 		else
 			putc('\n', stderr);
-		(void)fprintf(stderr, "%u packet%s dropped by interface\n",
+		(void)fprintf(stderr, "%u packet%s dropped by interface",
 		    stats.ps_ifdrop, PLURAL_SUFFIX(stats.ps_ifdrop));
-	} else
-		putc('\n', stderr);
+	}
+#ifdef DUMPWRITER_THREAD
+	if (async_write_kb != 0) {
+		u_int drops = dumpwriter_drops();
+
+		if (!verbose)
+			fputs(", ", stderr);
+		else
+			putc('\n', stderr);
+		(void)fprintf(stderr, "%u packet%s dropped by savefile writer",
+		    drops, PLURAL_SUFFIX(drops));
+	}
+#endif
+#ifdef RESOLVER_THREAD
+	if (async_dns) {
+		if (!verbose)
+			fputs(", ", stderr);
+		else
+			putc('\n', stderr);
+		print_resolver_stats();
+	}
+#endif
+	print_flow_stats(verbose, 1);
+	putc('\n', stderr);
+	if (profile)
+		print_profile();
 	infoprint = 0;
 }
 
@@ -3202,9 +3768,170 @@ compress_savefile(const char *filename)
 }
 #endif /* HAVE_FORK || HAVE_VFORK */
 
+#ifdef DUMPWRITER_THREAD
+/*
+ * Size of the standard I/O buffer of the savefile with --async-write;
+ * the savefile is written in chunks of this size, at offsets that are
+ * multiples of it.
+ */
+#define DUMP_WRITE_SIZE	(1024 * 1024)
+
+static char *dump_write_buf;
+
+/*
+ * Write out what's buffered for the savefile, and, with --async-write,
+ * have it written to stable storage, so that a file handed to the -z
+ * command, or left behind at exit, is complete; this is done on the
+ * writer thread, so it doesn't stall the capture.
+ */
+static void
+sync_dump_file(struct dump_info *dump_info)
+{
+	int fd;
+
+	if (pcap_dump_flush(dump_info->pdd) == -1)
+		error("%s: %s", dump_info->CurrentFileName,
+		    pcap_strerror(errno));
+	/*
+	 * A compressed savefile has no descriptor of its own; the
+	 * underlying file is synced when the savefile is closed.
+	 */
+	fd = fileno(pcap_dump_file(dump_info->pdd));
+	if (fd != -1 && fsync(fd) == -1 && errno != EINVAL && errno != EROFS)
+		warning("fsync of %s failed: %s", dump_info->CurrentFileName,
+		    pcap_strerror(errno));
+}
+
+static void
+flush_dump_file(u_char *user)
+{
+	pcap_dump_flush(((struct dump_info *)user)->pdd);
+}
+#endif /* DUMPWRITER_THREAD */
+
+static pcap_dumper_t *
+dump_fopen(pcap_t *p, FILE *fp)
+{
+#ifdef HAVE_ZFILE
+	if (compress_method != 0) {
+		int sync = 0;
+
+#ifdef DUMPWRITER_THREAD
+		sync = async_write_kb != 0;
+#endif
+		fp = zfile_wrap_write(fp, compress_method, compress_level,
+		    sync);
+		if (fp == NULL)
+			error("unable to compress the savefile: %s",
+			    pcap_strerror(errno));
+	}
+#endif
+#ifdef DUMPWRITER_THREAD
+	if (async_write_kb != 0) {
+		/*
+		 * Only one savefile is open at a time, so they can all
+		 * use the same buffer.
+		 */
+		if (dump_write_buf == NULL) {
+			dump_write_buf = malloc(DUMP_WRITE_SIZE);
+			if (dump_write_buf == NULL)
+				error("%s: malloc", __func__);
+		}
+		setvbuf(fp, dump_write_buf, _IOFBF, DUMP_WRITE_SIZE);
+	}
+#endif
+	return pcap_dump_fopen(p, fp);
+}
+
+static pcap_dumper_t *
+dump_open(pcap_t *p, const char *fname)
+{
+	int own_stream = 0;
+
+#ifdef DUMPWRITER_THREAD
+	own_stream |= async_write_kb != 0;
+#endif
+#ifdef HAVE_ZFILE
+	own_stream |= compress_method != 0;
+#endif
+	if (own_stream) {
+		FILE *fp;
+
+		/*
+		 * Open the file ourselves, so that we can compress it, or
+		 * give it a large buffer before anything is written to it.
+		 */
+		if (strcmp(fname, "-") == 0)
+			fp = stdout;
+		else {
+			fp = fopen(fname, "wb");
+			if (fp == NULL)
+				error("%s: %s", fname, pcap_strerror(errno));
+		}
+		return dump_fopen(p, fp);
+	}
+	return pcap_dump_open(p, fname);
+}
+
+/*
+ * Open a savefile for reading; with --compress support, the savefile
+ * may be compressed.
+ */
+static pcap_t *
+open_offline(const char *fname, int tstamp_precision _U_, char *ebuf)
+{
+#ifdef HAVE_ZFILE
+	FILE *fp, *zfp;
+#ifdef HAVE_CAPSICUM
+	cap_rights_t rights;
+#endif
+
+	if (strcmp(fname, "-") == 0)
+		fp = stdin;
+	else {
+		fp = fopen(fname, "rb");
+		if (fp == NULL) {
+			snprintf(ebuf, PCAP_ERRBUF_SIZE, "%s: %s", fname,
+			    pcap_strerror(errno));
+			return NULL;
+		}
+	}
+#ifdef HAVE_CAPSICUM
+	cap_rights_init(&rights, CAP_READ, CAP_SEEK);
+	if (cap_rights_limit(fileno(fp), &rights) < 0 && errno != ENOSYS)
+		error("unable to limit pcap descriptor");
+#endif
+	zfp = zfile_wrap_read(fp);
+	if (zfp == NULL) {
+		snprintf(ebuf, PCAP_ERRBUF_SIZE, "%s: %s", fname,
+		    pcap_strerror(errno));
+		if (fp != stdin)
+			fclose(fp);
+		return NULL;
+	}
+#ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
+	return pcap_fopen_offline_with_tstamp_precision(zfp, tstamp_precision,
+	    ebuf);
+#else
+	return pcap_fopen_offline(zfp, ebuf);
+#endif
+#else /* HAVE_ZFILE */
+#ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
+	return pcap_open_offline_with_tstamp_precision(fname, tstamp_precision,
+	    ebuf);
+#else
+	return pcap_open_offline(fname, ebuf);
+#endif
+#endif /* HAVE_ZFILE */
+}
+
 static void
 close_old_dump_file(struct dump_info *dump_info)
 {
+#ifdef DUMPWRITER_THREAD
+	if (async_write_kb != 0)
+		sync_dump_file(dump_info);
+#endif
 	/*
 	 * Close the current file and open a new one.
 	 */
@@ -3241,9 +3968,9 @@ open_new_dump_file(struct dump_info *dump_info)
 	if (fp == NULL) {
 		error("unable to fdopen file %s", dump_info->CurrentFileName);
 	}
-	dump_info->pdd = pcap_dump_fopen(dump_info->pd, fp);
+	dump_info->pdd = dump_fopen(dump_info->pd, fp);
 #else	/* !HAVE_CAPSICUM */
-	dump_info->pdd = pcap_dump_open(dump_info->pd, dump_info->CurrentFileName);
+	dump_info->pdd = dump_open(dump_info->pd, dump_info->CurrentFileName);
 #endif
 #ifdef HAVE_LIBCAP_NG
 	capng_update(CAPNG_DROP, CAPNG_EFFECTIVE, CAP_DAC_OVERRIDE);
@@ -3256,20 +3983,18 @@ open_new_dump_file(struct dump_info *dump_info)
 #endif
 }
 
+/*
+ * Write a packet to the savefile, first rotating the savefile if -C
+ * or -G says it's time to; with --async-write, this is called on the
+ * writer thread.
+ */
 static void
-dump_packet_and_trunc(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
+write_dump_packet(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
 {
 	struct dump_info *dump_info;
 
-	++packets_captured;
-
-	++infodelay;
-
 	dump_info = (struct dump_info *)user;
 
-	if (packets_captured <= packets_to_skip)
-		return;
-
 	/*
 	 * XXX - this won't force the file to rotate on the specified time
 	 * boundary, but it will rotate on the first packet received after the
@@ -3377,8 +4102,40 @@ dump_packet_and_trunc(u_char *user, const struct pcap_pkthdr *h, const u_char *s
 	}
 
 	pcap_dump((u_char *)dump_info->pdd, h, sp);
-	if (Uflag)
+	if (Uflag) {
+#ifdef DUMPWRITER_THREAD
+		/*
+		 * Flush once the writer has caught up, rather than
+		 * after every packet.
+		 */
+		if (async_write_kb != 0)
+			dumpwriter_request_flush();
+		else
+#endif
 		pcap_dump_flush(dump_info->pdd);
+	}
+}
+
+static void
+dump_packet_and_trunc(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
+{
+	struct dump_info *dump_info;
+
+	++packets_captured;
+
+	++infodelay;
+
+	dump_info = (struct dump_info *)user;
+
+	if (packets_captured <= packets_to_skip)
+		return;
+
+#ifdef DUMPWRITER_THREAD
+	if (async_write_kb != 0)
+		dumpwriter_packet(h, sp);
+	else
+#endif
+	write_dump_packet(user, h, sp);
 
 	if (dump_info->ndo != NULL)
 		pretty_print_packet(dump_info->ndo, h, sp, packets_captured);
@@ -3402,9 +4159,16 @@ dump_packet(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
 	if (packets_captured <= packets_to_skip)
 		return;
 
-	pcap_dump((u_char *)dump_info->pdd, h, sp);
-	if (Uflag)
-		pcap_dump_flush(dump_info->pdd);
+#ifdef DUMPWRITER_THREAD
+	if (async_write_kb != 0)
+		dumpwriter_packet(h, sp);
+	else
+#endif
+	{
+		pcap_dump((u_char *)dump_info->pdd, h, sp);
+		if (Uflag)
+			pcap_dump_flush(dump_info->pdd);
+	}
 
 	if (dump_info->ndo != NULL)
 		pretty_print_packet(dump_info->ndo, h, sp, packets_captured);
@@ -3421,8 +4185,14 @@ print_packet(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
 
 	++infodelay;
 
-	if (!count_mode && packets_captured > packets_to_skip)
+	if (!count_mode && packets_captured > packets_to_skip) {
+#ifdef PARALLEL_THREADS
+		if (nthreads > 1)
+			parallel_packet(h, sp, packets_captured);
+		else
+#endif
 		pretty_print_packet((netdissect_options *)user, h, sp, packets_captured);
+	}
 
 	--infodelay;
 	if (infoprint)
@@ -3444,6 +4214,12 @@ requestinfo(int signo _U_)
 static void
 flushpcap(int signo _U_)
 {
+#ifdef DUMPWRITER_THREAD
+	if (async_write_kb != 0) {
+		dumpwriter_request_flush();
+		return;
+	}
+#endif
 	if (pdd != NULL)
 		pcap_dump_flush(pdd);
 }
@@ -3514,21 +4290,39 @@ print_usage(FILE *f)
 "Usage: %s [-AbdDefghHI" J_FLAG "KlLnNOpqStuUvxX#] [ -B size ] [ -c count ] [--count]\n",
 	    executable_name);
 	(void)fprintf(f,
-"\t\t[ -C file_size ] " E_FLAG_USAGE "[ -F file ] [ -G seconds ]\n");
+"\t\t[ -C file_size ] " E_FLAG_USAGE "[ -F file ]\n");
+	(void)fprintf(f,
+"\t\t[ --flow-stats ] [ --flow-timeout seconds ] [ -G seconds ]\n");
 	(void)fprintf(f,
 "\t\t[ -i interface ]" IMMEDIATE_MODE_USAGE j_FLAG_USAGE "\n");
+#ifdef RESOLVER_THREAD
+	(void)fprintf(f,
+"\t\t[ --async-dns ] [ --dns-negative-ttl seconds ]\n");
+#endif
+	(void)fprintf(f,
+"\t\t[ --build-name-db file [ --name-db-source directory ] ]\n");
+	(void)fprintf(f,
+"\t\t" ASYNC_WRITE_USAGE "[ --lengths ]" LIST_REMOTE_INTERFACES_USAGE "\n");
 	(void)fprintf(f,
-"\t\t[ --lengths ]" LIST_REMOTE_INTERFACES_USAGE "\n");
+"\t\t" COMPRESS_USAGE "[ --output-format text|json|binary ]\n");
 #ifdef USE_LIBSMI
 	(void)fprintf(f,
 "\t\t" m_FLAG_USAGE "\n");
 #endif
 	(void)fprintf(f,
-"\t\t" M_FLAG_USAGE "[ --number ] [ --print ]\n");
+"\t\t" M_FLAG_USAGE "[ --max-flows count ]\n");
+	(void)fprintf(f,
+"\t\t[ --name-cache-size size ] [ --name-db file ]\n");
+	(void)fprintf(f,
+"\t\t[ --number ] [ --port-map proto:port=printer ] [ --print ]\n");
+	(void)fprintf(f,
+"\t\t[ --print-sampling nth ] [ --profile ] [ -Q in|out|inout ] [ -r file ]\n");
+	(void)fprintf(f,
+"\t\t[ --reassemble-ip ] [ --reassemble-tcp ] [ --reassembly-memory size ]\n");
 	(void)fprintf(f,
-"\t\t[ --print-sampling nth ] [ -Q in|out|inout ] [ -r file ]\n");
+"\t\t[ --rpc-calls count ]\n");
 	(void)fprintf(f,
-"\t\t[ -s snaplen ] [ --skip count ] [ -T type ] [ --version ]\n");
+"\t\t[ -s snaplen ] [ --skip count ] [ -T type ] " THREADS_USAGE "[ --version ]\n");
 	(void)fprintf(f,
 "\t\t[ -V file ] [ -w file ] [ -W filecount ] [ -y datalinktype ]\n");
 #ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
@@ -0,0 +1,471 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "netdissect.h"
+#include "extract.h"
+#include "ip.h"
+#include "ip6.h"
+#include "tcp.h"
+#include "flowtable.h"
+#include "tcpreasm.h"
+
+/*
+ * Room, before the data of a buffer, for a copy of the IPv4 or IPv6
+ * header of the packet that completes it, so that the printers can get
+ * the addresses of a PDU printed from the buffer.
+ */
+#define HDR_ROOM	sizeof(struct ip6_hdr)
+
+/*
+ * A segment that starts this far or more from the data expected is
+ * taken to be from a new connection rather than a retransmission or a
+ * segment that follows missing data.
+ */
+#define NEW_CONNECTION	(1U << 30)
+
+/* One direction of a connection */
+struct tcp_stream {
+	struct tcp_stream *prev;	/* in the buffer list, least recent last */
+	struct tcp_stream *next;
+	uint32_t next_seq;		/* of the data expected next */
+	uint32_t skip;			/* bytes of a PDU left not to print */
+	u_char *buf;			/* start of a PDU, after HDR_ROOM bytes */
+	u_int len;			/* bytes of the PDU in buf */
+	u_int size;			/* allocated for them */
+	u_int pdu_len;			/* length of the PDU, 0 until known */
+	u_char valid;			/* next_seq is set */
+	u_char fin;			/* a FIN has been seen */
+};
+
+struct tcp_stream_data {
+	struct tcp_stream dir[2];	/* sent by endpoint 0 and 1 of the key */
+};
+
+/* The streams of a thread that have a buffer */
+struct stream_buffers {
+	struct tcp_stream list;		/* list head, least recent last */
+	size_t mem_used;
+};
+
+/* What a segment has to print, in the order of the stream */
+struct delivery {
+	const char *note;
+	u_char *buf;			/* a PDU from a buffer, or NULL */
+	u_int buf_len;
+	const u_char *pdus;		/* whole PDUs in the segment */
+	u_int pdus_len;
+	const u_char *raw;		/* data that couldn't be framed */
+	u_int raw_len;
+};
+
+static ND_THREAD_LOCAL struct stream_buffers buffers;
+
+/* The same for all threads; set before any of them are started */
+static size_t mem_limit = TCP_REASM_DEFAULT_LIMIT_KB * (size_t)1024;
+
+static void tcp_stream_free(void *);
+
+struct nd_flow_type tcp_stream_flow_type =
+    ND_FLOW_TYPE_INIT_FREE(ND_FLOW_TYPE_TCP_STREAM, "TCP stream",
+			   sizeof(struct tcp_stream_data), tcp_stream_free);
+
+static void
+list_remove(struct tcp_stream *s)
+{
+	s->prev->next = s->next;
+	s->next->prev = s->prev;
+}
+
+static void
+list_insert(struct tcp_stream *s)
+{
+	struct tcp_stream *head = &buffers.list;
+
+	if (head->next == NULL)
+		head->next = head->prev = head;
+	s->prev = head;
+	s->next = head->next;
+	head->next->prev = s;
+	head->next = s;
+}
+
+/*
+ * Take the buffer of a stream away from it, and return it; it's freed
+ * by the caller.
+ */
+static u_char *
+detach_buffer(struct tcp_stream *s)
+{
+	u_char *buf = s->buf;
+
+	if (buf != NULL) {
+		list_remove(s);
+		buffers.mem_used -= HDR_ROOM + s->size;
+		s->buf = NULL;
+		s->len = s->size = s->pdu_len = 0;
+	}
+	return buf;
+}
+
+static void
+drop_buffer(struct tcp_stream *s)
+{
+	free(detach_buffer(s));
+}
+
+/* Called when the flow of a connection is removed */
+static void
+tcp_stream_free(void *data)
+{
+	struct tcp_stream_data *sd = data;
+
+	drop_buffer(&sd->dir[0]);
+	drop_buffer(&sd->dir[1]);
+}
+
+/*
+ * Drop the start of a PDU buffered for a stream, to make room for
+ * others; the rest of the PDU is skipped if its length is known, and
+ * otherwise the stream starts again with the next segment.
+ */
+static void
+lose_pdu(struct tcp_stream *s)
+{
+	if (s->pdu_len != 0)
+		s->skip = s->pdu_len - s->len;
+	else
+		s->valid = 0;
+	drop_buffer(s);
+}
+
+/*
+ * Make room for need more bytes of buffers, dropping those of the
+ * streams seen least recently; returns 0 if need is over the limit.
+ */
+static int
+make_room(size_t need)
+{
+	if (need > mem_limit)
+		return 0;
+	while (buffers.mem_used + need > mem_limit)
+		lose_pdu(buffers.list.prev);
+	return 1;
+}
+
+/*
+ * Make the buffer of a stream, allocating it if there's none, big
+ * enough for size bytes, and the most recently used one; returns 0,
+ * leaving the buffer as it was, if that would be over the limit or
+ * there's no memory.
+ */
+static int
+size_buffer(struct tcp_stream *s, u_int size)
+{
+	u_char *buf;
+	int ok = 1;
+
+	if (s->buf != NULL) {
+		list_remove(s);
+		buffers.mem_used -= HDR_ROOM + s->size;
+	}
+	if (size > s->size) {
+		if (make_room(HDR_ROOM + (size_t)size) &&
+		    (buf = realloc(s->buf, HDR_ROOM + (size_t)size)) != NULL) {
+			s->buf = buf;
+			s->size = size;
+		} else
+			ok = 0;
+	}
+	if (s->buf != NULL) {
+		buffers.mem_used += HDR_ROOM + s->size;
+		list_insert(s);
+	}
+	return ok;
+}
+
+static void
+append(struct tcp_stream *s, const u_char *data, u_int len)
+{
+	memcpy(s->buf + HDR_ROOM + s->len, data, len);
+	s->len += len;
+}
+
+/* The length of the PDU that starts at p, or 0 if it's invalid */
+static u_int
+pdu_length(const struct tcp_framing *framing, const u_char *p)
+{
+	u_int len = (*framing->pdu_len)(p);
+
+	return len >= framing->hdr_len ? len : 0;
+}
+
+/*
+ * Add the data of a segment, which starts at sequence number seq, to
+ * its stream, and fill in what it has to print.
+ */
+static void
+add_data(netdissect_options *ndo, struct tcp_stream *s, uint32_t seq,
+	 const u_char *data, u_int len, const struct tcp_framing *framing,
+	 struct delivery *d)
+{
+	uint32_t behind;
+	u_int n, plen;
+
+	if (!ND_TTEST_LEN(data, len)) {
+		/* Print what was captured, and start again. */
+		drop_buffer(s);
+		s->skip = 0;
+		s->valid = 0;
+		d->raw = data;
+		d->raw_len = len;
+		return;
+	}
+
+	if (s->valid && (behind = s->next_seq - seq) != 0) {
+		if (behind < NEW_CONNECTION) {
+			if (behind >= len) {
+				d->note = " [retransmission]";
+				return;
+			}
+			data += behind;
+			len -= behind;
+			seq = s->next_seq;
+		} else {
+			if ((uint32_t)(seq - s->next_seq) < NEW_CONNECTION)
+				d->note = " [missing data]";
+			drop_buffer(s);
+			s->valid = 0;
+		}
+	}
+	if (!s->valid) {
+		/* Take the segment to start a PDU. */
+		s->skip = 0;
+		s->valid = 1;
+	}
+	s->next_seq = seq + len;
+
+	n = ND_MIN(s->skip, len);
+	s->skip -= n;
+	data += n;
+	len -= n;
+
+	if (s->buf != NULL && len != 0) {
+		if (s->len < framing->hdr_len) {
+			n = ND_MIN(framing->hdr_len - s->len, len);
+			append(s, data, n);
+			data += n;
+			len -= n;
+			if (s->len < framing->hdr_len) {
+				(void)size_buffer(s, s->size);
+				return;
+			}
+		}
+		if (s->pdu_len == 0) {
+			plen = pdu_length(framing, s->buf + HDR_ROOM);
+			if (plen == 0) {
+				/* Not a PDU: print the data, and start again. */
+				d->buf_len = s->len;
+				d->buf = detach_buffer(s);
+				d->raw = data;
+				d->raw_len = len;
+				s->valid = 0;
+				return;
+			}
+			if (!size_buffer(s, plen)) {
+				/* Print the start of the PDU, skip the rest. */
+				s->skip = plen - s->len;
+				d->buf_len = s->len;
+				d->buf = detach_buffer(s);
+				n = ND_MIN(s->skip, len);
+				s->skip -= n;
+				data += n;
+				len -= n;
+				goto pdus;
+			}
+			s->pdu_len = plen;
+		} else
+			(void)size_buffer(s, s->size);
+		n = ND_MIN(s->pdu_len - s->len, len);
+		append(s, data, n);
+		data += n;
+		len -= n;
+		if (s->len < s->pdu_len)
+			return;
+		d->buf_len = s->len;
+		d->buf = detach_buffer(s);
+	}
+
+pdus:
+	/*
+	 * The rest of the segment starts with a PDU; print the whole ones
+	 * from the segment, and buffer the start of the last one if it
+	 * continues in the segments that follow.
+	 */
+	while (len != 0) {
+		if (len >= framing->hdr_len) {
+			plen = pdu_length(framing, data);
+			if (plen == 0) {
+				d->raw = data;
+				d->raw_len = len;
+				s->valid = 0;
+				return;
+			}
+			if (plen <= len) {
+				if (d->pdus == NULL)
+					d->pdus = data;
+				d->pdus_len += plen;
+				data += plen;
+				len -= plen;
+				continue;
+			}
+		} else
+			plen = 0;
+		if (!size_buffer(s, plen != 0 ? plen : framing->hdr_len)) {
+			/* Print the start of the PDU, skip the rest. */
+			d->raw = data;
+			d->raw_len = len;
+			if (plen != 0)
+				s->skip = plen - len;
+			else
+				s->valid = 0;
+			return;
+		}
+		s->pdu_len = plen;
+		append(s, data, len);
+		return;
+	}
+}
+
+/* Print part of the data of the packet, as if it were all there was */
+static void
+print_part(netdissect_options *ndo, const u_char *ip, uint16_t sport,
+	   uint16_t dport, const u_char *data, u_int len,
+	   tcp_pdu_printer printer)
+{
+	if (!nd_push_snaplen(ndo, data, len)) {
+		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+			"%s: can't push snaplen on buffer stack", __func__);
+	}
+	(*printer)(ndo, data, len, ip, sport, dport);
+	nd_pop_packet_info(ndo);
+}
+
+/*
+ * Add a segment of a connection, which carries a protocol with the
+ * given framing, to the stream of its direction, and print the PDUs,
+ * or parts of PDUs, that it makes available.  seq is the sequence
+ * number, not the relative one, and the data of a segment with no data
+ * isn't looked at; only SYN, FIN and RST matter in such a segment.
+ *
+ * The flow of the connection may be removed by the printer, which may
+ * keep flows of its own, so the stream mustn't be used after it's
+ * called.
+ */
+void
+tcp_reasm_segment(netdissect_options *ndo, const u_char *ip,
+		  uint16_t sport, uint16_t dport, uint32_t seq, uint16_t flags,
+		  const u_char *data, u_int len,
+		  const struct tcp_framing *framing, tcp_pdu_printer printer)
+{
+	struct nd_flow_key key;
+	struct nd_flow *flow;
+	struct tcp_stream_data *sd;
+	struct tcp_stream *s;
+	struct delivery d;
+	const u_char *p;
+	u_int hl, plen;
+	int rev;
+
+	rev = nd_flow_key_set(&key, ip, IPPROTO_TCP, sport, dport);
+	flow = nd_flow_lookup(ndo, &tcp_stream_flow_type, &key, len != 0);
+	if (flow == NULL)
+		return;
+	sd = ND_FLOW_DATA(flow);
+	s = &sd->dir[rev];
+
+	if (flags & TH_RST) {
+		drop_buffer(&sd->dir[0]);
+		drop_buffer(&sd->dir[1]);
+		nd_flow_close(ndo, flow);
+		return;
+	}
+	if (flags & TH_SYN) {
+		/* A new connection, with data after the SYN. */
+		drop_buffer(s);
+		s->skip = 0;
+		s->fin = 0;
+		s->next_seq = ++seq;
+		s->valid = 1;
+		nd_flow_reopen(ndo, flow);
+	}
+	memset(&d, 0, sizeof(d));
+	if (len != 0)
+		add_data(ndo, s, seq, data, len, framing, &d);
+	if (flags & TH_FIN) {
+		drop_buffer(s);
+		s->fin = 1;
+		if (sd->dir[!rev].fin)
+			nd_flow_close(ndo, flow);
+	}
+	if (len == 0)
+		return;
+
+	/* Print, in order, what the segment has made available. */
+	if (d.note != NULL)
+		ND_PRINT("%s", d.note);
+	else if (d.buf == NULL && d.pdus_len == 0 && d.raw_len == 0)
+		ND_PRINT(" [partial PDU]");
+	if (d.buf != NULL) {
+		hl = (EXTRACT_U_1(ip) >> 4) == 6 ? sizeof(struct ip6_hdr) :
+		    sizeof(struct ip);
+		memcpy(d.buf + HDR_ROOM - hl, ip, hl);
+		if (!nd_push_buffer(ndo, d.buf, d.buf + HDR_ROOM - hl,
+				    hl + d.buf_len)) {
+			free(d.buf);
+			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+				"%s: can't push buffer on buffer stack",
+				__func__);
+		}
+		(*printer)(ndo, d.buf + HDR_ROOM, d.buf_len,
+			   d.buf + HDR_ROOM - hl, sport, dport);
+		nd_pop_packet_info(ndo);
+	}
+	if (d.pdus_len != 0 && framing->one_per_call) {
+		for (p = d.pdus; p < d.pdus + d.pdus_len; p += plen) {
+			plen = pdu_length(framing, p);
+			print_part(ndo, ip, sport, dport, p, plen, printer);
+		}
+	} else if (d.pdus_len != 0)
+		print_part(ndo, ip, sport, dport, d.pdus, d.pdus_len, printer);
+	if (d.raw_len != 0)
+		print_part(ndo, ip, sport, dport, d.raw, d.raw_len, printer);
+}
+
+/*
+ * Set the limit on the memory used by the buffers of each thread.
+ */
+void
+tcp_reasm_set_limit(size_t limit)
+{
+	mem_limit = limit;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef tcpreasm_h
+#define tcpreasm_h
+
+/*
+ * Reassembly of TCP streams into the PDUs of the protocols they carry
+ * ("--reassemble-tcp").
+ *
+ * For the protocols whose PDUs start with their length, the data of
+ * each direction of a connection is followed in sequence, and handed
+ * to the printer as whole PDUs: those that are entirely in a segment
+ * are printed from the segment, and the start of a PDU that continues
+ * in later segments is kept in a buffer until the rest arrives.  The
+ * state of a connection is a flow in the flow table, so the number of
+ * connections is bounded by --max-flows; the buffers of each thread
+ * are bounded by a memory limit, and those of the connections seen
+ * least recently are dropped to stay under it.
+ *
+ * Only in-order data is kept.  When a segment starts past the data
+ * expected, as after a lost or reordered segment, the buffered data is
+ * dropped and the segment is taken to start a PDU; data that has
+ * already been seen, as in a retransmission, is skipped.  A PDU that
+ * can't be buffered, or whose length is invalid, is printed from its
+ * segment as without reassembly, and the rest of it is skipped.
+ */
+
+/* Default and smallest limits on the memory used by each thread */
+#define TCP_REASM_DEFAULT_LIMIT_KB	16384
+#define TCP_REASM_MIN_LIMIT_KB		256
+
+/*
+ * How the PDUs of a protocol are delimited.  pdu_len is given the
+ * first hdr_len bytes of a PDU, and returns its length, including
+ * those bytes, or 0 if they aren't the start of a valid PDU.
+ */
+struct tcp_framing {
+	u_int hdr_len;
+	u_int (*pdu_len)(const u_char *);
+	int one_per_call;		/* the printer handles one PDU */
+};
+
+/*
+ * Prints PDUs, or data that couldn't be framed, given the IPv4 or IPv6
+ * header and the ports of the connection.
+ */
+typedef void (*tcp_pdu_printer)(netdissect_options *, const u_char *,
+    u_int, const u_char *, uint16_t, uint16_t);
+
+extern void tcp_reasm_segment(netdissect_options *, const u_char *,
+    uint16_t, uint16_t, uint32_t, uint16_t, const u_char *, u_int,
+    const struct tcp_framing *, tcp_pdu_printer);
+extern void tcp_reasm_set_limit(size_t);
+
+#endif /* tcpreasm_h */
@@ -44,6 +44,8 @@ struct udphdr {
 	nd_uint16_t	uh_sum;			/* udp checksum */
 };
 
+#define UDP_HDRLEN	8		/* "struct udphdr" on the wire */
+
 #ifndef NAMESERVER_PORT
 #define NAMESERVER_PORT			53
 #endif
@@ -40,7 +40,9 @@
 #include "netdissect-stdinc.h"
 
 
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "netdissect-ctype.h"
@@ -69,7 +71,7 @@ fn_print_char(netdissect_options *ndo, u_char c)
 		c ^= 0x40;	/* DEL to ?, others to alpha */
 		ND_PRINT("^");
 	}
-	ND_PRINT("%c", c);
+	nd_out_char(ndo, c);
 }
 
 /*
@@ -212,13 +214,15 @@ ts_frac_print(netdissect_options *ndo, const struct timeval *tv)
 	switch (ndo->ndo_tstamp_precision) {
 
 	case PCAP_TSTAMP_PRECISION_MICRO:
-		ND_PRINT(".%06u", (unsigned)tv->tv_usec);
+		nd_out_char(ndo, '.');
+		nd_out_uint(ndo, (unsigned)tv->tv_usec, 6);
 		if ((unsigned)tv->tv_usec > ND_MICRO_PER_SEC - 1)
 			ND_PRINT(" " ND_INVALID_MICRO_SEC_STR);
 		break;
 
 	case PCAP_TSTAMP_PRECISION_NANO:
-		ND_PRINT(".%09u", (unsigned)tv->tv_usec);
+		nd_out_char(ndo, '.');
+		nd_out_uint(ndo, (unsigned)tv->tv_usec, 9);
 		if ((unsigned)tv->tv_usec > ND_NANO_PER_SEC - 1)
 			ND_PRINT(" " ND_INVALID_NANO_SEC_STR);
 		break;
@@ -228,7 +232,8 @@ ts_frac_print(netdissect_options *ndo, const struct timeval *tv)
 		break;
 	}
 #else
-	ND_PRINT(".%06u", (unsigned)tv->tv_usec);
+	nd_out_char(ndo, '.');
+	nd_out_uint(ndo, (unsigned)tv->tv_usec, 6);
 	if ((unsigned)tv->tv_usec > ND_MICRO_PER_SEC - 1)
 		ND_PRINT(" " ND_INVALID_MICRO_SEC_STR);
 #endif
@@ -238,49 +243,49 @@ ts_frac_print(netdissect_options *ndo, const struct timeval *tv)
  * Print the timestamp as [YY:MM:DD] HH:MM:SS.FRAC.
  *   if time_flag == LOCAL_TIME print local time else UTC/GMT time
  *   if date_flag == WITH_DATE print YY:MM:DD before HH:MM:SS.FRAC
+ *
+ * The seconds are converted and formatted only when they differ from
+ * those of the previous call with the same flags.
  */
 static void
 ts_date_hmsfrac_print(netdissect_options *ndo, const struct timeval *tv,
 		      enum date_flag date_flag, enum time_flag time_flag)
 {
-	struct tm *tm;
+	struct nd_ts_cache *tc = &ndo->ndo_ts_cache;
+	int format = 1 + (date_flag << 1 | time_flag);
+	struct tm tmbuf, *tm;
 	char timebuf[32];
 	const char *timestr;
-#ifdef _WIN32
 	time_t sec;
-#endif
 
 	if (tv->tv_sec < 0) {
 		ND_PRINT("[timestamp overflow]");
 		return;
 	}
 
-#ifdef _WIN32
 	/* on Windows tv->tv_sec is a long not a 64-bit time_t. */
 	sec = tv->tv_sec;
-#endif
-
-	if (time_flag == LOCAL_TIME)
-#ifdef _WIN32
-		tm = localtime(&sec);
-#else
-		tm = localtime(&tv->tv_sec);
-#endif
-	else
-#ifdef _WIN32
-		tm = gmtime(&sec);
-#else
-		tm = gmtime(&tv->tv_sec);
-#endif
+	if (tc->tc_format != format || tc->tc_sec != sec) {
+		if (time_flag == LOCAL_TIME)
+			tm = nd_localtime(&sec, &tmbuf);
+		else
+			tm = nd_gmtime(&sec, &tmbuf);
 
-	if (date_flag == WITH_DATE) {
-		timestr = nd_format_time(timebuf, sizeof(timebuf),
-		    "%Y-%m-%d %H:%M:%S", tm);
-	} else {
-		timestr = nd_format_time(timebuf, sizeof(timebuf),
-		    "%H:%M:%S", tm);
+		if (date_flag == WITH_DATE) {
+			timestr = nd_format_time(timebuf, sizeof(timebuf),
+			    "%Y-%m-%d %H:%M:%S", tm);
+		} else {
+			timestr = nd_format_time(timebuf, sizeof(timebuf),
+			    "%H:%M:%S", tm);
+		}
+		tc->tc_len = strlen(timestr);
+		if (tc->tc_len > sizeof(tc->tc_str))
+			tc->tc_len = sizeof(tc->tc_str);
+		memcpy(tc->tc_str, timestr, tc->tc_len);
+		tc->tc_sec = sec;
+		tc->tc_format = format;
 	}
-	ND_PRINT("%s", timestr);
+	nd_out_bytes(ndo, tc->tc_str, tc->tc_len);
 
 	ts_frac_print(ndo, tv);
 }
@@ -296,7 +301,7 @@ ts_unix_print(netdissect_options *ndo, const struct timeval *tv)
 		return;
 	}
 
-	ND_PRINT("%" PRId64, (int64_t)tv->tv_sec);
+	nd_out_uint(ndo, (uint64_t)tv->tv_sec, 0);
 	ts_frac_print(ndo, tv);
 }
 
@@ -307,7 +312,6 @@ void
 ts_print(netdissect_options *ndo,
          const struct timeval *tvp)
 {
-	static struct timeval tv_ref;
 	struct timeval tv_result;
 	int negative_offset;
 	int nano_prec;
@@ -344,21 +348,21 @@ ts_print(netdissect_options *ndo,
 #else
 		nano_prec = 0;
 #endif
-		if (!(netdissect_timevalisset(&tv_ref)))
-			tv_ref = *tvp; /* set timestamp for first packet */
+		if (!(netdissect_timevalisset(&ndo->ndo_tv_ref)))
+			ndo->ndo_tv_ref = *tvp; /* set timestamp for first packet */
 
-		negative_offset = netdissect_timevalcmp(tvp, &tv_ref, <);
+		negative_offset = netdissect_timevalcmp(tvp, &ndo->ndo_tv_ref, <);
 		if (negative_offset)
-			netdissect_timevalsub(&tv_ref, tvp, &tv_result, nano_prec);
+			netdissect_timevalsub(&ndo->ndo_tv_ref, tvp, &tv_result, nano_prec);
 		else
-			netdissect_timevalsub(tvp, &tv_ref, &tv_result, nano_prec);
+			netdissect_timevalsub(tvp, &ndo->ndo_tv_ref, &tv_result, nano_prec);
 
 		ND_PRINT((negative_offset ? "-" : " "));
 		ts_date_hmsfrac_print(ndo, &tv_result, WITHOUT_DATE, UTC_TIME);
 		ND_PRINT(" ");
 
                 if (ndo->ndo_tflag == 3)
-			tv_ref = *tvp; /* set timestamp for previous packet */
+			ndo->ndo_tv_ref = *tvp; /* set timestamp for previous packet */
 		break;
 
 	case 4: /* Date + Default */
@@ -456,6 +460,8 @@ nd_format_time(char *buf, size_t bufsize, const char *format,
 void nd_print_trunc(netdissect_options *ndo)
 {
 	ND_PRINT(" [|%s]", ndo->ndo_protocol);
+	if (ndo->ndo_profile != NULL)
+		nd_profile_count(ndo, ND_PROFILE_TRUNCATED);
 }
 
 /* Print the protocol name */
@@ -476,6 +482,8 @@ void nd_print_protocol_caps(netdissect_options *ndo)
 void nd_print_invalid(netdissect_options *ndo)
 {
 	ND_PRINT(" (invalid)");
+	if (ndo->ndo_profile != NULL)
+		nd_profile_count(ndo, ND_PROFILE_INVALID);
 }
 
 /*
@@ -514,6 +522,191 @@ print_unknown_data(netdissect_options *ndo, const u_char *cp,
 	return(1); /* everything is ok */
 }
 
+/*
+ * Indexes of the tok tables, built the first time a table is used, so
+ * that tok2str() doesn't scan it.  A table with a few entries is still
+ * scanned; one whose values are in a small range is indexed by an array
+ * of the strings of all the values of the range, and the others by an
+ * array of their entries sorted by value.  As with a scan, the first
+ * entry with a value is the one found.
+ *
+ * The indexes are looked up by the address of their table, in a hash
+ * table for each thread, so they don't need locking.  If memory runs
+ * out, or the hash table fills up, the tables are scanned.
+ */
+#define TOK_INDEX_MIN_ENTRIES	8	/* smaller tables are scanned */
+#define TOK_INDEX_MAX_RANGE	65536	/* largest range of an array */
+#define TOK_INDEX_SLOTS		2048	/* a power of 2 */
+#define TOK_INDEX_MAX_TABLES	(TOK_INDEX_SLOTS / 4 * 3)
+
+enum tok_index_kind { TOK_INDEX_SCAN, TOK_INDEX_DIRECT, TOK_INDEX_SORTED };
+
+struct tok_index {
+	const struct tok *table;
+	enum tok_index_kind kind;
+	u_int bits;		/* all the values ORed, for bittok2str() */
+	u_int min;		/* smallest value */
+	u_int count;		/* number of strings or sorted entries */
+	const char **strings;	/* for the values from min to min+count-1 */
+	struct tok *sorted;	/* the first entry with each value */
+};
+
+static ND_THREAD_LOCAL struct tok_index **tok_indexes;
+static ND_THREAD_LOCAL u_int tok_indexes_count;
+static ND_THREAD_LOCAL const struct tok_index *tok_index_last;
+
+static int
+tok_ptr_cmp(const void *a, const void *b)
+{
+	const struct tok *ta = *(const struct tok * const *)a;
+	const struct tok *tb = *(const struct tok * const *)b;
+
+	if (ta->v != tb->v)
+		return ta->v < tb->v ? -1 : 1;
+	/* The same value; the entry first in the table comes first. */
+	return ta < tb ? -1 : (ta > tb ? 1 : 0);
+}
+
+static struct tok_index *
+tok_index_build(const struct tok *table)
+{
+	struct tok_index *ti;
+	const struct tok *lp, **ptrs;
+	u_int n = 0, min = UINT_MAX, max = 0, bits = 0, range, i, j;
+
+	for (lp = table; lp->s != NULL; lp++) {
+		n++;
+		bits |= lp->v;
+		if (lp->v < min)
+			min = lp->v;
+		if (lp->v > max)
+			max = lp->v;
+	}
+	range = n != 0 ? max - min : 0;
+
+	if (n < TOK_INDEX_MIN_ENTRIES) {
+		ti = calloc(1, sizeof(*ti));
+		if (ti == NULL)
+			return NULL;
+		ti->kind = TOK_INDEX_SCAN;
+	} else if (range < TOK_INDEX_MAX_RANGE && range < 4 * n + 64) {
+		ti = calloc(1, sizeof(*ti) + (range + 1) * sizeof(char *));
+		if (ti == NULL)
+			return NULL;
+		ti->kind = TOK_INDEX_DIRECT;
+		ti->strings = (const char **)(ti + 1);
+		ti->count = range + 1;
+		for (lp = table; lp->s != NULL; lp++) {
+			if (ti->strings[lp->v - min] == NULL)
+				ti->strings[lp->v - min] = lp->s;
+		}
+	} else {
+		ptrs = malloc(n * sizeof(*ptrs));
+		ti = malloc(sizeof(*ti) + n * sizeof(struct tok));
+		if (ptrs == NULL || ti == NULL) {
+			free(ptrs);
+			free(ti);
+			return NULL;
+		}
+		memset(ti, 0, sizeof(*ti));
+		ti->kind = TOK_INDEX_SORTED;
+		ti->sorted = (struct tok *)(ti + 1);
+		for (i = 0; i < n; i++)
+			ptrs[i] = &table[i];
+		qsort(ptrs, n, sizeof(*ptrs), tok_ptr_cmp);
+		for (i = j = 0; i < n; i++) {
+			if (j != 0 && ti->sorted[j - 1].v == ptrs[i]->v)
+				continue;
+			ti->sorted[j++] = *ptrs[i];
+		}
+		ti->count = j;
+		free(ptrs);
+	}
+	ti->table = table;
+	ti->bits = bits;
+	ti->min = min;
+	return ti;
+}
+
+/*
+ * Return the index of a table, building it if it's the first time the
+ * table is used, or NULL if it can't be built.
+ */
+static const struct tok_index *
+tok_index(const struct tok *table)
+{
+	struct tok_index *ti;
+	u_int i;
+
+	/* The same table is often looked up several times in a row. */
+	if (tok_index_last != NULL && tok_index_last->table == table)
+		return tok_index_last;
+	if (tok_indexes == NULL) {
+		tok_indexes = calloc(TOK_INDEX_SLOTS, sizeof(*tok_indexes));
+		if (tok_indexes == NULL)
+			return NULL;
+	}
+	i = (u_int)(((uintptr_t)table >> 4) * 0x9e3779b1U) &
+	    (TOK_INDEX_SLOTS - 1);
+	while ((ti = tok_indexes[i]) != NULL) {
+		if (ti->table == table)
+			return (tok_index_last = ti);
+		i = (i + 1) & (TOK_INDEX_SLOTS - 1);
+	}
+	if (tok_indexes_count >= TOK_INDEX_MAX_TABLES)
+		return NULL;
+	ti = tok_index_build(table);
+	if (ti == NULL)
+		return NULL;
+	tok_indexes[i] = ti;
+	tok_indexes_count++;
+	return (tok_index_last = ti);
+}
+
+/*
+ * Find the string of a value in a table, or return NULL.
+ */
+static const char *
+tok_lookup(const struct tok *lp, const u_int v)
+{
+	const struct tok_index *ti;
+	u_int lo, hi, mid;
+
+	ti = tok_index(lp);
+	if (ti != NULL) {
+		switch (ti->kind) {
+
+		case TOK_INDEX_DIRECT:
+			if (v - ti->min < ti->count)
+				return ti->strings[v - ti->min];
+			return NULL;
+
+		case TOK_INDEX_SORTED:
+			lo = 0;
+			hi = ti->count;
+			while (lo < hi) {
+				mid = lo + (hi - lo) / 2;
+				if (ti->sorted[mid].v < v)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			if (lo < ti->count && ti->sorted[lo].v == v)
+				return ti->sorted[lo].s;
+			return NULL;
+
+		case TOK_INDEX_SCAN:
+			break;
+		}
+	}
+	while (lp->s != NULL) {
+		if (lp->v == v)
+			return (lp->s);
+		++lp;
+	}
+	return NULL;
+}
+
 /*
  * Convert a token value to a string; use "fmt" if not found.
  */
@@ -521,12 +714,12 @@ static const char *
 tok2strbuf(const struct tok *lp, const char *fmt,
 	   const u_int v, char *buf, const size_t bufsize)
 {
+	const char *s;
+
 	if (lp != NULL) {
-		while (lp->s != NULL) {
-			if (lp->v == v)
-				return (lp->s);
-			++lp;
-		}
+		s = tok_lookup(lp, v);
+		if (s != NULL)
+			return (s);
 	}
 	if (fmt == NULL)
 		fmt = "#%d";
@@ -543,8 +736,8 @@ tok2strbuf(const struct tok *lp, const char *fmt,
 const char *
 tok2str(const struct tok *lp, const char *fmt, const u_int v)
 {
-	static char buf[4][TOKBUFSIZE];
-	static int idx = 0;
+	static ND_THREAD_LOCAL char buf[4][TOKBUFSIZE];
+	static ND_THREAD_LOCAL int idx = 0;
 	char *ret;
 
 	ret = buf[idx];
@@ -564,10 +757,15 @@ static char *
 bittok2str_internal(const struct tok *lp, const char *fmt,
 		    const u_int v, const char *sep)
 {
-        static char buf[1024+1]; /* our string buffer */
+        static ND_THREAD_LOCAL char buf[1024+1]; /* our string buffer */
         char *bufp = buf;
         size_t space_left = sizeof(buf), string_size;
         const char * sepstr = "";
+        const struct tok_index *ti;
+
+        /* No token can match if v has none of their bits set. */
+        if (lp != NULL && (ti = tok_index(lp)) != NULL && (v & ti->bits) == 0)
+            lp = NULL;
 
         while (lp != NULL && lp->s != NULL) {
             if (lp->v && (v & lp->v) == lp->v) {
@@ -626,7 +824,7 @@ bittok2str(const struct tok *lp, const char *fmt, const u_int v)
 const char *
 tok2strary_internal(const char **lp, int n, const char *fmt, const int v)
 {
-	static char buf[TOKBUFSIZE];
+	static ND_THREAD_LOCAL char buf[TOKBUFSIZE];
 
 	if (v >= 0 && v < n && lp[v] != NULL)
 		return lp[v];
@@ -0,0 +1,644 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#include <config.h>
+
+#include "netdissect-stdinc.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zfile.h"
+
+#ifdef HAVE_ZFILE
+
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+
+/*
+ * Size of the buffer of compressed data.
+ */
+#define ZBUF_SIZE	(128 * 1024)
+
+#define ZFILE_RAW	0	/* reading an uncompressed pipe */
+
+struct zfile {
+	FILE *f;		/* the underlying file */
+	int method;		/* ZFILE_ values, or ZFILE_RAW */
+	int writing;
+	int sync;		/* fsync() f before closing it */
+	uint64_t pos;		/* offset in the uncompressed data */
+	u_char *buf;		/* compressed data */
+	size_t len;		/* reading: length of the data in buf */
+	size_t off;		/* reading: offset of unconsumed data in buf */
+	int eof;		/* reading: the end of f has been reached */
+	int fd;			/* reading a pipe: its descriptor, else -1 */
+#ifdef HAVE_LIBZ
+	z_stream zs;
+#endif
+#ifdef HAVE_LIBZSTD
+	ZSTD_CCtx *cctx;
+	ZSTD_DCtx *dctx;
+#endif
+};
+
+static const u_char gzip_magic[] = { 0x1f, 0x8b };
+static const u_char zstd_magic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+
+/*
+ * Return the ZFILE_ value for a compression method name, or -1 if the
+ * method isn't supported.
+ */
+int
+zfile_method(const char *name)
+{
+#ifdef HAVE_LIBZ
+	if (strcmp(name, "gzip") == 0)
+		return ZFILE_GZIP;
+#endif
+#ifdef HAVE_LIBZSTD
+	if (strcmp(name, "zstd") == 0)
+		return ZFILE_ZSTD;
+#endif
+	return -1;
+}
+
+int
+zfile_max_level(int method)
+{
+	switch (method) {
+
+#ifdef HAVE_LIBZSTD
+	case ZFILE_ZSTD:
+		return ZSTD_maxCLevel();
+#endif
+
+	default:
+		return 9;
+	}
+}
+
+const char *
+zfile_suffix(int method)
+{
+	return method == ZFILE_ZSTD ? ".zst" : ".gz";
+}
+
+static void
+zfile_free(struct zfile *z)
+{
+#ifdef HAVE_LIBZSTD
+	ZSTD_freeCCtx(z->cctx);
+	ZSTD_freeDCtx(z->dctx);
+#endif
+	free(z->buf);
+	free(z);
+}
+
+/*
+ * Write out the first len bytes of the buffer of compressed data.
+ */
+static int
+zfile_write_buf(struct zfile *z, size_t len)
+{
+	if (len != 0 && fwrite(z->buf, 1, len, z->f) != len)
+		return -1;
+	return 0;
+}
+
+/*
+ * Compress size bytes of data; if finish is set, end the compressed
+ * stream.
+ */
+static int
+zfile_compress(struct zfile *z, const char *data, size_t size, int finish)
+{
+	switch (z->method) {
+
+#ifdef HAVE_LIBZ
+	case ZFILE_GZIP:
+		z->zs.next_in = (Bytef *)(uintptr_t)data;
+		z->zs.avail_in = (uInt)size;
+		for (;;) {
+			int ret;
+
+			z->zs.next_out = z->buf;
+			z->zs.avail_out = ZBUF_SIZE;
+			ret = deflate(&z->zs, finish ? Z_FINISH : Z_NO_FLUSH);
+			if (ret == Z_STREAM_ERROR) {
+				errno = EIO;
+				return -1;
+			}
+			if (zfile_write_buf(z, ZBUF_SIZE - z->zs.avail_out) == -1)
+				return -1;
+			if (finish ? ret == Z_STREAM_END :
+			    z->zs.avail_in == 0 && z->zs.avail_out != 0)
+				break;
+		}
+		return 0;
+#endif
+
+#ifdef HAVE_LIBZSTD
+	case ZFILE_ZSTD: {
+		ZSTD_inBuffer in = { data, size, 0 };
+		ZSTD_outBuffer out;
+		size_t ret;
+
+		do {
+			out.dst = z->buf;
+			out.size = ZBUF_SIZE;
+			out.pos = 0;
+			ret = ZSTD_compressStream2(z->cctx, &out, &in,
+			    finish ? ZSTD_e_end : ZSTD_e_continue);
+			if (ZSTD_isError(ret)) {
+				errno = EIO;
+				return -1;
+			}
+			if (zfile_write_buf(z, out.pos) == -1)
+				return -1;
+		} while (finish ? ret != 0 : in.pos < in.size);
+		return 0;
+	}
+#endif
+	}
+	errno = EINVAL;
+	return -1;
+}
+
+/*
+ * Read up to size bytes from the underlying file; returns 0 at the end
+ * of the file.  A pipe is read with a single read(), so that we get
+ * what has arrived so far instead of waiting for size bytes, which
+ * might take forever when the packets are coming from a capture.
+ */
+static ssize_t
+zfile_input(struct zfile *z, void *dst, size_t size)
+{
+	ssize_t n;
+
+	if (z->fd == -1) {
+		n = (ssize_t)fread(dst, 1, size, z->f);
+		if (n == 0 && ferror(z->f))
+			return -1;
+		return n;
+	}
+	do
+		n = read(z->fd, dst, size);
+	while (n == -1 && errno == EINTR);
+	return n;
+}
+
+/*
+ * Read more compressed data into the buffer; returns 0 at the end of
+ * the file.
+ */
+static int
+zfile_fill(struct zfile *z)
+{
+	ssize_t n;
+
+	if (z->eof)
+		return 0;
+	n = zfile_input(z, z->buf, ZBUF_SIZE);
+	if (n == -1)
+		return -1;
+	z->len = (size_t)n;
+	z->off = 0;
+	if (z->len == 0) {
+		z->eof = 1;
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Whether decompression should stop and return the data it has so far
+ * instead of reading more input, which, from a pipe, might block.
+ */
+#define ZFILE_HAVE_ENOUGH(z, n)	((n) != 0 && (z)->fd != -1)
+
+static ssize_t
+zfile_read_raw(struct zfile *z, char *dst, size_t size)
+{
+	size_t n = 0;
+	ssize_t ret;
+
+	/* First the bytes read to look for a magic number. */
+	if (z->off < z->len) {
+		n = z->len - z->off;
+		if (n > size)
+			n = size;
+		memcpy(dst, z->buf + z->off, n);
+		z->off += n;
+	}
+	if (n < size && !ZFILE_HAVE_ENOUGH(z, n)) {
+		ret = zfile_input(z, dst + n, size - n);
+		if (ret == -1)
+			return -1;
+		n += (size_t)ret;
+	}
+	return (ssize_t)n;
+}
+
+/*
+ * Decompress up to size bytes of data.
+ */
+static ssize_t
+zfile_decompress(struct zfile *z, char *dst, size_t size)
+{
+	switch (z->method) {
+
+	case ZFILE_RAW:
+		return zfile_read_raw(z, dst, size);
+
+#ifdef HAVE_LIBZ
+	case ZFILE_GZIP:
+		z->zs.next_out = (Bytef *)dst;
+		z->zs.avail_out = (uInt)size;
+		while (z->zs.avail_out != 0) {
+			int ret;
+
+			if (z->off == z->len) {
+				if (ZFILE_HAVE_ENOUGH(z,
+				    size - z->zs.avail_out))
+					break;
+				ret = zfile_fill(z);
+				if (ret == -1)
+					return -1;
+				if (ret == 0)
+					break;
+			}
+			z->zs.next_in = z->buf + z->off;
+			z->zs.avail_in = (uInt)(z->len - z->off);
+			ret = inflate(&z->zs, Z_NO_FLUSH);
+			z->off = z->len - z->zs.avail_in;
+			if (ret == Z_STREAM_END) {
+				/* Another gzip member may follow. */
+				inflateReset(&z->zs);
+			} else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+				errno = EIO;
+				return -1;
+			}
+		}
+		return (ssize_t)(size - z->zs.avail_out);
+#endif
+
+#ifdef HAVE_LIBZSTD
+	case ZFILE_ZSTD: {
+		ZSTD_outBuffer out = { dst, size, 0 };
+
+		while (out.pos < out.size) {
+			ZSTD_inBuffer in;
+			size_t ret;
+
+			if (z->off == z->len) {
+				int fill;
+
+				if (ZFILE_HAVE_ENOUGH(z, out.pos))
+					break;
+				fill = zfile_fill(z);
+
+				if (fill == -1)
+					return -1;
+				if (fill == 0)
+					break;
+			}
+			in.src = z->buf;
+			in.size = z->len;
+			in.pos = z->off;
+			ret = ZSTD_decompressStream(z->dctx, &out, &in);
+			z->off = in.pos;
+			if (ZSTD_isError(ret)) {
+				errno = EIO;
+				return -1;
+			}
+		}
+		return (ssize_t)out.pos;
+	}
+#endif
+	}
+	errno = EINVAL;
+	return -1;
+}
+
+static ssize_t
+zfile_read(void *cookie, char *buf, size_t size)
+{
+	struct zfile *z = cookie;
+	ssize_t n;
+
+	n = zfile_decompress(z, buf, size);
+	if (n > 0)
+		z->pos += n;
+	return n;
+}
+
+static ssize_t
+zfile_write(void *cookie, const char *buf, size_t size)
+{
+	struct zfile *z = cookie;
+
+	if (zfile_compress(z, buf, size, 0) == -1)
+		return -1;
+	z->pos += size;
+	return (ssize_t)size;
+}
+
+/*
+ * The only seek supported is the one done by ftell(), which gets the
+ * offset in the uncompressed data; that's what -C compares with the
+ * file size limit.
+ */
+static int
+zfile_tell(void *cookie, int64_t *offset, int whence)
+{
+	struct zfile *z = cookie;
+
+	if (whence != SEEK_CUR || *offset != 0) {
+		errno = ESPIPE;
+		return -1;
+	}
+	*offset = (int64_t)z->pos;
+	return 0;
+}
+
+static int
+zfile_close(void *cookie)
+{
+	struct zfile *z = cookie;
+	int ret = 0;
+
+	if (z->writing) {
+		/*
+		 * Finish the compressed stream, and make sure it's on
+		 * stable storage if asked to.
+		 */
+		if (zfile_compress(z, NULL, 0, 1) == -1 ||
+		    fflush(z->f) == EOF)
+			ret = -1;
+		else if (z->sync && fsync(fileno(z->f)) == -1 &&
+		    errno != EINVAL && errno != EROFS)
+			ret = -1;
+	}
+	if (z->f != stdin && z->f != stdout && fclose(z->f) == EOF)
+		ret = -1;
+#ifdef HAVE_LIBZ
+	if (z->method == ZFILE_GZIP) {
+		if (z->writing)
+			deflateEnd(&z->zs);
+		else
+			inflateEnd(&z->zs);
+	}
+#endif
+	zfile_free(z);
+	return ret;
+}
+
+#ifdef HAVE_FOPENCOOKIE
+static int
+zfile_seek(void *cookie, off64_t *offset, int whence)
+{
+	int64_t off = *offset;
+
+	if (zfile_tell(cookie, &off, whence) == -1)
+		return -1;
+	*offset = off;
+	return 0;
+}
+
+static FILE *
+zfile_fopen(struct zfile *z)
+{
+	cookie_io_functions_t funcs;
+
+	funcs.read = z->writing ? NULL : zfile_read;
+	funcs.write = z->writing ? zfile_write : NULL;
+	funcs.seek = zfile_seek;
+	funcs.close = zfile_close;
+	return fopencookie(z, z->writing ? "w" : "r", funcs);
+}
+#else /* HAVE_FUNOPEN */
+static int
+zfile_funopen_read(void *cookie, char *buf, int size)
+{
+	return (int)zfile_read(cookie, buf, (size_t)size);
+}
+
+static int
+zfile_funopen_write(void *cookie, const char *buf, int size)
+{
+	return (int)zfile_write(cookie, buf, (size_t)size);
+}
+
+static fpos_t
+zfile_funopen_seek(void *cookie, fpos_t offset, int whence)
+{
+	int64_t off = offset;
+
+	if (zfile_tell(cookie, &off, whence) == -1)
+		return -1;
+	return (fpos_t)off;
+}
+
+static FILE *
+zfile_fopen(struct zfile *z)
+{
+	return funopen(z, z->writing ? NULL : zfile_funopen_read,
+	    z->writing ? zfile_funopen_write : NULL, zfile_funopen_seek,
+	    zfile_close);
+}
+#endif
+
+static struct zfile *
+zfile_alloc(FILE *f, int method, int writing)
+{
+	struct zfile *z;
+
+	z = calloc(1, sizeof(*z));
+	if (z == NULL)
+		return NULL;
+	z->buf = malloc(ZBUF_SIZE);
+	if (z->buf == NULL) {
+		free(z);
+		return NULL;
+	}
+	z->f = f;
+	z->method = method;
+	z->writing = writing;
+	z->fd = -1;
+	return z;
+}
+
+/*
+ * Return a stream that compresses what's written to it with the given
+ * method and level (0 for the default level) and writes it to f.
+ * Closing the stream ends the compressed stream and closes f, after
+ * calling fsync() on it if sync is set.
+ *
+ * Returns NULL, with errno set, on failure.
+ */
+FILE *
+zfile_wrap_write(FILE *f, int method, int level, int sync)
+{
+	struct zfile *z;
+	FILE *zf;
+
+	z = zfile_alloc(f, method, 1);
+	if (z == NULL)
+		return NULL;
+	z->sync = sync;
+	switch (method) {
+
+#ifdef HAVE_LIBZ
+	case ZFILE_GZIP:
+		/* 16 + the maximum window size means a gzip header. */
+		if (deflateInit2(&z->zs,
+		    level == 0 ? Z_DEFAULT_COMPRESSION : level, Z_DEFLATED,
+		    16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+			zfile_free(z);
+			errno = ENOMEM;
+			return NULL;
+		}
+		break;
+#endif
+
+#ifdef HAVE_LIBZSTD
+	case ZFILE_ZSTD:
+		z->cctx = ZSTD_createCCtx();
+		if (z->cctx == NULL) {
+			zfile_free(z);
+			errno = ENOMEM;
+			return NULL;
+		}
+		if (level != 0)
+			ZSTD_CCtx_setParameter(z->cctx,
+			    ZSTD_c_compressionLevel, level);
+		break;
+#endif
+
+	default:
+		zfile_free(z);
+		errno = EINVAL;
+		return NULL;
+	}
+	zf = zfile_fopen(z);
+	if (zf == NULL) {
+#ifdef HAVE_LIBZ
+		if (method == ZFILE_GZIP)
+			deflateEnd(&z->zs);
+#endif
+		zfile_free(z);
+	}
+	return zf;
+}
+
+/*
+ * If f, which is at its beginning, is compressed with a method we
+ * support, return a stream from which the decompressed data can be
+ * read; otherwise return f, or, if f can't be rewound, a stream that
+ * reads it as it is.  Closing the returned stream closes f.
+ *
+ * Returns NULL, with errno set, on failure.
+ */
+FILE *
+zfile_wrap_read(FILE *f)
+{
+	u_char magic[sizeof(zstd_magic)];
+	size_t n;
+	int is_pipe, method;
+	struct zfile *z;
+	FILE *zf;
+
+	/*
+	 * A pipe is read unbuffered, so that none of what's read is
+	 * held in the buffer of f, where zfile_input() wouldn't see it.
+	 */
+	is_pipe = lseek(fileno(f), 0, SEEK_CUR) == -1;
+	if (is_pipe)
+		setvbuf(f, NULL, _IONBF, 0);
+	n = fread(magic, 1, sizeof(magic), f);
+	if (n >= sizeof(gzip_magic) &&
+	    memcmp(magic, gzip_magic, sizeof(gzip_magic)) == 0)
+		method = ZFILE_GZIP;
+	else if (n >= sizeof(zstd_magic) &&
+	    memcmp(magic, zstd_magic, sizeof(zstd_magic)) == 0)
+		method = ZFILE_ZSTD;
+	else {
+		if (fseek(f, 0, SEEK_SET) == 0)
+			return f;
+		method = ZFILE_RAW;
+	}
+#ifndef HAVE_LIBZ
+	if (method == ZFILE_GZIP) {
+		errno = EPROTONOSUPPORT;
+		return NULL;
+	}
+#endif
+#ifndef HAVE_LIBZSTD
+	if (method == ZFILE_ZSTD) {
+		errno = EPROTONOSUPPORT;
+		return NULL;
+	}
+#endif
+
+	z = zfile_alloc(f, method, 0);
+	if (z == NULL)
+		return NULL;
+	/* The bytes read above are the first of the input. */
+	memcpy(z->buf, magic, n);
+	z->len = n;
+	if (is_pipe)
+		z->fd = fileno(f);
+	switch (method) {
+
+#ifdef HAVE_LIBZ
+	case ZFILE_GZIP:
+		if (inflateInit2(&z->zs, 16 + MAX_WBITS) != Z_OK) {
+			zfile_free(z);
+			errno = ENOMEM;
+			return NULL;
+		}
+		break;
+#endif
+
+#ifdef HAVE_LIBZSTD
+	case ZFILE_ZSTD:
+		z->dctx = ZSTD_createDCtx();
+		if (z->dctx == NULL) {
+			zfile_free(z);
+			errno = ENOMEM;
+			return NULL;
+		}
+		break;
+#endif
+	}
+	zf = zfile_fopen(z);
+	if (zf == NULL) {
+#ifdef HAVE_LIBZ
+		if (method == ZFILE_GZIP)
+			inflateEnd(&z->zs);
+#endif
+		zfile_free(z);
+	}
+	return zf;
+}
+#endif /* HAVE_ZFILE */
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef zfile_h
+#define zfile_h
+
+/*
+ * Compressed savefiles ("--compress", and reading compressed savefiles
+ * with -r and -V).
+ *
+ * A compressed savefile is read or written through a standard I/O
+ * stream that compresses or decompresses on the fly, so that libpcap
+ * can read and write it with pcap_fopen_offline() and
+ * pcap_dump_fopen().  This requires zlib or libzstd, and
+ * fopencookie() or funopen() to create the streams.
+ */
+#define ZFILE_GZIP	1
+#define ZFILE_ZSTD	2
+
+#if (defined(HAVE_FOPENCOOKIE) || defined(HAVE_FUNOPEN)) && \
+    (defined(HAVE_LIBZ) || defined(HAVE_LIBZSTD))
+#define HAVE_ZFILE
+
+extern int zfile_method(const char *);
+extern int zfile_max_level(int);
+extern const char *zfile_suffix(int);
+extern FILE *zfile_wrap_write(FILE *, int, int, int);
+extern FILE *zfile_wrap_read(FILE *);
+#endif
+
+#endif /* zfile_h */